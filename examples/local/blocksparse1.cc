@@ -0,0 +1,171 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <tensor/block_sparse_tensor.h>
+#include <tensor/dense_tensor.h>
+#include <tensor/indices.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+/*
+ * Checks of block-sparse tensors against dense tensors holding the same elements (with zeros in the blocks which are
+ * not stored): contractions, permuted sums, scaling, and dot products, over explicitly listed (spin) blocks and over
+ * the irrep blocks of index ranges with several subblocks; returns nonzero if any fails
+ */
+
+using namespace ambit::tensor;
+
+/*
+ * A dense tensor with the blocks of A at their offsets along each index and zeros elsewhere
+ */
+static DenseTensor<double> to_dense(const BlockSparseTensor<double>& A)
+{
+    const int ndim = A.getDimension();
+    const std::string idx = std::string("abcdefgh").substr(0, ndim);
+    std::vector<int> len(ndim, 0), nblock(ndim);
+
+    for (int i = 0;i < ndim;i++)
+    {
+        nblock[i] = A.getNumBlocks(i);
+        for (int b = 0;b < nblock[i];b++) len[i] += A.getBlockLengths(i)[b];
+    }
+
+    DenseTensor<double> D(A.getName(), len);
+
+    std::vector<int> block(ndim, 0);
+    for (bool done = false;!done;)
+    {
+        if (A.exists(block))
+        {
+            std::vector<int> start(ndim, 0), block_len(ndim);
+            for (int i = 0;i < ndim;i++)
+            {
+                for (int b = 0;b < block[i];b++) start[i] += A.getBlockLengths(i)[b];
+                block_len[i] = A.getBlockLengths(i)[block[i]];
+            }
+
+            DenseTensor<double> view = D.slice(start, block_len);
+            view[idx] = A.getBlock(block)[idx];
+        }
+
+        done = true;
+        for (int i = 0;i < ndim;i++)
+        {
+            if (++block[i] < nblock[i])
+            {
+                done = false;
+                break;
+            }
+            block[i] = 0;
+        }
+    }
+
+    return D;
+}
+
+/*
+ * The largest difference between the elements of A and B relative to the largest element of B
+ */
+static double diff(const DenseTensor<double>& A, const DenseTensor<double>& B)
+{
+    double d = 0, norm = 1;
+    for (uint64_t i = 0;i < B.getSize();i++)
+    {
+        d = std::max(d, std::abs(A.get_data()[i]-B.get_data()[i]));
+        norm = std::max(norm, std::abs(B.get_data()[i]));
+    }
+    return d/norm;
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    /*
+     * alpha and beta spin blocks of one-index operators, with the mixed blocks not stored
+     */
+    const std::vector< std::vector<int> > spin_len = {{2,3}, {2,3}}, spin_blocks = {{0,0}, {1,1}};
+    BlockSparseTensor<double> F("F", spin_len, spin_blocks), G("G", spin_len, spin_blocks);
+    BlockSparseTensor<double> H("H", spin_len, spin_blocks);
+
+    F.fill_with_random_data();
+    G.fill_with_random_data();
+    H.fill_with_random_data();
+
+    check(H.getStoredSize() == 2*2+3*3 && !H.exists({0,1}) && H.exists({1,1}),
+          "only the listed spin blocks are stored");
+
+    DenseTensor<double> DF = to_dense(F), DG = to_dense(G), DH = to_dense(H);
+
+    H["ij"] = F["ik"]*G["kj"];
+    DH["ij"] = DF["ik"]*DG["kj"];
+    check(diff(to_dense(H), DH) < 1e-12, "a product of spin-blocked matrices matches the dense product");
+
+    H["ij"] += F["ji"];
+    DH["ij"] += DF["ji"];
+    check(diff(to_dense(H), DH) < 1e-12, "a transposed sum of spin-blocked matrices matches the dense sum");
+
+    /*
+     * two irreps in each index range; blocks of a totally symmetric tensor have block numbers whose exclusive-or
+     * is zero
+     */
+    declare_index_range("occupied", "i,j,k,l", {0, 3}, {3, 5});
+    declare_index_range("virtual", "a,b,c,d", {0, 4}, {4, 7});
+
+    BlockSparseTensor<double> T("T", "i,j,a,b"), V("V", "a,b,c,d"), R("R", "i,j,a,b"), X("X", "i,a", 1);
+
+    T.fill_with_random_data();
+    V.fill_with_random_data();
+    R.fill_with_random_data();
+    X.fill_with_random_data();
+
+    uint64_t stored = 0;
+    for (int i = 0;i < 2;i++)
+        for (int j = 0;j < 2;j++)
+            for (int a = 0;a < 2;a++)
+                stored += (uint64_t)(3-i)*(3-j)*(4-a)*(4-(i^j^a));
+    check(T.getStoredSize() == stored && !T.exists({0,0,0,1}) && T.exists({1,0,0,1}),
+          "only the totally symmetric irrep blocks are stored");
+    check(X.getStoredSize() == 3*3+2*4 && X.exists({0,1}) && !X.exists({1,1}),
+          "only the blocks of a tensor of the second irrep are stored");
+
+    DenseTensor<double> DT = to_dense(T), DV = to_dense(V), DR = to_dense(R), DX = to_dense(X);
+
+    R["ijab"] *= 0.5;
+    DR["ijab"] *= 0.5;
+    R["ijab"] += T["ijcd"]*V["cdab"];
+    DR["ijab"] += DT["ijcd"]*DV["cdab"];
+    check(diff(to_dense(R), DR) < 1e-12, "a contraction of irrep-blocked tensors matches the dense contraction");
+
+    R["ijab"] -= T["jiba"];
+    DR["ijab"] -= DT["jiba"];
+    check(diff(to_dense(R), DR) < 1e-12, "a permuted sum of irrep-blocked tensors matches the dense sum");
+
+    BlockSparseTensor<double> Y("Y", "i,a", 1);
+    Y["ia"] = T["ijab"]*X["jb"];
+    DenseTensor<double> DY = to_dense(Y);
+    DY["ia"] = DT["ijab"]*DX["jb"];
+    check(diff(to_dense(Y), DY) < 1e-12, "a product with a tensor of the second irrep matches the dense product");
+
+    const double dot = R.dot(T), ddot = DR.dot(DT);
+    check(std::abs(dot-ddot) < 1e-12*std::max(1.0, std::abs(ddot)), "the dot product matches the dense one");
+
+    return finish();
+}
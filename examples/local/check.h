@@ -0,0 +1,60 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#if !defined(AMBIT_EXAMPLES_LOCAL_CHECK)
+#define AMBIT_EXAMPLES_LOCAL_CHECK
+
+#include <iostream>
+#include <string>
+
+/*
+ * The checks made by the examples: check prints each result, finish prints a summary and gives the exit status,
+ * and throws tells whether f throws an E (printing its message). With print false (e.g. on all but one process)
+ * the failures are counted without printing anything.
+ */
+
+static int failures = 0;
+
+static void check(const bool ok, const std::string& what, const bool print = true)
+{
+    if (print) std::cout << (ok ? "ok     " : "FAILED ") << what << std::endl;
+    if (!ok) failures++;
+}
+
+template <class E, class F>
+static bool throws(F f, const bool print = true)
+{
+    try
+    {
+        f();
+    }
+    catch (E& e)
+    {
+        if (print) std::cout << "       " << e.what() << std::endl;
+        return true;
+    }
+    return false;
+}
+
+static int finish(const bool print = true)
+{
+    if (print) std::cout << (failures == 0 ? "all passed" : "some failed") << std::endl;
+    return (failures == 0 ? 0 : 1);
+}
+
+#endif
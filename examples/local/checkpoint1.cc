@@ -0,0 +1,80 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <tensor/cyclops_tensor.h>
+#include <tensor/tensor_file.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/*
+ * Checks of CyclopsTensor::checkpoint and restart (see tensor/cyclops_tensor.h): a tensor is written and read back
+ * into another with a different name and shape, and a file which is not a checkpoint is rejected; run on any number
+ * of processes, returns nonzero if any check fails on any of them
+ */
+
+using namespace ambit;
+using namespace ambit::tensor;
+
+int main(int argc, char** argv)
+{
+    MPI::Init(argc, argv);
+
+    {
+        util::World world;
+        int bad = 0;
+        const std::string path = "checkpoint1.ckp";
+        const std::vector<int> len = {7, 11, 13}, sym = {NS, NS, NS};
+
+        CyclopsTensor<double> A("amplitudes", world, len, sym);
+        std::vector<tkv_pair<double> > pairs;
+        A.read_local(pairs);
+        for (size_t i = 0;i < pairs.size();i++) pairs[i].d = 0.5*pairs[i].k+1;
+        A.write(pairs);
+        A.checkpoint(path);
+
+        CyclopsTensor<double> B("scratch", world, std::vector<int>(1, 2), std::vector<int>(1, NS));
+        B.restart(path);
+        if (B.getName() != "amplitudes" || B.getLengths() != len) bad++;
+
+        B.read_local(pairs);
+        for (size_t i = 0;i < pairs.size();i++)
+            if (pairs[i].d != 0.5*pairs[i].k+1) bad++;
+
+        const std::string other = "checkpoint1.tns";
+        if (world.rank == 0) save_tensor(other, DenseTensor<double>("A", std::vector<int>{2,2}));
+        world.get_comm().Barrier();
+
+        if (!throws<TensorFileError>([&] { B.restart(other); }, world.rank == 0)) bad++;
+
+        world.allreduce(&bad, 1);
+        check(bad == 0, "checkpoint and restart on " + std::to_string(world.nproc) + " processes", world.rank == 0);
+
+        if (world.rank == 0)
+        {
+            remove(path.c_str());
+            remove(other.c_str());
+        }
+    }
+
+    MPI::Finalize();
+
+    return finish(false);
+}
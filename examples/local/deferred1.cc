@@ -0,0 +1,200 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <tensor/dense_tensor.h>
+#include <util/memory.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+/*
+ * Checks of deferred evaluation (see tensor/deferred.h): scalings folded into other terms, contractions shared
+ * between terms, and nested Deferreds, each against immediate evaluation; returns nonzero if any fails
+ */
+
+using ambit::tensor::DenseTensor;
+typedef ambit::tensor::Deferred< DenseTensor<double>, double > Deferred;
+
+static double max_diff(const DenseTensor<double>& A, const DenseTensor<double>& B)
+{
+    double d = 0;
+    for (size_t i = 0;i < A.getSize();i++) d = std::max(d, std::abs(A.get_data()[i]-B.get_data()[i]));
+    return d;
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    const int o = 4, v = 6;
+
+    DenseTensor<double> T2("T2", std::vector<int>{o,o,v,v}), V("V", std::vector<int>{v,v,v,v});
+    DenseTensor<double> R("R", std::vector<int>{o,o,v,v}), S("S", std::vector<int>{v,v,o,o});
+    T2.fill_with_random_data();
+    V.fill_with_random_data();
+    R.fill_with_random_data();
+    S.fill_with_random_data();
+
+    DenseTensor<double> R0("R0", R), S0("S0", S);
+
+    /*
+     * R *= 0.5 is folded into the beta of the next term writing R, and T2*V is evaluated once for R and S
+     */
+    R0["ijab"] *= 0.5;
+    R0["ijab"] += T2["ijcd"]*V["cdab"];
+    S0["abkl"] -= T2["klcd"]*V["cdab"];
+
+    {
+        Deferred deferred;
+        R["ijab"] *= 0.5;
+        R["ijab"] += T2["ijcd"]*V["cdab"];
+        S["abkl"] -= T2["klcd"]*V["cdab"];
+        deferred.flush();
+
+        check(deferred.getNumFolded() == 1, "a scaling is folded into the next term");
+        check(deferred.getNumReused() == 1, "a repeated contraction is evaluated once");
+        deferred.printReport();
+    }
+
+    check(max_diff(R, R0) < 1e-12 && max_diff(S, S0) < 1e-12, "the deferred terms match immediate evaluation");
+
+    /*
+     * an inner Deferred reading a tensor written in the outer one sees the outer term evaluated first
+     */
+    DenseTensor<double> A("A", std::vector<int>{o,v}), B("B", std::vector<int>{v,o}), Y("Y", std::vector<int>{o,o});
+    DenseTensor<double> X("X", std::vector<int>{o,o}), Z("Z", std::vector<int>{o,o});
+    A.fill_with_random_data();
+    B.fill_with_random_data();
+    Y.fill_with_random_data();
+
+    DenseTensor<double> X0("X0", std::vector<int>{o,o}), Z0("Z0", std::vector<int>{o,o});
+    X0["ij"] = A["ia"]*B["aj"];
+    Z0["ij"] = X0["ik"]*Y["kj"];
+
+    {
+        Deferred outer;
+        X["ij"] = A["ia"]*B["aj"];
+        {
+            Deferred inner;
+            Z["ij"] = X["ik"]*Y["kj"];
+        }
+        check(outer.getNumTerms() == 0, "flushing an inner Deferred flushes the outer one");
+    }
+
+    check(max_diff(X, X0) < 1e-12 && max_diff(Z, Z0) < 1e-12, "nested Deferreds match immediate evaluation");
+
+    /*
+     * reading a scalar in an inner Deferred flushes the outer one as well
+     */
+    {
+        Deferred outer;
+        X["ij"] = 2.0*A["ia"]*B["aj"];
+        {
+            Deferred inner;
+            const double s = ambit::scalar(X["ij"]*Y["ij"]);
+            double s0 = 0;
+            for (int i = 0;i < o*o;i++) s0 += 2*X0.get_data()[i]*Y.get_data()[i];
+            check(std::abs(s-s0) < 1e-12, "a scalar read in an inner Deferred sees the outer terms");
+        }
+    }
+
+    /*
+     * a view and its parent are ordered as the same tensor: the scaling of P is not folded past a read of W, the
+     * second W*Y2 is not shared with the first across a write of P (while A*B is), and P += ... does not jump ahead
+     * of a write of W
+     */
+    DenseTensor<double> P("P", std::vector<int>{o,o}), Q("Q", std::vector<int>{o,2}), Y2("Y2", std::vector<int>{2,o});
+    DenseTensor<double> Q1("Q1", std::vector<int>{o,o}), Q2("Q2", std::vector<int>{o,o});
+    P.fill_with_random_data();
+    Y2.fill_with_random_data();
+
+    DenseTensor<double> P0("P0", P), Q0("Q0", Q), Q10("Q10", Q1), Q20("Q20", Q2);
+    {
+        DenseTensor<double> W0 = P0.slice({0,0}, {o,2});
+        P0["ij"] *= 0.5;
+        Q0["ij"] = W0["ij"];
+        P0["ij"] = A["ia"]*B["aj"];
+        Q10["ij"] = W0["ik"]*Y2["kj"];
+        P0["ij"] = X0["ij"];
+        Q20["ij"] = W0["ik"]*Y2["kj"];
+        P0["ij"] = A["ia"]*B["aj"];
+        W0["ij"] = 3.0*Q0["ij"];
+        P0["ij"] += Y["ij"];
+    }
+
+    {
+        DenseTensor<double> W = P.slice({0,0}, {o,2});
+        Deferred deferred;
+        P["ij"] *= 0.5;
+        Q["ij"] = W["ij"];
+        P["ij"] = A["ia"]*B["aj"];
+        Q1["ij"] = W["ik"]*Y2["kj"];
+        P["ij"] = X0["ij"];
+        Q2["ij"] = W["ik"]*Y2["kj"];
+        P["ij"] = A["ia"]*B["aj"];
+        W["ij"] = 3.0*Q["ij"];
+        P["ij"] += Y["ij"];
+        deferred.flush();
+
+        check(deferred.getNumFolded() == 0 && deferred.getNumReused() == 1 &&
+              deferred.getReused()[0].expr.find("P[") == std::string::npos,
+              "terms on a view are not folded or shared across writes of its parent");
+    }
+
+    check(max_diff(P, P0) < 1e-12 && max_diff(Q, Q0) < 1e-12 && max_diff(Q1, Q10) < 1e-12 &&
+          max_diff(Q2, Q20) < 1e-12, "terms on a view and its parent match immediate evaluation");
+
+    /*
+     * an error in a flush (here the memory budget running out for a shared intermediate) is thrown by an explicit
+     * flush, and only reported by the destructor
+     */
+    {
+        Deferred deferred;
+        R["ijab"] += T2["ijcd"]*V["cdab"];
+        S["abkl"] -= T2["klcd"]*V["cdab"];
+
+        ambit::util::ambit_memory_set_budget(ambit::util::ambit_memory_used()+1);
+
+        bool threw = false;
+        try
+        {
+            deferred.flush();
+        }
+        catch (std::bad_alloc&)
+        {
+            threw = true;
+        }
+
+        check(threw && Deferred::active() == &deferred && deferred.getNumTerms() == 0,
+              "a failed flush throws and leaves the Deferred active and empty");
+
+        {
+            Deferred inner;
+            R["ijab"] += T2["ijcd"]*V["cdab"];
+            S["abkl"] -= T2["klcd"]*V["cdab"];
+        }
+        check(Deferred::active() == &deferred, "a failed flush in the destructor does not throw");
+
+        ambit::util::ambit_memory_set_budget(0);
+    }
+
+    return finish();
+}
@@ -0,0 +1,137 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <tensor/dense_tensor.h>
+#include <tensor/disk_tensor.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <dirent.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Checks of disk-backed tensors against dense tensors holding the same elements: tiling, reading and writing,
+ * contractions and sums over operands with different tilings, scaling, elementwise division, and dot products, and
+ * that no files are left in the disk directory; returns nonzero if any fails
+ */
+
+using namespace ambit::tensor;
+
+static DenseTensor<double> to_dense(const DiskTensor<double>& A)
+{
+    DenseTensor<double> D(A.getName(), A.getLengths());
+    A.read(D);
+    return D;
+}
+
+/*
+ * The largest difference between the elements of A and B relative to the largest element of B
+ */
+static double diff(const DenseTensor<double>& A, const DenseTensor<double>& B)
+{
+    double d = 0, norm = 1;
+    for (uint64_t i = 0;i < B.getSize();i++)
+    {
+        d = std::max(d, std::abs(A.get_data()[i]-B.get_data()[i]));
+        norm = std::max(norm, std::abs(B.get_data()[i]));
+    }
+    return d/norm;
+}
+
+static int count_files(const std::string& dir)
+{
+    int n = 0;
+    DIR* d = opendir(dir.c_str());
+    if (d == NULL) return -1;
+    for (dirent* e = readdir(d);e != NULL;e = readdir(d))
+        if (std::string(e->d_name) != "." && std::string(e->d_name) != "..") n++;
+    closedir(d);
+    return n;
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    char dir[] = "/tmp/disk1.XXXXXX";
+    if (mkdtemp(dir) == NULL) return 1;
+    const std::string previous = tensor_get_disk_directory();
+    tensor_set_disk_directory(dir);
+
+    {
+        /*
+         * tiles of a few kilobytes, so that every operand is split into several, and differently for B and C
+         */
+        const int o = 5, v = 9;
+        DiskTensor<double> A("A", std::vector<int>{o,o,v,v}, 4096), B("B", std::vector<int>{v,v,v,v}, 8192);
+        DiskTensor<double> C("C", std::vector<int>{v,v,o,o}, 2048), R("R", std::vector<int>{o,o,v,v}, 4096);
+        A.fill_with_random_data();
+        B.fill_with_random_data();
+        C.fill_with_random_data();
+        R.fill_with_random_data();
+
+        check(A.getNumTiles() > 1 && B.getNumTiles() > 1 && C.getNumTiles() > 1 &&
+              (A.getNumTiles()-1)*A.getTileLength() < v && A.getNumTiles()*A.getTileLength() >= v,
+              "the tiles cover the last index");
+        check(count_files(dir) == 0, "no files are left in the disk directory");
+
+        DenseTensor<double> DA = to_dense(A), DB = to_dense(B), DC = to_dense(C), DR = to_dense(R);
+
+        DenseTensor<double> tile = A.readTile(1);
+        DenseTensor<double> part = DA.slice({0, 0, 0, A.getTileLength()},
+                                            {o, o, v, std::min(A.getTileLength(), v-A.getTileLength())});
+        bool same = tile.getLengths() == part.getLengths();
+        for (int i = 0;same && i < o;i++)
+            for (int j = 0;same && j < o;j++)
+                for (int a = 0;same && a < v;a++)
+                    for (int b = 0;same && b < part.getLengths()[3];b++)
+                        same = tile.get_data()[i+o*(j+o*(a+v*b))] ==
+                               DA.get_data()[i+o*(j+o*(a+v*(b+A.getTileLength())))];
+        check(same, "a tile holds its part of the tensor");
+
+        DenseTensor<double> W("W", R.getLengths());
+        W.fill_with_random_data();
+        DiskTensor<double> X("X", R);
+        X.write(W);
+        check(diff(to_dense(X), W) == 0, "writing a dense tensor and reading it back");
+
+        R["ijcd"] *= 0.5;
+        DR["ijcd"] *= 0.5;
+        R["ijcd"] += A["ijab"]*B["abcd"];
+        DR["ijcd"] += DA["ijab"]*DB["abcd"];
+        check(diff(to_dense(R), DR) < 1e-12, "a contraction of tiled operands matches the dense contraction");
+
+        R["ijab"] -= C["baji"];
+        DR["ijab"] -= DC["baji"];
+        check(diff(to_dense(R), DR) < 1e-12, "a permuted sum across tilings matches the dense sum");
+
+        X.div(2.0, R, A, 0.0);
+        W.div(2.0, DR, DA, 0.0);
+        check(diff(to_dense(X), W) < 1e-12, "elementwise division matches the dense division");
+
+        const double dot = R.dot(A, "ijab", "ijab"), ddot = DR.dot(DA, "ijab", "ijab");
+        check(std::abs(dot-ddot) < 1e-12*std::max(1.0, std::abs(ddot)), "the dot product matches the dense one");
+    }
+
+    tensor_set_disk_directory(previous);
+    rmdir(dir);
+
+    return finish();
+}
@@ -0,0 +1,129 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <tensor/cyclops_tensor.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+/*
+ * Checks of the dot products and norms of distributed tensors (see tensor/cyclops_tensor.h) against sums over the
+ * same elements computed on every process: single and batched dot products, including after a map which would
+ * write nonzero values into any padding, a dot product with the indices transposed, and each norm; run on any
+ * number of processes, returns nonzero if any check fails on any of them
+ */
+
+using namespace ambit;
+using namespace ambit::tensor;
+
+/*
+ * The value of element k of operand n
+ */
+static double value(const int n, const int64_t k)
+{
+    return std::sin(0.1*(n+1)*k + n);
+}
+
+static void set_values(CyclopsTensor<double>& A, const int n)
+{
+    std::vector<tkv_pair<double> > pairs;
+    A.read_local(pairs);
+    for (size_t i = 0;i < pairs.size();i++) pairs[i].d = value(n, pairs[i].k);
+    A.write(pairs);
+}
+
+static bool close(const double a, const double b)
+{
+    return std::abs(a-b) < 1e-12*std::max(1.0, std::abs(b));
+}
+
+int main(int argc, char** argv)
+{
+    MPI::Init(argc, argv);
+
+    {
+        util::World world;
+        int bad = 0;
+        const std::vector<int> len = {7, 11, 13}, sym = {NS, NS, NS};
+        const int64_t size = 7*11*13;
+
+        CyclopsTensor<double> X0("X0", world, len, sym), X1("X1", world, len, sym), X2("X2", world, len, sym);
+        CyclopsTensor<double>* X[] = {&X0, &X1, &X2};
+        for (int n = 0;n < 3;n++) set_values(*X[n], n);
+
+        double dot = 0, norm1 = 0, norm2 = 0, norm_inf = 0;
+        for (int64_t k = 0;k < size;k++)
+        {
+            dot += value(0, k)*value(1, k);
+            norm1 += std::abs(value(0, k));
+            norm2 += value(0, k)*value(0, k);
+            norm_inf = std::max(norm_inf, std::abs(value(0, k)));
+        }
+
+        if (!close(X1.dot(X0, "ijk", "ijk"), dot)) bad++;
+        if (!close(X0.norm(0), norm_inf) || !close(X0.norm(1), norm1) || !close(X0.norm(2), std::sqrt(norm2)))
+            bad++;
+
+        /*
+         * every product of the first three operands with the first two
+         */
+        std::vector<const CyclopsTensor<double>*> A = {&X0, &X1, &X2}, B = {&X0, &X1};
+        std::vector<double> val;
+        CyclopsTensor<double>::dot(A, B, val);
+
+        for (int j = 0;j < 2;j++)
+        {
+            for (int i = 0;i < 3;i++)
+            {
+                double ref = 0;
+                for (int64_t k = 0;k < size;k++) ref += value(i, k)*value(j, k);
+                if (!close(val[i+3*j], ref)) bad++;
+            }
+        }
+
+        /*
+         * a map with f(0) != 0 leaves any padding zero, so that it does not enter the dot products
+         */
+        X2.map(1.0, X0, [](const double a) { return a+1; }, 0.0);
+        double ref = 0;
+        for (int64_t k = 0;k < size;k++) ref += (value(0, k)+1)*value(1, k);
+        if (!close(X2.dot(X1, "ijk", "ijk"), ref)) bad++;
+
+        /*
+         * a dot product which is not elementwise is a contraction
+         */
+        const std::vector<int> len2 = {9, 9}, sym2 = {NS, NS};
+        CyclopsTensor<double> P("P", world, len2, sym2), Q("Q", world, len2, sym2);
+        set_values(P, 0);
+        set_values(Q, 1);
+        ref = 0;
+        for (int i = 0;i < 9;i++)
+            for (int j = 0;j < 9;j++) ref += value(0, i+9*j)*value(1, j+9*i);
+        if (!close(Q.dot(P, "ij", "ji"), ref)) bad++;
+
+        world.allreduce(&bad, 1);
+        check(bad == 0, "dot products and norms on " + std::to_string(world.nproc) + " processes", world.rank == 0);
+    }
+
+    MPI::Finalize();
+
+    return finish(false);
+}
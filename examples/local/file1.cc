@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <tensor/tensor_file.h>
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Checks of the tensor file format (see tensor/tensor_file.h): round trips of a tensor and of views, and detection
+ * of damaged or mismatched files; returns nonzero if any fails
+ */
+
+using namespace ambit::tensor;
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    const std::string path = "file1.tns";
+
+    DenseTensor<double> A("A", std::vector<int>{6,7});
+    for (int i = 0;i < 42;i++) A.get_data()[i] = i;
+
+    /*
+     * a tensor is read back with its name, lengths, and elements, without copying them
+     */
+    save_tensor(path, A);
+    {
+        MappedDenseTensor<double> M(path);
+        bool same = (M.getName() == "A" && M.getLengths() == A.getLengths() && !M.ownsData());
+        for (int i = 0;i < 42 && same;i++) same = (M.get_data()[i] == i);
+        check(same, "a tensor round trips through a file");
+    }
+
+    /*
+     * a view is written compactly, including one which ends at the end of its parent
+     */
+    save_tensor(path, A.slice({4,5}, {2,2}));
+    {
+        MappedDenseTensor<double> M(path);
+        check(M.getSize() == 4 && M.get_data()[0] == 34 && M.get_data()[1] == 35 &&
+              M.get_data()[2] == 40 && M.get_data()[3] == 41, "a view at the end of its parent round trips");
+    }
+
+    save_tensor(path, A.slice({2,0}, {0,7}));
+    {
+        MappedDenseTensor<double> M(path);
+        bool same = (M.getLengths() == std::vector<int>(1, 7));
+        for (int j = 0;j < 7 && same;j++) same = (M.get_data()[j] == 2+6*j);
+        check(same, "a strided view round trips");
+    }
+
+    /*
+     * the checksum detects a damaged element, and the element type is checked
+     */
+    save_tensor(path, A);
+    std::vector<int> len, ld;
+    std::string name;
+    const TensorFileHeader header = read_tensor_file_header(path, len, ld, name);
+    check(header.data_size == 42*sizeof(double) && len == A.getLengths(), "the header describes the tensor");
+
+    check(throws<TensorFileError>([&] { MappedDenseTensor<float> M(path); }), "reading the file as float fails");
+
+    FILE* f = fopen(path.c_str(), "r+b");
+    fseek(f, header.data_offset+8*sizeof(double), SEEK_SET);
+    fputc(0x55, f);
+    fclose(f);
+
+    check(throws<TensorFileError>([&] { MappedDenseTensor<double> M(path); }), "a damaged file fails its checksum");
+
+    remove(path.c_str());
+
+    return finish();
+}
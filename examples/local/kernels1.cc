@@ -0,0 +1,563 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <tensor/tensor.h>
+#include <tensor/tensor_loops_dense.h>
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Checks of the dense kernels for each element type: the loop kernel against a direct sum over all of the indices,
+ * and each of the other contraction algorithms against the loop kernel, with operands with and without padding; the
+ * plan cache, threading, transposes, vector instruction sets, and unrolled loops; returns nonzero if any fails
+ */
+
+using namespace ambit::tensor;
+
+template <typename T>
+static void set_random(T& x)
+{
+    x = T(drand48()-.5);
+}
+
+template <typename T>
+static void set_random(std::complex<T>& x)
+{
+    x = std::complex<T>(drand48()-.5, drand48()-.5);
+}
+
+template <typename T>
+static double tolerance()
+{
+    return (sizeof(typename ambit::real_type<T>::type) == sizeof(float) ? 1e-4 : 1e-12);
+}
+
+/*
+ * A dense operand with index labels idx, either without padding (passed to the kernels with a NULL ld) or with two
+ * extra elements after each index; the padding holds a large value which would show up in any result read from it,
+ * and must not be written
+ */
+template <typename T>
+struct Operand
+{
+    std::string idx;
+    std::vector<int> len, ld;
+    std::vector<size_t> stride;
+    std::vector<T> data;
+    bool padded;
+
+    Operand(const std::string& idx, const std::vector<int>& len, const bool padded)
+    : idx(idx), len(len), ld(len.size()), stride(len.size()), padded(padded)
+    {
+        size_t size = 1;
+        for (size_t i = 0;i < len.size();i++)
+        {
+            ld[i] = (i == 0 ? 1 : len[i-1] + (padded ? 2 : 0));
+            stride[i] = (i == 0 ? 1 : stride[i-1])*ld[i];
+            size = stride[i]*len[i];
+        }
+
+        data.assign(size, padding());
+        std::vector<size_t> off = offsets();
+        for (size_t i = 0;i < off.size();i++) set_random(data[off[i]]);
+    }
+
+    static T padding() { return T(1e10); }
+
+    int ndim() const { return len.size(); }
+
+    const int* ldp() const { return (padded ? ld.data() : NULL); }
+
+    std::vector<int> labels() const { return std::vector<int>(idx.begin(), idx.end()); }
+
+    /*
+     * The offsets of the elements within the lengths, with index 0 varying fastest
+     */
+    std::vector<size_t> offsets() const
+    {
+        std::vector<size_t> off(1, 0);
+        for (size_t i = 0;i < len.size();i++)
+        {
+            std::vector<size_t> next;
+            for (int j = 0;j < len[i];j++)
+                for (size_t k = 0;k < off.size();k++) next.push_back(off[k] + j*stride[i]);
+            off.swap(next);
+        }
+        return off;
+    }
+
+    /*
+     * The largest difference from B (which has the same lengths) relative to the largest element of B, or infinity
+     * if the padding has been written
+     */
+    double diff(const Operand<T>& B) const
+    {
+        std::vector<size_t> off = offsets(), off_B = B.offsets();
+        std::vector<bool> inside(data.size(), false);
+        double d = 0, norm = 1;
+
+        for (size_t i = 0;i < off.size();i++)
+        {
+            inside[off[i]] = true;
+            d = std::max(d, (double)std::abs(data[off[i]]-B.data[off_B[i]]));
+            norm = std::max(norm, (double)std::abs(B.data[off_B[i]]));
+        }
+
+        for (size_t i = 0;i < data.size();i++)
+            if (!inside[i] && data[i] != padding()) return INFINITY;
+
+        return d/norm;
+    }
+};
+
+/*
+ * C = alpha*A*B + beta*C by a direct sum over every combination of the values of the indices
+ */
+template <typename T>
+static void reference(const T alpha, const Operand<T>& A, const Operand<T>& B, const T beta, Operand<T>& C)
+{
+    std::string labels;
+    std::vector<int> len;
+    const Operand<T>* ops[3] = {&A, &B, &C};
+
+    for (int op = 0;op < 3;op++)
+    {
+        for (size_t i = 0;i < ops[op]->idx.size();i++)
+        {
+            if (labels.find(ops[op]->idx[i]) != std::string::npos) continue;
+            labels += ops[op]->idx[i];
+            len.push_back(ops[op]->len[i]);
+        }
+    }
+
+    std::vector<size_t> off = C.offsets();
+    for (size_t i = 0;i < off.size();i++) C.data[off[i]] *= beta;
+
+    std::vector<int> pos(labels.size(), 0);
+    for (bool done = false;!done;)
+    {
+        size_t off_op[3] = {0, 0, 0};
+        for (int op = 0;op < 3;op++)
+            for (size_t i = 0;i < ops[op]->idx.size();i++)
+                off_op[op] += pos[labels.find(ops[op]->idx[i])]*ops[op]->stride[i];
+
+        C.data[off_op[2]] += alpha*A.data[off_op[0]]*B.data[off_op[1]];
+
+        done = true;
+        for (size_t i = 0;i < labels.size();i++)
+        {
+            if (++pos[i] < len[i])
+            {
+                done = false;
+                break;
+            }
+            pos[i] = 0;
+        }
+    }
+}
+
+template <typename T>
+static int mult(const T alpha, const Operand<T>& A, const Operand<T>& B, const T beta, Operand<T>& C,
+                const int algorithm)
+{
+    std::vector<int> idx_A = A.labels(), idx_B = B.labels(), idx_C = C.labels();
+
+    return tensor_mult_dense_(alpha, A.data.data(), A.ndim(), A.len.data(), A.ldp(), idx_A.data(),
+                                     B.data.data(), B.ndim(), B.len.data(), B.ldp(), idx_B.data(),
+                              beta,  C.data.data(), C.ndim(), C.len.data(), C.ldp(), idx_C.data(), algorithm);
+}
+
+/*
+ * The operations checked, as the labels of A, B, and C, with the length of each label
+ */
+static const char* const operations[][3] =
+{
+    {"ik",   "kj",   "ij"},
+    {"ki",   "jk",   "ij"},
+    {"ijcd", "cdab", "ijab"},
+    {"akic", "ckjb", "ijab"},
+    {"bik",  "bkj",  "bij"},
+    {"i",    "j",    "ij"},
+    {"ij",   "ij",   ""},
+    {"ij",   "jk",   "ijk"}
+};
+
+static std::vector<int> lengths(const std::string& idx)
+{
+    std::vector<int> len;
+    for (size_t i = 0;i < idx.size();i++) len.push_back(3 + (idx[i]-'a')%5);
+    return len;
+}
+
+static const char* algorithm_name(const int algorithm)
+{
+    switch (algorithm)
+    {
+        case kTensorContractLoop: return "the loop kernel";
+        case kTensorContractTTGT: return "TTGT";
+        case kTensorContractGETT: return "GETT";
+        default: return "the automatic choice";
+    }
+}
+
+/*
+ * The largest difference over the operations between the algorithm and the loop kernel (or, for the loop kernel,
+ * the direct sum), with each combination of padded operands
+ */
+template <typename T>
+static double algorithm_diff(const int algorithm)
+{
+    const T alpha = T(0.7), beta = T(0.3);
+    double d = 0;
+
+    for (size_t op = 0;op < sizeof(operations)/sizeof(operations[0]);op++)
+    {
+        const std::string idx_A = operations[op][0], idx_B = operations[op][1], idx_C = operations[op][2];
+
+        for (int padded = 0;padded < 8;padded++)
+        {
+            Operand<T> A(idx_A, lengths(idx_A), padded&1), B(idx_B, lengths(idx_B), padded&2);
+            Operand<T> C(idx_C, lengths(idx_C), padded&4), ref(C);
+
+            if (algorithm == kTensorContractLoop)
+            {
+                reference(alpha, A, B, beta, ref);
+            }
+            else if (mult(alpha, A, B, beta, ref, kTensorContractLoop) != kTensorReturnCodeSuccess)
+            {
+                return INFINITY;
+            }
+
+            if (mult(alpha, A, B, beta, C, algorithm) != kTensorReturnCodeSuccess) return INFINITY;
+
+            const double d_op = std::max(C.diff(ref), std::max(A.diff(A), B.diff(B)));
+            if (d_op > tolerance<T>())
+                std::cout << "       " << idx_A << "*" << idx_B << " -> " << idx_C << " with padding " << padded
+                          << ": " << d_op << std::endl;
+            d = std::max(d, d_op);
+        }
+    }
+
+    return d;
+}
+
+template <typename T>
+static void check_algorithms(const std::string& type, const std::vector<int>& algorithms)
+{
+    for (size_t i = 0;i < algorithms.size();i++)
+    {
+        const std::string what = (algorithms[i] == kTensorContractLoop ? "the loop kernel matches a direct sum" :
+                                  std::string(algorithm_name(algorithms[i])) + " matches the loop kernel");
+        check(algorithm_diff<T>(algorithms[i]) < tolerance<T>(), what + " (" + type + ")");
+    }
+}
+
+/*
+ * A repeated contraction reuses its plan, a contraction with a different layout or number of threads does not, and
+ * the results do not depend on whether the plan came from the cache
+ */
+static void check_plan_cache()
+{
+    const std::string idx_A = "ijcd", idx_B = "cdab", idx_C = "ijab";
+    const size_t capacity = tensor_get_plan_cache_capacity();
+    const int nthread = tensor_get_num_threads();
+
+    Operand<double> A(idx_A, lengths(idx_A), false), B(idx_B, lengths(idx_B), false);
+    Operand<double> C(idx_C, lengths(idx_C), false), D(C), E(C), F(idx_C, lengths(idx_C), true);
+
+    tensor_clear_plan_cache();
+    tensor_reset_plan_cache_stats();
+
+    mult(1.0, A, B, 0.0, C, kTensorContractAuto);
+    mult(1.0, A, B, 0.0, D, kTensorContractAuto);
+    check(tensor_plan_cache_misses() == 1 && tensor_plan_cache_hits() == 1 && D.diff(C) == 0,
+          "a repeated contraction reuses its plan");
+
+    mult(1.0, A, B, 0.0, F, kTensorContractAuto);
+    check(tensor_plan_cache_misses() == 2 && F.diff(C) < tolerance<double>(),
+          "a contraction with a padded result has its own plan");
+
+    tensor_set_num_threads(nthread == 1 ? 2 : 1);
+    mult(1.0, A, B, 0.0, D, kTensorContractAuto);
+    check(tensor_get_num_threads() == nthread || tensor_plan_cache_misses() == 3,
+          "an automatic contraction on another number of threads has its own plan");
+    tensor_set_num_threads(0);
+
+    tensor_set_plan_cache_capacity(0);
+    tensor_reset_plan_cache_stats();
+    mult(1.0, A, B, 0.0, E, kTensorContractAuto);
+    mult(1.0, A, B, 0.0, E, kTensorContractAuto);
+    check(tensor_plan_cache_hits() == 0 && E.diff(C) == 0, "a capacity of zero disables the cache");
+    tensor_set_plan_cache_capacity(capacity);
+}
+
+/*
+ * Operations large enough to be divided among threads give the same results on one thread and on several
+ */
+static void check_threads()
+{
+    static const char* const large[][3] =
+    {
+        {"ijcd", "cdab", "ijab"},
+        {"aik",  "akj",  "aij"},
+        {"ijk",  "ijk",  "ijk"},
+        {"ij",   "k",    "ijk"}
+    };
+    const int algorithms[] = {kTensorContractLoop, kTensorContractTTGT, kTensorContractGETT, kTensorContractAuto};
+
+    for (int a = 0;a < 4;a++)
+    {
+        double d = 0;
+
+        for (size_t op = 0;op < sizeof(large)/sizeof(large[0]);op++)
+        {
+            const std::string idx_A = large[op][0], idx_B = large[op][1], idx_C = large[op][2];
+            std::vector<int> len_A, len_B, len_C;
+            for (size_t i = 0;i < idx_A.size();i++) len_A.push_back(8 + (idx_A[i]-'a')%3*4);
+            for (size_t i = 0;i < idx_B.size();i++) len_B.push_back(8 + (idx_B[i]-'a')%3*4);
+            for (size_t i = 0;i < idx_C.size();i++) len_C.push_back(8 + (idx_C[i]-'a')%3*4);
+
+            Operand<double> A(idx_A, len_A, false), B(idx_B, len_B, true), C(idx_C, len_C, op%2 == 1), ref(C);
+
+            tensor_set_num_threads(1);
+            mult(0.7, A, B, 0.3, ref, algorithms[a]);
+            tensor_set_num_threads(4);
+            mult(0.7, A, B, 0.3, C, algorithms[a]);
+
+            d = std::max(d, C.diff(ref));
+        }
+
+        check(d < tolerance<double>(), std::string(algorithm_name(algorithms[a])) +
+              " gives the same results on four threads as on one");
+    }
+
+    tensor_set_num_threads(0);
+}
+
+/*
+ * Permutations of the indices, in tiles and with contiguous runs, on one thread and on several, against a direct
+ * sum (a product with a scalar one)
+ */
+template <typename T>
+static void check_transpose(const std::string& type)
+{
+    static const char* const permutations[][2] =
+    {
+        {"ij",    "ji"},
+        {"ij",    "ij"},
+        {"ijk",   "kji"},
+        {"ijk",   "jki"},
+        {"ijkl",  "ljik"},
+        {"ijklm", "mkilj"}
+    };
+    const T betas[] = {T(0), T(1), T(0.3)};
+    double d = 0;
+
+    Operand<T> one("", std::vector<int>(), false);
+    one.data[0] = T(1);
+
+    for (size_t p = 0;p < sizeof(permutations)/sizeof(permutations[0]);p++)
+    {
+        const std::string idx_A = permutations[p][0], idx_B = permutations[p][1];
+        std::vector<int> len_A, len_B;
+
+        /*
+         * two indices are longer than a tile, so that the edges of the tiles are exercised
+         */
+        for (size_t i = 0;i < idx_A.size();i++) len_A.push_back(idx_A.size() <= 2 ? 45 + 7*i : 3 + i);
+        for (size_t i = 0;i < idx_B.size();i++) len_B.push_back(len_A[idx_A.find(idx_B[i])]);
+        if (idx_A.size() > 2) len_A[0] = len_B[idx_B.find(idx_A[0])] = 37;
+
+        for (int padded = 0;padded < 4;padded++)
+        {
+            for (int b = 0;b < 3;b++)
+            {
+                Operand<T> A(idx_A, len_A, padded&1), B(idx_B, len_B, padded&2), ref(B);
+                std::vector<int> lbl_A = A.labels(), lbl_B = B.labels();
+
+                reference(T(0.7), A, one, betas[b], ref);
+
+                tensor_set_num_threads(padded < 2 ? 1 : 4);
+                if (tensor_transpose_dense_(T(0.7), A.data.data(), A.ndim(), A.len.data(), A.ldp(), lbl_A.data(),
+                                            betas[b], B.data.data(), B.ndim(), B.len.data(), B.ldp(), lbl_B.data())
+                    != kTensorReturnCodeSuccess) d = INFINITY;
+
+                d = std::max(d, std::max(B.diff(ref), A.diff(A)));
+            }
+        }
+    }
+
+    tensor_set_num_threads(0);
+
+    check(d < tolerance<T>(), "transposes match a direct sum (" + type + ")");
+}
+
+/*
+ * Each instruction set supported by the processor gives the same scaling, sum, and elementwise product as the
+ * portable loops, including for lengths which are not a multiple of the vector width and for the special values of
+ * alpha and beta; requests for an unsupported instruction set are lowered to the best supported one
+ */
+static void check_vector_isa()
+{
+    const int isa = tensor_get_vector_isa();
+    const double alphas[] = {0.0, 1.0, 0.7}, betas[] = {0.0, 1.0, 0.3};
+    const std::string idx = "ij";
+    const std::vector<int> len = {37, 5};
+
+    tensor_set_vector_isa(kTensorVectorAVX512);
+    const int max_isa = tensor_get_vector_isa();
+    tensor_set_vector_isa(kTensorVectorAVX512+1);
+    bool lowered = tensor_get_vector_isa() == max_isa;
+    tensor_set_vector_isa(kTensorVectorGeneric-1);
+    lowered = lowered && tensor_get_vector_isa() == kTensorVectorGeneric;
+    check(lowered, "requests for an unsupported instruction set are lowered");
+
+    double d = 0;
+    for (int padded = 0;padded < 2;padded++)
+    {
+        for (int a = 0;a < 3;a++)
+        {
+            for (int b = 0;b < 3;b++)
+            {
+                Operand<double> A(idx, len, padded), B(idx, len, padded), C(idx, len, padded);
+                std::vector<int> lbl = A.labels();
+                std::vector<Operand<double> > ref;
+
+                for (int vec = kTensorVectorGeneric;vec <= max_isa;vec++)
+                {
+                    tensor_set_vector_isa(vec);
+
+                    std::vector<Operand<double> > res(3, C);
+                    res[1] = B;
+                    tensor_scale_dense_(alphas[a], res[0].data.data(), 2, len.data(), res[0].ldp(), lbl.data());
+                    tensor_sum_dense_(alphas[a], A.data.data(), 2, len.data(), A.ldp(), lbl.data(),
+                                      betas[b], res[1].data.data(), 2, len.data(), res[1].ldp(), lbl.data());
+                    tensor_mult_dense_(alphas[a], A.data.data(), 2, len.data(), A.ldp(), lbl.data(),
+                                                  B.data.data(), 2, len.data(), B.ldp(), lbl.data(),
+                                       betas[b], res[2].data.data(), 2, len.data(), res[2].ldp(), lbl.data());
+
+                    if (vec == kTensorVectorGeneric) ref = res;
+                    for (int i = 0;i < 3;i++) d = std::max(d, res[i].diff(ref[i]));
+                }
+            }
+        }
+    }
+
+    tensor_set_vector_isa(isa);
+
+    check(d < tolerance<double>(), "each instruction set up to " + std::to_string(max_isa) +
+                                   " matches the portable loops");
+}
+
+/*
+ * The loop kernel against a direct sum for contractions and sums with up to one more index in each group than the
+ * unrolled loops handle, so that both the unrolled loops of each depth and the generic loops beyond them are checked
+ */
+static void check_unrolled()
+{
+    const int max_rank = kDenseMaxUnrolledRank + 1;
+    const double betas[] = {0.0, 0.3};
+    double d_mult = 0, d_sum = 0;
+
+    Operand<double> one("", std::vector<int>(), false);
+    one.data[0] = 1.0;
+
+    for (int n_ABC = 0;n_ABC <= max_rank;n_ABC++)
+    {
+        /*
+         * every depth of each group is reached with the other group short, which keeps the padded operands small
+         */
+        for (int n_AB = 0;n_AB <= max_rank && n_ABC+n_AB <= max_rank+1;n_AB++)
+        {
+            /*
+             * ABC indices (or, for the sum, AB indices) are labelled from 'a' and AB (or A-only) indices from 'n'
+             */
+            std::string idx_ABC, idx_AB;
+            std::vector<int> len_ABC, len_AB;
+            for (int i = 0;i < n_ABC;i++)
+            {
+                idx_ABC += char('a'+i);
+                len_ABC.push_back(i == 0 ? 3 : 2);
+            }
+            for (int i = 0;i < n_AB;i++)
+            {
+                idx_AB += char('n'+i);
+                len_AB.push_back(i == 0 ? 3 : 2);
+            }
+
+            std::vector<int> len_A = len_ABC, len_B = len_AB;
+            len_A.insert(len_A.end(), len_AB.begin(), len_AB.end());
+            len_B.insert(len_B.end(), len_ABC.begin(), len_ABC.end());
+
+            for (int padded = 0;padded < 2;padded++)
+            {
+                for (int b = 0;b < 2;b++)
+                {
+                    Operand<double> A(idx_ABC+idx_AB, len_A, padded), B(idx_AB+idx_ABC, len_B, !padded);
+                    Operand<double> C(idx_ABC, len_ABC, padded), ref(C);
+                    std::vector<int> lbl_A = A.labels(), lbl_C = C.labels();
+
+                    reference(0.7, A, B, betas[b], ref);
+                    if (mult(0.7, A, B, betas[b], C, kTensorContractLoop) != kTensorReturnCodeSuccess) d_mult = INFINITY;
+                    d_mult = std::max(d_mult, C.diff(ref));
+
+                    C = ref = Operand<double>(idx_ABC, len_ABC, padded);
+                    reference(0.7, A, one, betas[b], ref);
+                    if (tensor_sum_dense_(0.7,      A.data.data(), A.ndim(), A.len.data(), A.ldp(), lbl_A.data(),
+                                          betas[b], C.data.data(), C.ndim(), C.len.data(), C.ldp(), lbl_C.data())
+                        != kTensorReturnCodeSuccess) d_sum = INFINITY;
+                    d_sum = std::max(d_sum, C.diff(ref));
+                }
+            }
+        }
+    }
+
+    check(d_mult < tolerance<double>(), "unrolled and generic contraction loops match a direct sum");
+    check(d_sum < tolerance<double>(), "unrolled and generic summation loops match a direct sum");
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    srand48(1);
+
+    check_algorithms<double>("double", {kTensorContractLoop, kTensorContractTTGT, kTensorContractGETT,
+                                        kTensorContractAuto});
+    check_algorithms<float>("float", {kTensorContractLoop, kTensorContractTTGT, kTensorContractGETT,
+                                      kTensorContractAuto});
+    check_algorithms<std::complex<float> >("complex float", {kTensorContractLoop, kTensorContractTTGT,
+                                                             kTensorContractGETT, kTensorContractAuto});
+    check_algorithms<std::complex<double> >("complex double", {kTensorContractLoop, kTensorContractTTGT,
+                                                               kTensorContractGETT, kTensorContractAuto});
+    check_plan_cache();
+    check_threads();
+    check_transpose<double>("double");
+    check_transpose<float>("float");
+    check_transpose<std::complex<float> >("complex float");
+    check_transpose<std::complex<double> >("complex double");
+    check_vector_isa();
+    check_unrolled();
+
+    return finish();
+}
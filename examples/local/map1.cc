@@ -0,0 +1,126 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <tensor/dense_tensor.h>
+#include <tensor/tensor_map_dense.h>
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+/*
+ * Checks of the elementwise operations (div, invert, and map) on a dense tensor; returns nonzero if any fails
+ */
+
+using ambit::tensor::DenseTensor;
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    const std::vector<int> len(1, 4);
+    DenseTensor<double> A("A", len), B("B", len), C("C", len);
+
+    /*
+     * with beta = 0 the old value of C is not used, however large or non-finite
+     */
+    for (int i = 0;i < 4;i++)
+    {
+        A.get_data()[i] = 1;
+        B.get_data()[i] = 3;
+    }
+    C.get_data()[0] = 1e20;
+    C.get_data()[1] = inf;
+    C.get_data()[2] = nan;
+    C.get_data()[3] = -inf;
+
+    C.div(1.0, A, B, 0.0);
+    bool ok = true;
+    for (int i = 0;i < 4;i++) ok = ok && std::abs(C.get_data()[i]-1.0/3) < 1e-15;
+    check(ok, "div with beta = 0 overwrites large, infinite and NaN elements");
+
+    C.get_data()[0] = 1e20;
+    C.get_data()[1] = inf;
+    C.get_data()[2] = nan;
+    C.invert(1.0, B, 0.0);
+    ok = true;
+    for (int i = 0;i < 4;i++) ok = ok && std::abs(C.get_data()[i]-1.0/3) < 1e-15;
+    check(ok, "invert with beta = 0 overwrites large, infinite and NaN elements");
+
+    /*
+     * elements where the divisor is (nearly) zero are left as they were
+     */
+    B.get_data()[1] = 0;
+    B.get_data()[3] = 1e-320;
+    C.get_data()[0] = 2;
+    C.get_data()[1] = inf;
+    C.get_data()[2] = 2;
+    C.get_data()[3] = -inf;
+
+    C.div(1.0, A, B, 0.5);
+    check(std::abs(C.get_data()[0]-(1.0/3+1)) < 1e-15 && C.get_data()[1] == inf &&
+          std::abs(C.get_data()[2]-(1.0/3+1)) < 1e-15 && C.get_data()[3] == -inf,
+          "div leaves elements with a zero divisor unchanged");
+
+    C.invert(1.0, B, 0.0);
+    check(std::abs(C.get_data()[0]-1.0/3) < 1e-15 && C.get_data()[1] == inf && C.get_data()[3] == -inf,
+          "invert leaves elements with a zero divisor unchanged");
+
+    /*
+     * the initial value of a reduction is combined once, not once per partial result
+     */
+    std::vector<double> ones(10000, 1.0);
+    const double* data[1] = {ones.data()};
+    const double sum = ambit::tensor::tensor_map_reduce_dense_<1>([](const double a) { return a; },
+                                                                  std::plus<double>(), 1.0, data, ones.size());
+    check(sum == 10001, "a reduction of 10000 ones from 1 is 10001");
+
+    const double few = ambit::tensor::tensor_map_reduce_dense_<1>([](const double a) { return a; },
+                                                                  std::plus<double>(), 1.0, data, 3);
+    check(few == 4, "a reduction of 3 ones from 1 is 4");
+
+    /*
+     * a map over a padded tensor only touches the elements within its lengths
+     */
+    DenseTensor<double> P("P", {3,4}, {1,5});
+    for (int i = 0;i < 20;i++) P.get_data()[i] = -1;
+    P.map(0.0, [](const double a) { return a; }, 0.0);
+    ok = true;
+    for (int j = 0;j < 4;j++)
+        for (int i = 0;i < 5;i++) ok = ok && P.get_data()[i+5*j] == (i < 3 ? 0 : -1);
+    check(ok, "map over a padded tensor skips the padding");
+
+    /*
+     * weighting divides by a sum of one value per index, which for a scalar is empty
+     */
+    DenseTensor<double> W("W", std::vector<int>{2,3});
+    for (int i = 0;i < 6;i++) W.get_data()[i] = 1;
+    const std::vector<double> d0 = {1, 2}, d1 = {10, 20, 30};
+    W.weight({&d0, &d1});
+    check(W.get_data()[0] == 1.0/11 && W.get_data()[5] == 1.0/32, "weight divides by d0[i]+d1[j]");
+
+    DenseTensor<double> S("S", 2.0);
+    S.weight({});
+    check(S.get_data()[0] == 2, "weight leaves a scalar unchanged");
+
+    return finish();
+}
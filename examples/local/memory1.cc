@@ -0,0 +1,124 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <util/memory.h>
+
+#include <cstring>
+#include <iostream>
+
+/*
+ * Checks of the memory pool, arenas, accounting, and budget (see util/memory.h); returns nonzero if any fails
+ */
+
+using namespace ambit::util;
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    const size_t mib = size_t(1) << 20;
+
+    /*
+     * the pool is bounded by default, and a freed large block is kept in it and handed out again for the next
+     * allocation of its size class
+     */
+    check(ambit_pool_get_limit() == (size_t(1) << 30), "the pool is limited to 1 GiB by default");
+    ambit_pool_trim();
+
+    char* p = SAFE_MALLOC(char, mib);
+    p[0] = 1;
+    FREE(p);
+    const size_t cached = ambit_pool_get_cached();
+    check(cached >= mib, "a freed block is kept in the pool");
+
+    char* q = SAFE_MALLOC(char, mib);
+    check(q == p && ambit_pool_get_cached() < cached, "the pooled block is reused");
+    FREE(q);
+
+    ambit_pool_trim();
+    check(ambit_pool_get_cached() == 0, "trimming empties the pool");
+
+    /*
+     * within an arena blocks are carved from its chunks, and the most recently allocated block can be reused
+     */
+    {
+        memory_arena arena(4*mib);
+        check(memory_arena::active() == &arena, "the arena is active in its scope");
+
+        double* a = SAFE_MALLOC(double, 1000);
+        double* b = SAFE_MALLOC(double, 1000);
+        check(arena.used() >= 2*1000*sizeof(double) && arena.reserved() >= 4*mib, "blocks come from the arena");
+
+        FREE(b);
+        double* c = SAFE_MALLOC(double, 1000);
+        check(c == b, "freeing the most recent block makes it available again");
+
+        FREE(c);
+        FREE(a);
+    }
+    check(memory_arena::active() == NULL, "the arena is inactive after its scope");
+    check(ambit_pool_get_cached() >= 4*mib, "the arena's chunks are returned to the pool");
+
+    /*
+     * allocations are accounted for in total and by call site
+     */
+    ambit_pool_trim();
+    const size_t used = ambit_memory_used();
+    ambit_memory_reset_peak();
+
+    char* r = SAFE_MALLOC(char, 2*mib);
+    check(ambit_memory_used() >= used+2*mib && ambit_memory_peak() >= used+2*mib, "an allocation is accounted for");
+
+    bool found = false;
+    std::vector<memory_site> sites = ambit_memory_sites();
+    for (size_t i = 0;i < sites.size();i++)
+        if (strstr(sites[i].file.c_str(), "memory1.cc") != NULL && sites[i].used >= 2*mib) found = true;
+    check(found, "the allocation is attributed to its call site");
+
+    FREE(r);
+    check(ambit_memory_used() == used, "freeing it releases the count");
+
+    /*
+     * an allocation over the budget throws, or returns NULL without bailout, after trying to trim the pool
+     */
+    ambit_memory_set_budget(used+4*mib);
+    check(ambit_memory_available() == 4*mib, "the budget bounds the memory available");
+
+    bool thrown = false;
+    try
+    {
+        char* s = SAFE_MALLOC(char, 8*mib);
+        FREE(s);
+    }
+    catch (memory_budget_error& e)
+    {
+        thrown = true;
+        std::cout << "       " << e.what() << std::endl;
+    }
+    check(thrown, "an allocation over the budget throws memory_budget_error");
+
+    check(ambit_malloc(8*mib, __FILE__, __LINE__, 0) == NULL, "without bailout it returns NULL instead");
+
+    char* t = SAFE_MALLOC(char, 3*mib);
+    check(t != NULL, "an allocation within the budget succeeds");
+    FREE(t);
+
+    ambit_memory_set_budget(0);
+    ambit_memory_report(3);
+
+    return finish();
+}
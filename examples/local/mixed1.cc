@@ -0,0 +1,88 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <tensor/dense_tensor.h>
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+/*
+ * Mixed-precision contraction: float operands with a double result (accumulated in double and in single
+ * precision), and an all-float contraction, each compared with an all-double contraction of the same (float)
+ * inputs; prints the relative error of each and returns nonzero if one is larger than expected
+ */
+
+using ambit::tensor::DenseTensor;
+
+static DenseTensor<double> to_double(const DenseTensor<float>& A)
+{
+    DenseTensor<double> B("double", A.getLengths());
+    for (size_t i = 0;i < A.getSize();i++) B.get_data()[i] = A.get_data()[i];
+    return B;
+}
+
+static double relative_error(const DenseTensor<double>& A, const DenseTensor<double>& ref)
+{
+    double diff = 0, norm = 0;
+    for (size_t i = 0;i < ref.getSize();i++)
+    {
+        diff += (A.get_data()[i]-ref.get_data()[i])*(A.get_data()[i]-ref.get_data()[i]);
+        norm += ref.get_data()[i]*ref.get_data()[i];
+    }
+    return std::sqrt(diff/norm);
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    const int o = 8, v = 24;
+
+    DenseTensor<float> T2("T2", std::vector<int>{o,o,v,v}), V("V", std::vector<int>{v,v,v,v});
+    T2.fill_with_random_data();
+    V.fill_with_random_data();
+
+    DenseTensor<double> T2_d = to_double(T2), V_d = to_double(V);
+    DenseTensor<double> ref("ref", std::vector<int>{o,o,v,v});
+    ref.mult(1.0, T2_d, "ijcd", V_d, "cdab", 0.0, "ijab");
+
+    DenseTensor<double> R_dd("R", std::vector<int>{o,o,v,v}), R_ds("R", std::vector<int>{o,o,v,v});
+    R_dd.mult(1.0, T2, "ijcd", V, "cdab", 0.0, "ijab", kTensorContractAuto, kTensorAccumulateDouble);
+    R_ds.mult(1.0, T2, "ijcd", V, "cdab", 0.0, "ijab", kTensorContractAuto, kTensorAccumulateSingle);
+
+    DenseTensor<float> R_ss("R", std::vector<int>{o,o,v,v});
+    R_ss.mult(1.0f, T2, "ijcd", V, "cdab", 0.0f, "ijab");
+
+    const double err_dd = relative_error(R_dd, ref);
+    const double err_ds = relative_error(R_ds, ref);
+    const double err_ss = relative_error(to_double(R_ss), ref);
+
+    std::cout.precision(3);
+    std::cout << std::scientific;
+
+    std::cout << "relative error against an all-double contraction:" << std::endl;
+    std::cout << "    float x float -> double, double accumulation: " << err_dd << std::endl;
+    std::cout << "    float x float -> double, single accumulation: " << err_ds << std::endl;
+    std::cout << "    float x float -> float:                       " << err_ss << std::endl;
+
+    check(err_dd < 1e-12, "float x float -> double with double accumulation is within double precision");
+    check(err_ds < 1e-5, "float x float -> double with single accumulation is within single precision");
+    check(err_ss < 1e-5, "float x float -> float is within single precision");
+
+    return finish();
+}
@@ -0,0 +1,121 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <tensor/dense_tensor.h>
+#include <util/memory.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+/*
+ * Checks of the placement policies for large blocks (see util/memory.h): tensors allocated under each policy are
+ * zeroed, copied, and contracted like those allocated under the default one, policies apply to their scope only,
+ * and the pool keeps blocks of different policies apart; returns nonzero if any fails
+ */
+
+using namespace ambit::tensor;
+using namespace ambit::util;
+
+/*
+ * The largest difference between the elements of A and B relative to the largest element of B
+ */
+static double diff(const DenseTensor<double>& A, const DenseTensor<double>& B)
+{
+    double d = 0, norm = 1;
+    for (uint64_t i = 0;i < B.getSize();i++)
+    {
+        d = std::max(d, std::abs(A.get_data()[i]-B.get_data()[i]));
+        norm = std::max(norm, std::abs(B.get_data()[i]));
+    }
+    return d/norm;
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    const size_t mib = size_t(1) << 20;
+    const int global = ambit_get_memory_policy();
+
+    /*
+     * each operand is over 2 MiB, so that the policy applies to it; the result is computed under the default policy
+     */
+    const std::vector<int> len_A = {600, 600}, len_B = {600, 8};
+    DenseTensor<double> A0("A", len_A), B0("B", len_B), C0("C", len_B);
+    A0.fill_with_random_data();
+    B0.fill_with_random_data();
+    C0["ij"] = A0["ik"]*B0["kj"];
+
+    const int policies[] = {kMemoryFirstTouch, kMemoryInterleave, memory_policy_bind(0), kMemoryHugePages,
+                            kMemoryInterleave|kMemoryHugePages};
+    const char* const names[] = {"first touch", "interleaved", "bound to node 0", "huge pages",
+                                 "interleaved huge pages"};
+
+    tensor_set_num_threads(4);
+    for (int p = 0;p < 5;p++)
+    {
+        memory_policy_scope scope(policies[p]);
+        check(ambit_get_memory_policy() == policies[p], std::string("the scope sets the policy (") + names[p] + ")");
+
+        DenseTensor<double> A("A", len_A), B(B0), C("C", len_B);
+
+        bool zero = true;
+        for (uint64_t i = 0;i < A.getSize();i++) zero = zero && A.get_data()[i] == 0;
+
+        A["ij"] = A0["ij"];
+
+        C["ij"] = A["ik"]*B["kj"];
+        check(zero && diff(B, B0) == 0 && diff(C, C0) < 1e-12,
+              std::string("tensors are zeroed, copied, and contracted as by default (") + names[p] + ")");
+    }
+    tensor_set_num_threads(0);
+    check(ambit_get_memory_policy() == global, "the policy is restored after the scope");
+
+    /*
+     * a pooled block is only handed out again under its own policy
+     */
+    ambit_pool_trim();
+    char* p;
+    {
+        memory_policy_scope scope(kMemoryInterleave);
+        p = SAFE_MALLOC(char, 4*mib);
+        FREE(p);
+    }
+
+    char* q = SAFE_MALLOC(char, 4*mib);
+    check(q != p, "a block pooled under another policy is not reused");
+    FREE(q);
+
+    {
+        memory_policy_scope scope(kMemoryInterleave);
+        q = SAFE_MALLOC(char, 4*mib);
+        check(q == p, "a block pooled under the same policy is reused");
+        FREE(q);
+    }
+    ambit_pool_trim();
+
+    /*
+     * the default policy can always be applied to a block
+     */
+    q = SAFE_MALLOC(char, 4*mib);
+    check(ambit_apply_memory_policy(q, 4*mib, kMemoryFirstTouch) == 0, "the first-touch policy can be applied");
+    FREE(q);
+
+    return finish();
+}
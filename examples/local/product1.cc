@@ -0,0 +1,117 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <tensor/dense_tensor.h>
+#include <tensor/tensor_plan_product.h>
+#include <util/memory.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+/*
+ * Checks of products of three or more tensors: the order chosen by the planner, and the results against the same
+ * products evaluated two tensors at a time, with the intermediates freed afterwards; returns nonzero if any fails
+ */
+
+using namespace ambit::tensor;
+using namespace ambit::util;
+
+/*
+ * The largest difference between the elements of A and B relative to the largest element of B
+ */
+static double diff(const DenseTensor<double>& A, const DenseTensor<double>& B)
+{
+    double d = 0, norm = 1;
+    for (uint64_t i = 0;i < B.getSize();i++)
+    {
+        d = std::max(d, std::abs(A.get_data()[i]-B.get_data()[i]));
+        norm = std::max(norm, std::abs(B.get_data()[i]));
+    }
+    return d/norm;
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    /*
+     * v["a"]*M["ab"]*N["bc"] costs 2*50^2 multiply-adds from the left and 50^3+50^2 from the right
+     */
+    ProductPlan plan;
+    const int ret = tensor_plan_product({"a", "ab", "bc"}, {{50}, {50,50}, {50,50}}, "c", {50}, sizeof(double), plan);
+    check(ret == kTensorReturnCodeSuccess && plan.steps.size() == 2 && plan.flops == 2*50*50 &&
+          std::min(plan.steps[0].A, plan.steps[0].B) == 0 && std::max(plan.steps[0].A, plan.steps[0].B) == 1 &&
+          plan.steps[0].idx_C == "b" && plan.peak == 50,
+          "a vector-matrix-matrix product is evaluated from the vector");
+
+    DenseTensor<double> v("v", std::vector<int>{50}), M("M", std::vector<int>{50,50}), N("N", std::vector<int>{50,50});
+    DenseTensor<double> r("r", std::vector<int>{50}), x("x", std::vector<int>{50}), y("y", std::vector<int>{50});
+    v.fill_with_random_data();
+    M.fill_with_random_data();
+    N.fill_with_random_data();
+
+    const size_t used = ambit_memory_used();
+    ambit_memory_reset_peak();
+    r["c"] = v["a"]*M["ab"]*N["bc"];
+    check(ambit_memory_used() == used && ambit_memory_peak() < used+50*50*sizeof(double),
+          "the intermediate is the smaller one and is freed");
+
+    x["b"] = v["a"]*M["ab"];
+    y["c"] = x["b"]*N["bc"];
+    check(diff(r, y) < 1e-12, "a product of three tensors matches two binary products");
+
+    /*
+     * a contraction of four-index tensors, with a factor, accumulated onto the result
+     */
+    const int o = 4, u = 7;
+    DenseTensor<double> A("A", std::vector<int>{o,o,u,u}), B("B", std::vector<int>{u,u,u,u});
+    DenseTensor<double> C("C", std::vector<int>{u,u,o,o}), D("D", std::vector<int>{o,o});
+    DenseTensor<double> R("R", std::vector<int>{o,o,o,o}), S("S", std::vector<int>{o,o,o,o});
+    DenseTensor<double> X("X", std::vector<int>{o,o,u,u}), Y("Y", std::vector<int>{o,o,o,o});
+    A.fill_with_random_data();
+    B.fill_with_random_data();
+    C.fill_with_random_data();
+    D.fill_with_random_data();
+    R.fill_with_random_data();
+    S["ijkl"] = R["ijkl"];
+
+    R["ijkl"] += 0.5*A["ijab"]*B["abcd"]*C["cdkl"];
+    X["ijcd"] = A["ijab"]*B["abcd"];
+    S["ijkl"] += 0.5*X["ijcd"]*C["cdkl"];
+    check(diff(R, S) < 1e-12, "a scaled product of three tensors accumulates like binary products");
+
+    /*
+     * four operands, one of which only connects to the result
+     */
+    R["ijkl"] -= A["ijab"]*B["abcd"]*C["cdml"]*D["mk"];
+    Y["ijml"] = X["ijcd"]*C["cdml"];
+    S["ijkl"] -= Y["ijml"]*D["mk"];
+    check(diff(R, S) < 1e-12, "a product of four tensors matches binary products");
+
+    /*
+     * with a memory limit no order can meet, the cheapest order is used regardless
+     */
+    tensor_set_product_memory_limit(1);
+    R["ijkl"] = A["ijab"]*B["abcd"]*C["cdkl"];
+    tensor_set_product_memory_limit(0);
+    S["ijkl"] = X["ijcd"]*C["cdkl"];
+    check(diff(R, S) < 1e-12, "a product whose intermediates exceed the memory limit is still evaluated");
+
+    return finish();
+}
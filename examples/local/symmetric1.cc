@@ -0,0 +1,128 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <tensor/dense_tensor.h>
+#include <tensor/symmetric_tensor.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/*
+ * Checks of packed (anti)symmetric tensors against the dense tensors they unpack to: storage sizes, packing,
+ * contractions with and without symmetrization of the result, permuted sums and changes of symmetry, and scaling;
+ * returns nonzero if any fails
+ */
+
+using namespace ambit::tensor;
+
+static DenseTensor<double> unpacked(const SymmetricTensor<double>& A)
+{
+    DenseTensor<double> D(A.getName(), A.getLengths());
+    A.unpack(D);
+    return D;
+}
+
+/*
+ * The largest difference between the elements of A and B relative to the largest element of B
+ */
+static double diff(const DenseTensor<double>& A, const DenseTensor<double>& B)
+{
+    double d = 0, norm = 1;
+    for (uint64_t i = 0;i < B.getSize();i++)
+    {
+        d = std::max(d, std::abs(A.get_data()[i]-B.get_data()[i]));
+        norm = std::max(norm, std::abs(B.get_data()[i]));
+    }
+    return d/norm;
+}
+
+int main(int /*argc*/, char** /*argv*/)
+{
+    /*
+     * a group of three indices of length 6 has 20 unique antisymmetric (and hollow) elements and 56 symmetric ones
+     */
+    const std::vector<int> len3 = {6,6,6,4};
+    check(SymmetricTensor<double>::getSize(4, len3, {AS,AS,NS,NS}) == 20*4 &&
+          SymmetricTensor<double>::getSize(4, len3, {SH,SH,NS,NS}) == 20*4 &&
+          SymmetricTensor<double>::getSize(4, len3, {SY,SY,NS,NS}) == 56*4,
+          "packed groups store only the unique elements");
+
+    const std::vector<int> len = {6,6,6,6}, as_as = {AS,NS,AS,NS};
+    SymmetricTensor<double> A("A", len, as_as), B("B", len, as_as), C("C", len, as_as);
+    A.fill_with_random_data();
+    B.fill_with_random_data();
+    C.fill_with_random_data();
+
+    DenseTensor<double> DA = unpacked(A), DB = unpacked(B), DC = unpacked(C);
+
+    SymmetricTensor<double> P("P", DA, as_as);
+    check(P.getSize() == 15*15 && diff(unpacked(P), DA) == 0, "packing an antisymmetric tensor and unpacking it");
+
+    /*
+     * a product of antisymmetric tensors which is already antisymmetric in the indices of C
+     */
+    C["abij"] = A["abef"]*B["efij"];
+    DC["abij"] = DA["abef"]*DB["efij"];
+    check(diff(unpacked(C), DC) < 1e-12, "an antisymmetric contraction matches the dense contraction");
+
+    /*
+     * a product which is not, and is antisymmetrized onto C: P(ab)X_abij/2
+     */
+    SymmetricTensor<double> F("F", {6,6}, {NS,NS}), W("W", len, {NS,NS,AS,NS});
+    F.fill_with_random_data();
+    W.fill_with_random_data();
+
+    C["abij"] = F["ak"]*W["kbij"];
+    DenseTensor<double> DX("X", len);
+    DX["abij"] = unpacked(F)["ak"]*unpacked(W)["kbij"];
+    DC["abij"] = DX["abij"];
+    DC["abij"] -= DX["baij"];
+    DC["abij"] *= 0.5;
+    check(diff(unpacked(C), DC) < 1e-12, "a contraction is antisymmetrized onto a packed result");
+
+    /*
+     * permutations of the indices, including within a group, and changes of symmetry
+     */
+    C["abij"] += A["baji"];
+    DC["abij"] += DA["baji"];
+    C["abij"] -= B["ijab"];
+    DC["abij"] -= DB["ijab"];
+    check(diff(unpacked(C), DC) < 1e-12, "permuted sums of packed tensors match the dense sums");
+
+    SymmetricTensor<double> S("S", {6,6}, {SY,NS});
+    S["ab"] = F["ba"];
+    DenseTensor<double> DS("S", std::vector<int>{6,6}), DF = unpacked(F);
+    DS["ab"] = DF["ab"];
+    DS["ab"] += DF["ba"];
+    DS["ab"] *= 0.5;
+    check(diff(unpacked(S), DS) < 1e-12, "a sum onto a symmetric tensor symmetrizes it");
+
+    SymmetricTensor<double> N("N", len, {NS,NS,NS,NS});
+    N["ijab"] = C["abij"];
+    DenseTensor<double> DN("N", len);
+    DN["ijab"] = DC["abij"];
+    check(diff(unpacked(N), DN) < 1e-12, "a sum onto a nonsymmetric tensor unpacks it");
+
+    C["abij"] *= 0.5;
+    DC["abij"] *= 0.5;
+    check(diff(unpacked(C), DC) < 1e-12, "scaling a packed tensor matches scaling the dense one");
+
+    return finish();
+}
@@ -0,0 +1,111 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-151 USA.
+ */
+
+#include "check.h"
+#include <util/world.h>
+
+#include <string>
+#include <vector>
+
+/*
+ * Checks of the collectives of util::World against the values each process can work out for itself: reductions,
+ * gathers, all-to-all exchanges, and nonblocking broadcasts and reductions; run on any number of processes, returns
+ * nonzero if any check fails on any of them
+ */
+
+using namespace ambit;
+
+int main(int argc, char** argv)
+{
+    MPI::Init(argc, argv);
+
+    {
+        util::World world;
+        const int rank = world.rank, nproc = world.nproc;
+        int bad = 0;
+
+        /*
+         * reductions of the ranks, in place and not, onto every process and onto the last one
+         */
+        const int sum = nproc*(nproc-1)/2;
+        if (world.allreduce(rank) != sum || world.allreduce((double)rank, MPI::MAX) != nproc-1) bad++;
+
+        std::vector<int> v = {rank, 2*rank, 1};
+        world.allreduce(v);
+        if (v != std::vector<int>{sum, 2*sum, nproc}) bad++;
+
+        std::vector<double> w = {(double)rank, -(double)rank};
+        world.reduce(w, nproc-1, MPI::MIN);
+        if (rank == nproc-1 && w != std::vector<double>{0.0, -(double)(nproc-1)}) bad++;
+
+        /*
+         * process p contributes p+1 copies of p to the variable gather
+         */
+        std::vector<int> ranks = world.allgather(rank);
+        for (int p = 0;p < nproc;p++) if (ranks[p] != p) bad++;
+
+        std::vector<int> mine(rank+1, rank), all, counts;
+        world.allgatherv(mine, all, &counts);
+        if ((int)all.size() != sum+nproc) bad++;
+        for (int p = 0, k = 0;p < nproc && k < (int)all.size();p++)
+        {
+            if (counts[p] != p+1) bad++;
+            for (int i = 0;i <= p;i++) if (all[k++] != p) bad++;
+        }
+
+        /*
+         * process p sends 100*p+q to process q, and for the variable exchange q+1 copies of it
+         */
+        std::vector<int> send(nproc), recv;
+        for (int q = 0;q < nproc;q++) send[q] = 100*rank+q;
+        world.alltoall(send, recv);
+        for (int p = 0;p < nproc;p++) if (recv[p] != 100*p+rank) bad++;
+
+        std::vector<int> sendcounts(nproc), recvcounts;
+        send.clear();
+        for (int q = 0;q < nproc;q++)
+        {
+            sendcounts[q] = q+1;
+            send.insert(send.end(), q+1, 100*rank+q);
+        }
+        world.alltoallv(send, sendcounts, recv, recvcounts);
+        if ((int)recv.size() != nproc*(rank+1)) bad++;
+        for (int p = 0;p < nproc && (int)recv.size() == nproc*(rank+1);p++)
+        {
+            if (recvcounts[p] != rank+1) bad++;
+            for (int i = 0;i <= rank;i++) if (recv[p*(rank+1)+i] != 100*p+rank) bad++;
+        }
+
+        /*
+         * nonblocking collectives overlapped with each other, complete once waited on
+         */
+        std::vector<double> b(4, rank == 0 ? 2.5 : 0.0), r = {1.0, (double)rank};
+        MPI::Request bcast = world.ibcast(b.data(), b.size(), 0);
+        MPI::Request reduce = world.iallreduce(r.data(), r.size());
+        bcast.Wait();
+        reduce.Wait();
+        if (b != std::vector<double>(4, 2.5) || r != std::vector<double>{(double)nproc, (double)sum}) bad++;
+
+        world.allreduce(&bad, 1);
+        check(bad == 0, "collectives on " + std::to_string(nproc) + " processes", rank == 0);
+    }
+
+    MPI::Finalize();
+
+    return finish(false);
+}
@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2013 Devin Matthews
+ *
+ * This is a slimmed down version of the tensor framework developed by
+ * Devin Matthews. The version by Devin was tied to Aquarius. This
+ * version is not.
+ *
+ * Copyright (C) 2013  Justin Turney
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "block_sparse_tensor.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+namespace ambit { namespace tensor {
+
+template <typename T>
+BlockSparseTensor<T>::BlockSparseTensor(const std::string& name, const std::string& indices, const int irrep)
+    : IndexableCompositeTensor< BlockSparseTensor<T>, DenseTensor<T>, T >(name, split_indices(indices).size()),
+      len(ndim), scalar_(NULL)
+{
+    std::vector<IndexRange> ranges = IndexRange::find(split_indices(indices));
+    size_t nblocks = 1;
+
+    for (int i = 0;i < ndim;i++)
+    {
+        if (ranges[i].start.size() != ranges[i].end.size()) throw InvalidLengthError();
+
+        for (size_t b = 0;b < ranges[i].start.size();b++)
+        {
+            len[i].push_back(ranges[i].end[b] - ranges[i].start[b]);
+        }
+
+        nblocks *= len[i].size();
+    }
+
+    tensors.resize(nblocks);
+
+    /*
+     * store each block whose irreps multiply to irrep and which has any elements
+     */
+    std::vector<int> block(ndim, 0);
+    for (size_t n = 0;n < nblocks;n++)
+    {
+        size_t m = n;
+        int sym = 0;
+        std::vector<int> block_len(ndim);
+        bool empty = false;
+
+        for (int i = 0;i < ndim;i++)
+        {
+            block[i] = m%len[i].size();
+            m /= len[i].size();
+            sym ^= block[i];
+            block_len[i] = len[i][block[i]];
+            if (block_len[i] == 0) empty = true;
+        }
+
+        if (sym == irrep && !empty)
+        {
+            tensors[n] = typename CompositeTensor< BlockSparseTensor<T>, DenseTensor<T>, T >::TensorRef(
+                new DenseTensor<T>(name, block_len), true);
+        }
+    }
+}
+
+template <typename T>
+BlockSparseTensor<T>::BlockSparseTensor(const std::string& name, const std::vector< std::vector<int> >& len_,
+                                        const std::vector< std::vector<int> >& blocks)
+    : IndexableCompositeTensor< BlockSparseTensor<T>, DenseTensor<T>, T >(name, len_.size()),
+      len(len_), scalar_(NULL)
+{
+    size_t nblocks = 1;
+    for (int i = 0;i < ndim;i++) nblocks *= len[i].size();
+
+    tensors.resize(nblocks);
+
+    for (size_t n = 0;n < blocks.size();n++)
+    {
+        const std::vector<int>& block = blocks[n];
+        std::vector<int> block_len(ndim);
+        bool empty = false;
+
+        if ((int)block.size() != ndim) throw InvalidNdimError();
+
+        for (int i = 0;i < ndim;i++)
+        {
+            if (block[i] < 0 || block[i] >= (int)len[i].size()) throw OutOfBoundsError();
+            block_len[i] = len[i][block[i]];
+            if (block_len[i] == 0) empty = true;
+        }
+
+        const size_t idx = blockIndex(block.data());
+        if (!empty && tensors[idx] == NULL)
+        {
+            tensors[idx] = typename CompositeTensor< BlockSparseTensor<T>, DenseTensor<T>, T >::TensorRef(
+                new DenseTensor<T>(name, block_len), true);
+        }
+    }
+}
+
+template <typename T>
+BlockSparseTensor<T>::BlockSparseTensor(const BlockSparseTensor<T>& other)
+    : IndexableCompositeTensor< BlockSparseTensor<T>, DenseTensor<T>, T >(other),
+      len(other.len), scalar_(NULL) {}
+
+template <typename T>
+BlockSparseTensor<T>::BlockSparseTensor(const std::string& name, const BlockSparseTensor<T>& other)
+    : IndexableCompositeTensor< BlockSparseTensor<T>, DenseTensor<T>, T >(name, other),
+      len(other.len), scalar_(NULL) {}
+
+template <typename T>
+BlockSparseTensor<T>::~BlockSparseTensor()
+{
+    delete scalar_;
+}
+
+template <typename T>
+size_t BlockSparseTensor<T>::blockIndex(const int* block) const
+{
+    size_t idx = 0, stride = 1;
+
+    for (int i = 0;i < ndim;i++)
+    {
+        idx += block[i]*stride;
+        stride *= len[i].size();
+    }
+
+    return idx;
+}
+
+template <typename T>
+uint64_t BlockSparseTensor<T>::getStoredSize() const
+{
+    uint64_t size = 0;
+
+    for (size_t n = 0;n < tensors.size();n++)
+    {
+        if (tensors[n] != NULL) size += tensors[n].tensor->getSize();
+    }
+
+    return size;
+}
+
+template <typename T>
+bool BlockSparseTensor<T>::exists(const std::vector<int>& block) const
+{
+    if ((int)block.size() != ndim) throw InvalidNdimError();
+
+    for (int i = 0;i < ndim;i++)
+    {
+        if (block[i] < 0 || block[i] >= (int)len[i].size()) return false;
+    }
+
+    return tensors[blockIndex(block.data())] != NULL;
+}
+
+template <typename T>
+DenseTensor<T>& BlockSparseTensor<T>::getBlock(const std::vector<int>& block)
+{
+    if (!exists(block)) throw std::logic_error("tensor block does not exist");
+    return *tensors[blockIndex(block.data())].tensor;
+}
+
+template <typename T>
+const DenseTensor<T>& BlockSparseTensor<T>::getBlock(const std::vector<int>& block) const
+{
+    if (!exists(block)) throw std::logic_error("tensor block does not exist");
+    return *tensors[blockIndex(block.data())].tensor;
+}
+
+template <typename T>
+BlockSparseTensor<T>& BlockSparseTensor<T>::scalar() const
+{
+    if (scalar_ == NULL)
+    {
+        scalar_ = new BlockSparseTensor<T>(this->getName(), std::vector< std::vector<int> >(),
+                                                 std::vector< std::vector<int> >(1));
+    }
+
+    return *scalar_;
+}
+
+template <typename T>
+void BlockSparseTensor<T>::print() const
+{
+    printf("Name: %s\n", this->getName().c_str());
+
+    for (size_t n = 0;n < tensors.size();n++)
+    {
+        if (tensors[n] == NULL) continue;
+
+        size_t m = n;
+        printf("Block:");
+        for (int i = 0;i < ndim;i++)
+        {
+            printf(" %d", (int)(m%len[i].size()));
+            m /= len[i].size();
+        }
+        printf("\n");
+
+        tensors[n].tensor->print();
+    }
+}
+
+template <typename T>
+void BlockSparseTensor<T>::fill_with_random_data()
+{
+    for (size_t n = 0;n < tensors.size();n++)
+    {
+        if (tensors[n] != NULL) tensors[n].tensor->fill_with_random_data();
+    }
+}
+
+/*
+ * Call f(a, b, c) with the positions of the stored blocks of A, B, and C whose block numbers agree for each
+ * index label (including repeated labels within one tensor); B may be NULL for unary operations
+ *
+ * The pairs of stored blocks of A and B are enumerated directly, and any labels which appear only in C are
+ * looped over.
+ */
+template <typename T>
+template <class F>
+void BlockSparseTensor<T>::matchBlocks(const BlockSparseTensor<T>& A, const std::string& idx_A,
+                                       const BlockSparseTensor<T>* B, const std::string& idx_B,
+                                       const BlockSparseTensor<T>& C, const std::string& idx_C, F f)
+{
+    const BlockSparseTensor<T>* ops[3] = {&A, B, &C};
+    const std::string* idx[3] = {&idx_A, &idx_B, &idx_C};
+    std::vector<char> labels;
+    std::vector<const std::vector<int>*> label_len;
+    std::vector<int> lbl[3];
+
+    /*
+     * number the distinct labels, checking that each is blocked the same way everywhere it appears
+     */
+    for (int op = 0;op < 3;op++)
+    {
+        if (ops[op] == NULL) continue;
+        if ((int)idx[op]->size() != ops[op]->ndim) throw InvalidNdimError();
+
+        for (int i = 0;i < ops[op]->ndim;i++)
+        {
+            const char c = (*idx[op])[i];
+            const int l = std::find(labels.begin(), labels.end(), c) - labels.begin();
+
+            if (l == (int)labels.size())
+            {
+                labels.push_back(c);
+                label_len.push_back(&ops[op]->len[i]);
+            }
+            else if (*label_len[l] != ops[op]->len[i])
+            {
+                throw LengthMismatchError();
+            }
+
+            lbl[op].push_back(l);
+        }
+    }
+
+    const int nlabel = labels.size();
+    std::vector<int> only_C;
+    for (int l = 0;l < nlabel;l++)
+    {
+        if (std::find(lbl[0].begin(), lbl[0].end(), l) == lbl[0].end() &&
+            std::find(lbl[1].begin(), lbl[1].end(), l) == lbl[1].end()) only_C.push_back(l);
+    }
+
+    /*
+     * assign the block numbers of one stored block of op to its labels, returning false if they conflict
+     * with those already assigned
+     */
+    auto assign = [&](const int op, size_t n, std::vector<int>& block) -> bool
+    {
+        for (int i = 0;i < ops[op]->ndim;i++)
+        {
+            const int nb = ops[op]->len[i].size();
+            const int b = n%nb;
+            n /= nb;
+
+            int& cur = block[lbl[op][i]];
+            if (cur == -1)
+                cur = b;
+            else if (cur != b)
+                return false;
+        }
+
+        return true;
+    };
+
+    std::vector<int> block_A(nlabel), block_AB(nlabel), block_C(C.ndim);
+
+    for (size_t a = 0;a < A.tensors.size();a++)
+    {
+        if (A.tensors[a] == NULL) continue;
+
+        std::fill(block_A.begin(), block_A.end(), -1);
+        if (!assign(0, a, block_A)) continue;
+
+        const size_t nb = (B == NULL ? 1 : B->tensors.size());
+        for (size_t b = 0;b < nb;b++)
+        {
+            block_AB = block_A;
+
+            if (B != NULL)
+            {
+                if (B->tensors[b] == NULL) continue;
+                if (!assign(1, b, block_AB)) continue;
+            }
+
+            /*
+             * loop over the blocks of labels appearing only in C
+             */
+            for (size_t l = 0;l < only_C.size();l++) block_AB[only_C[l]] = 0;
+
+            for (bool done = false;!done;)
+            {
+                for (int i = 0;i < C.ndim;i++) block_C[i] = block_AB[lbl[2][i]];
+
+                /*
+                 * repeated labels in C always agree here, since they share one entry of block_AB
+                 */
+                const size_t c = C.blockIndex(block_C.data());
+                if (C.tensors[c] != NULL) f(a, b, c);
+
+                done = true;
+                for (size_t l = 0;l < only_C.size();l++)
+                {
+                    int& cur = block_AB[only_C[l]];
+                    if (cur == (int)label_len[only_C[l]]->size() - 1)
+                    {
+                        cur = 0;
+                    }
+                    else
+                    {
+                        cur++;
+                        done = false;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+void BlockSparseTensor<T>::mult(const T alpha, const BlockSparseTensor<T>& A, const std::string& idx_A,
+                                               const BlockSparseTensor<T>& B, const std::string& idx_B,
+                                const T beta,                                 const std::string& idx_C)
+{
+    std::vector<bool> touched(tensors.size(), false);
+
+    /*
+     * the first contribution to each block of C scales it by beta, and later ones add to it
+     */
+    matchBlocks(A, idx_A, &B, idx_B, *this, idx_C,
+    [&](const size_t a, const size_t b, const size_t c)
+    {
+        tensors[c].tensor->mult(alpha, *A.tensors[a].tensor, idx_A,
+                                       *B.tensors[b].tensor, idx_B,
+                                (touched[c] ? (T)1 : beta),  idx_C);
+        touched[c] = true;
+    });
+
+    for (size_t c = 0;c < tensors.size();c++)
+    {
+        if (tensors[c] != NULL && !touched[c])
+            tensors[c].tensor->scale(beta, tensors[c].tensor->implicit());
+    }
+}
+
+template <typename T>
+void BlockSparseTensor<T>::sum(const T alpha, const BlockSparseTensor<T>& A, const std::string& idx_A,
+                               const T beta,                                 const std::string& idx_B)
+{
+    std::vector<bool> touched(tensors.size(), false);
+
+    matchBlocks(A, idx_A, NULL, "", *this, idx_B,
+    [&](const size_t a, const size_t, const size_t b)
+    {
+        tensors[b].tensor->sum(alpha, *A.tensors[a].tensor, idx_A,
+                               (touched[b] ? (T)1 : beta),  idx_B);
+        touched[b] = true;
+    });
+
+    for (size_t b = 0;b < tensors.size();b++)
+    {
+        if (tensors[b] != NULL && !touched[b])
+            tensors[b].tensor->scale(beta, tensors[b].tensor->implicit());
+    }
+}
+
+template <typename T>
+void BlockSparseTensor<T>::scale(const T alpha, const std::string& idx_A)
+{
+    /*
+     * blocks whose repeated labels have different block numbers contain no diagonal elements to scale
+     */
+    matchBlocks(*this, idx_A, NULL, "", *this, idx_A,
+    [&](const size_t a, const size_t, const size_t c)
+    {
+        if (a == c) tensors[a].tensor->scale(alpha, idx_A);
+    });
+}
+
+template <typename T>
+T BlockSparseTensor<T>::dot(const BlockSparseTensor<T>& A, const std::string& idx_A,
+                                                           const std::string& idx_B) const
+{
+    T s = (T)0;
+
+    matchBlocks(A, idx_A, NULL, "", *this, idx_B,
+    [&](const size_t a, const size_t, const size_t b)
+    {
+        s += tensors[b].tensor->dot(*A.tensors[a].tensor, idx_A, idx_B);
+    });
+
+    return s;
+}
+
+INSTANTIATE_SPECIALIZATIONS(BlockSparseTensor);
+
+}
+}
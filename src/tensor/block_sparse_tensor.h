@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2013 Devin Matthews
+ *
+ * This is a slimmed down version of the tensor framework developed by
+ * Devin Matthews. The version by Devin was tied to Aquarius. This
+ * version is not.
+ *
+ * Copyright (C) 2013  Justin Turney
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined(AMBIT_LIB_TENSOR_BLOCK_SPARSE_TENSOR)
+#define AMBIT_LIB_TENSOR_BLOCK_SPARSE_TENSOR
+
+#include "composite_tensor.h"
+#include "dense_tensor.h"
+#include "indices.h"
+
+#include <vector>
+
+namespace ambit {
+
+namespace tensor {
+
+/*
+ * A tensor divided into blocks along each index, of which only the allowed (symmetry-nonzero) blocks are stored
+ *
+ * Each block is a DenseTensor, and blocks are numbered along each index from zero. Operations loop over the pairs
+ * of stored blocks of the operands whose block numbers agree on every shared index label, so that both memory and
+ * work scale with the number of nonzero blocks rather than with the full dimensions.
+ */
+template <typename T>
+class BlockSparseTensor : public IndexableCompositeTensor< BlockSparseTensor<T>, DenseTensor<T>, T >
+{
+    INHERIT_FROM_INDEXABLE_COMPOSITE_TENSOR(BlockSparseTensor<T>, DenseTensor<T>, T)
+
+    protected:
+        std::vector< std::vector<int> > len;
+        mutable BlockSparseTensor<T>* scalar_;
+
+        size_t blockIndex(const int* block) const;
+
+        template <class F>
+        static void matchBlocks(const BlockSparseTensor<T>& A, const std::string& idx_A,
+                                const BlockSparseTensor<T>* B, const std::string& idx_B,
+                                const BlockSparseTensor<T>& C, const std::string& idx_C, F f);
+
+    public:
+        /*
+         * Create a tensor over index spaces declared with declare_index_range, one block per subblock of each
+         * range, whose blocks are those in which the exclusive-or of the block numbers (taken as irrep labels
+         * of an abelian point group) equals irrep
+         */
+        BlockSparseTensor(const std::string& name, const std::string& indices, const int irrep = 0);
+
+        /*
+         * Create a tensor whose ith index has blocks of lengths len[i], storing only the listed blocks (each
+         * given by its block number along every index), e.g. the spin-allowed blocks of a spin-orbital tensor
+         */
+        BlockSparseTensor(const std::string& name, const std::vector< std::vector<int> >& len,
+                          const std::vector< std::vector<int> >& blocks);
+
+        BlockSparseTensor(const BlockSparseTensor<T>& other);
+        BlockSparseTensor(const std::string& name, const BlockSparseTensor<T>& other);
+
+        ~BlockSparseTensor();
+
+        int getNumBlocks(const int dim) const { return len[dim].size(); }
+        const std::vector<int>& getBlockLengths(const int dim) const { return len[dim]; }
+
+        /*
+         * The number of elements actually stored, summed over the nonzero blocks
+         */
+        uint64_t getStoredSize() const;
+
+        bool exists(const std::vector<int>& block) const;
+        DenseTensor<T>& getBlock(const std::vector<int>& block);
+        const DenseTensor<T>& getBlock(const std::vector<int>& block) const;
+
+        BlockSparseTensor<T>& scalar() const;
+
+        void print() const;
+
+        void fill_with_random_data();
+
+        void mult(const T alpha, const BlockSparseTensor<T>& A, const std::string& idx_A,
+                                 const BlockSparseTensor<T>& B, const std::string& idx_B,
+                  const T beta,                                 const std::string& idx_C);
+
+        void sum(const T alpha, const BlockSparseTensor<T>& A, const std::string& idx_A,
+                 const T beta,                                 const std::string& idx_B);
+
+        void scale(const T alpha, const std::string& idx_A);
+
+        T dot(const BlockSparseTensor<T>& A, const std::string& idx_A,
+                                             const std::string& idx_B) const;
+};
+
+}
+
+}
+
+#endif
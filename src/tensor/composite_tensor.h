@@ -59,7 +59,7 @@ namespace tensor
         using ambit::tensor::Tensor< Derived,T >::operator/; \
         Derived & operator=(const Derived & other) \
         { \
-            sum((T)1, false, other, (T)0); \
+            sum((T)1, other, (T)0); \
             return *this; \
         } \
     private:
@@ -89,7 +89,7 @@ namespace tensor
         using ambit::tensor::Tensor< Derived,T >::operator/; \
         Derived & operator=(const Derived & other) \
         { \
-            sum((T)1, false, other, (T)0); \
+            sum((T)1, other, (T)0); \
             return *this; \
         } \
     private:
@@ -363,7 +363,7 @@ class IndexableCompositeTensor : public IndexableTensorBase<Derived,T>, public C
                   const T beta)
         {
             #ifdef VALIDATE_INPUTS
-            if (ndim != A.ndim || ndim != B_.ndim) throw InvalidNdimError();
+            if (ndim != A.ndim || ndim != B.ndim) throw InvalidNdimError();
             #endif //VALIDATE_INPUTS
 
             mult(alpha, A, A.implicit(),
@@ -413,6 +413,11 @@ class IndexableCompositeTensor : public IndexableTensorBase<Derived,T>, public C
             return dot(A, A.implicit(),
                             implicit());
         }
+
+        T dot(const Derived& A) const
+        {
+            return dot(A, false);
+        }
 };
 
 }
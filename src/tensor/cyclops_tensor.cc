@@ -24,9 +24,13 @@
 
 #include "cyclops_tensor.h"
 #include "indices.h"
+#include "tensor_file.h"
 #include "util.h"
 
 #include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <functional>
 
 namespace ambit { namespace tensor {
 
@@ -69,6 +73,14 @@ CyclopsTensor<T>::CyclopsTensor(const std::string& name, util::World& arena, con
         *dt = (T)0;
 }
 
+template<typename T>
+CyclopsTensor<T>::CyclopsTensor(const std::string& name, const CyclopsTensor<T>& like, const std::vector<int>& len)
+    : IndexableTensor<CyclopsTensor<T>, T>(name, len.size()), world(like.world), len(len), sym(len.size(), NS)
+{
+    allocate();
+    *dt = (T)0;
+}
+
 template<typename T>
 CyclopsTensor<T>::~CyclopsTensor()
 {
@@ -90,8 +102,8 @@ void CyclopsTensor<T>::free()
 template<typename T>
 void CyclopsTensor<T>::resize(int _ndim, const std::vector<int> &_len, const std::vector<int> &_sym, bool zero)
 {
-    assert(_len.size() == ndim);
-    assert(_sym.size() == ndim);
+    assert(_len.size() == _ndim);
+    assert(_sym.size() == _ndim);
 
     ndim = _ndim;
     len = _len;
@@ -224,36 +236,248 @@ void CyclopsTensor<T>::get_all_data(std::vector<T>& vals, int rank) const
     }
 }
 
+namespace {
+
+bool nonsymmetric(const std::vector<int>& sym)
+{
+    for (int i = 0;i < sym.size();i++) if (sym[i] != NS) return false;
+    return true;
+}
+
+const char checkpoint_magic[8] = {'A','M','B','I','T','C','K','P'};
+
+/*
+ * Lay out the header, lengths, symmetry, and name of a checkpoint file, padded to the start of the pairs
+ */
+template <typename T>
+std::vector<char> checkpoint_header(const std::string& name, const std::vector<int>& len,
+                                    const std::vector<int>& sym, const int64_t npair)
+{
+    const int ndim = len.size();
+
+    TensorFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, checkpoint_magic, sizeof(checkpoint_magic));
+    header.version = kCyclopsCheckpointVersion;
+    header.dtype = TensorFileType<T>::value;
+    header.elem_size = sizeof(tkv_pair<T>);
+    header.ndim = ndim;
+    header.name_size = name.size();
+    header.data_size = npair*sizeof(tkv_pair<T>);
+
+    const size_t meta = sizeof(header) + 2*ndim*sizeof(int64_t) + name.size();
+    header.data_offset = (meta+kTensorFileAlignment-1)/kTensorFileAlignment*kTensorFileAlignment;
+
+    std::vector<char> head(header.data_offset, 0);
+    memcpy(head.data(), &header, sizeof(header));
+
+    for (int i = 0;i < ndim;i++)
+    {
+        const int64_t l = len[i], s = sym[i];
+        memcpy(head.data()+sizeof(header)+i*sizeof(int64_t), &l, sizeof(int64_t));
+        memcpy(head.data()+sizeof(header)+(ndim+i)*sizeof(int64_t), &s, sizeof(int64_t));
+    }
+
+    memcpy(head.data()+sizeof(header)+2*ndim*sizeof(int64_t), name.data(), name.size());
+
+    return head;
+}
+
+}
+
+template <typename T>
+void CyclopsTensor<T>::checkpoint(const std::string& path) const
+{
+    const MPI::Intracomm& comm = world.get_comm();
+
+    std::vector<tkv_pair<T> > pairs;
+    read_local(pairs);
+
+    const int64_t npair = pairs.size();
+    const std::vector<int64_t> counts = world.allgather(npair);
+    int64_t first = 0, total = 0;
+
+    for (int i = 0;i < world.nproc;i++)
+    {
+        if (i < world.rank) first += counts[i];
+        total += counts[i];
+    }
+
+    const std::vector<char> head = checkpoint_header<T>(this->name, len, sym, total);
+    const int64_t data_offset = head.size();
+
+    /*
+     * every process takes part in the same number of collective writes, some of them empty
+     */
+    const int64_t bytes = npair*sizeof(tkv_pair<T>);
+    const int64_t nround = world.allreduce((bytes+kCyclopsCheckpointChunk-1)/kCyclopsCheckpointChunk, MPI::MAX);
+
+    MPI::File fh = MPI::File::Open(comm, path.c_str(), MPI::MODE_CREATE|MPI::MODE_WRONLY, MPI::INFO_NULL);
+    if (fh == MPI::FILE_NULL) throw TensorFileError(path, "cannot open checkpoint file for writing");
+
+    try
+    {
+        fh.Set_errhandler(MPI::ERRORS_THROW_EXCEPTIONS);
+        fh.Set_size(data_offset + total*sizeof(tkv_pair<T>));
+
+        if (world.rank == 0) fh.Write_at(0, head.data(), head.size(), MPI::BYTE);
+
+        const char* data = (const char*)pairs.data();
+        MPI::Offset off = data_offset + first*sizeof(tkv_pair<T>);
+
+        for (int64_t round = 0, done = 0;round < nround;round++)
+        {
+            const int64_t n = std::min(bytes-done, (int64_t)kCyclopsCheckpointChunk);
+            fh.Write_at_all(off+done, data+done, n, MPI::BYTE);
+            done += n;
+        }
+
+        fh.Close();
+    }
+    catch (MPI::Exception& e)
+    {
+        if (fh != MPI::FILE_NULL) fh.Close();
+        throw TensorFileError(path, e.Get_error_string());
+    }
+}
+
+template <typename T>
+void CyclopsTensor<T>::restart(const std::string& path)
+{
+    const MPI::Intracomm& comm = world.get_comm();
+
+    MPI::File fh = MPI::File::Open(comm, path.c_str(), MPI::MODE_RDONLY, MPI::INFO_NULL);
+    if (fh == MPI::FILE_NULL) throw TensorFileError(path, "cannot open checkpoint file for reading");
+
+    TensorFileHeader header;
+    std::vector<int> new_len, new_sym;
+    std::string new_name;
+
+    /*
+     * every process reads the header, so that all of them find the same problems and throw together
+     */
+    try
+    {
+        fh.Set_errhandler(MPI::ERRORS_THROW_EXCEPTIONS);
+
+        const MPI::Offset size = fh.Get_size();
+        memset(&header, 0, sizeof(header));
+        if (size >= (MPI::Offset)sizeof(header)) fh.Read_at_all(0, &header, sizeof(header), MPI::BYTE);
+
+        const char* problem = NULL;
+        if (memcmp(header.magic, checkpoint_magic, sizeof(checkpoint_magic)) != 0)
+            problem = "not a checkpoint file";
+        else if (header.version != kCyclopsCheckpointVersion)
+            problem = "unsupported checkpoint file version";
+        else if (header.dtype != (uint32_t)TensorFileType<T>::value || header.elem_size != sizeof(tkv_pair<T>))
+            problem = "checkpoint file holds elements of a different type";
+        else if (header.ndim > 64 || header.name_size > 4096 || header.data_size%sizeof(tkv_pair<T>) != 0)
+            problem = "corrupt checkpoint file header";
+        else if (header.data_offset+header.data_size > (uint64_t)size)
+            problem = "truncated checkpoint file";
+
+        if (problem)
+        {
+            fh.Close();
+            throw TensorFileError(path, problem);
+        }
+
+        std::vector<char> meta(2*header.ndim*sizeof(int64_t) + header.name_size);
+        fh.Read_at_all(sizeof(header), meta.data(), meta.size(), MPI::BYTE);
+
+        for (int i = 0;i < (int)header.ndim;i++)
+        {
+            int64_t l, s;
+            memcpy(&l, meta.data()+i*sizeof(int64_t), sizeof(int64_t));
+            memcpy(&s, meta.data()+(header.ndim+i)*sizeof(int64_t), sizeof(int64_t));
+            new_len.push_back(l);
+            new_sym.push_back(s);
+        }
+
+        new_name.assign(meta.data()+2*header.ndim*sizeof(int64_t), header.name_size);
+    }
+    catch (MPI::Exception& e)
+    {
+        fh.Close();
+        throw TensorFileError(path, e.Get_error_string());
+    }
+
+    this->name = new_name;
+    resize(header.ndim, new_len, new_sym, true);
+
+    /*
+     * read an equal share of the pairs, which CTF sends to wherever they are stored now
+     */
+    const int64_t total = header.data_size/sizeof(tkv_pair<T>);
+    const int64_t first = total*world.rank/world.nproc;
+    const int64_t npair = total*(world.rank+1)/world.nproc - first;
+    const int64_t max_npair = (total+world.nproc-1)/world.nproc;
+    const int64_t chunk = std::max((int64_t)1, (int64_t)(kCyclopsCheckpointChunk/sizeof(tkv_pair<T>)));
+    const int64_t nround = (max_npair+chunk-1)/chunk;
+
+    std::vector<tkv_pair<T> > pairs;
+
+    try
+    {
+        for (int64_t round = 0, done = 0;round < nround;round++)
+        {
+            const int64_t n = std::min(npair-done, chunk);
+            pairs.resize(n);
+            fh.Read_at_all(header.data_offset + (first+done)*sizeof(tkv_pair<T>),
+                           pairs.data(), n*sizeof(tkv_pair<T>), MPI::BYTE);
+            write(pairs);
+            done += n;
+        }
+
+        fh.Close();
+    }
+    catch (MPI::Exception& e)
+    {
+        fh.Close();
+        throw TensorFileError(path, e.Get_error_string());
+    }
+}
+
+/*
+ * As in LocalTensor, elements where the divisor is not larger than DBL_MIN in magnitude are left unchanged, and the
+ * others are not read when beta is zero
+ */
 template <typename T>
 void CyclopsTensor<T>::div(T alpha, const CyclopsTensor<T>& A,
-                                        const CyclopsTensor<T>& B, T beta)
-{
-    const_cast<tCTF_Tensor<T>*>(A.dt)->align(*dt);
-    const_cast<tCTF_Tensor<T>*>(B.dt)->align(*dt);
-    int64_t size, size_A, size_B;
-    T* raw_data = get_raw_data(size);
-    const T* raw_data_A = A.get_raw_data(size_A);
-    const T* raw_data_B = B.get_raw_data(size_B);
-    assert(size == size_A);
-    assert(size == size_B);
-
-    for (int64_t i = 0;i < size;i++) {
-        if (abs(raw_data_B[i]) > DBL_MIN)
-            raw_data[i] = beta*raw_data[i] + alpha*raw_data_A[i]/raw_data_B[i];
+                                    const CyclopsTensor<T>& B, T beta)
+{
+    if (beta == T(0))
+    {
+        map(T(1), A, B, *this, [alpha](const T a, const T b, const T c)
+        {
+            return (std::abs(b) > DBL_MIN ? alpha*a/b : c);
+        }, T(0));
+    }
+    else
+    {
+        map(T(1), A, B, *this, [alpha,beta](const T a, const T b, const T c)
+        {
+            return (std::abs(b) > DBL_MIN ? alpha*a/b + beta*c : c);
+        }, T(0));
     }
 }
 
 template <typename T>
 void CyclopsTensor<T>::invert(T alpha, const CyclopsTensor<T>& A, T beta)
 {
-    dt->align(*A.dt);
-    int64_t size, size_A;
-    T* raw_data = get_raw_data(size);
-    const T* raw_data_A = A.get_raw_data(size_A);
-    assert(size == size_A);
-    for (int64_t i = 0; i < size; ++i) {
-        if (abs(raw_data_A[i]) > DBL_MIN)
-            raw_data[i] = beta*raw_data[i] + alpha/raw_data_A[i];
+    if (beta == T(0))
+    {
+        map(T(1), A, *this, [alpha](const T a, const T c)
+        {
+            return (std::abs(a) > DBL_MIN ? alpha/a : c);
+        }, T(0));
+    }
+    else
+    {
+        map(T(1), A, *this, [alpha,beta](const T a, const T c)
+        {
+            return (std::abs(a) > DBL_MIN ? alpha/a + beta*c : c);
+        }, T(0));
     }
 }
 
@@ -269,17 +493,52 @@ void CyclopsTensor<T>::compare(const CyclopsTensor<T>& other, double cutoff) con
     dt->compare(*other.dt, stdout, cutoff);
 }
 
+/*
+ * For nonsymmetric tensors, the norm is reduced over the local data (where the padding is zero) and then with a
+ * single collective; symmetric tensors are left to CTF, since each stored element may stand for several
+ */
 template <typename T>
 typename real_type<T>::type CyclopsTensor<T>::norm(int p) const
 {
-    T ans = (T)0;
+    typedef typename real_type<T>::type R;
+
+    if (!nonsymmetric(sym))
+    {
+        T ans = (T)0;
+        if (p == 0)
+            ans = dt->reduce(CTF_OP_NORM_INFTY);
+        else if (p == 1)
+            ans = dt->reduce(CTF_OP_NORM1);
+        else if (p == 2)
+            ans = dt->reduce(CTF_OP_NORM2);
+        return std::abs(ans);
+    }
+
+    int64_t size;
+    const T* data = get_raw_data(size);
+    R local = 0, ans = 0;
+
     if (p == 0)
-        ans = dt->reduce(CTF_OP_NORM_INFTY);
+    {
+        local = tensor_map_reduce_dense_<1>([](const T a) { return std::abs(a); },
+                                            [](const R a, const R b) { return std::max(a, b); },
+                                            R(0), &data, size);
+        ans = world.allreduce(local, MPI::MAX);
+    }
     else if (p == 1)
-        ans = dt->reduce(CTF_OP_NORM1);
+    {
+        local = tensor_map_reduce_dense_<1>([](const T a) { return std::abs(a); }, std::plus<R>(),
+                                            R(0), &data, size);
+        ans = world.allreduce(local);
+    }
     else if (p == 2)
-        ans = dt->reduce(CTF_OP_NORM2);
-    return abs(ans);
+    {
+        local = tensor_map_reduce_dense_<1>([](const T a) { return std::norm(a); }, std::plus<R>(),
+                                            R(0), &data, size);
+        ans = std::sqrt(world.allreduce(local));
+    }
+
+    return ans;
 }
 
 template <typename T>
@@ -310,14 +569,90 @@ template <typename T>
 T CyclopsTensor<T>::dot(const CyclopsTensor<T>& A, const std::string& idx_A,
                                                    const std::string& idx_B) const
 {
+    if (idx_A == idx_B && A.len == len && nonsymmetric(A.sym) && nonsymmetric(sym))
+    {
+        std::vector<T> val;
+        dot(std::vector<const CyclopsTensor<T>*>(1, &A), std::vector<const CyclopsTensor<T>*>(1, this), val);
+        return val[0];
+    }
+
+    /*
+     * every process reads the single element of the result, in one collective
+     */
     CyclopsTensor<T> dt(A.name, A.world);
-    std::vector<T> val;
     dt.mult(1,     A, idx_A,
                *this, idx_B,
             0,           "");
-    dt.get_all_data(val);
-    assert(val.size()==1);
-    return val[0];
+
+    std::vector<tkv_pair<T> > val(1, tkv_pair<T>(0, (T)0));
+    dt.read(val);
+    return val[0].d;
+}
+
+template <typename T>
+void CyclopsTensor<T>::dot(const std::vector<const CyclopsTensor<T>*>& A, const std::vector<const CyclopsTensor<T>*>& B,
+                           std::vector<T>& val)
+{
+    const int na = A.size(), nb = B.size();
+    val.assign(na*nb, (T)0);
+    if (na == 0 || nb == 0) return;
+
+    const CyclopsTensor<T>& first = *A[0];
+    bool local = true;
+
+    for (int i = 0;i < na+nb;i++)
+    {
+        const CyclopsTensor<T>& X = (i < na ? *A[i] : *B[i-na]);
+        if (X.len != first.len) throw LengthMismatchError();
+        if (!nonsymmetric(X.sym)) local = false;
+    }
+
+    if (!local)
+    {
+        std::string idx(first.ndim, 'a');
+        for (int i = 0;i < first.ndim;i++) idx[i] += i;
+
+        for (int j = 0;j < nb;j++)
+            for (int i = 0;i < na;i++)
+                val[i+j*na] = B[j]->dot(*A[i], idx, idx);
+
+        return;
+    }
+
+    std::vector<const T*> data_A(na), data_B(nb);
+    int64_t size = 0, size_X;
+
+    for (int i = 0;i < na+nb;i++)
+    {
+        const CyclopsTensor<T>& X = (i < na ? *A[i] : *B[i-na]);
+        if (&X != &first) const_cast<tCTF_Tensor<T>*>(X.dt)->align(*first.dt);
+    }
+
+    first.get_raw_data(size);
+    for (int i = 0;i < na;i++)
+    {
+        data_A[i] = A[i]->get_raw_data(size_X);
+        assert(size_X == size);
+    }
+    for (int j = 0;j < nb;j++)
+    {
+        data_B[j] = B[j]->get_raw_data(size_X);
+        assert(size_X == size);
+    }
+
+    std::vector<T> partial(na*nb);
+
+    for (int j = 0;j < nb;j++)
+    {
+        for (int i = 0;i < na;i++)
+        {
+            const T* data[2] = {data_A[i], data_B[j]};
+            partial[i+j*na] = tensor_map_reduce_dense_<2>([](const T a, const T b) { return a*b; }, std::plus<T>(),
+                                                          (T)0, data, size);
+        }
+    }
+
+    first.world.allreduce(partial.data(), val.data(), na*nb);
 }
 
 template <typename T>
@@ -326,6 +661,36 @@ void CyclopsTensor<T>::weight(const std::vector<const std::vector<T>*>& d)
     assert(d.size() == ndim);
     for (int i = 0;i < d.size();i++) assert(d[i]->size() == len[i]);
 
+    if (nonsymmetric(sym))
+    {
+        /*
+         * form the denominators as a tensor of the same shape, as a sum of one-index tensors which CTF replicates
+         * along the other indices, and divide by it on the aligned local data; the local data includes padding, where
+         * both are zero, so zero elements are left as they are rather than set to 0/0
+         */
+        CyclopsTensor<T> den("denominator", world, len, sym, true);
+        std::string idx(ndim, 'a');
+        for (int i = 0;i < ndim;i++) idx[i] += i;
+
+        for (int i = 0;i < ndim;i++)
+        {
+            CyclopsTensor<T> di("denominator", world, std::vector<int>(1, len[i]), std::vector<int>(1, NS), true);
+            std::vector<tkv_pair<T> > pairs;
+
+            if (world.rank == 0)
+                for (int j = 0;j < len[i];j++) pairs.push_back(tkv_pair<T>(j, (*d[i])[j]));
+
+            di.write(pairs);
+            den.sum(T(1), di, idx.substr(i, 1), T(1), idx);
+        }
+
+        map(T(1), *this, den, [](const T a, const T b) { return (a == T(0) ? a : a/b); }, T(0));
+        return;
+    }
+
+    /*
+     * symmetric tensors store only some of the elements, so the denominators are found from the keys
+     */
     std::vector<tkv_pair<T> > pairs;
     read_local(pairs);
 
@@ -339,7 +704,7 @@ void CyclopsTensor<T>::weight(const std::vector<const std::vector<T>*>& d)
             den += (*d[j])[o];
         }
 
-        pairs[i].d /= den;
+        if (pairs[i].d != T(0)) pairs[i].d /= den;
     }
 
     write(pairs);
@@ -368,6 +733,9 @@ void CyclopsTensor<T>::sort(T alpha, const CyclopsTensor<T>& A, const std::strin
     (*dt)[idx_B.c_str()] = alpha * (*A.dt)[idx_A.c_str()];
 }
 
-INSTANTIATE_SPECIALIZATIONS(CyclopsTensor)
+/*
+ * util::World only provides a CTF world for double
+ */
+template class CyclopsTensor<double>;
 
 }}
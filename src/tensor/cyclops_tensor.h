@@ -31,14 +31,23 @@
 
 #include <ctf.hpp>
 #include "indexable_tensor.h"
+#include "tensor_map_dense.h"
 #include <util/world.h>
 
+#include <algorithm>
+#include <cassert>
 #include <vector>
 
 namespace ambit {
 
 namespace tensor {
 
+enum
+{
+    kCyclopsCheckpointVersion = 1,
+    kCyclopsCheckpointChunk = 64*1024*1024
+};
+
 template <typename T>
 struct CyclopsTensor : public IndexableTensor< CyclopsTensor<T>, T>
 {
@@ -62,11 +71,17 @@ public:
     CyclopsTensor(const std::string& name, util::World& arena, const std::vector<int>& len, const std::vector<int>& sym,
                 bool zero=true);
 
+    /*
+     * A zeroed, nonsymmetric tensor of the given lengths in the same World as like
+     */
+    CyclopsTensor(const std::string& name, const CyclopsTensor<T>& like, const std::vector<int>& len);
+
     ~CyclopsTensor();
 
     void resize(int ndim, const std::vector<int>& len, const std::vector<int>& sym, bool zero);
 
     const std::vector<int>& get_lengths() const { return len; }
+    const std::vector<int>& getLengths() const { return len; }
     const std::vector<int>& get_symmetry() const { return sym; }
 
     void fill_with_random_data();
@@ -88,11 +103,76 @@ public:
     void get_all_data(std::vector<T>& vals) const;
     void get_all_data(std::vector<T> &vals, int rank) const;
 
+    /*
+     * Write the tensor to a file shared by all processes, each of which writes its own key/value pairs with
+     * collective MPI-IO calls of at most kCyclopsCheckpointChunk bytes
+     */
+    void checkpoint(const std::string& path) const;
+
+    /*
+     * Read a file written by checkpoint, on any number of processes, replacing the name, lengths, symmetry, and
+     * data of this tensor; each process reads an equal share of the pairs, a chunk at a time, and CTF
+     * redistributes them
+     */
+    void restart(const std::string& path);
+
     void div(T alpha, const CyclopsTensor<T>& A,
                       const CyclopsTensor<T>& B, T beta);
 
     void invert(T alpha, const CyclopsTensor<T>& A, T beta);
 
+    /*
+     * this = alpha*f(...) + beta*this elementwise on the local data, where f takes one element of this tensor (for
+     * the first form) or of each of the one to four operands, which are first aligned with this tensor (see
+     * tensor_map_dense_)
+     *
+     * When alpha*f(0, ..., 0) is not zero the map is done on the local key-value pairs, which is slower but leaves
+     * CTF's padding zero.
+     */
+    template <class F>
+    void map(T alpha, F f, T beta)
+    {
+        map_(alpha, f, beta, this);
+    }
+
+    template <class F>
+    void map(T alpha, const CyclopsTensor<T>& A, F f, T beta)
+    {
+        map_(alpha, f, beta, &A);
+    }
+
+    template <class F>
+    void map(T alpha, const CyclopsTensor<T>& A, const CyclopsTensor<T>& B, F f, T beta)
+    {
+        map_(alpha, f, beta, &A, &B);
+    }
+
+    template <class F>
+    void map(T alpha, const CyclopsTensor<T>& A, const CyclopsTensor<T>& B, const CyclopsTensor<T>& C,
+             F f, T beta)
+    {
+        map_(alpha, f, beta, &A, &B, &C);
+    }
+
+    template <class F>
+    void map(T alpha, const CyclopsTensor<T>& A, const CyclopsTensor<T>& B, const CyclopsTensor<T>& C,
+             const CyclopsTensor<T>& D, F f, T beta)
+    {
+        map_(alpha, f, beta, &A, &B, &C, &D);
+    }
+
+    /*
+     * Divide each element by the sum of d[k][i_k] over its indices i_k, where d[k] has the length of index k
+     *
+     * For a nonsymmetric tensor the denominators are formed as a temporary distributed tensor of the same size as
+     * this one, with one distributed sum per index, and divided by on the local data, so that the peak memory is
+     * twice that of the tensor and the cost is ndim redistributing sums; weighting several tensors with the same
+     * lengths and d is cheaper done as a map with one such denominator tensor. A symmetric tensor is instead
+     * weighted from the keys of its local elements, which reads and writes them as key-value pairs.
+     *
+     * Zero elements are left zero; any other element whose denominator is zero becomes infinite, as for a
+     * DenseTensor, so the caller must ensure that the denominators of the nonzero elements are nonzero.
+     */
     void weight(const std::vector<const std::vector<T>*>& d);
 
     void print() const;
@@ -113,8 +193,87 @@ public:
     T dot(const CyclopsTensor<T>& A, const std::string& idx_A,
                                          const std::string& idx_B) const;
 
+    /*
+     * val[i+j*A.size()] = A[i]["..."]*B[j]["..."] (a full contraction with the indices in the same order) for
+     * tensors of the same lengths, e.g. a DIIS matrix with A and B the same list
+     *
+     * For nonsymmetric tensors, all of the products are formed from the aligned local data and summed with a single
+     * collective; otherwise each is a separate contraction.
+     */
+    static void dot(const std::vector<const CyclopsTensor<T>*>& A, const std::vector<const CyclopsTensor<T>*>& B,
+                    std::vector<T>& val);
+
     /// Performs this[idx_B] = factor * A[idx_A]
     void sort(T alpha, const CyclopsTensor<T>& A, const std::string& idx_A, const std::string& idx_B);
+
+protected:
+    template <class F, class... Operands>
+    void map_(T alpha, F& f, T beta, const Operands*... operands)
+    {
+        const CyclopsTensor<T>* ops[] = {operands...};
+        const int N = sizeof...(Operands);
+        const T* A[N];
+        int64_t size, size_A;
+
+        for (int k = 0;k < N;k++)
+        {
+            if (ops[k]->len != len) throw LengthMismatchError();
+            if (ops[k] != this) const_cast<tCTF_Tensor<T>*>(ops[k]->dt)->align(*dt);
+        }
+
+        /*
+         * the raw data includes CTF's padding, which is zero in every operand and must stay zero; if f does not
+         * take zeros to zero, map the local elements as key-value pairs instead
+         */
+        const T zero = T(0);
+        const T* zeros[N];
+        for (int k = 0;k < N;k++) zeros[k] = &zero;
+
+        if (alpha*DenseMapCall<N>::apply(f, zeros, 0) != T(0))
+        {
+            std::vector<tkv_pair<T> > pairs[N+1];
+
+            for (int k = 0;k < N;k++)
+            {
+                ops[k]->read_local(pairs[k]);
+                std::sort(pairs[k].begin(), pairs[k].end());
+            }
+
+            read_local(pairs[N]);
+            std::sort(pairs[N].begin(), pairs[N].end());
+
+            const size_t npair = pairs[N].size();
+            std::vector<T> vals[N];
+
+            for (int k = 0;k < N;k++)
+            {
+                assert(pairs[k].size() == npair);
+                vals[k].resize(npair);
+                for (size_t i = 0;i < npair;i++) vals[k][i] = pairs[k][i].d;
+                A[k] = vals[k].data();
+            }
+
+            std::vector<T> val(npair);
+            for (size_t i = 0;i < npair;i++) val[i] = pairs[N][i].d;
+
+            tensor_map_dense_<N>(alpha, f, A, beta, val.data(), npair);
+
+            for (size_t i = 0;i < npair;i++) pairs[N][i].d = val[i];
+
+            write(pairs[N]);
+            return;
+        }
+
+        T* data = get_raw_data(size);
+
+        for (int k = 0;k < N;k++)
+        {
+            A[k] = ops[k]->get_raw_data(size_A);
+            assert(size == size_A);
+        }
+
+        tensor_map_dense_<N>(alpha, f, A, beta, data, (size_t)size);
+    }
 };
 
 }
@@ -0,0 +1,660 @@
+/*
+ * Copyright (C) 2013 Devin Matthews
+ *
+ * This is a slimmed down version of the tensor framework developed by
+ * Devin Matthews. The version by Devin was tied to Aquarius. This
+ * version is not.
+ *
+ * Copyright (C) 2013  Justin Turney
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined(AMBIT_LIB_TENSOR_DEFERRED)
+#define AMBIT_LIB_TENSOR_DEFERRED
+
+#include "tensor.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+#include <functional>
+#include <map>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace ambit { namespace tensor {
+
+/*
+ * Deferred evaluation of indexed tensor expressions
+ *
+ * While a Deferred<Derived,T> exists, the assignments C["..."] = ..., += ..., -= ..., and *= ... to tensors of type
+ * Derived made on the same thread are recorded instead of evaluated, and are evaluated together by flush() (which
+ * the destructor calls if flush() has not been), e.g.
+ *
+ *     {
+ *         Deferred< DenseTensor<double>, double > deferred;
+ *         R["ijab"] = 0.5*R["ijab"];
+ *         R["ijab"] += T2["ijcd"]*V["cdab"];
+ *         X["ijkl"] = T2["ijcd"]*V["cdkl"];
+ *         R["ijab"] += X["ijkl"]*T2["klab"];
+ *     }
+ *
+ * The recorded terms form a DAG, with an edge wherever a term reads a tensor written by an earlier term, writes a
+ * tensor read by an earlier term, or writes a tensor written by an earlier term (except that accumulations, with
+ * beta = 1, into the same tensor commute with each other). Within the constraints of the DAG the terms are
+ * scheduled so that those writing the same tensor run back to back, and a term which reads a freshly written
+ * intermediate runs as soon as it can, while the intermediate is still in cache. Scaling a whole tensor, e.g.
+ * R["ijab"] = 0.5*R["ijab"] or R["ijab"] *= 0.5, is folded into the beta of the next term writing that tensor,
+ * saving a pass over it.
+ *
+ * Contractions which are recorded more than once with the same operands, index pattern (up to renaming of the
+ * labels), and operand contents (the operands are not written in between, as tracked by a generation counter per
+ * tensor) are evaluated once into an intermediate, which each of the terms then adds into its own output, e.g. for
+ *
+ *     R["ijab"] += T2["ijcd"]*V["cdab"];
+ *     S["abkl"] -= T2["klcd"]*V["cdab"];
+ *
+ * the contraction is performed once and the second term becomes a transposed sum. printReport() lists the
+ * contractions shared in this way and the work saved.
+ *
+ * The operands must outlive the flush, and their contents must not change before it. Direct calls of mult, sum,
+ * scale, etc. on a tensor are not recorded and so may run before earlier recorded terms (scalar() flushes first).
+ * Tensors whose data is local (those with get_data() and getSize()) are compared by the range of memory they
+ * span, so that a view (e.g. DenseTensor::slice) and its parent, or two overlapping views, are ordered as the
+ * same tensor would be; other tensors are compared by address. A Deferred may be nested in another for the same
+ * type, in which case the inner one records until it is flushed; flushing it first flushes the enclosing ones, so
+ * that the terms they recorded earlier are evaluated first.
+ *
+ * A destructor cannot throw, so an error in the flush done by the destructor is only printed to stderr, and
+ * nothing is evaluated if the Deferred is destroyed by an exception; call flush() explicitly to handle errors.
+ */
+template <typename Derived, typename T>
+class Deferred
+{
+    public:
+        enum TermType { kDeferredSum, kDeferredMult, kDeferredScale, kDeferredFill };
+
+        /*
+         * C[idx_C] = alpha*A[idx_A]*B[idx_B] + beta*C[idx_C] (MULT), alpha*A[idx_A] + beta*C[idx_C] (SUM),
+         * alpha*C[idx_C] (SCALE), or alpha + beta*C[idx_C] (FILL)
+         */
+        struct Term
+        {
+            int type;
+            T alpha, beta;
+            const Derived* A;
+            std::string idx_A;
+            const Derived* B;
+            std::string idx_B;
+            Derived* C;
+            std::string idx_C;
+        };
+
+        /*
+         * A contraction evaluated once and used by several terms
+         */
+        struct Reuse
+        {
+            std::string expr;
+            size_t uses;
+            double flops;
+        };
+
+    protected:
+        typedef std::tuple<const Derived*, size_t, const Derived*, size_t,
+                           std::string, std::string, std::string> Key;
+
+        std::vector<Term> terms;
+        std::vector<Derived*> owned;
+        std::vector<Reuse> reused;
+        Deferred* parent;
+        size_t nfolded;
+
+        static Deferred*& current()
+        {
+            static thread_local Deferred* active = NULL;
+            return active;
+        }
+
+        static bool distinct(const std::string& idx)
+        {
+            for (size_t i = 0;i < idx.size();i++)
+                for (size_t j = i+1;j < idx.size();j++)
+                    if (idx[i] == idx[j]) return false;
+            return true;
+        }
+
+        /*
+         * The memory spanned by a tensor: its data for a tensor with get_data() and getSize(), or else the object
+         */
+        template <class X>
+        static auto extent(const X* x, int) -> decltype(x->get_data(), x->getSize(), std::pair<const char*, const char*>())
+        {
+            const char* p = (const char*)x->get_data();
+            return std::make_pair(p, p+std::max<uint64_t>(x->getSize(), 1)*sizeof(T));
+        }
+
+        template <class X>
+        static std::pair<const char*, const char*> extent(const X* x, long)
+        {
+            return std::make_pair((const char*)x, (const char*)x+1);
+        }
+
+        /*
+         * Whether X and Y may share elements
+         */
+        static bool overlaps(const Derived* X, const Derived* Y)
+        {
+            if (X == Y) return true;
+            if (X == NULL || Y == NULL) return false;
+
+            std::pair<const char*, const char*> x = extent(X, 0), y = extent(Y, 0);
+            std::less<const char*> less;
+            return less(x.first, y.second) && less(y.first, x.second);
+        }
+
+        static bool reads(const Term& t, const Derived* X)
+        {
+            return overlaps(t.A, X) || overlaps(t.B, X);
+        }
+
+        static bool accumulates(const Term& t)
+        {
+            return (t.type == kDeferredSum || t.type == kDeferredMult) && t.beta == (T)1 && !reads(t, t.C);
+        }
+
+        /*
+         * Whether term j (recorded after term i) must run after it
+         */
+        static bool depends(const Term& i, const Term& j)
+        {
+            if (reads(j, i.C) || reads(i, j.C)) return true;
+            return overlaps(i.C, j.C) && !(accumulates(i) && accumulates(j));
+        }
+
+        void record(const Term& t)
+        {
+            terms.push_back(t);
+
+            /*
+             * C[idx] = alpha*C[idx] + beta*C[idx] scales C
+             */
+            Term& u = terms.back();
+            if (u.type == kDeferredSum && u.A == u.C && u.idx_A == u.idx_C)
+            {
+                u.type = kDeferredScale;
+                u.alpha += u.beta;
+                u.beta = (T)1;
+                u.A = NULL;
+                u.idx_A.clear();
+            }
+        }
+
+        /*
+         * Order the terms topologically, preferring at each step a term with the same output as the last one, then
+         * one which reads the last output, then the earliest recorded
+         */
+        std::vector<size_t> schedule() const
+        {
+            const size_t n = terms.size();
+            std::vector<size_t> order;
+            std::vector<int> npred(n, 0);
+            std::vector< std::vector<size_t> > succ(n);
+            std::vector<bool> done(n, false);
+
+            for (size_t i = 0;i < n;i++)
+            {
+                for (size_t j = i+1;j < n;j++)
+                {
+                    if (depends(terms[i], terms[j]))
+                    {
+                        succ[i].push_back(j);
+                        npred[j]++;
+                    }
+                }
+            }
+
+            const Derived* last = NULL;
+            while (order.size() < n)
+            {
+                size_t best = n;
+                int best_rank = 3;
+
+                for (size_t i = 0;i < n;i++)
+                {
+                    if (done[i] || npred[i] > 0) continue;
+
+                    int rank = 2;
+                    if (last != NULL && terms[i].C == last) rank = 0;
+                    else if (last != NULL && reads(terms[i], last)) rank = 1;
+
+                    if (rank < best_rank)
+                    {
+                        best = i;
+                        best_rank = rank;
+                    }
+                }
+
+                done[best] = true;
+                order.push_back(best);
+                last = terms[best].C;
+                for (size_t k = 0;k < succ[best].size();k++) npred[succ[best][k]]--;
+            }
+
+            return order;
+        }
+
+        /*
+         * Fold each scaling of a whole tensor into the beta of the next term in order which writes all of that tensor
+         * without reading it, if no term in between reads or writes it (or a tensor sharing its data)
+         */
+        void fold(std::vector<size_t>& order)
+        {
+            std::vector<size_t> kept;
+            std::vector<bool> dropped(order.size(), false);
+
+            for (size_t p = 0;p < order.size();p++)
+            {
+                Term& s = terms[order[p]];
+                if (s.type != kDeferredScale || !distinct(s.idx_C)) continue;
+
+                for (size_t q = p+1;q < order.size();q++)
+                {
+                    Term& t = terms[order[q]];
+                    if (dropped[q] || (!overlaps(t.C, s.C) && !reads(t, s.C))) continue;
+
+                    if (t.C == s.C && !reads(t, s.C) && distinct(t.idx_C))
+                    {
+                        if (t.type == kDeferredScale)
+                        {
+                            t.alpha *= s.alpha;
+                        }
+                        else
+                        {
+                            t.beta *= s.alpha;
+                        }
+
+                        dropped[p] = true;
+                        nfolded++;
+                    }
+                    break;
+                }
+            }
+
+            for (size_t p = 0;p < order.size();p++)
+                if (!dropped[p]) kept.push_back(order[p]);
+            order.swap(kept);
+        }
+
+        /*
+         * The labels of a contraction term in canonical order (the order of first appearance in its operands, taken
+         * in order of address), and its key given the generations of the operands
+         */
+        static std::string labels(const Term& t)
+        {
+            std::string all = (t.B < t.A ? t.idx_B + t.idx_A : t.idx_A + t.idx_B);
+            std::string ret;
+            for (size_t i = 0;i < all.size();i++)
+                if (ret.find(all[i]) == std::string::npos) ret += all[i];
+            return ret;
+        }
+
+        static Key key(const Term& t, const std::string& lbl, size_t gen_A, size_t gen_B)
+        {
+            std::string ca, cb, cc;
+            for (size_t i = 0;i < t.idx_A.size();i++) ca += (char)('a'+lbl.find(t.idx_A[i]));
+            for (size_t i = 0;i < t.idx_B.size();i++) cb += (char)('a'+lbl.find(t.idx_B[i]));
+            for (size_t i = 0;i < t.idx_C.size();i++) cc += (char)('a'+lbl.find(t.idx_C[i]));
+            std::sort(cc.begin(), cc.end());
+
+            if (t.B < t.A) return Key(t.B, gen_B, t.A, gen_A, cb, ca, cc);
+            return Key(t.A, gen_A, t.B, gen_B, ca, cb, cc);
+        }
+
+        /*
+         * Whether a term is a contraction whose output could be held in an intermediate
+         */
+        static bool shareable(const Term& t)
+        {
+            if (t.type != kDeferredMult || !distinct(t.idx_C)) return false;
+            for (size_t i = 0;i < t.idx_C.size();i++)
+                if (t.idx_A.find(t.idx_C[i]) == std::string::npos &&
+                    t.idx_B.find(t.idx_C[i]) == std::string::npos) return false;
+            return true;
+        }
+
+        static double flops(const Term& t)
+        {
+            const std::vector<int>& len_A = t.A->getLengths();
+            const std::vector<int>& len_B = t.B->getLengths();
+            std::string seen;
+            double ret = 2;
+
+            for (size_t i = 0;i < t.idx_A.size();i++)
+            {
+                if (seen.find(t.idx_A[i]) != std::string::npos) continue;
+                seen += t.idx_A[i];
+                ret *= len_A[i];
+            }
+            for (size_t i = 0;i < t.idx_B.size();i++)
+            {
+                if (seen.find(t.idx_B[i]) != std::string::npos) continue;
+                seen += t.idx_B[i];
+                ret *= len_B[i];
+            }
+
+            return ret;
+        }
+
+        /*
+         * The generation of X after the terms before term n: the number of them writing X or a tensor sharing its data
+         */
+        size_t generation(const Derived* X, const size_t n) const
+        {
+            size_t gen = 0;
+            for (size_t i = 0;i < n;i++)
+                if (overlaps(terms[i].C, X)) gen++;
+            return gen;
+        }
+
+        /*
+         * Evaluate each contraction recorded more than once with the same operands, index pattern, and operand
+         * generations into an intermediate, and replace the terms using it by sums from the intermediate
+         */
+        void eliminate()
+        {
+            std::map<Key, size_t> first;
+            std::vector< std::vector<size_t> > groups;
+            std::vector<size_t> group(terms.size(), terms.size());
+
+            for (size_t i = 0;i < terms.size();i++)
+            {
+                const Term& t = terms[i];
+
+                if (shareable(t))
+                {
+                    Key k = key(t, labels(t), generation(t.A, i), generation(t.B, i));
+                    typename std::map<Key, size_t>::iterator it = first.find(k);
+
+                    if (it == first.end())
+                    {
+                        it = first.insert(std::make_pair(k, groups.size())).first;
+                        groups.push_back(std::vector<size_t>());
+                    }
+
+                    groups[it->second].push_back(i);
+                    group[i] = it->second;
+                }
+            }
+
+            std::vector<Derived*> intermediate(groups.size(), (Derived*)NULL);
+            std::vector<Term> rebuilt;
+
+            for (size_t i = 0;i < terms.size();i++)
+            {
+                const Term& t = terms[i];
+
+                if (group[i] == terms.size() || groups[group[i]].size() < 2)
+                {
+                    rebuilt.push_back(t);
+                    continue;
+                }
+
+                const Term& f = terms[groups[group[i]][0]];
+                Derived*& X = intermediate[group[i]];
+
+                if (X == NULL)
+                {
+                    X = new Derived("intermediate", *t.C, t.C->getLengths());
+                    owned.push_back(X);
+
+                    Term m = {kDeferredMult, (T)1, (T)0, t.A, t.idx_A, t.B, t.idx_B, X, t.idx_C};
+                    rebuilt.push_back(m);
+
+                    Reuse r = {t.A->getName() + "[\"" + t.idx_A + "\"]*" + t.B->getName() + "[\"" + t.idx_B + "\"]",
+                               groups[group[i]].size(), flops(t)};
+                    reused.push_back(r);
+                }
+
+                /*
+                 * The labels of the intermediate (named as in the first term) renamed to those of this term
+                 */
+                std::string lbl_f = labels(f), lbl_t = labels(t), idx_X;
+                for (size_t j = 0;j < f.idx_C.size();j++) idx_X += lbl_t[lbl_f.find(f.idx_C[j])];
+
+                Term u = {kDeferredSum, t.alpha, t.beta, X, idx_X, NULL, "", t.C, t.idx_C};
+                rebuilt.push_back(u);
+            }
+
+            terms.swap(rebuilt);
+        }
+
+        static void evaluate(const Term& t)
+        {
+            switch (t.type)
+            {
+                case kDeferredMult:
+                    t.C->mult(t.alpha, *t.A, t.idx_A, *t.B, t.idx_B, t.beta, t.idx_C);
+                    break;
+                case kDeferredSum:
+                    t.C->sum(t.alpha, *t.A, t.idx_A, t.beta, t.idx_C);
+                    break;
+                case kDeferredScale:
+                    t.C->scale(t.alpha, t.idx_C);
+                    break;
+                case kDeferredFill:
+                {
+                    Derived scalar("scalar", *t.C, t.alpha);
+                    t.C->sum((T)1, scalar, "", t.beta, t.idx_C);
+                    break;
+                }
+            }
+        }
+
+    public:
+        Deferred() : parent(current()), nfolded(0)
+        {
+            current() = this;
+        }
+
+        ~Deferred()
+        {
+            try
+            {
+                if (!std::uncaught_exception()) flush();
+            }
+            catch (std::exception& e)
+            {
+                fprintf(stderr, "Deferred: flush failed: %s\n", e.what());
+            }
+            catch (...)
+            {
+                fprintf(stderr, "Deferred: flush failed\n");
+            }
+
+            discard();
+            current() = parent;
+        }
+
+        /*
+         * The innermost Deferred for this type on this thread, or NULL if assignments are being evaluated immediately
+         */
+        static Deferred* active()
+        {
+            return current();
+        }
+
+        /*
+         * Flush every active Deferred, outermost first, e.g. before reading a tensor they may write
+         */
+        static void flush_active()
+        {
+            std::vector<Deferred*> chain;
+            for (Deferred* d = current();d != NULL;d = d->parent) chain.push_back(d);
+            for (size_t i = chain.size();i > 0;i--) chain[i-1]->flush();
+        }
+
+        /*
+         * Record C[idx_C] = alpha*A[idx_A]*B[idx_B] + beta*C[idx_C] and return true, or return false if there is
+         * no active Deferred (and so the caller should evaluate it immediately); similarly for the other terms
+         */
+        static bool mult(const T alpha, const Derived& A, const std::string& idx_A,
+                                        const Derived& B, const std::string& idx_B,
+                         const T beta,        Derived& C, const std::string& idx_C)
+        {
+            if (current() == NULL) return false;
+            Term t = {kDeferredMult, alpha, beta, &A, idx_A, &B, idx_B, &C, idx_C};
+            current()->record(t);
+            return true;
+        }
+
+        static bool sum(const T alpha, const Derived& A, const std::string& idx_A,
+                        const T beta,        Derived& C, const std::string& idx_C)
+        {
+            if (current() == NULL) return false;
+            Term t = {kDeferredSum, alpha, beta, &A, idx_A, NULL, "", &C, idx_C};
+            current()->record(t);
+            return true;
+        }
+
+        static bool scale(const T alpha, Derived& C, const std::string& idx_C)
+        {
+            if (current() == NULL) return false;
+            Term t = {kDeferredScale, alpha, (T)1, NULL, "", NULL, "", &C, idx_C};
+            current()->record(t);
+            return true;
+        }
+
+        static bool fill(const T val, const T beta, Derived& C, const std::string& idx_C)
+        {
+            if (current() == NULL) return false;
+            Term t = {kDeferredFill, val, beta, NULL, "", NULL, "", &C, idx_C};
+            current()->record(t);
+            return true;
+        }
+
+        /*
+         * Take ownership of X, an intermediate used by the recorded terms, and delete it after the next flush; return
+         * false if there is no active Deferred
+         */
+        static bool adopt(Derived* X)
+        {
+            if (current() == NULL) return false;
+            current()->owned.push_back(X);
+            return true;
+        }
+
+        /*
+         * Evaluate the recorded terms and clear them, after those of the enclosing Deferreds (which were recorded
+         * before them)
+         *
+         * Terms are evaluated with this Deferred inactive, so that anything they assign is evaluated immediately. If
+         * a term throws, the terms not yet evaluated are discarded and the exception is passed on.
+         */
+        void flush()
+        {
+            Deferred* saved = current();
+
+            try
+            {
+                if (!terms.empty())
+                {
+                    if (parent != NULL) parent->flush();
+
+                    eliminate();
+
+                    std::vector<size_t> order = schedule();
+                    fold(order);
+
+                    current() = parent;
+
+                    for (size_t i = 0;i < order.size();i++) evaluate(terms[order[i]]);
+
+                    current() = saved;
+                }
+            }
+            catch (...)
+            {
+                current() = saved;
+                discard();
+                throw;
+            }
+
+            discard();
+        }
+
+        /*
+         * Clear the recorded terms without evaluating them, and delete the intermediates
+         */
+        void discard()
+        {
+            terms.clear();
+            for (size_t i = 0;i < owned.size();i++) delete owned[i];
+            owned.clear();
+        }
+
+        /*
+         * The number of terms recorded since the last flush
+         */
+        size_t getNumTerms() const { return terms.size(); }
+
+        /*
+         * The number of passes over a tensor saved by folding scalings into other terms, over all flushes
+         */
+        size_t getNumFolded() const { return nfolded; }
+
+        /*
+         * The contractions evaluated once for several terms, over all flushes
+         */
+        const std::vector<Reuse>& getReused() const { return reused; }
+
+        /*
+         * The number of contractions and floating-point operations saved by sharing intermediates, over all flushes
+         */
+        size_t getNumReused() const
+        {
+            size_t n = 0;
+            for (size_t i = 0;i < reused.size();i++) n += reused[i].uses-1;
+            return n;
+        }
+
+        double getFlopsSaved() const
+        {
+            double f = 0;
+            for (size_t i = 0;i < reused.size();i++) f += (reused[i].uses-1)*reused[i].flops;
+            return f;
+        }
+
+        /*
+         * Print the shared contractions and the work saved by them and by folding
+         */
+        void printReport() const
+        {
+            printf("Deferred: %zu scalings folded, %zu contractions shared (%.3e flops saved)\n",
+                   nfolded, getNumReused(), getFlopsSaved());
+            for (size_t i = 0;i < reused.size();i++)
+                printf("    %s: used %zu times, %.3e flops saved\n", reused[i].expr.c_str(), reused[i].uses,
+                       (reused[i].uses-1)*reused[i].flops);
+        }
+};
+
+}
+}
+
+#endif
@@ -23,7 +23,9 @@
  */
 
 #include "dense_tensor.h"
+#include <algorithm>
 #include <cassert>
+#include <utility>
 
 namespace ambit { namespace tensor {
 
@@ -39,6 +41,10 @@ template <typename T>
 DenseTensor<T>::DenseTensor(const DenseTensor<T>& A)
     : LocalTensor< DenseTensor<T>,T >(A) {}
 
+template <typename T>
+DenseTensor<T>::DenseTensor(DenseTensor<T>&& A)
+    : LocalTensor< DenseTensor<T>,T >(std::move(A)) {}
+
 template <typename T>
 DenseTensor<T>::DenseTensor(const std::string& name, const DenseTensor<T>& A)
     : LocalTensor< DenseTensor<T>,T >(name, A) {}
@@ -49,24 +55,28 @@ DenseTensor<T>::DenseTensor(const std::string& name, DenseTensor<T>& A, typename
 
 template <typename T>
 DenseTensor<T>::DenseTensor(const std::string& name, const std::vector<int>& len, T* data, bool zero)
-    : LocalTensor< DenseTensor<T>,T >(name, len, std::vector<int>(), getSize(ndim, len, std::vector<int>()), data, zero) {}
+    : LocalTensor< DenseTensor<T>,T >(name, len, std::vector<int>(), getSize(len.size(), len, std::vector<int>()), data, zero) {}
 
 template <typename T>
 DenseTensor<T>::DenseTensor(const std::string& name, const std::vector<int>& len, bool zero)
-    : LocalTensor< DenseTensor<T>,T >(name, len, std::vector<int>(), getSize(ndim, len, std::vector<int>()), zero) {}
+    : LocalTensor< DenseTensor<T>,T >(name, len, std::vector<int>(), getSize(len.size(), len, std::vector<int>()), zero) {}
 
 template <typename T>
 DenseTensor<T>::DenseTensor(const std::string& name, const std::vector<int>& len, const std::vector<int>& ld, T* data, bool zero)
-    : LocalTensor< DenseTensor<T>,T >(name, len, ld, getSize(ndim, len, ld), data, zero) {}
+    : LocalTensor< DenseTensor<T>,T >(name, len, ld, getSize(len.size(), len, ld), data, zero) {}
 
 template <typename T>
 DenseTensor<T>::DenseTensor(const std::string& name, const std::vector<int>& len, const std::vector<int>& ld, bool zero)
-    : LocalTensor< DenseTensor<T>,T >(name, len, ld, getSize(ndim, len, ld), zero) {}
+    : LocalTensor< DenseTensor<T>,T >(name, len, ld, getSize(len.size(), len, ld), zero) {}
 
 template <typename T>
 DenseTensor<T>::DenseTensor(const std::string& name, const std::string& indices)
     : LocalTensor<DenseTensor<T>, T>(name, indices) {}
 
+template <typename T>
+DenseTensor<T>::DenseTensor(const std::string& name, const DenseTensor<T>& like, const std::vector<int>& len)
+    : LocalTensor< DenseTensor<T>,T >(name, len, std::vector<int>(), getSize(len.size(), len, std::vector<int>()), true) {}
+
 template <typename T>
 uint64_t DenseTensor<T>::getSize(int ndim, const std::vector<int>& len, const std::vector<int>& ld)
 {
@@ -87,10 +97,69 @@ void DenseTensor<T>::print() const
     tensor_print_dense(data, ndim, len.data(), ld.data()));
 }
 
+template <typename T>
+DenseTensor<T> DenseTensor<T>::slice(const std::vector<int>& start, const std::vector<int>& len_)
+{
+    return slice_(start, len_);
+}
+
+template <typename T>
+const DenseTensor<T> DenseTensor<T>::slice(const std::vector<int>& start, const std::vector<int>& len_) const
+{
+    return slice_(start, len_);
+}
+
+template <typename T>
+DenseTensor<T> DenseTensor<T>::slice_(const std::vector<int>& start, const std::vector<int>& len_) const
+{
+    if ((int)start.size() != ndim || (int)len_.size() != ndim) throw InvalidNdimError();
+
+    for (int i = 0;i < ndim;i++)
+    {
+        if (start[i] < 0 || start[i] >= len[i]) throw InvalidStartError();
+        if (len_[i] < 0 || start[i]+std::max(1,len_[i]) > len[i]) throw InvalidLengthError();
+    }
+
+    /*
+     * start from a reference to the whole tensor and narrow it to the block
+     */
+    DenseTensor<T> view(getName(), const_cast<DenseTensor<T>&>(*this), REFERENCE);
+
+    CHECK_RETURN_VALUE(
+    tensor_slice_dense(data, ndim, len.data(), ld.data(),
+                       &view.data, &view.ndim, view.len.data(), view.ld.data(),
+                       start.data(), len_.data()));
+
+    view.len.resize(view.ndim);
+    view.ld.resize(view.ndim);
+
+    /*
+     * the view spans from its first element to its last, and not the whole of the parent's leading dimensions
+     */
+    view.size = 1;
+    int64_t stride = 1;
+    for (int i = 0;i < view.ndim;i++)
+    {
+        stride *= view.ld[i];
+        view.size += (view.len[i]-1)*stride;
+    }
+
+    return view;
+}
+
 template <typename T>
 void DenseTensor<T>::mult(const T alpha, const DenseTensor<T>& A, const std::string& idx_A,
                                          const DenseTensor<T>& B, const std::string& idx_B,
                           const T beta,                           const std::string& idx_C)
+{
+    mult(alpha, A, idx_A, B, idx_B, beta, idx_C, kTensorContractAuto);
+}
+
+template <typename T>
+void DenseTensor<T>::mult(const T alpha, const DenseTensor<T>& A, const std::string& idx_A,
+                                         const DenseTensor<T>& B, const std::string& idx_B,
+                          const T beta,                           const std::string& idx_C,
+                          const int algorithm)
 {
     std::vector<int> idx_A_(    A.ndim);
     std::vector<int> idx_B_(    B.ndim);
@@ -103,7 +172,40 @@ void DenseTensor<T>::mult(const T alpha, const DenseTensor<T>& A, const std::str
     CHECK_RETURN_VALUE(
     tensor_mult_dense_(alpha, A.data, A.ndim, A.len.data(), A.ld.data(), idx_A_.data(),
                               B.data, B.ndim, B.len.data(), B.ld.data(), idx_B_.data(),
-                       beta,    data,   ndim,   len.data(),   ld.data(), idx_C_.data()));
+                       beta,    data,   ndim,   len.data(),   ld.data(), idx_C_.data(), algorithm));
+}
+
+template <typename T>
+template <typename U>
+void DenseTensor<T>::mult(const T alpha, const DenseTensor<U>& A, const std::string& idx_A,
+                                         const DenseTensor<U>& B, const std::string& idx_B,
+                          const T beta,                           const std::string& idx_C)
+{
+    mult(alpha, A, idx_A, B, idx_B, beta, idx_C, kTensorContractAuto, tensor_get_mixed_accumulation());
+}
+
+template <typename T>
+template <typename U>
+void DenseTensor<T>::mult(const T alpha, const DenseTensor<U>& A, const std::string& idx_A,
+                                         const DenseTensor<U>& B, const std::string& idx_B,
+                          const T beta,                           const std::string& idx_C,
+                          const int algorithm, const int accumulation)
+{
+    const int ndim_A = A.getDimension();
+    const int ndim_B = B.getDimension();
+    std::vector<int> idx_A_(    ndim_A);
+    std::vector<int> idx_B_(    ndim_B);
+    std::vector<int> idx_C_(this->ndim);
+
+    for (int i = 0;i <     ndim_A;i++) idx_A_[i] = idx_A[i];
+    for (int i = 0;i <     ndim_B;i++) idx_B_[i] = idx_B[i];
+    for (int i = 0;i < this->ndim;i++) idx_C_[i] = idx_C[i];
+
+    CHECK_RETURN_VALUE(
+    tensor_mult_dense_(alpha, A.get_data(), ndim_A, A.getLengths().data(), A.getLeadingDims().data(), idx_A_.data(),
+                              B.get_data(), ndim_B, B.getLengths().data(), B.getLeadingDims().data(), idx_B_.data(),
+                       beta,          data,   ndim,             len.data(),                  ld.data(), idx_C_.data(),
+                       algorithm, accumulation));
 }
 
 template <typename T>
@@ -132,7 +234,43 @@ void DenseTensor<T>::scale(const T alpha, const std::string& idx_A)
     tensor_scale_dense_(alpha, data, ndim, len.data(), ld.data(), idx_A_.data()));
 }
 
+template <typename T>
+void DenseTensor<T>::weight(const std::vector<const std::vector<T>*>& d)
+{
+    if ((int)d.size() != ndim) throw InvalidNdimError();
+
+    std::vector<const T*> d_(ndim);
+
+    for (int i = 0;i < ndim;i++)
+    {
+        if ((int)d[i]->size() != len[i]) throw LengthMismatchError();
+        d_[i] = d[i]->data();
+    }
+
+    CHECK_RETURN_VALUE(
+    tensor_denominator_dense_(data, ndim, len.data(), ld.data(), d_.data()));
+}
+
 INSTANTIATE_SPECIALIZATIONS(DenseTensor);
 
+/*
+ * With operands of the same type as the result, the seven-argument form is that of the non-template mult
+ */
+template void DenseTensor<double>::mult<float>(const double alpha, const DenseTensor<float>& A, const std::string& idx_A,
+                                                                   const DenseTensor<float>& B, const std::string& idx_B,
+                                               const double beta,                              const std::string& idx_C);
+template void DenseTensor< std::complex<double> >::mult< std::complex<float> >(
+    const std::complex<double> alpha, const DenseTensor< std::complex<float> >& A, const std::string& idx_A,
+                                      const DenseTensor< std::complex<float> >& B, const std::string& idx_B,
+    const std::complex<double> beta,                                               const std::string& idx_C);
+
+#define INSTANTIATE_DENSE_TENSOR_MIXED_MULT(U,T) \
+template void DenseTensor<T>::mult<U>(const T alpha, const DenseTensor<U>& A, const std::string& idx_A, \
+                                                     const DenseTensor<U>& B, const std::string& idx_B, \
+                                      const T beta,                           const std::string& idx_C, \
+                                      const int algorithm, const int accumulation);
+
+INSTANTIATE_MIXED_DENSE_KERNELS(INSTANTIATE_DENSE_TENSOR_MIXED_MULT)
+
 }
 }
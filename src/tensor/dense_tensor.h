@@ -43,6 +43,7 @@ public:
     DenseTensor(const std::string& name, T val = (T)0);
     DenseTensor(const std::string& name, const DenseTensor<T>& A, T val);
     DenseTensor(const DenseTensor<T>& A);
+    DenseTensor(DenseTensor<T>&& A);
     DenseTensor(const std::string& name, const DenseTensor<T>& A);
     DenseTensor(const std::string& name, DenseTensor<T>& A, CopyType_ type=CLONE);
     DenseTensor(const std::string& name, const std::vector<int>& len, T* data, bool zero=false);
@@ -51,6 +52,11 @@ public:
     DenseTensor(const std::string& name, const std::vector<int>& len, const std::vector<int>& ld, bool zero=true);
     DenseTensor(const std::string& name, const std::string& indices);
 
+    /*
+     * A zeroed, contiguous tensor of the given lengths (like is only used to select the constructor)
+     */
+    DenseTensor(const std::string& name, const DenseTensor<T>& like, const std::vector<int>& len);
+
     static uint64_t getSize(int ndim, const std::vector<int>& len, const std::vector<int>& ld);
 
     void print() const;
@@ -59,13 +65,57 @@ public:
                              const DenseTensor<T>& B, const std::string& idx_B,
               const T beta,                           const std::string& idx_C);
 
+    /*
+     * As above, with the contraction algorithm (one of kTensorContractAlgorithms) chosen explicitly
+     */
+    void mult(const T alpha, const DenseTensor<T>& A, const std::string& idx_A,
+                             const DenseTensor<T>& B, const std::string& idx_B,
+              const T beta,                           const std::string& idx_C,
+              const int algorithm);
+
+    /*
+     * Mixed-precision multiplication of single-precision operands, with the products formed and summed in the
+     * precision given by accumulation (one of kTensorAccumulations, by default tensor_get_mixed_accumulation())
+     */
+    template <typename U>
+    void mult(const T alpha, const DenseTensor<U>& A, const std::string& idx_A,
+                             const DenseTensor<U>& B, const std::string& idx_B,
+              const T beta,                           const std::string& idx_C);
+
+    template <typename U>
+    void mult(const T alpha, const DenseTensor<U>& A, const std::string& idx_A,
+                             const DenseTensor<U>& B, const std::string& idx_B,
+              const T beta,                           const std::string& idx_C,
+              const int algorithm, const int accumulation);
+
     void sum(const T alpha, const DenseTensor<T>& A, const std::string& idx_A,
              const T beta,                           const std::string& idx_B);
 
     void scale(const T alpha, const std::string& idx_A);
 
-    //DenseTensor<T> slice(const std::vector<int>& start, const std::vector<int>& len);
-
+    /*
+     * Divide each element by the sum of d[k][i_k] over its indices i_k, where d[k] has the length of index k
+     */
+    void weight(const std::vector<const std::vector<T>*>& d);
+
+    /*
+     * Return a view of the block of this tensor starting at start and with lengths len, sharing this tensor's
+     * data (no elements are copied)
+     *
+     * An index with a length of zero is fixed at its starting value and removed from the view. The view does
+     * not own its data and must not outlive this tensor; it may be used anywhere a DenseTensor may, e.g.
+     * C["ij"] = A.slice({0,2}, {4,3})["ik"]*B["kj"], and writing to it writes to this tensor. Throws
+     * InvalidStartError or InvalidLengthError if the block does not lie within this tensor.
+     */
+    DenseTensor<T> slice(const std::vector<int>& start, const std::vector<int>& len);
+
+    /*
+     * As above, for reading only: the view is const and so cannot be written to
+     */
+    const DenseTensor<T> slice(const std::vector<int>& start, const std::vector<int>& len) const;
+
+protected:
+    DenseTensor<T> slice_(const std::vector<int>& start, const std::vector<int>& len) const;
 };
 
 }
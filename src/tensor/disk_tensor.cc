@@ -0,0 +1,712 @@
+/*
+ * Copyright (C) 2013 Devin Matthews
+ *
+ * This is a slimmed down version of the tensor framework developed by
+ * Devin Matthews. The version by Devin was tied to Aquarius. This
+ * version is not.
+ *
+ * Copyright (C) 2013  Justin Turney
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "disk_tensor.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ambit { namespace tensor {
+
+namespace {
+
+std::mutex directory_mutex;
+std::string directory;
+
+void read_all(const int fd, void* buf, size_t n, off_t off)
+{
+    char* p = (char*)buf;
+
+    while (n > 0)
+    {
+        const ssize_t r = pread(fd, p, n, off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) throw std::runtime_error("DiskTensor: read failed");
+        p += r;
+        n -= r;
+        off += r;
+    }
+}
+
+void write_all(const int fd, const void* buf, size_t n, off_t off)
+{
+    const char* p = (const char*)buf;
+
+    while (n > 0)
+    {
+        const ssize_t r = pwrite(fd, p, n, off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) throw std::runtime_error("DiskTensor: write failed");
+        p += r;
+        n -= r;
+        off += r;
+    }
+}
+
+/*
+ * Reads a list of tiles in order, each one in the background while the previous one is in use
+ */
+template <typename T>
+class TileReader
+{
+    public:
+        struct Load
+        {
+            const DiskTensor<T>* tensor;
+            int tile;
+        };
+
+        TileReader(const std::vector<Load>& loads) : loads(loads), pos(0)
+        {
+            start();
+        }
+
+        ~TileReader()
+        {
+            if (pending.valid()) pending.wait();
+        }
+
+        std::shared_ptr< DenseTensor<T> > next()
+        {
+            std::shared_ptr< DenseTensor<T> > tile = pending.get();
+            pos++;
+            start();
+            return tile;
+        }
+
+    private:
+        std::vector<Load> loads;
+        size_t pos;
+        std::future< std::shared_ptr< DenseTensor<T> > > pending;
+
+        void start()
+        {
+            if (pos == loads.size()) return;
+
+            const Load l = loads[pos];
+            pending = std::async(std::launch::async, [l]()
+            {
+                return std::make_shared< DenseTensor<T> >(l.tensor->readTile(l.tile));
+            });
+        }
+};
+
+/*
+ * Writes tiles in the background, one at a time
+ */
+template <typename T>
+class TileWriter
+{
+    public:
+        TileWriter(DiskTensor<T>& tensor) : tensor(tensor) {}
+
+        ~TileWriter()
+        {
+            if (pending.valid()) pending.wait();
+        }
+
+        void write(const int t, const std::shared_ptr< DenseTensor<T> >& tile)
+        {
+            finish();
+
+            DiskTensor<T>* to = &tensor;
+            pending = std::async(std::launch::async, [to, t, tile]() { to->writeTile(t, *tile); });
+        }
+
+        void finish()
+        {
+            if (pending.valid()) pending.get();
+        }
+
+    private:
+        DiskTensor<T>& tensor;
+        std::future<void> pending;
+};
+
+/*
+ * The index labels of an output (operand 0) and up to two inputs, with the range of each label covered by a
+ * combination of tiles of the operands
+ */
+template <typename T>
+class TileMatch
+{
+    public:
+        TileMatch(const DiskTensor<T>& C, const std::string& idx_C,
+                  const DiskTensor<T>* A, const std::string& idx_A,
+                  const DiskTensor<T>* B, const std::string& idx_B)
+        {
+            const std::string* idx[3] = {&idx_C, &idx_A, &idx_B};
+            ops[0] = &C;
+            ops[1] = A;
+            ops[2] = B;
+
+            for (int op = 0;op < 3;op++)
+            {
+                if (ops[op] == NULL) continue;
+                if ((int)idx[op]->size() != ops[op]->getDimension()) throw InvalidNdimError();
+
+                for (size_t i = 0;i < idx[op]->size();i++)
+                {
+                    const char c = (*idx[op])[i];
+                    const int l = std::find(labels.begin(), labels.end(), c) - labels.begin();
+                    const int n = ops[op]->getLengths()[i];
+
+                    if (l == (int)labels.size())
+                    {
+                        labels.push_back(c);
+                        len.push_back(n);
+                    }
+                    else if (len[l] != n)
+                    {
+                        throw LengthMismatchError();
+                    }
+
+                    lbl[op].push_back(l);
+                }
+            }
+        }
+
+        int getNumTiles(const int op) const
+        {
+            return (ops[op] == NULL ? 1 : ops[op]->getNumTiles());
+        }
+
+        /*
+         * Narrow the label ranges to the tiles t of the operands, returning false if they do not overlap
+         */
+        bool overlap(const int* t, std::vector<int>& lo, std::vector<int>& hi) const
+        {
+            lo.assign(len.size(), 0);
+            hi = len;
+
+            for (int op = 0;op < 3;op++)
+            {
+                if (ops[op] == NULL || lbl[op].empty()) continue;
+
+                const int l = lbl[op].back();
+                const int s = t[op]*ops[op]->getTileLength();
+                lo[l] = std::max(lo[l], s);
+                hi[l] = std::min(hi[l], s+ops[op]->getTileLength());
+            }
+
+            for (size_t l = 0;l < len.size();l++)
+                if (lo[l] >= hi[l]) return false;
+
+            return true;
+        }
+
+        /*
+         * The part of tile t of an operand within the label ranges
+         */
+        DenseTensor<T> view(const int op, const int t, DenseTensor<T>& tile,
+                            const std::vector<int>& lo, const std::vector<int>& hi) const
+        {
+            const int ndim = lbl[op].size();
+            std::vector<int> start(ndim), length(ndim);
+
+            for (int i = 0;i < ndim;i++)
+            {
+                const int l = lbl[op][i];
+                start[i] = lo[l] - (i == ndim-1 ? t*ops[op]->getTileLength() : 0);
+                length[i] = hi[l] - lo[l];
+            }
+
+            return tile.slice(start, length);
+        }
+
+    private:
+        const DiskTensor<T>* ops[3];
+        std::vector<int> lbl[3];
+        std::vector<char> labels;
+        std::vector<int> len;
+};
+
+/*
+ * Stream over the tiles of C and the overlapping tiles of the inputs A and B (either of which may be NULL), calling
+ * f(C, A, B) on views of the overlapping parts of each combination (with C in place of a missing input)
+ *
+ * Each tile of C is read if read_C and zeroed otherwise, passed to init, and written back after its last
+ * combination, unless nothing touched it and !write_untouched. Reads run ahead of, and writes behind, the calls.
+ */
+template <typename T, typename Init, typename F>
+void stream_tiles(DiskTensor<T>& C, const std::string& idx_C,
+                  const DiskTensor<T>* A, const std::string& idx_A,
+                  const DiskTensor<T>* B, const std::string& idx_B,
+                  const bool read_C, const bool write_untouched, Init init, F f)
+{
+    typedef typename TileReader<T>::Load Load;
+
+    TileMatch<T> m(C, idx_C, A, idx_A, B, idx_B);
+    std::vector<int> lo, hi;
+    std::vector< std::vector< std::pair<int,int> > > steps(C.getNumTiles());
+    std::vector<Load> loads;
+
+    /*
+     * list the overlapping combinations of tiles, and the tiles to read for them in order
+     */
+    int t[3], last_a = -1, last_b = -1;
+    for (t[0] = 0;t[0] < C.getNumTiles();t[0]++)
+    {
+        if (read_C)
+        {
+            Load l = {&C, t[0]};
+            loads.push_back(l);
+        }
+
+        for (t[1] = 0;t[1] < m.getNumTiles(1);t[1]++)
+        {
+            for (t[2] = 0;t[2] < m.getNumTiles(2);t[2]++)
+            {
+                if (!m.overlap(t, lo, hi)) continue;
+
+                steps[t[0]].push_back(std::make_pair(t[1], t[2]));
+
+                if (A != NULL && t[1] != last_a)
+                {
+                    Load l = {A, t[1]};
+                    loads.push_back(l);
+                    last_a = t[1];
+                }
+
+                if (B != NULL && t[2] != last_b)
+                {
+                    Load l = {B, t[2]};
+                    loads.push_back(l);
+                    last_b = t[2];
+                }
+            }
+        }
+    }
+
+    TileReader<T> reader(loads);
+    TileWriter<T> writer(C);
+    std::shared_ptr< DenseTensor<T> > tile_A, tile_B;
+    last_a = last_b = -1;
+
+    const int ndim = C.getDimension();
+
+    for (t[0] = 0;t[0] < C.getNumTiles();t[0]++)
+    {
+        std::shared_ptr< DenseTensor<T> > tile_C;
+
+        if (read_C)
+        {
+            tile_C = reader.next();
+        }
+        else
+        {
+            std::vector<int> len_t(C.getLengths());
+            if (ndim > 0) len_t[ndim-1] = std::min(C.getTileLength(), len_t[ndim-1]-t[0]*C.getTileLength());
+            tile_C = std::make_shared< DenseTensor<T> >("tile", len_t);
+        }
+
+        init(*tile_C);
+
+        for (size_t s = 0;s < steps[t[0]].size();s++)
+        {
+            t[1] = steps[t[0]][s].first;
+            t[2] = steps[t[0]][s].second;
+
+            if (A != NULL && t[1] != last_a)
+            {
+                tile_A = reader.next();
+                last_a = t[1];
+            }
+
+            if (B != NULL && t[2] != last_b)
+            {
+                tile_B = reader.next();
+                last_b = t[2];
+            }
+
+            m.overlap(t, lo, hi);
+            DenseTensor<T> view_C = m.view(0, t[0], *tile_C, lo, hi);
+
+            if (A == NULL)
+            {
+                f(view_C, view_C, view_C);
+            }
+            else if (B == NULL)
+            {
+                DenseTensor<T> view_A = m.view(1, t[1], *tile_A, lo, hi);
+                f(view_C, view_A, view_C);
+            }
+            else
+            {
+                DenseTensor<T> view_A = m.view(1, t[1], *tile_A, lo, hi);
+                DenseTensor<T> view_B = m.view(2, t[2], *tile_B, lo, hi);
+                f(view_C, view_A, view_B);
+            }
+        }
+
+        if (write_untouched || !steps[t[0]].empty()) writer.write(t[0], tile_C);
+    }
+
+    writer.finish();
+}
+
+}
+
+void tensor_set_disk_directory(const std::string& dir)
+{
+    std::lock_guard<std::mutex> lock(directory_mutex);
+    directory = dir;
+}
+
+std::string tensor_get_disk_directory()
+{
+    std::lock_guard<std::mutex> lock(directory_mutex);
+
+    if (directory.empty())
+    {
+        const char* tmp = getenv("TMPDIR");
+        directory = (tmp != NULL && tmp[0] != '\0' ? tmp : "/tmp");
+    }
+
+    return directory;
+}
+
+template <typename T>
+void DiskTensor<T>::create(const size_t tile_bytes)
+{
+    stride = 1;
+    for (int i = 0;i+1 < ndim;i++) stride *= len[i];
+
+    tile_len = 1;
+    if (ndim > 0)
+    {
+        const uint64_t n = tile_bytes/(sizeof(T)*std::max(stride, (uint64_t)1));
+        tile_len = (int)std::max((uint64_t)1, std::min(n, (uint64_t)std::max(len[ndim-1], 1)));
+    }
+
+    const std::string dir = tensor_get_disk_directory();
+    std::vector<char> path(dir.begin(), dir.end());
+    const std::string suffix = "/ambit-XXXXXX";
+    path.insert(path.end(), suffix.begin(), suffix.end());
+    path.push_back('\0');
+
+    fd = mkstemp(path.data());
+    if (fd < 0) throw std::runtime_error("DiskTensor: cannot create a file in " + dir);
+    unlink(path.data());
+
+    /*
+     * the file reads as zeros until written
+     */
+    if (ftruncate(fd, getSize()*sizeof(T)) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("DiskTensor: cannot extend the file in " + dir);
+    }
+}
+
+template <typename T>
+DiskTensor<T>::DiskTensor(const std::string& name, T val)
+    : IndexableTensor< DiskTensor<T>,T >(name, 0)
+{
+    create(kDefaultTileBytes);
+    write_all(fd, &val, sizeof(T), 0);
+}
+
+template <typename T>
+DiskTensor<T>::DiskTensor(const std::string& name, const DiskTensor<T>& A, T val)
+    : IndexableTensor< DiskTensor<T>,T >(name, 0)
+{
+    create(kDefaultTileBytes);
+    write_all(fd, &val, sizeof(T), 0);
+}
+
+template <typename T>
+DiskTensor<T>::DiskTensor(const DiskTensor<T>& A)
+    : IndexableTensor< DiskTensor<T>,T >(A.getName(), A.ndim), len(A.len)
+{
+    create(A.tile_len*A.stride*sizeof(T));
+    sum((T)1, A, A.implicit(), (T)0, this->implicit());
+}
+
+template <typename T>
+DiskTensor<T>::DiskTensor(const std::string& name, const DiskTensor<T>& A)
+    : IndexableTensor< DiskTensor<T>,T >(name, A.ndim), len(A.len)
+{
+    create(A.tile_len*A.stride*sizeof(T));
+    sum((T)1, A, A.implicit(), (T)0, this->implicit());
+}
+
+template <typename T>
+DiskTensor<T>::DiskTensor(const std::string& name, const std::vector<int>& len, const size_t tile_bytes)
+    : IndexableTensor< DiskTensor<T>,T >(name, len.size()), len(len)
+{
+    create(tile_bytes);
+}
+
+template <typename T>
+DiskTensor<T>::DiskTensor(const std::string& name, const DiskTensor<T>& like, const std::vector<int>& len)
+    : IndexableTensor< DiskTensor<T>,T >(name, len.size()), len(len)
+{
+    create(like.tile_len*like.stride*sizeof(T));
+}
+
+template <typename T>
+DiskTensor<T>::~DiskTensor()
+{
+    close(fd);
+}
+
+template <typename T>
+int DiskTensor<T>::getNumTiles() const
+{
+    if (ndim == 0) return 1;
+    return (len[ndim-1]+tile_len-1)/tile_len;
+}
+
+template <typename T>
+DenseTensor<T> DiskTensor<T>::readTile(const int t) const
+{
+    std::vector<int> len_t(len);
+    if (ndim > 0) len_t[ndim-1] = std::min(tile_len, len[ndim-1]-t*tile_len);
+
+    DenseTensor<T> tile("tile", len_t, false);
+    read_all(fd, tile.get_data(), tile.getSize()*sizeof(T), (off_t)t*tile_len*stride*sizeof(T));
+
+    return tile;
+}
+
+template <typename T>
+void DiskTensor<T>::writeTile(const int t, const DenseTensor<T>& tile)
+{
+    uint64_t n = stride;
+    if (ndim > 0) n *= std::min(tile_len, len[ndim-1]-t*tile_len);
+    if (tile.getSize() != n) throw LengthMismatchError();
+
+    write_all(fd, tile.get_data(), n*sizeof(T), (off_t)t*tile_len*stride*sizeof(T));
+}
+
+template <typename T>
+void DiskTensor<T>::read(DenseTensor<T>& A) const
+{
+    if (A.getLengths() != len) throw LengthMismatchError();
+
+    for (int t = 0;t < getNumTiles();t++)
+    {
+        DenseTensor<T> tile = readTile(t);
+
+        std::vector<int> start(ndim, 0);
+        if (ndim > 0) start[ndim-1] = t*tile_len;
+
+        DenseTensor<T> view = A.slice(start, tile.getLengths());
+        view.sum((T)1, tile, tile.implicit(), (T)0, view.implicit());
+    }
+}
+
+template <typename T>
+void DiskTensor<T>::write(const DenseTensor<T>& A)
+{
+    if (A.getLengths() != len) throw LengthMismatchError();
+
+    for (int t = 0;t < getNumTiles();t++)
+    {
+        std::vector<int> start(ndim, 0), len_t(len);
+        if (ndim > 0)
+        {
+            start[ndim-1] = t*tile_len;
+            len_t[ndim-1] = std::min(tile_len, len[ndim-1]-t*tile_len);
+        }
+
+        const DenseTensor<T> view = A.slice(start, len_t);
+        DenseTensor<T> tile("tile", len_t, false);
+        tile.sum((T)1, view, view.implicit(), (T)0, tile.implicit());
+        writeTile(t, tile);
+    }
+}
+
+template <typename T>
+void DiskTensor<T>::print() const
+{
+    printf("Name: %s\n", getName().c_str());
+
+    for (int t = 0;t < getNumTiles();t++)
+    {
+        DenseTensor<T> tile = readTile(t);
+        printf("Tile %d of %d (last index from %d)\n", t, getNumTiles(), t*tile_len);
+        CHECK_RETURN_VALUE(
+        tensor_print_dense(tile.get_data(), ndim, tile.getLengths().data(), (const int*)NULL));
+    }
+}
+
+template <typename T>
+void DiskTensor<T>::fill_with_random_data()
+{
+    for (int t = 0;t < getNumTiles();t++)
+    {
+        DenseTensor<T> tile = readTile(t);
+        tile.fill_with_random_data();
+        writeTile(t, tile);
+    }
+}
+
+template <typename T>
+void DiskTensor<T>::mult(const T alpha, const DiskTensor<T>& A, const std::string& idx_A,
+                                        const DiskTensor<T>& B, const std::string& idx_B,
+                         const T beta,                          const std::string& idx_C)
+{
+    /*
+     * tiles of this tensor are rewritten while the others are still to be read
+     */
+    if (&A == this || &B == this)
+    {
+        DiskTensor<T> copy(*this);
+        mult(alpha, (&A == this ? copy : A), idx_A, (&B == this ? copy : B), idx_B, beta, idx_C);
+        return;
+    }
+
+    stream_tiles(*this, idx_C, &A, idx_A, &B, idx_B, beta != (T)0, beta != (T)1,
+    [&](DenseTensor<T>& C)
+    {
+        if (beta != (T)0 && beta != (T)1) C.scale(beta, C.implicit());
+    },
+    [&](DenseTensor<T>& C, DenseTensor<T>& A, DenseTensor<T>& B)
+    {
+        C.mult(alpha, A, idx_A, B, idx_B, (T)1, idx_C);
+    });
+}
+
+template <typename T>
+void DiskTensor<T>::sum(const T alpha, const DiskTensor<T>& A, const std::string& idx_A,
+                        const T beta,                          const std::string& idx_B)
+{
+    if (&A == this)
+    {
+        DiskTensor<T> copy(*this);
+        sum(alpha, copy, idx_A, beta, idx_B);
+        return;
+    }
+
+    stream_tiles(*this, idx_B, &A, idx_A, (const DiskTensor<T>*)NULL, "", beta != (T)0, beta != (T)1,
+    [&](DenseTensor<T>& B)
+    {
+        if (beta != (T)0 && beta != (T)1) B.scale(beta, B.implicit());
+    },
+    [&](DenseTensor<T>& B, DenseTensor<T>& A, DenseTensor<T>&)
+    {
+        B.sum(alpha, A, idx_A, (T)1, idx_B);
+    });
+}
+
+template <typename T>
+void DiskTensor<T>::scale(const T alpha, const std::string& idx_A)
+{
+    /*
+     * a repeated label limits the other indices it labels to the range of the tile
+     */
+    stream_tiles(*this, idx_A, (const DiskTensor<T>*)NULL, "", (const DiskTensor<T>*)NULL, "", true, true,
+    [&](DenseTensor<T>&) {},
+    [&](DenseTensor<T>& A, DenseTensor<T>&, DenseTensor<T>&)
+    {
+        A.scale(alpha, idx_A);
+    });
+}
+
+template <typename T>
+void DiskTensor<T>::div(const T alpha, const DiskTensor<T>& A,
+                                       const DiskTensor<T>& B, const T beta)
+{
+    /*
+     * elementwise, so tile t of this tensor is read before it is rewritten even if A or B is this tensor
+     */
+    stream_tiles(*this, this->implicit(), &A, A.implicit(), &B, B.implicit(), true, true,
+    [&](DenseTensor<T>&) {},
+    [&](DenseTensor<T>& C, DenseTensor<T>& A, DenseTensor<T>& B)
+    {
+        C.div(alpha, A, B, beta);
+    });
+}
+
+template <typename T>
+void DiskTensor<T>::invert(const T alpha, const DiskTensor<T>& A, const T beta)
+{
+    stream_tiles(*this, this->implicit(), &A, A.implicit(), (const DiskTensor<T>*)NULL, "", true, true,
+    [&](DenseTensor<T>&) {},
+    [&](DenseTensor<T>& C, DenseTensor<T>& A, DenseTensor<T>&)
+    {
+        C.invert(alpha, A, beta);
+    });
+}
+
+template <typename T>
+T DiskTensor<T>::dot(const DiskTensor<T>& A, const std::string& idx_A,
+                                             const std::string& idx_B) const
+{
+    TileMatch<T> m(*this, idx_B, &A, idx_A, NULL, "");
+    std::vector<int> lo, hi;
+    std::vector< std::pair<int,int> > steps;
+    std::vector<typename TileReader<T>::Load> loads;
+
+    int t[3] = {0, 0, 0};
+    for (t[0] = 0;t[0] < getNumTiles();t[0]++)
+    {
+        for (t[1] = 0;t[1] < m.getNumTiles(1);t[1]++)
+        {
+            if (!m.overlap(t, lo, hi)) continue;
+
+            steps.push_back(std::make_pair(t[0], t[1]));
+
+            typename TileReader<T>::Load b = {this, t[0]}, a = {&A, t[1]};
+            loads.push_back(b);
+            loads.push_back(a);
+        }
+    }
+
+    TileReader<T> reader(loads);
+    T s = (T)0;
+
+    for (size_t i = 0;i < steps.size();i++)
+    {
+        t[0] = steps[i].first;
+        t[1] = steps[i].second;
+
+        std::shared_ptr< DenseTensor<T> > tile_B = reader.next();
+        std::shared_ptr< DenseTensor<T> > tile_A = reader.next();
+
+        m.overlap(t, lo, hi);
+        DenseTensor<T> view_B = m.view(0, t[0], *tile_B, lo, hi);
+        DenseTensor<T> view_A = m.view(1, t[1], *tile_A, lo, hi);
+
+        s += view_B.dot(view_A, idx_A, idx_B);
+    }
+
+    return s;
+}
+
+INSTANTIATE_SPECIALIZATIONS(DiskTensor);
+
+}
+}
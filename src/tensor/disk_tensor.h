@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2013 Devin Matthews
+ *
+ * This is a slimmed down version of the tensor framework developed by
+ * Devin Matthews. The version by Devin was tied to Aquarius. This
+ * version is not.
+ *
+ * Copyright (C) 2013  Justin Turney
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined(AMBIT_LIB_TENSOR_DISK_TENSOR)
+#define AMBIT_LIB_TENSOR_DISK_TENSOR
+
+#include "dense_tensor.h"
+#include "indexable_tensor.h"
+
+#include <vector>
+
+namespace ambit {
+
+namespace tensor {
+
+/*
+ * Set or get the directory in which DiskTensor files are created (by default $TMPDIR, or /tmp)
+ */
+void tensor_set_disk_directory(const std::string& dir);
+std::string tensor_get_disk_directory();
+
+/*
+ * A tensor stored in a file on local disk, for tensors which do not fit in memory
+ *
+ * The elements are laid out as in a contiguous DenseTensor and divided into tiles along the last index, each tile
+ * being read into memory as a DenseTensor when needed. Operations stream over the combinations of tiles of the
+ * operands whose ranges overlap on every shared index label, handing views of the overlapping parts to the dense
+ * kernels; while one combination is computed the tile needed next is read in the background, and finished tiles of
+ * the result are written in the background, so that I/O overlaps computation. At most a few tiles of each operand
+ * are in memory at once.
+ *
+ * The file is created in the directory given by tensor_set_disk_directory and removed as soon as it is opened, so
+ * nothing is left behind when the tensor is destroyed (or the program ends abnormally).
+ */
+template <typename T>
+class DiskTensor : public IndexableTensor< DiskTensor<T>, T >
+{
+    INHERIT_FROM_INDEXABLE_TENSOR(DiskTensor<T>,T)
+
+    protected:
+        std::vector<int> len;
+        uint64_t stride;
+        int tile_len;
+        int fd;
+
+        void create(const size_t tile_bytes);
+
+    public:
+        enum { kDefaultTileBytes = 64*1024*1024 };
+
+        DiskTensor(const std::string& name, T val = (T)0);
+        DiskTensor(const std::string& name, const DiskTensor<T>& A, T val);
+        DiskTensor(const DiskTensor<T>& A);
+        DiskTensor(const std::string& name, const DiskTensor<T>& A);
+
+        /*
+         * A zeroed tensor with tiles of about tile_bytes bytes
+         */
+        DiskTensor(const std::string& name, const std::vector<int>& len, const size_t tile_bytes = kDefaultTileBytes);
+
+        /*
+         * A zeroed tensor of the given lengths with tiles of about the same size as those of like
+         */
+        DiskTensor(const std::string& name, const DiskTensor<T>& like, const std::vector<int>& len);
+
+        ~DiskTensor();
+
+        const std::vector<int>& getLengths() const { return len; }
+        uint64_t getSize() const { return (ndim == 0 ? 1 : stride*len[ndim-1]); }
+
+        /*
+         * Tile t covers the elements with last index from t*getTileLength() up to the smaller of (t+1)*getTileLength()
+         * and the last length
+         */
+        int getNumTiles() const;
+        int getTileLength() const { return tile_len; }
+
+        DenseTensor<T> readTile(const int t) const;
+        void writeTile(const int t, const DenseTensor<T>& tile);
+
+        /*
+         * Copy the whole tensor to or from a contiguous DenseTensor of the same lengths
+         */
+        void read(DenseTensor<T>& A) const;
+        void write(const DenseTensor<T>& A);
+
+        void print() const;
+
+        void fill_with_random_data();
+
+        void mult(const T alpha, const DiskTensor<T>& A, const std::string& idx_A,
+                                 const DiskTensor<T>& B, const std::string& idx_B,
+                  const T beta,                          const std::string& idx_C);
+
+        void sum(const T alpha, const DiskTensor<T>& A, const std::string& idx_A,
+                 const T beta,                          const std::string& idx_B);
+
+        void scale(const T alpha, const std::string& idx_A);
+
+        void div(const T alpha, const DiskTensor<T>& A,
+                                const DiskTensor<T>& B, const T beta);
+
+        void invert(const T alpha, const DiskTensor<T>& A, const T beta);
+
+        T dot(const DiskTensor<T>& A, const std::string& idx_A,
+                                      const std::string& idx_B) const;
+};
+
+}
+
+}
+
+#endif
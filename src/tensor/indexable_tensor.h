@@ -26,12 +26,23 @@
 #define AMBIT_LIB_TENSOR_INDEXABLE_TENSOR
 
 #include "tensor.h"
+#include "tensor_plan_product.h"
+#include "util.h"
+
+#include <memory>
+#include <vector>
 
 namespace ambit { namespace tensor {
 
 template <typename Derived, typename T> struct IndexableTensor;
 template <typename Derived, typename T> struct IndexedTensor;
 template <typename Derived, typename T> struct IndexedTensorMult;
+template <typename Derived, typename T> struct IndexedTensorProduct;
+template <typename Derived, typename T> class Deferred;
+
+template <typename Derived, typename T, typename cvDerived>
+void evaluate_product(const T alpha, const std::vector< IndexedTensor<const cvDerived,T> >& operands,
+                      const T beta, Derived& C, const std::string& idx_C);
 
 #define INHERIT_FROM_INDEXABLE_TENSOR(Derived,T) \
     protected: \
@@ -228,7 +239,7 @@ public:
     void sum(const T alpha, const T beta)
     {
         Derived tensor("alpha", getDerived(), alpha);
-        beta*(*this)[implicit()] = tensor[""];
+        sum((T)1, tensor, "", beta, implicit());
     }
 
     void sum(const T alpha, const Derived& A, const T beta)
@@ -298,28 +309,32 @@ struct IndexedTensor
      *********************************************************************/
     IndexedTensor<Derived,T>& operator=(const IndexedTensor<Derived,T>& other)
     {
-        tensor_.sum(other.factor_, other.tensor_, other.idx_, (T)0, idx_);
+        if (!Deferred<Derived,T>::sum(other.factor_, other.tensor_, other.idx_, (T)0, tensor_, idx_))
+            tensor_.sum(other.factor_, other.tensor_, other.idx_, (T)0, idx_);
         return *this;
     }
 
     template <typename cvDerived>
     IndexedTensor<Derived,T>& operator=(const IndexedTensor<cvDerived,T>& other)
     {
-        tensor_.sum(other.factor_, other.tensor_, other.idx_, (T)0, idx_);
+        if (!Deferred<Derived,T>::sum(other.factor_, other.tensor_, other.idx_, (T)0, tensor_, idx_))
+            tensor_.sum(other.factor_, other.tensor_, other.idx_, (T)0, idx_);
         return *this;
     }
 
     template <typename cvDerived>
     IndexedTensor<Derived,T>& operator+=(const IndexedTensor<cvDerived,T>& other)
     {
-        tensor_.sum(other.factor_, other.tensor_, other.idx_, factor_, idx_);
+        if (!Deferred<Derived,T>::sum(other.factor_, other.tensor_, other.idx_, factor_, tensor_, idx_))
+            tensor_.sum(other.factor_, other.tensor_, other.idx_, factor_, idx_);
         return *this;
     }
 
     template <typename cvDerived>
     IndexedTensor<Derived,T>& operator-=(const IndexedTensor<cvDerived,T>& other)
     {
-        tensor_.sum(-other.factor_, other.tensor_, other.idx_, factor_, idx_);
+        if (!Deferred<Derived,T>::sum(-other.factor_, other.tensor_, other.idx_, factor_, tensor_, idx_))
+            tensor_.sum(-other.factor_, other.tensor_, other.idx_, factor_, idx_);
         return *this;
     }
 
@@ -331,27 +346,95 @@ struct IndexedTensor
     template <typename cvDerived>
     IndexedTensor<Derived,T>& operator=(const IndexedTensorMult<cvDerived,T>& other)
     {
-        tensor_.mult(other.factor_, other.A_.tensor_, other.A_.idx_,
-                                    other.B_.tensor_, other.B_.idx_,
-                              (T)0,                            idx_);
+        if (!Deferred<Derived,T>::mult(other.factor_, other.A_.tensor_, other.A_.idx_,
+                                                      other.B_.tensor_, other.B_.idx_,
+                                                (T)0,          tensor_,          idx_))
+            tensor_.mult(other.factor_, other.A_.tensor_, other.A_.idx_,
+                                        other.B_.tensor_, other.B_.idx_,
+                                  (T)0,                            idx_);
         return *this;
     }
 
     template <typename cvDerived>
     IndexedTensor<Derived,T>& operator+=(const IndexedTensorMult<cvDerived,T>& other)
     {
-        tensor_.mult(other.factor_, other.A_.tensor_, other.A_.idx_,
-                                    other.B_.tensor_, other.B_.idx_,
-                           factor_,                            idx_);
+        if (!Deferred<Derived,T>::mult(other.factor_, other.A_.tensor_, other.A_.idx_,
+                                                      other.B_.tensor_, other.B_.idx_,
+                                             factor_,          tensor_,          idx_))
+            tensor_.mult(other.factor_, other.A_.tensor_, other.A_.idx_,
+                                        other.B_.tensor_, other.B_.idx_,
+                               factor_,                            idx_);
         return *this;
     }
 
     template <typename cvDerived>
     IndexedTensor<Derived,T>& operator-=(const IndexedTensorMult<cvDerived,T>& other)
     {
-        tensor_.mult(-other.factor_, other.A_.tensor_, other.A_.idx_,
-                                     other.B_.tensor_, other.B_.idx_,
-                            factor_,                            idx_);
+        if (!Deferred<Derived,T>::mult(-other.factor_, other.A_.tensor_, other.A_.idx_,
+                                                       other.B_.tensor_, other.B_.idx_,
+                                              factor_,          tensor_,          idx_))
+            tensor_.mult(-other.factor_, other.A_.tensor_, other.A_.idx_,
+                                         other.B_.tensor_, other.B_.idx_,
+                                factor_,                            idx_);
+        return *this;
+    }
+
+    /*
+     * Products of three or more tensors (see IndexedTensorProduct)
+     */
+    template <typename cvDerived>
+    IndexedTensor<Derived,T>& operator=(const IndexedTensorProduct<cvDerived,T>& other)
+    {
+        evaluate_product(other.factor_, other.operands_, (T)0, tensor_, idx_);
+        return *this;
+    }
+
+    template <typename cvDerived>
+    IndexedTensor<Derived,T>& operator+=(const IndexedTensorProduct<cvDerived,T>& other)
+    {
+        evaluate_product(other.factor_, other.operands_, factor_, tensor_, idx_);
+        return *this;
+    }
+
+    template <typename cvDerived>
+    IndexedTensor<Derived,T>& operator-=(const IndexedTensorProduct<cvDerived,T>& other)
+    {
+        evaluate_product(-other.factor_, other.operands_, factor_, tensor_, idx_);
+        return *this;
+    }
+
+    /*
+     * Mixed-precision multiplication, e.g. of single-precision operands onto a double-precision tensor
+     *
+     * These are always evaluated immediately, after flushing any deferred terms writing the result.
+     */
+    template <typename cvDerived, typename U>
+    IndexedTensor<Derived,T>& operator=(const IndexedTensorMult<cvDerived,U>& other)
+    {
+        Deferred<Derived,T>::flush_active();
+        tensor_.mult((T)other.factor_, other.A_.tensor_, other.A_.idx_,
+                                       other.B_.tensor_, other.B_.idx_,
+                                 (T)0,                            idx_);
+        return *this;
+    }
+
+    template <typename cvDerived, typename U>
+    IndexedTensor<Derived,T>& operator+=(const IndexedTensorMult<cvDerived,U>& other)
+    {
+        Deferred<Derived,T>::flush_active();
+        tensor_.mult((T)other.factor_, other.A_.tensor_, other.A_.idx_,
+                                       other.B_.tensor_, other.B_.idx_,
+                              factor_,                            idx_);
+        return *this;
+    }
+
+    template <typename cvDerived, typename U>
+    IndexedTensor<Derived,T>& operator-=(const IndexedTensorMult<cvDerived,U>& other)
+    {
+        Deferred<Derived,T>::flush_active();
+        tensor_.mult(-(T)other.factor_, other.A_.tensor_, other.A_.idx_,
+                                        other.B_.tensor_, other.B_.idx_,
+                               factor_,                            idx_);
         return *this;
     }
 
@@ -394,28 +477,38 @@ struct IndexedTensor
 
     IndexedTensor<Derived,T>& operator*=(const T factor)
     {
-        tensor_.scale(factor, idx_);
+        if (!Deferred<Derived,T>::scale(factor, tensor_, idx_))
+            tensor_.scale(factor, idx_);
         return *this;
     }
 
     IndexedTensor<Derived,T>& operator=(const T val)
     {
-        Derived tensor(tensor_, val);
-        *this = tensor[""];
+        if (!Deferred<Derived,T>::fill(val, (T)0, tensor_, idx_))
+        {
+            Derived tensor("scalar", tensor_, val);
+            *this = tensor[""];
+        }
         return *this;
     }
 
     IndexedTensor<Derived,T>& operator+=(const T val)
     {
-        Derived tensor(tensor_, val);
-        *this += tensor[""];
+        if (!Deferred<Derived,T>::fill(val, factor_, tensor_, idx_))
+        {
+            Derived tensor("scalar", tensor_, val);
+            *this += tensor[""];
+        }
         return *this;
     }
 
     IndexedTensor<Derived,T>& operator-=(const T val)
     {
-        Derived tensor(tensor_, val);
-        *this -= tensor[""];
+        if (!Deferred<Derived,T>::fill(-val, factor_, tensor_, idx_))
+        {
+            Derived tensor("scalar", tensor_, val);
+            *this -= tensor[""];
+        }
         return *this;
     }
 };
@@ -488,8 +581,164 @@ public:
     {
         return other*factor;
     }
+
+    /**********************************************************************
+     *
+     * Products with further tensors
+     *
+     *********************************************************************/
+    template <typename cvDerived>
+    IndexedTensorProduct<Derived,T> operator*(const IndexedTensor<cvDerived,T>& other) const
+    {
+        return IndexedTensorProduct<Derived,T>(*this, other);
+    }
 };
 
+/*
+ * A product of three or more tensors, e.g. A["ijab"]*B["abcd"]*C["cdkl"]
+ *
+ * When assigned to a tensor, the operands are multiplied two at a time in the order chosen by
+ * tensor_plan_product, with the intermediates created as zeroed tensors of the needed lengths by the
+ * constructor Derived(name, C, len) (with C the tensor assigned to) and freed as soon as they are consumed.
+ * Under a Deferred the multiplications are recorded instead, and the intermediates live until it is flushed.
+ */
+template <typename Derived, typename T>
+struct IndexedTensorProduct
+{
+private:
+    const IndexedTensorProduct& operator=(const IndexedTensorProduct<Derived, T>& other);
+
+public:
+    std::vector< IndexedTensor<const Derived,T> > operands_;
+    T factor_;
+
+    template <typename cvDerived>
+    IndexedTensorProduct(const IndexedTensorMult<Derived,T>& AB, const IndexedTensor<cvDerived,T>& C)
+        : factor_(AB.factor_*C.factor_)
+    {
+        operands_.push_back(AB.A_);
+        operands_.push_back(AB.B_);
+        operands_.push_back(C);
+    }
+
+    template <typename cvDerived>
+    IndexedTensorProduct(const IndexedTensorProduct<Derived,T>& AB, const IndexedTensor<cvDerived,T>& C)
+        : operands_(AB.operands_), factor_(AB.factor_*C.factor_)
+    {
+        operands_.push_back(C);
+    }
+
+    template <typename cvDerived>
+    IndexedTensorProduct<Derived,T> operator*(const IndexedTensor<cvDerived,T>& other) const
+    {
+        return IndexedTensorProduct<Derived,T>(*this, other);
+    }
+
+    /**********************************************************************
+     *
+     * Unary negation
+     *
+     *********************************************************************/
+    IndexedTensorProduct<Derived,T> operator-() const
+    {
+        IndexedTensorProduct<Derived,T> ret(*this);
+        ret.factor_ = -ret.factor_;
+        return ret;
+    }
+
+    /**********************************************************************
+     *
+     * Operations with scalars
+     *
+     *********************************************************************/
+    IndexedTensorProduct<Derived,T> operator*(const T factor) const
+    {
+        IndexedTensorProduct<Derived,T> ret(*this);
+        ret.factor_ *= factor;
+        return ret;
+    }
+
+    IndexedTensorProduct<Derived,T> operator/(const T factor) const
+    {
+        IndexedTensorProduct<Derived,T> ret(*this);
+        ret.factor_ /= factor;
+        return ret;
+    }
+
+    friend IndexedTensorProduct<Derived,T> operator*(const T factor, const IndexedTensorProduct<Derived,T>& other)
+    {
+        return other*factor;
+    }
+};
+
+template <typename Derived, typename T, typename cvDerived>
+void evaluate_product(const T alpha, const std::vector< IndexedTensor<const cvDerived,T> >& operands,
+                      const T beta, Derived& C, const std::string& idx_C)
+{
+    const size_t n = operands.size();
+    std::vector<std::string> idx(n);
+    std::vector< std::vector<int> > len(n);
+    std::vector<const Derived*> tensor(n);
+
+    for (size_t i = 0;i < n;i++)
+    {
+        idx[i] = operands[i].idx_;
+        len[i] = operands[i].tensor_.getLengths();
+        tensor[i] = &operands[i].tensor_;
+    }
+
+    ProductPlan plan;
+    switch (tensor_plan_product(idx, len, idx_C, C.getLengths(), sizeof(T), plan))
+    {
+        case kTensorReturnCodeSuccess:
+            break;
+        case kTensorReturnCodeLengthMismatch:
+            throw LengthMismatchError();
+        default:
+            throw InvalidNdimError();
+    }
+
+    /*
+     * intermediates are owned here until consumed, or handed to the active Deferred
+     */
+    std::vector< std::unique_ptr<Derived> > owned(n + plan.steps.size());
+    const bool deferred = (Deferred<Derived,T>::active() != NULL);
+
+    for (size_t s = 0;s < plan.steps.size();s++)
+    {
+        const ProductStep& step = plan.steps[s];
+        const Derived& A = *tensor[step.A];
+        const Derived& B = *tensor[step.B];
+
+        if (s == plan.steps.size()-1)
+        {
+            if (!Deferred<Derived,T>::mult(alpha, A, idx[step.A], B, idx[step.B], beta, C, idx_C))
+                C.mult(alpha, A, idx[step.A], B, idx[step.B], beta, idx_C);
+        }
+        else
+        {
+            owned[step.C].reset(new Derived("intermediate", C, step.len_C));
+            Derived& X = *owned[step.C];
+
+            if (!Deferred<Derived,T>::mult((T)1, A, idx[step.A], B, idx[step.B], (T)0, X, step.idx_C))
+                X.mult((T)1, A, idx[step.A], B, idx[step.B], (T)0, step.idx_C);
+
+            tensor.push_back(&X);
+            idx.push_back(step.idx_C);
+        }
+
+        if (deferred)
+        {
+            if (owned[step.C]) Deferred<Derived,T>::adopt(owned[step.C].release());
+        }
+        else
+        {
+            owned[step.A].reset();
+            owned[step.B].reset();
+        }
+    }
+}
+
 } // namespace tensor
 
 /**************************************************************************
@@ -500,10 +749,14 @@ public:
 template <class Derived, typename T>
 T scalar(const tensor::IndexedTensorMult<Derived,T>& itm)
 {
+    tensor::Deferred<typename remove_cv<Derived>::type,T>::flush_active();
+
     return itm.factor_*itm.B_.tensor_.dot(itm.A_.tensor_, itm.A_.idx_,
                                                           itm.B_.idx_);
 }
 
 } // namespace ambit
 
+#include "deferred.h"
+
 #endif
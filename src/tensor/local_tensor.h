@@ -27,6 +27,7 @@
 
 #include "indexable_tensor.h"
 #include "indices.h"
+#include "tensor_map_dense.h"
 #include <util/memory.h>
 
 #include <cassert>
@@ -107,6 +108,67 @@ protected:
     T* data;
     bool isAlloced;
 
+    /*
+     * Fill or copy into newly allocated data with the elements divided among the threads in contiguous blocks, as in
+     * the dense kernels, so that under kMemoryFirstTouch (see util::ambit_set_memory_policy) each page is placed on the
+     * NUMA node of the thread that will work on it
+     */
+    static int first_touch_threads(const uint64_t size)
+    {
+        return (size*sizeof(T) < (uint64_t(1) << 20) ? 1 : tensor_get_num_threads());
+    }
+
+    static void first_touch_fill(T* data, const uint64_t size, const T val)
+    {
+        const int nthread = first_touch_threads(size);
+
+        #pragma omp parallel for num_threads(nthread) schedule(static) if (nthread > 1)
+        for (int64_t i = 0;i < (int64_t)size;i++) data[i] = val;
+    }
+
+    static void first_touch_copy(const T* from, const uint64_t size, T* data)
+    {
+        const int nthread = first_touch_threads(size);
+
+        #pragma omp parallel for num_threads(nthread) schedule(static) if (nthread > 1)
+        for (int64_t i = 0;i < (int64_t)size;i++) data[i] = from[i];
+    }
+
+    /*
+     * Allocate data for a copy of A (whose lengths and leading dimensions this tensor has taken) and copy into it; if
+     * A is a view or is padded the copy is made compact, so that the parts of A's data outside of its lengths are
+     * neither allocated nor copied
+     */
+    void clone_data(const Derived& A)
+    {
+        bool packed = true;
+        for (int i = 0;i < ndim;i++)
+        {
+            if (ld[i] != (i == 0 ? 1 : len[i-1])) packed = false;
+        }
+
+        if (packed)
+        {
+            data = SAFE_MALLOC(T, size);
+            first_touch_copy(A.data, size, data);
+        }
+        else
+        {
+            size = 1;
+            for (int i = 0;i < ndim;i++)
+            {
+                ld[i] = (i == 0 ? 1 : len[i-1]);
+                size *= len[i];
+            }
+
+            data = SAFE_MALLOC(T, size);
+            auto copy = [](const T a) { return a; };
+            map_(T(1), copy, T(0), &A);
+        }
+
+        isAlloced = true;
+    }
+
 public:
     enum CopyType { CLONE, REFERENCE, REPLACE };
 
@@ -121,17 +183,24 @@ public:
     LocalTensor(const Derived& A)
         : IndexableTensor<Derived,T>(A.name, A.ndim), len(A.len), ld(A.ld), size(A.size)
     {
-        data = SAFE_MALLOC(T, size);
-        std::copy(A.data, A.data+size, data);
-        isAlloced = true;
+        clone_data(A);
+    }
+
+    /*
+     * Take over the data of A (or, if A does not own its data, refer to the same data)
+     */
+    LocalTensor(Derived&& A)
+        : IndexableTensor<Derived,T>(A.name, A.ndim), len(A.len), ld(A.ld), size(A.size)
+    {
+        data = A.data;
+        isAlloced = A.isAlloced;
+        A.isAlloced = false;
     }
 
     LocalTensor(const std::string& name, const Derived& A)
         : IndexableTensor<Derived,T>(name, A.ndim), len(A.len), ld(A.ld), size(A.size)
     {
-        data = SAFE_MALLOC(T, size);
-        std::copy(A.data, A.data+size, data);
-        isAlloced = true;
+        clone_data(A);
     }
 
     LocalTensor(const std::string& name, Derived& A, const CopyType type=CLONE)
@@ -140,9 +209,7 @@ public:
         switch(type)
         {
             case CLONE:
-                data = SAFE_MALLOC(T, size);
-                std::copy(A.data, A.data+size, data);
-                isAlloced = true;
+                clone_data(A);
                 break;
             case REFERENCE:
                 data = A.data;
@@ -164,7 +231,7 @@ public:
             ld.resize(ndim);
             ld[0] = 1;
             for (int i=1; i<ndim; ++i)
-                ld[i] = ld[i-1]*len[i-1];
+                ld[i] = len[i-1];
         }
 
 #ifdef VALIDATE_INPUTS
@@ -175,7 +242,7 @@ public:
         data = data_;
         isAlloced = false;
         if (zero)
-            std::fill(data, data+size, (T)0);
+            first_touch_fill(data, size, (T)0);
     }
 
     LocalTensor(const std::string& name, const std::string& indices, bool zero=false)
@@ -206,7 +273,7 @@ public:
         std::cout << "LocalTensor::LocalTensor: len[" << 0 << "] = " << size << "\n";
         for (int i=1; i<ndim; ++i) {
             const size_t lsize = ind[i].end[0] - ind[i].start[0];
-            ld[i] = ld[i-1] * lsize;
+            ld[i] = len[i-1];
             len[i] = lsize;
             size *= lsize;
 
@@ -215,7 +282,7 @@ public:
         data = SAFE_MALLOC(T, size);
         isAlloced = true;
         if (zero)
-            std::fill(data, data+size, (T)0);
+            first_touch_fill(data, size, (T)0);
     }
 
     LocalTensor(const std::string& name, const std::vector<int>& len, const std::vector<int>& ld_, uint64_t size_, bool zero=true)
@@ -227,7 +294,7 @@ public:
             ld.resize(ndim);
             ld[0] = 1;
             for (int i=1; i<ndim; ++i)
-                ld[i] = ld[i-1]*len[i-1];
+                ld[i] = len[i-1];
         }
 
 #ifdef VALIDATE_INPUTS
@@ -238,7 +305,7 @@ public:
         data = SAFE_MALLOC(T, size);
         isAlloced = true;
         if (zero)
-            std::fill(data, data+size, (T)0);
+            first_touch_fill(data, size, (T)0);
     }
 
     ~LocalTensor()
@@ -251,24 +318,87 @@ public:
     const std::vector<int>& getLeadingDims() const { return ld; }
     uint64_t getSize() const { return size; }
 
+    /*
+     * Whether this tensor owns its data (false for views such as DenseTensor::slice)
+     */
+    bool ownsData() const { return isAlloced; }
+
+    /*
+     * this = alpha*f(...) + beta*this elementwise, where f takes one element of this tensor (for the first form) or of
+     * each of the one to four operands, which have the same lengths as this tensor (see tensor_map_dense_)
+     *
+     * The map is done by Derived::map_, so that a derived tensor whose elements are not laid out by len and ld (such
+     * as SymmetricTensor) can supply its own.
+     */
+    template <class F>
+    void map(const T alpha, F f, const T beta)
+    {
+        getDerived().map_(alpha, f, beta, &getDerived());
+    }
+
+    template <class F>
+    void map(const T alpha, const Derived& A, F f, const T beta)
+    {
+        getDerived().map_(alpha, f, beta, &A);
+    }
+
+    template <class F>
+    void map(const T alpha, const Derived& A, const Derived& B, F f, const T beta)
+    {
+        getDerived().map_(alpha, f, beta, &A, &B);
+    }
+
+    template <class F>
+    void map(const T alpha, const Derived& A, const Derived& B, const Derived& C, F f, const T beta)
+    {
+        getDerived().map_(alpha, f, beta, &A, &B, &C);
+    }
+
+    template <class F>
+    void map(const T alpha, const Derived& A, const Derived& B, const Derived& C, const Derived& D,
+             F f, const T beta)
+    {
+        getDerived().map_(alpha, f, beta, &A, &B, &C, &D);
+    }
+
+    /*
+     * Elements where the divisor is not larger than DBL_MIN in magnitude are left unchanged; when beta is zero the
+     * other elements are overwritten without reading them, so that an infinite or NaN value there does not propagate
+     */
     void div(const T alpha, const Derived& A,
                             const Derived& B, const T beta)
     {
-        assert(size == A.size && size == B.size);
-
-        for (uint64_t i=0; i<size; ++i) {
-            if (std::abs(B.data[i]) > DBL_MIN)
-                data[i] = beta*data[i] + alpha*A.data[i]/B.data[i];
+        if (beta == T(0))
+        {
+            map(T(1), A, B, getDerived(), [alpha](const T a, const T b, const T c)
+            {
+                return (std::abs(b) > DBL_MIN ? alpha*a/b : c);
+            }, T(0));
+        }
+        else
+        {
+            map(T(1), A, B, getDerived(), [alpha,beta](const T a, const T b, const T c)
+            {
+                return (std::abs(b) > DBL_MIN ? alpha*a/b + beta*c : c);
+            }, T(0));
         }
     }
 
     void invert(const T alpha, const Derived& A, const T beta)
     {
-        assert(size == A.size);
-
-        for (uint64_t i=0; i<size; ++i) {
-            if (std::abs(A.data[i]) > DBL_MIN)
-                data[i] = beta*data[i] + alpha/A.data[i];
+        if (beta == T(0))
+        {
+            map(T(1), A, getDerived(), [alpha](const T a, const T c)
+            {
+                return (std::abs(a) > DBL_MIN ? alpha/a : c);
+            }, T(0));
+        }
+        else
+        {
+            map(T(1), A, getDerived(), [alpha,beta](const T a, const T c)
+            {
+                return (std::abs(a) > DBL_MIN ? alpha/a + beta*c : c);
+            }, T(0));
         }
     }
 
@@ -277,9 +407,10 @@ public:
     void fill_with_random_data()
     {
         // Set random values for only our data
-        for (uint64_t i=0; i<size; ++i) {
+        for_each_element(getDerived(), getDerived(), [&](const uint64_t i, const uint64_t, const uint64_t)
+        {
             data[i] = drand48()-.5;
-        }
+        });
     }
 
     T* get_data() { return data; }
@@ -294,6 +425,73 @@ public:
                 0,               "");
         return dt.get_data()[0];
     }
+
+protected:
+    template <class F, class... Operands>
+    void map_(const T alpha, F& f, const T beta, const Operands*... operands)
+    {
+        const Derived* ops[] = {operands...};
+        const int N = sizeof...(Operands);
+        const T* A[N];
+        const int* lda[N];
+
+        for (int k = 0;k < N;k++)
+        {
+            if (ops[k]->len != len) throw LengthMismatchError();
+            A[k] = ops[k]->data;
+            lda[k] = ops[k]->ld.data();
+        }
+
+        tensor_map_dense_<N>(alpha, f, A, lda, beta, data, ndim, len.data(), ld.data());
+    }
+
+    /*
+     * Call f(off, off_A, off_B) with the offsets of each element of this tensor and the corresponding
+     * elements of A and B, which have the same lengths but possibly different leading dimensions
+     *
+     * Only the elements within the lengths are visited, so that the padding of a tensor (or, for a view,
+     * the parts of the parent tensor outside of the view) is not touched.
+     */
+    template <class F>
+    void for_each_element(const Derived& A, const Derived& B, F f) const
+    {
+        const std::vector<int>* lds[3] = {&ld, &A.ld, &B.ld};
+        std::vector<uint64_t> stride[3];
+        std::vector<int> pos(ndim, 0);
+        uint64_t off[3] = {0, 0, 0};
+
+        for (int op = 0;op < 3;op++)
+        {
+            stride[op].resize(ndim);
+            for (int i = 0;i < ndim;i++)
+                stride[op][i] = (i == 0 ? 1 : stride[op][i-1])*(*lds[op])[i];
+        }
+
+        for (int i = 0;i < ndim;i++)
+            if (len[i] == 0) return;
+
+        for (bool done = false;!done;)
+        {
+            f(off[0], off[1], off[2]);
+
+            done = true;
+            for (int i = 0;i < ndim;i++)
+            {
+                if (pos[i] == len[i] - 1)
+                {
+                    pos[i] = 0;
+                    for (int op = 0;op < 3;op++) off[op] -= stride[op][i]*(len[i]-1);
+                }
+                else
+                {
+                    pos[i]++;
+                    for (int op = 0;op < 3;op++) off[op] += stride[op][i];
+                    done = false;
+                    break;
+                }
+            }
+        }
+    }
 };
 
 }
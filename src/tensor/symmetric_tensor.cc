@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2013 Devin Matthews
+ *
+ * This is a slimmed down version of the tensor framework developed by
+ * Devin Matthews. The version by Devin was tied to Aquarius. This
+ * version is not.
+ *
+ * Copyright (C) 2013  Justin Turney
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "symmetric_tensor.h"
+#include <cassert>
+#include <utility>
+
+namespace ambit { namespace tensor {
+
+template <typename T>
+SymmetricTensor<T>::SymmetricTensor(const std::string& name, T val)
+    : LocalTensor<SymmetricTensor<T>,T>(name, val) {}
+
+template <typename T>
+SymmetricTensor<T>::SymmetricTensor(const std::string& name, const SymmetricTensor<T>& A, T val)
+    : LocalTensor< SymmetricTensor<T>,T >(name, val) {}
+
+template <typename T>
+SymmetricTensor<T>::SymmetricTensor(const SymmetricTensor<T>& A)
+    : LocalTensor< SymmetricTensor<T>,T >(A), sym(A.sym) {}
+
+template <typename T>
+SymmetricTensor<T>::SymmetricTensor(SymmetricTensor<T>&& A)
+    : LocalTensor< SymmetricTensor<T>,T >(std::move(A)), sym(A.sym) {}
+
+template <typename T>
+SymmetricTensor<T>::SymmetricTensor(const std::string& name, const SymmetricTensor<T>& A)
+    : LocalTensor< SymmetricTensor<T>,T >(name, A), sym(A.sym) {}
+
+template <typename T>
+SymmetricTensor<T>::SymmetricTensor(const std::string& name, const std::vector<int>& len, const std::vector<int>& sym, bool zero)
+    : LocalTensor< SymmetricTensor<T>,T >(name, len, std::vector<int>(), getSize(len.size(), len, sym), zero), sym(sym) {}
+
+template <typename T>
+SymmetricTensor<T>::SymmetricTensor(const std::string& name, const DenseTensor<T>& A, const std::vector<int>& sym)
+    : LocalTensor< SymmetricTensor<T>,T >(name, A.getLengths(), std::vector<int>(), getSize(A.getDimension(), A.getLengths(), sym), false), sym(sym)
+{
+    std::vector<int> idx(ndim), sym_A(ndim, NS);
+
+    for (int i = 0;i < ndim;i++) idx[i] = i;
+
+    CHECK_RETURN_VALUE(
+    tensor_sum_(T(1), A.get_data(), ndim, len.data(), A.getLeadingDims().data(), sym_A.data(), idx.data(),
+                T(0),         data, ndim, len.data(),            (const int*)NULL,   sym.data(), idx.data()));
+}
+
+template <typename T>
+uint64_t SymmetricTensor<T>::getSize(int ndim, const std::vector<int>& len, const std::vector<int>& sym)
+{
+    if ((int)sym.size() != ndim) throw InvalidNdimError();
+
+    int64_t r = tensor_size(ndim, len.data(), NULL, sym.data());
+
+    CHECK_RETURN_VALUE(r);
+
+    return r;
+}
+
+template <typename T>
+void SymmetricTensor<T>::unpack(DenseTensor<T>& A) const
+{
+    if (A.getLengths() != len) throw LengthMismatchError();
+
+    std::vector<int> idx(ndim), sym_A(ndim, NS);
+
+    for (int i = 0;i < ndim;i++) idx[i] = i;
+
+    CHECK_RETURN_VALUE(
+    tensor_sum_(T(1),         data, ndim, len.data(),            (const int*)NULL,   sym.data(), idx.data(),
+                T(0), A.get_data(), ndim, len.data(), A.getLeadingDims().data(), sym_A.data(), idx.data()));
+}
+
+/*
+ * The packed elements are contiguous, so the elementwise operations need not go through for_each_element
+ */
+template <typename T>
+void SymmetricTensor<T>::fill_with_random_data()
+{
+    for (uint64_t i = 0;i < size;i++) data[i] = drand48()-.5;
+}
+
+template <typename T>
+void SymmetricTensor<T>::div(const T alpha, const SymmetricTensor<T>& A,
+                                            const SymmetricTensor<T>& B, const T beta)
+{
+    assert(len == A.len && len == B.len && sym == A.sym && sym == B.sym);
+
+    for (uint64_t i = 0;i < size;i++)
+    {
+        if (std::abs(B.data[i]) > DBL_MIN)
+            data[i] = beta*data[i] + alpha*A.data[i]/B.data[i];
+    }
+}
+
+template <typename T>
+void SymmetricTensor<T>::invert(const T alpha, const SymmetricTensor<T>& A, const T beta)
+{
+    assert(len == A.len && sym == A.sym);
+
+    for (uint64_t i = 0;i < size;i++)
+    {
+        if (std::abs(A.data[i]) > DBL_MIN)
+            data[i] = beta*data[i] + alpha/A.data[i];
+    }
+}
+
+template <typename T>
+void SymmetricTensor<T>::print() const
+{
+    printf("Name: %s\n", getName().c_str());
+    CHECK_RETURN_VALUE(
+    tensor_print(data, ndim, len.data(), (const int*)NULL, sym.data()));
+}
+
+template <typename T>
+void SymmetricTensor<T>::mult(const T alpha, const SymmetricTensor<T>& A, const std::string& idx_A,
+                                             const SymmetricTensor<T>& B, const std::string& idx_B,
+                              const T beta,                               const std::string& idx_C)
+{
+    std::vector<int> idx_A_(    A.ndim);
+    std::vector<int> idx_B_(    B.ndim);
+    std::vector<int> idx_C_(this->ndim);
+
+    for (int i = 0;i <     A.ndim;i++) idx_A_[i] = idx_A[i];
+    for (int i = 0;i <     B.ndim;i++) idx_B_[i] = idx_B[i];
+    for (int i = 0;i < this->ndim;i++) idx_C_[i] = idx_C[i];
+
+    CHECK_RETURN_VALUE(
+    tensor_mult_(alpha, A.data, A.ndim, A.len.data(), (const int*)NULL, A.sym.data(), idx_A_.data(),
+                        B.data, B.ndim, B.len.data(), (const int*)NULL, B.sym.data(), idx_B_.data(),
+                 beta,    data,   ndim,   len.data(), (const int*)NULL,   sym.data(), idx_C_.data()));
+}
+
+template <typename T>
+void SymmetricTensor<T>::sum(const T alpha, const SymmetricTensor<T>& A, const std::string& idx_A,
+                             const T beta,                               const std::string& idx_B)
+{
+    std::vector<int> idx_A_(    A.ndim);
+    std::vector<int> idx_B_(this->ndim);
+
+    for (int i = 0;i <     A.ndim;i++) idx_A_[i] = idx_A[i];
+    for (int i = 0;i < this->ndim;i++) idx_B_[i] = idx_B[i];
+
+    CHECK_RETURN_VALUE(
+    tensor_sum_(alpha, A.data, A.ndim, A.len.data(), (const int*)NULL, A.sym.data(), idx_A_.data(),
+                beta,    data,   ndim,   len.data(), (const int*)NULL,   sym.data(), idx_B_.data()));
+}
+
+template <typename T>
+void SymmetricTensor<T>::scale(const T alpha, const std::string& idx_A)
+{
+    std::vector<int> idx_A_(this->ndim);
+
+    for (int i = 0;i < this->ndim;i++) idx_A_[i] = idx_A[i];
+
+    CHECK_RETURN_VALUE(
+    tensor_scale_(alpha, data, ndim, len.data(), (const int*)NULL, sym.data(), idx_A_.data()));
+}
+
+INSTANTIATE_SPECIALIZATIONS(SymmetricTensor);
+
+}
+}
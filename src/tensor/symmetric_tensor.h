@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2013 Devin Matthews
+ *
+ * This is a slimmed down version of the tensor framework developed by
+ * Devin Matthews. The version by Devin was tied to Aquarius. This
+ * version is not.
+ *
+ * Copyright (C) 2013  Justin Turney
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined(AMBIT_LIB_TENSOR_SYMMETRIC_TENSOR)
+#define AMBIT_LIB_TENSOR_SYMMETRIC_TENSOR
+
+#include "local_tensor.h"
+#include "dense_tensor.h"
+#include <vector>
+
+namespace ambit {
+
+namespace tensor {
+
+/*
+ * A local tensor in packed (anti)symmetric storage
+ *
+ * sym[i] (one of kTensorSymmetryTypes) relates indices i and i+1, as for CyclopsTensor, and within each group of
+ * (anti)symmetric indices only the unique elements are stored, contiguously (see tensor_size), so that a group of
+ * n indices takes about 1/n! of the memory of the dense tensor. The leading dimensions are those of the unpacked
+ * tensor. A packed result is (anti)symmetrized onto its symmetry, e.g. C["abij"] = A["ak"]*B["kbij"] with C
+ * antisymmetric in ab and ij gives P(ab)C_abij/2.
+ *
+ * Sums which only permute the indices (copies, transposes, and changes of symmetry), unpack, and packing from a
+ * DenseTensor work directly on the packed elements. Other operations save storage between operations only: during
+ * a contraction or a trace each packed operand and a packed result are held whole in dense form, so its peak memory
+ * is that of the same operation on dense tensors plus the packed tensors themselves.
+ */
+template <typename T>
+struct SymmetricTensor : public LocalTensor< SymmetricTensor<T>, T>
+{
+    INHERIT_FROM_LOCAL_TENSOR(SymmetricTensor<T>,T)
+
+protected:
+    std::vector<int> sym;
+
+public:
+    SymmetricTensor(const std::string& name, T val = (T)0);
+    SymmetricTensor(const std::string& name, const SymmetricTensor<T>& A, T val);
+    SymmetricTensor(const SymmetricTensor<T>& A);
+    SymmetricTensor(SymmetricTensor<T>&& A);
+    SymmetricTensor(const std::string& name, const SymmetricTensor<T>& A);
+    SymmetricTensor(const std::string& name, const std::vector<int>& len, const std::vector<int>& sym, bool zero=true);
+
+    /*
+     * Pack the (anti)symmetrized dense tensor A
+     */
+    SymmetricTensor(const std::string& name, const DenseTensor<T>& A, const std::vector<int>& sym);
+
+    static uint64_t getSize(int ndim, const std::vector<int>& len, const std::vector<int>& sym);
+
+    const std::vector<int>& getSymmetry() const { return sym; }
+
+    /*
+     * Write all of the elements of this tensor, including the redundant and zero ones, to A
+     */
+    void unpack(DenseTensor<T>& A) const;
+
+    void fill_with_random_data();
+
+    void div(const T alpha, const SymmetricTensor<T>& A,
+                            const SymmetricTensor<T>& B, const T beta);
+
+    void invert(const T alpha, const SymmetricTensor<T>& A, const T beta);
+
+    void print() const;
+
+    void mult(const T alpha, const SymmetricTensor<T>& A, const std::string& idx_A,
+                             const SymmetricTensor<T>& B, const std::string& idx_B,
+              const T beta,                               const std::string& idx_C);
+
+    void sum(const T alpha, const SymmetricTensor<T>& A, const std::string& idx_A,
+             const T beta,                               const std::string& idx_B);
+
+    void scale(const T alpha, const std::string& idx_A);
+
+protected:
+    /*
+     * The elementwise maps of LocalTensor, over the packed elements only: the operands must have the same symmetry
+     * as this tensor, and for an antisymmetric group f should be odd (f(-a) = -f(a)) for the result to represent
+     * the map of the unpacked tensor
+     */
+    template <class F, class... Operands>
+    void map_(const T alpha, F& f, const T beta, const Operands*... operands)
+    {
+        const SymmetricTensor<T>* ops[] = {operands...};
+        const int N = sizeof...(Operands);
+        const T* A[N];
+
+        for (int k = 0;k < N;k++)
+        {
+            if (ops[k]->len != len) throw LengthMismatchError();
+            if (ops[k]->sym != sym) throw SymmetryMismatchError();
+            A[k] = ops[k]->data;
+        }
+
+        tensor_map_dense_<N>(alpha, f, A, beta, data, (size_t)size);
+    }
+};
+
+}
+
+}
+
+#endif
@@ -66,6 +66,33 @@ enum kTensorReturnCodes {
     kTensorReturnCodeInvalidStart = -10
 };
 
+/*
+ * Instruction sets for which the dense kernels have vectorized variants (see tensor_set_vector_isa)
+ */
+enum kTensorVectorISAs {
+    kTensorVectorGeneric = 0,
+    kTensorVectorAVX2 = 1,
+    kTensorVectorAVX512 = 2
+};
+
+/*
+ * Algorithms for dense contractions
+ */
+enum kTensorContractAlgorithms {
+    kTensorContractAuto = 0,
+    kTensorContractLoop = 1,
+    kTensorContractTTGT = 2,
+    kTensorContractGETT = 3
+};
+
+/*
+ * Precisions in which single-precision operands are multiplied and summed
+ */
+enum kTensorAccumulations {
+    kTensorAccumulateSingle = 0,
+    kTensorAccumulateDouble = 1
+};
+
 namespace ambit {
 
 template <typename T>
@@ -101,13 +128,42 @@ class InvalidSymmetryError;
 class InvalidStartError;
 
 #define INSTANTIATE_SPECIALIZATIONS(name) \
-template class name<double>;
+template class name<float>; \
+template class name<double>; \
+template class name< std::complex<float> >; \
+template class name< std::complex<double> >;
 
 #define INSTANTIATE_SPECIALIZATIONS_2(name,extra1) \
-template class name<double,extra1>;
+template class name<float,extra1>; \
+template class name<double,extra1>; \
+template class name< std::complex<float>,extra1 >; \
+template class name< std::complex<double>,extra1 >;
 
 #define INSTANTIATE_SPECIALIZATIONS_3(name,extra1,extra2) \
-template class name<double,extra1,extra2>;
+template class name<float,extra1,extra2>; \
+template class name<double,extra1,extra2>; \
+template class name< std::complex<float>,extra1,extra2 >; \
+template class name< std::complex<double>,extra1,extra2 >;
+
+/*
+ * Expand macro(T) once for each element type supported by the dense kernels, e.g. to explicitly
+ * instantiate a kernel template
+ */
+#define INSTANTIATE_DENSE_KERNELS(macro) \
+macro(float) \
+macro(double) \
+macro(std::complex<float>) \
+macro(std::complex<double>)
+
+/*
+ * Expand macro(T,U) once for each pair of operand and result types supported by the mixed-precision
+ * dense multiplication
+ */
+#define INSTANTIATE_MIXED_DENSE_KERNELS(macro) \
+macro(float,float) \
+macro(float,double) \
+macro(std::complex<float>,std::complex<float>) \
+macro(std::complex<float>,std::complex<double>)
 
 #define INHERIT_FROM_TENSOR(Derived,T) \
     public: \
@@ -159,7 +215,7 @@ struct Tensor
 
     Derived& operator*=(const T val)
     {
-        mul(val);
+        mult(val);
         return getDerived();
     }
 
@@ -975,10 +1031,14 @@ typedef int (*tensor_func_binary)(const double alpha, const double* A, const int
  * the binary contraction operation is similar in form to the unary trace operation, while the binary weighting operation is similar in form to the
  * unary diagonal operation. Any combination of these operations may be performed. Even in the case that only a subset of the elements of C are written
  * to by the multiplication, all elements of C are first scaled by beta. Replication is performed in-place.
+ *
+ * Tensors with (anti)symmetric groups of indices are stored packed (see tensor_size). If C has such groups, the product
+ * is (anti)symmetrized onto them as by tensor_symmetrize before being added to C.
  */
-int tensor_mult_(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A,
-                                     const double* B, const int ndim_B, const int* len_B, const int* ldb, const int* sym_B, const int* idx_B,
-                 const double beta,        double* C, const int ndim_C, const int* len_C, const int* ldc, const int* sym_C, const int* idx_C);
+template <typename T>
+int tensor_mult_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A,
+                                const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* sym_B, const int* idx_B,
+                 const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* sym_C, const int* idx_C);
 
 /**
  * Contract two tensors into a third
@@ -1018,13 +1078,122 @@ typedef int (*tensor_func_binary_dense)(const double alpha, const double* A, con
                                                             const double* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
                                         const double beta,        double* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C);
 
-int tensor_mult_dense_(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
-                                           const double* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
-                       const double beta,        double* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C);
+/**
+ * The dense kernels are templates over the element type T, which may be float, double, std::complex<float>, or
+ * std::complex<double> (see INSTANTIATE_DENSE_KERNELS)
+ */
+template <typename T>
+int tensor_mult_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                                      const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                       const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C);
+
+/**
+ * As above, but with the algorithm used for pure contractions given explicitly (one of kTensorContractAlgorithms)
+ */
+template <typename T>
+int tensor_mult_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                                      const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                       const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+                       const int algorithm);
+
+/**
+ * Mixed-precision multiplication of single-precision operands onto a result of type U (the same as T or its
+ * double-precision counterpart; see INSTANTIATE_MIXED_DENSE_KERNELS)
+ *
+ * With kTensorAccumulateDouble the products of A and B are formed and summed in double precision, and with
+ * kTensorAccumulateSingle in single precision; the result is then scaled and added to C in type U. Pure
+ * contractions always use GETT (which converts the operands as it packs them), since there is no mixed-precision
+ * gemm, unless T, U, and the accumulation precision are all the same.
+ */
+template <typename T, typename U>
+int tensor_mult_dense_(const U alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                                      const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                       const U beta,        U* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+                       const int algorithm, const int accumulation);
+
+/**
+ * Contract two dense tensors into a third
+ *
+ * Every index must appear exactly once in exactly two of A, B, and C, or exactly once in each of A, B, and C (in which case the
+ * contraction is batched over that index). The TTGT algorithm permutes operands which are not already laid out as matrices into
+ * scratch space and calls dgemm, while the GETT algorithm packs small panels directly from the strided operands. By default, TTGT
+ * is used unless its scratch space would exceed the limit set by tensor_set_contract_scratch_limit or what is left of the memory
+ * budget (see util::ambit_memory_set_budget).
+ */
+template <typename T>
+int tensor_contract_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                                          const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                           const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C);
+
+template <typename T>
+int tensor_contract_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                                          const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                           const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+                           const int algorithm);
+
+/**
+ * Set or get the largest amount of scratch space (in bytes) that an automatically chosen TTGT contraction may use
+ */
+void tensor_set_contract_scratch_limit(const size_t bytes);
+size_t tensor_get_contract_scratch_limit();
+
+/**
+ * Set or get the largest amount of memory (in bytes) that the intermediates of a product of three or more tensors
+ * should occupy at once (see tensor_plan_product). A value of zero (the default) means no limit. What is left of the memory
+ * budget (see util::ambit_memory_set_budget) is a limit as well.
+ */
+void tensor_set_product_memory_limit(const size_t bytes);
+size_t tensor_get_product_memory_limit();
 
-int tensor_contract_dense_(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
-                                               const double* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
-                           const double beta,        double* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C);
+/**
+ * Set or get the number of OpenMP threads used by the dense kernels
+ *
+ * A value of zero (the default) uses omp_get_max_threads(). Operations too small to benefit run on one thread, as does
+ * any operation started from inside a parallel region. Without OpenMP, tensor_get_num_threads always returns one.
+ */
+void tensor_set_num_threads(const int nthread);
+int tensor_get_num_threads();
+
+/**
+ * Set or get the instruction set used by the contiguous inner loops of the dense kernels (one of kTensorVectorISAs)
+ *
+ * The default is the best one supported by the processor; requests for an unsupported instruction set are lowered to the
+ * best supported one.
+ */
+void tensor_set_vector_isa(const int isa);
+int tensor_get_vector_isa();
+
+/**
+ * Set or get the accumulation precision (one of kTensorAccumulations) used by mixed-precision multiplications of
+ * dense tensors which do not give one explicitly, e.g. C["ij"] = A["ik"]*B["kj"] with single-precision A and B and
+ * a double-precision C. The default is kTensorAccumulateDouble.
+ */
+void tensor_set_mixed_accumulation(const int accumulation);
+int tensor_get_mixed_accumulation();
+
+/**
+ * Control the cache of plans used by tensor_mult_dense_ and tensor_contract_dense_
+ *
+ * A plan is reused whenever an operation is repeated with the same lengths, leading dimensions, index labels, and
+ * algorithm (and, for kTensorContractAuto, number of threads, so that plans made inside and outside of a parallel
+ * region are kept apart); once the capacity is reached the least recently used plan is discarded. A capacity of
+ * zero disables caching. The hit and miss counters record lookups since the last call to
+ * tensor_reset_plan_cache_stats.
+ */
+void tensor_set_plan_cache_capacity(const size_t capacity);
+size_t tensor_get_plan_cache_capacity();
+void tensor_clear_plan_cache();
+uint64_t tensor_plan_cache_hits();
+uint64_t tensor_plan_cache_misses();
+void tensor_reset_plan_cache_stats();
+
+/**
+ * Determine whether a binary operation may be performed by tensor_contract_dense_, i.e. it does not
+ * include any trace, diagonal, or replication.
+ */
+bool tensor_is_contraction_dense(const int ndim_A, const int* idx_A,
+                                 const int ndim_B, const int* idx_B,
+                                 const int ndim_C, const int* idx_C);
 
 int tensor_weight_dense_(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
                                              const double* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
@@ -1046,9 +1215,13 @@ typedef int (*tensor_func_unary)(const double alpha, const double* A, const int
  * This form generalizes all of the unary operations trace, transpose, resym, diagonal, and replicate, which may be performed
  * in any combination. Even in the case that only a subset of the elements of B are written to by the operation, all elements
  * of B are first scaled by beta. Replication is performed in-place.
+ *
+ * If A or B is packed and the operation only permutes the indices, it is done on the packed elements without unpacking
+ * either tensor; A and B must then not overlap unless they are the same.
  */
-int tensor_sum_(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A,
-                const double beta,        double* B, const int ndim_B, const int* len_B, const int* ldb, const int* sym_B, const int* idx_B);
+template <typename T>
+int tensor_sum_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A,
+                const T beta,        T* B, const int ndim_B, const int* len_B, const int* ldb, const int* sym_B, const int* idx_B);
 
 /**
  * Transpose a tensor and sum onto a second
@@ -1070,11 +1243,13 @@ int tensor_transpose_(const double alpha, const double* A, const int ndim_A, con
  * both possibilities allowed concurrently on disjoint sets of indices. A set of (anti)symmetric indices may be partially unpacked, leaving
  * two or more indices in packed storage, while one or more nonsymmetric indices may be (anti)symmetrized onto an existing packed set of
  * indices. Even in the case that only a subset of the elements of B are written to by the operation, all elements of B are first scaled
- * by beta. Transposition of the indices is allowed. Each (partial) unpacking includes a permutation factor of n'!/n! where n and n' are
- * number of (anti)symmetric indices before and after the unpacking.
+ * by beta. Transposition of the indices is allowed. Unpacking expands the stored elements as tensor_unpack does, and (anti)symmetrization
+ * averages over the permutations of the indices as tensor_symmetrize does, so that a tensor which has both symmetries is unchanged by
+ * a round trip.
  */
-int tensor_resym_(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A,
-                  const double beta,        double* B, const int ndim_B, const int* len_B, const int* ldb, const int* sym_B, const int* idx_B);
+template <typename T>
+int tensor_resym_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A,
+                  const T beta,        T* B, const int ndim_B, const int* len_B, const int* ldb, const int* sym_B, const int* idx_B);
 
 /**
  * Sum over (semi)diagonal elements of a tensor and sum onto a second
@@ -1112,11 +1287,23 @@ int tensor_diagonal_(const double alpha, const double* A, const int ndim_A, cons
 typedef int (*tensor_func_unary_dense)(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
                                        const double beta,        double* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B);
 
-int tensor_sum_dense_(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
-                      const double beta,        double* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B);
+template <typename T>
+int tensor_sum_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                      const T beta,        T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B);
 
-int tensor_transpose_dense_(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
-                            const double beta,        double* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B);
+/**
+ * Permute the indices of a dense tensor and sum onto a second
+ *
+ * Every index must appear exactly once in each of A and B. Both the input and the output are traversed in cache-sized tiles,
+ * and the work is divided among tensor_get_num_threads() threads. tensor_sum_dense_ calls this automatically whenever
+ * tensor_is_permutation_dense is true.
+ */
+template <typename T>
+int tensor_transpose_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                            const T beta,        T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B);
+
+bool tensor_is_permutation_dense(const int ndim_A, const int* idx_A,
+                                 const int ndim_B, const int* idx_B);
 
 int tensor_trace_dense_(const double alpha, const double* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
                         const double beta,        double* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B);
@@ -1131,12 +1318,22 @@ int tensor_diagonal_dense_(const double alpha, const double* A, const int ndim_A
  * Helper function definitions
  */
 
-int tensor_scale_(const double alpha, double* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A);
+template <typename T>
+int tensor_scale_(const T alpha, T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A);
 
-int tensor_scale_dense_(const double alpha, double* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A);
+template <typename T>
+int tensor_scale_dense_(const T alpha, T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A);
 
-int tensor_slice_dense(const double*  A, const int  ndim_A, const int* len_A, const int* lda,
-                             double** B,       int* ndim_B,       int* len_B,       int* ldb,
+/*
+ * A[i_0 i_1 ...] /= d[0][i_0] + d[1][i_1] + ..., where d[k] has len_A[k] elements (e.g. orbital-energy denominators);
+ * a scalar (ndim_A == 0) has an empty denominator and is left unchanged
+ */
+template <typename T>
+int tensor_denominator_dense_(T* A, const int ndim_A, const int* len_A, const int* lda, const T* const* d);
+
+template <typename T>
+int tensor_slice_dense(const T*  A, const int  ndim_A, const int* len_A, const int* lda,
+                             T** B,       int* ndim_B,       int* len_B,       int* ldb,
                        const int* start, const int* len);
 
 /**
@@ -1146,7 +1343,8 @@ int tensor_slice_dense(const double*  A, const int  ndim_A, const int* len_A, co
  *
  * where i_j;k are the index string for the kth element of A (A_k) in packed order, for k = 0...size-1.
  */
-int tensor_print(const double* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A);
+template <typename T>
+int tensor_print(const T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A);
 
 /**
  * Print a tensor in the form:
@@ -1155,10 +1353,12 @@ int tensor_print(const double* A, const int ndim_A, const int* len_A, const int*
  *
  * where i_j;k are the index string for the kth element of A (A_k) in order, for k = 0...size-1.
  */
-int tensor_print_dense(const double* A, const int ndim_A, const int* len_A, const int* lda);
+template <typename T>
+int tensor_print_dense(const T* A, const int ndim_A, const int* len_A, const int* lda);
 
 /**
- * Calculate the number of non-zero (and hence stored) elements in the given tensor.
+ * Calculate the number of non-zero (and hence stored) elements in the given tensor. A tensor with (anti)symmetric
+ * groups of indices is stored packed and contiguously, so ld must be NULL unless sym is NULL or all NS.
  */
 int64_t tensor_size(const int ndim, const int* len, const int* ld, const int* sym);
 
@@ -1174,25 +1374,27 @@ int tensor_densify(int* ndim, int* len, const int* sym);
 
 /**
  * Take a packed (anti)symmetric tensor and expand it to a dense (rectangular) layout, with all redundant and
- * zero elements written explicitly. The result is scaled by a factor prod_k 1/[(l_k)^(n_k)] for k=0...ngroup, where
- * l_k is the length of the indices in the kth (anti)symmetric group of indices and n_k is the number of such indices.
- * This factor produces a normalized result when combined with tensor_symmetrize or tensor_pack.
+ * zero elements written explicitly. Each stored element is written to every permutation of its indices within
+ * each (anti)symmetric group (negated for odd permutations of antisymmetric groups), and the elements with a
+ * repeated index in an antisymmetric or symmetric-hollow group are zero.
  */
-int tensor_unpack(const double* A, double* B, const int ndim_A, const int* len_A, const int* sym_A);
+template <typename T>
+int tensor_unpack(const T* A, T* B, const int ndim_A, const int* len_A, const int* sym_A);
 
 /**
- * Perform the reverse of tensor_unpack, referencing only non-redundant, non-zero elements of A (although which set of
- * redundant elements will be accessed is unspecified). The result is scaled by a factor prod_k (l_k)^(n_k) for
- *  k=0...ngroup, where l_k is the length of the indices in the kth (anti)symmetric group of indices and n_k is the
- *  number of such indices. The behavior is the same as tensor_symmetrize for the same input, except that fewer elements
- *  must be accessed.
+ * Perform the reverse of tensor_unpack, referencing only non-redundant, non-zero elements of A (those with
+ * i_0 <= i_1 <= ... within each symmetric group, or i_0 < i_1 < ... within each antisymmetric or symmetric-hollow
+ * group). A is assumed to already have the given symmetry; for a general dense tensor, use tensor_symmetrize first.
  */
-int tensor_pack(const double* A, double* B, const int ndim_A, const int* len_A, const int* sym_A);
+template <typename T>
+int tensor_pack(const T* A, T* B, const int ndim_A, const int* len_A, const int* sym_A);
 
 /**
- * Perform an explicit (anti)symmetrization of the given dense tensor.
+ * Perform an explicit (anti)symmetrization of the given dense tensor, averaging each element over the permutations
+ * of its indices within each (anti)symmetric group (so that a tensor which already has the symmetry is unchanged).
  */
-int tensor_symmetrize(const double* A, double* B, const int ndim_A, const int* len_A, const int* sym_A);
+template <typename T>
+int tensor_symmetrize(const T* A, T* B, const int ndim_A, const int* len_A, const int* sym_A);
 
 } // namespace tensor
 
@@ -0,0 +1,473 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Contract two tensors into a third.
+ *
+ * The indices are sorted into four groups: A and C only (I), B and C only (J), A and B only (K), and
+ * A, B and C (L). Each operand is then viewed as a batch (over L) of matrices, C[I,J] = A[I,K]*B[K,J],
+ * which is evaluated with one of two algorithms, as chosen by tensor_plan_mult_dense:
+ *
+ * TTGT (transpose-transpose-GEMM-transpose): operands whose strides already form a column-major matrix
+ * (in either normal or transposed order) are passed to gemm directly, while all other operands are first
+ * permuted into a scratch matrix with tensor_sum_dense_.
+ *
+ * GETT (GEMM-like tensor-tensor): a blocked GEMM whose packing routines gather cache-sized panels of A and B
+ * directly from the strided tensors and whose micro-kernel scatters its results directly into C, so that no
+ * full-size permuted copy of any operand is made.
+ */
+
+#include "tensor.h"
+#include "tensor_plan_dense.h"
+#include "util.h"
+#include <util/blas.h>
+#include <util/memory.h>
+
+#include <vector>
+#include <algorithm>
+
+namespace ambit {
+namespace tensor {
+
+namespace {
+
+/*
+ * Cache blocking parameters for GETT: panels of A are MC x KC and panels of B are KC x NC,
+ * while the micro-kernel accumulates an MR x NR block of C in registers.
+ */
+enum { GETT_MC = 96, GETT_KC = 256, GETT_NC = 2048, GETT_MR = 4, GETT_NR = 4 };
+
+/*
+ * Below this many multiply-adds GETT runs on a single thread
+ */
+enum { GETT_PARALLEL_MIN_WORK = 262144 };
+
+size_t packed_size(const std::vector<int>& len)
+{
+    size_t size = 1;
+    for (size_t i = 0;i < len.size();i++) size *= len[i];
+    return size;
+}
+
+/*
+ * Gather an mc x kc block of A into MR-row slivers of type W, padding the last sliver with zeros
+ */
+template <typename T, typename W>
+void gett_pack_A(const T* restrict A, const size_t* restrict off_I, const size_t* restrict off_K,
+                 const int mc, const int kc, W* restrict Ap)
+{
+    for (int ir = 0;ir < mc;ir += GETT_MR)
+    {
+        const int mr = std::min((int)GETT_MR, mc-ir);
+
+        for (int p = 0;p < kc;p++)
+        {
+            const T* restrict a = A+off_K[p];
+
+            for (int i = 0;i < mr;i++) Ap[i] = W(a[off_I[ir+i]]);
+            for (int i = mr;i < GETT_MR;i++) Ap[i] = W(0);
+
+            Ap += GETT_MR;
+        }
+    }
+}
+
+/*
+ * Gather a kc x nc block of B into NR-column slivers of type W, padding the last sliver with zeros
+ */
+template <typename T, typename W>
+void gett_pack_B(const T* restrict B, const size_t* restrict off_K, const size_t* restrict off_J,
+                 const int kc, const int nc, W* restrict Bp)
+{
+    for (int jr = 0;jr < nc;jr += GETT_NR)
+    {
+        const int nr = std::min((int)GETT_NR, nc-jr);
+
+        for (int p = 0;p < kc;p++)
+        {
+            const T* restrict b = B+off_K[p];
+
+            for (int j = 0;j < nr;j++) Bp[j] = W(b[off_J[jr+j]]);
+            for (int j = nr;j < GETT_NR;j++) Bp[j] = W(0);
+
+            Bp += GETT_NR;
+        }
+    }
+}
+
+/*
+ * Multiply an MR-row sliver of A by an NR-column sliver of B and scatter the result into C
+ */
+template <typename U, typename W>
+void gett_micro_kernel(const int kc, const U alpha, const W* restrict Ap, const W* restrict Bp,
+                       const U beta, U* restrict C, const size_t* restrict off_I, const size_t* restrict off_J,
+                       const int mr, const int nr)
+{
+    W ab[GETT_MR*GETT_NR];
+
+    for (int i = 0;i < GETT_MR*GETT_NR;i++) ab[i] = W(0);
+
+    for (int p = 0;p < kc;p++)
+    {
+        for (int j = 0;j < GETT_NR;j++)
+        {
+            for (int i = 0;i < GETT_MR;i++)
+            {
+                ab[i+j*GETT_MR] += Ap[i]*Bp[j];
+            }
+        }
+
+        Ap += GETT_MR;
+        Bp += GETT_NR;
+    }
+
+    for (int j = 0;j < nr;j++)
+    {
+        U* restrict c = C+off_J[j];
+
+        if (beta == U(0))
+        {
+            for (int i = 0;i < mr;i++) c[off_I[i]] = alpha*U(ab[i+j*GETT_MR]);
+        }
+        else
+        {
+            for (int i = 0;i < mr;i++) c[off_I[i]] = alpha*U(ab[i+j*GETT_MR]) + beta*c[off_I[i]];
+        }
+    }
+}
+
+}
+
+template <typename T>
+int tensor_contract_dense_ttgt(const DenseContractPlan& plan,
+                               const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                                              const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                               const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C)
+{
+    const std::vector<DenseIndex>& L = plan.L;
+
+    const T* X = (plan.swap ? B : A);
+    const int ndim_X = (plan.swap ? ndim_B : ndim_A);
+    const int* len_X = (plan.swap ? len_B : len_A);
+    const int* ldx = (plan.swap ? ldb : lda);
+    const int* idx_X = (plan.swap ? idx_B : idx_A);
+
+    const T* Y = (plan.swap ? A : B);
+    const int ndim_Y = (plan.swap ? ndim_A : ndim_B);
+    const int* len_Y = (plan.swap ? len_A : len_B);
+    const int* ldy = (plan.swap ? lda : ldb);
+    const int* idx_Y = (plan.swap ? idx_A : idx_B);
+
+    const int m = (plan.swap ? plan.n : plan.m);
+    const int n = (plan.swap ? plan.m : plan.n);
+    const int k = plan.k;
+
+    /*
+     * permute operands into scratch matrices as needed
+     */
+    T* X_packed = NULL;
+    T* Y_packed = NULL;
+    T* C_packed = NULL;
+    int ret;
+
+    if (plan.pack_X)
+    {
+        X_packed = SAFE_MALLOC(T, packed_size(plan.len_X_P));
+        ret = tensor_sum_dense_(T(1), X, ndim_X, len_X, ldx, idx_X,
+                                T(0), X_packed, plan.len_X_P.size(), plan.len_X_P.data(), NULL, plan.idx_X_P.data());
+        if (ret != kTensorReturnCodeSuccess) { FREE(X_packed); return ret; }
+        X = X_packed;
+    }
+
+    if (plan.pack_Y)
+    {
+        Y_packed = SAFE_MALLOC(T, packed_size(plan.len_Y_P));
+        ret = tensor_sum_dense_(T(1), Y, ndim_Y, len_Y, ldy, idx_Y,
+                                T(0), Y_packed, plan.len_Y_P.size(), plan.len_Y_P.data(), NULL, plan.idx_Y_P.data());
+        if (ret != kTensorReturnCodeSuccess) { FREE(X_packed); FREE(Y_packed); return ret; }
+        Y = Y_packed;
+    }
+
+    T* Z = C;
+    T beta_Z = beta;
+
+    if (plan.pack_C)
+    {
+        C_packed = SAFE_MALLOC(T, packed_size(plan.len_C_P));
+        Z = C_packed;
+        beta_Z = T(0);
+    }
+
+    /*
+     * loop over the batch indices and multiply one matrix at a time
+     */
+    const int ndim_L = L.size();
+    int pos_L[ndim_L];
+    size_t off_X = 0, off_Y = 0, off_Z = 0;
+    bool done;
+
+    for (int i = 0;i < ndim_L;i++) pos_L[i] = 0;
+
+    for (done = false;!done;)
+    {
+        util::gemm(plan.trans_X, plan.trans_Y, m, n, k,
+                   alpha, X+off_X, plan.ldx,
+                          Y+off_Y, plan.ldy,
+                   beta_Z, Z+off_Z, plan.ldc);
+
+        done = true;
+        for (int i = 0;i < ndim_L;i++)
+        {
+            if (pos_L[i] == L[i].len - 1)
+            {
+                pos_L[i] = 0;
+                off_X -= plan.stride_X_L[i]*(L[i].len-1);
+                off_Y -= plan.stride_Y_L[i]*(L[i].len-1);
+                off_Z -= plan.stride_Z_L[i]*(L[i].len-1);
+            }
+            else
+            {
+                pos_L[i]++;
+                off_X += plan.stride_X_L[i];
+                off_Y += plan.stride_Y_L[i];
+                off_Z += plan.stride_Z_L[i];
+                done = false;
+                break;
+            }
+        }
+    }
+
+    ret = kTensorReturnCodeSuccess;
+
+    if (plan.pack_C)
+    {
+        ret = tensor_sum_dense_(T(1), (const T*)C_packed, plan.len_C_P.size(), plan.len_C_P.data(), NULL, plan.idx_C_P.data(),
+                                beta, C, ndim_C, len_C, ldc, idx_C);
+    }
+
+    FREE(X_packed);
+    FREE(Y_packed);
+    FREE(C_packed);
+
+    return ret;
+}
+
+template <typename T, typename U, typename W>
+int tensor_contract_dense_gett(const DenseContractPlan& plan,
+                               const U alpha, const T* A, const T* B,
+                               const U beta,        U* C)
+{
+    const int m = plan.m;
+    const int n = plan.n;
+    const int k = plan.k;
+    const std::vector<DenseIndex>& L = plan.L;
+
+    /*
+     * offsets of each row, column, and contracted element in each operand
+     */
+    const std::vector<size_t>& off_A_I = plan.off_A_I;
+    const std::vector<size_t>& off_C_I = plan.off_C_I;
+    const std::vector<size_t>& off_B_J = plan.off_B_J;
+    const std::vector<size_t>& off_C_J = plan.off_C_J;
+    const std::vector<size_t>& off_A_K = plan.off_A_K;
+    const std::vector<size_t>& off_B_K = plan.off_B_K;
+
+    const int mc_max = std::min(m + GETT_MR - 1, (int)GETT_MC) / GETT_MR * GETT_MR;
+    const int nc_max = std::min(n + GETT_NR - 1, (int)GETT_NC) / GETT_NR * GETT_NR;
+    const int kc_max = std::min(k, (int)GETT_KC);
+    const int nthread = ((size_t)m*n*k < GETT_PARALLEL_MIN_WORK ? 1 : tensor_get_num_threads());
+
+    W* Ap = SAFE_MALLOC(W, (size_t)mc_max*kc_max);
+    W* Bp = SAFE_MALLOC(W, (size_t)kc_max*nc_max);
+
+    const int ndim_L = L.size();
+    int pos_L[ndim_L];
+    size_t off_A = 0, off_B = 0, off_C = 0;
+    bool done;
+
+    for (int i = 0;i < ndim_L;i++) pos_L[i] = 0;
+
+    for (done = false;!done;)
+    {
+        for (int jc = 0;jc < n;jc += GETT_NC)
+        {
+            const int nc = std::min((int)GETT_NC, n-jc);
+
+            for (int pc = 0;pc < k;pc += GETT_KC)
+            {
+                const int kc = std::min((int)GETT_KC, k-pc);
+
+                /*
+                 * C is scaled by beta only on the first pass over K
+                 */
+                const U beta_pc = (pc == 0 ? beta : U(1));
+
+                gett_pack_B(B+off_B, &off_B_K[pc], &off_B_J[jc], kc, nc, Bp);
+
+                for (int ic = 0;ic < m;ic += GETT_MC)
+                {
+                    const int mc = std::min((int)GETT_MC, m-ic);
+
+                    gett_pack_A(A+off_A, &off_A_I[ic], &off_A_K[pc], mc, kc, Ap);
+
+                    /*
+                     * each thread updates a disjoint set of NR-column slivers of C
+                     */
+                    #pragma omp parallel for num_threads(nthread) schedule(static) if (nthread > 1)
+                    for (int jr = 0;jr < nc;jr += GETT_NR)
+                    {
+                        const int nr = std::min((int)GETT_NR, nc-jr);
+
+                        for (int ir = 0;ir < mc;ir += GETT_MR)
+                        {
+                            const int mr = std::min((int)GETT_MR, mc-ir);
+
+                            gett_micro_kernel(kc, alpha, Ap+(size_t)ir*kc, Bp+(size_t)jr*kc,
+                                              beta_pc, C+off_C, &off_C_I[ic+ir], &off_C_J[jc+jr], mr, nr);
+                        }
+                    }
+                }
+            }
+        }
+
+        done = true;
+        for (int i = 0;i < ndim_L;i++)
+        {
+            if (pos_L[i] == L[i].len - 1)
+            {
+                pos_L[i] = 0;
+                off_A -= L[i].stride[kDenseOperandA]*(L[i].len-1);
+                off_B -= L[i].stride[kDenseOperandB]*(L[i].len-1);
+                off_C -= L[i].stride[kDenseOperandC]*(L[i].len-1);
+            }
+            else
+            {
+                pos_L[i]++;
+                off_A += L[i].stride[kDenseOperandA];
+                off_B += L[i].stride[kDenseOperandB];
+                off_C += L[i].stride[kDenseOperandC];
+                done = false;
+                break;
+            }
+        }
+    }
+
+    FREE(Ap);
+    FREE(Bp);
+
+    return kTensorReturnCodeSuccess;
+}
+
+bool tensor_is_contraction_dense(const int ndim_A, const int* idx_A,
+                                 const int ndim_B, const int* idx_B,
+                                 const int ndim_C, const int* idx_C)
+{
+    const int  ndim[3] = { ndim_A,  ndim_B,  ndim_C};
+    const int*  idx[3] = {  idx_A,   idx_B,   idx_C};
+
+    for (int op = 0;op < 3;op++)
+    {
+        for (int i = 0;i < ndim[op];i++)
+        {
+            int appears = 0;
+
+            for (int other = 0;other < 3;other++)
+            {
+                int count = 0;
+                for (int j = 0;j < ndim[other];j++)
+                {
+                    if (idx[other][j] == idx[op][i]) count++;
+                }
+
+                /*
+                 * repeated indices (diagonals and traces) are not contractions
+                 */
+                if (count > 1) return false;
+                if (count == 1) appears++;
+            }
+
+            /*
+             * indices in only one tensor (traces and replications) are not contractions
+             */
+            if (appears < 2) return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename T>
+int tensor_contract_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                                          const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                           const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C)
+{
+    return tensor_contract_dense_(alpha, A, ndim_A, len_A, lda, idx_A,
+                                         B, ndim_B, len_B, ldb, idx_B,
+                                  beta,  C, ndim_C, len_C, ldc, idx_C, kTensorContractAuto);
+}
+
+template <typename T>
+int tensor_contract_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                                          const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                           const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+                           const int algorithm)
+{
+    if (!tensor_is_contraction_dense(ndim_A, idx_A, ndim_B, idx_B, ndim_C, idx_C))
+        return kTensorReturnCodeIndexMismatch;
+
+    return tensor_mult_dense_(alpha, A, ndim_A, len_A, lda, idx_A,
+                                     B, ndim_B, len_B, ldb, idx_B,
+                              beta,  C, ndim_C, len_C, ldc, idx_C, algorithm);
+}
+
+#define INSTANTIATE_CONTRACT_DENSE(T) \
+template int tensor_contract_dense_ttgt(const DenseContractPlan& plan, \
+                                        const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A, \
+                                                       const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B, \
+                                        const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C); \
+template int tensor_contract_dense_gett<T,T,T>(const DenseContractPlan& plan, \
+                                               const T alpha, const T* A, const T* B, \
+                                               const T beta,        T* C); \
+template int tensor_contract_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A, \
+                                                   const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B, \
+                                    const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C); \
+template int tensor_contract_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A, \
+                                                   const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B, \
+                                    const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C, \
+                                    const int algorithm);
+
+INSTANTIATE_DENSE_KERNELS(INSTANTIATE_CONTRACT_DENSE)
+
+/*
+ * GETT for the mixed-precision multiplication (see tensor_mult_dense_): operands of type T, a result of type U,
+ * and accumulation in type W, for each combination other than T, U, and W all the same
+ */
+#define INSTANTIATE_GETT_MIXED_DENSE(T,U,W) \
+template int tensor_contract_dense_gett<T,U,W>(const DenseContractPlan& plan, \
+                                               const U alpha, const T* A, const T* B, \
+                                               const U beta,        U* C);
+
+INSTANTIATE_GETT_MIXED_DENSE(float, float, double)
+INSTANTIATE_GETT_MIXED_DENSE(float, double, float)
+INSTANTIATE_GETT_MIXED_DENSE(float, double, double)
+INSTANTIATE_GETT_MIXED_DENSE(std::complex<float>, std::complex<float>, std::complex<double>)
+INSTANTIATE_GETT_MIXED_DENSE(std::complex<float>, std::complex<double>, std::complex<float>)
+INSTANTIATE_GETT_MIXED_DENSE(std::complex<float>, std::complex<double>, std::complex<double>)
+
+}
+}
@@ -0,0 +1,125 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Divide each element of a tensor by a sum of one value per index, A[i_0 i_1 ...] /= d_0[i_0] + d_1[i_1] + ...
+ *
+ * The elements are visited in runs along the first index; for each run, the sum over the other indices is formed
+ * once, so that the inner loop is one addition and one division per element. The runs are divided among threads.
+ */
+
+#include "tensor.h"
+#include <algorithm>
+#include <vector>
+
+namespace ambit {
+namespace tensor {
+
+namespace {
+
+/*
+ * The number of elements along the first index in one unit of work, and the size below which the weighting runs
+ * on a single thread
+ */
+enum { DENOMINATOR_RUN = 8192, DENOMINATOR_PARALLEL_MIN_SIZE = 65536 };
+
+}
+
+template <typename T>
+int tensor_denominator_dense_(T* restrict A, const int ndim_A, const int* restrict len_A, const int* restrict lda,
+                              const T* const* restrict d)
+{
+    int i;
+
+#ifdef VALIDATE_INPUTS
+    VALIDATE_TENSOR(ndim_A, len_A, lda, NULL);
+#endif //VALIDATE_INPUTS
+
+    /*
+     * the denominator of a scalar is an empty sum, so rather than divide by zero it is left unchanged
+     */
+    if (ndim_A == 0) return kTensorReturnCodeSuccess;
+
+    for (i = 0;i < ndim_A;i++)
+    {
+        if (len_A[i] == 0) return kTensorReturnCodeSuccess;
+    }
+
+    std::vector<size_t> stride(ndim_A);
+
+    if (lda == NULL)
+    {
+        stride[0] = 1;
+        for (i = 1;i < ndim_A;i++) stride[i] = stride[i-1]*len_A[i-1];
+    }
+    else
+    {
+        stride[0] = lda[0];
+        for (i = 1;i < ndim_A;i++) stride[i] = stride[i-1]*lda[i];
+    }
+
+    const size_t len_inner = len_A[0];
+    const size_t inc_inner = stride[0];
+    const size_t nrun = (len_inner+DENOMINATOR_RUN-1)/DENOMINATOR_RUN;
+    size_t nouter = 1;
+    for (i = 1;i < ndim_A;i++) nouter *= len_A[i];
+    const size_t nwork = nouter*nrun;
+    const int nthread = (nouter*len_inner < DENOMINATOR_PARALLEL_MIN_SIZE ? 1 : tensor_get_num_threads());
+
+    #pragma omp parallel for num_threads(nthread) schedule(static) if (nthread > 1)
+    for (size_t w = 0;w < nwork;w++)
+    {
+        const size_t run = w%nrun;
+        const size_t first = run*DENOMINATOR_RUN;
+        const size_t n = std::min((size_t)DENOMINATOR_RUN, len_inner-first);
+        size_t outer = w/nrun;
+        size_t off = first*inc_inner;
+        T partial = T(0);
+
+        for (int k = 1;k < ndim_A;k++)
+        {
+            const size_t pos = outer%len_A[k];
+            off += pos*stride[k];
+            partial += d[k][pos];
+            outer /= len_A[k];
+        }
+
+        T* restrict a = A+off;
+        const T* restrict d0 = d[0]+first;
+
+        if (inc_inner == 1)
+        {
+            #pragma omp simd
+            for (size_t k = 0;k < n;k++) a[k] /= partial+d0[k];
+        }
+        else
+        {
+            for (size_t k = 0;k < n;k++) a[k*inc_inner] /= partial+d0[k];
+        }
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+#define INSTANTIATE_DENOMINATOR_DENSE(T) \
+template int tensor_denominator_dense_(T* A, const int ndim_A, const int* len_A, const int* lda, const T* const* d);
+
+INSTANTIATE_DENSE_KERNELS(INSTANTIATE_DENOMINATOR_DENSE)
+
+}
+}
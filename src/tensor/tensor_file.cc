@@ -0,0 +1,340 @@
+/*
+ * Copyright (C) 2013 Devin Matthews
+ *
+ * This is a slimmed down version of the tensor framework developed by
+ * Devin Matthews. The version by Devin was tied to Aquarius. This
+ * version is not.
+ *
+ * Copyright (C) 2013  Justin Turney
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "tensor_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ambit { namespace tensor {
+
+namespace {
+
+const char magic[8] = {'A','M','B','I','T','T','E','N'};
+
+/*
+ * A 64-bit multiply-rotate hash processing four independent lanes of 64-bit words
+ */
+const uint64_t P1 = 11400714785074694791ULL;
+const uint64_t P2 = 14029467366897019727ULL;
+const uint64_t P3 =  1609587929392839161ULL;
+const uint64_t P4 =  9650029242287828579ULL;
+const uint64_t P5 =  2870177450012600261ULL;
+
+inline uint64_t rotl(const uint64_t x, const int r)
+{
+    return (x << r) | (x >> (64-r));
+}
+
+inline uint64_t load64(const unsigned char* p)
+{
+    uint64_t w;
+    memcpy(&w, p, 8);
+    return w;
+}
+
+inline uint64_t mix(const uint64_t acc, const uint64_t w)
+{
+    return rotl(acc + w*P2, 31)*P1;
+}
+
+uint64_t hash(const unsigned char* p, const size_t n, const uint64_t seed)
+{
+    const unsigned char* end = p+n;
+    uint64_t h;
+
+    if (n >= 32)
+    {
+        uint64_t v1 = seed+P1+P2, v2 = seed+P2, v3 = seed, v4 = seed-P1;
+
+        for (;p+32 <= end;p += 32)
+        {
+            v1 = mix(v1, load64(p));
+            v2 = mix(v2, load64(p+8));
+            v3 = mix(v3, load64(p+16));
+            v4 = mix(v4, load64(p+24));
+        }
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    }
+    else
+    {
+        h = seed+P5;
+    }
+
+    h += n;
+
+    for (;p+8 <= end;p += 8)
+    {
+        h ^= mix(0, load64(p));
+        h = rotl(h, 27)*P1 + P4;
+    }
+
+    for (;p < end;p++)
+    {
+        h ^= (*p)*P5;
+        h = rotl(h, 11)*P1;
+    }
+
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+void write_all(const int fd, const void* buf, size_t n, const std::string& path)
+{
+    const char* p = (const char*)buf;
+
+    while (n > 0)
+    {
+        const ssize_t r = write(fd, p, std::min(n, (size_t)1 << 30));
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) throw TensorFileError(path, strerror(errno));
+        p += r;
+        n -= r;
+    }
+}
+
+void read_all(const int fd, void* buf, size_t n, off_t off, const std::string& path)
+{
+    char* p = (char*)buf;
+
+    while (n > 0)
+    {
+        const ssize_t r = pread(fd, p, n, off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) throw TensorFileError(path, "truncated tensor file");
+        p += r;
+        n -= r;
+        off += r;
+    }
+}
+
+}
+
+uint64_t tensor_file_checksum(const void* data, const size_t size)
+{
+    const int64_t nblock = (size+kTensorFileHashBlock-1)/kTensorFileHashBlock;
+    const unsigned char* p = (const unsigned char*)data;
+    std::vector<uint64_t> h(nblock);
+
+    const int nthread = (nblock > 1 ? tensor_get_num_threads() : 1);
+
+    #pragma omp parallel for num_threads(nthread) schedule(static) if (nthread > 1)
+    for (int64_t b = 0;b < nblock;b++)
+    {
+        const size_t off = b*(size_t)kTensorFileHashBlock;
+        h[b] = hash(p+off, std::min((size_t)kTensorFileHashBlock, size-off), b);
+    }
+
+    return hash((const unsigned char*)h.data(), h.size()*sizeof(uint64_t), size);
+}
+
+TensorFileHeader read_tensor_file_header(const std::string& path, std::vector<int>& len, std::vector<int>& ld,
+                                         std::string& name)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw TensorFileError(path, strerror(errno));
+
+    TensorFileHeader header;
+
+    try
+    {
+        struct stat st;
+        if (fstat(fd, &st) != 0) throw TensorFileError(path, strerror(errno));
+
+        read_all(fd, &header, sizeof(header), 0, path);
+
+        if (memcmp(header.magic, magic, sizeof(magic)) != 0) throw TensorFileError(path, "not a tensor file");
+        if (header.version != kTensorFileVersion) throw TensorFileError(path, "unsupported tensor file version");
+        if (header.ndim > 64 || header.name_size > 4096) throw TensorFileError(path, "corrupt tensor file header");
+        if (header.data_offset+header.data_size > (uint64_t)st.st_size) throw TensorFileError(path, "truncated tensor file");
+
+        std::vector<int64_t> dims(2*header.ndim);
+        read_all(fd, dims.data(), dims.size()*sizeof(int64_t), sizeof(header), path);
+        len.assign(dims.begin(), dims.begin()+header.ndim);
+        ld.assign(dims.begin()+header.ndim, dims.end());
+
+        std::vector<char> chars(header.name_size);
+        read_all(fd, chars.data(), chars.size(), sizeof(header)+dims.size()*sizeof(int64_t), path);
+        name.assign(chars.begin(), chars.end());
+    }
+    catch (...)
+    {
+        close(fd);
+        throw;
+    }
+
+    close(fd);
+    return header;
+}
+
+template <typename T>
+void save_tensor(const std::string& path, const DenseTensor<T>& A)
+{
+    const int ndim = A.getDimension();
+    const std::string& name = A.getName();
+
+    /*
+     * the data of a view spans its elements but not the whole of its (parent's) leading dimensions, so that the file
+     * could not be read back; write a compact copy of it instead
+     */
+    if (A.getSize() != (uint64_t)tensor_size_dense(ndim, A.getLengths().data(), A.getLeadingDims().data()))
+    {
+        save_tensor(path, DenseTensor<T>(A));
+        return;
+    }
+
+    TensorFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = kTensorFileVersion;
+    header.dtype = TensorFileType<T>::value;
+    header.elem_size = sizeof(T);
+    header.ndim = ndim;
+    header.name_size = name.size();
+    header.data_size = A.getSize()*sizeof(T);
+
+    const size_t meta = sizeof(header) + 2*ndim*sizeof(int64_t) + name.size();
+    header.data_offset = (meta+kTensorFileAlignment-1)/kTensorFileAlignment*kTensorFileAlignment;
+    header.checksum = tensor_file_checksum(A.get_data(), header.data_size);
+
+    std::vector<char> head(header.data_offset, 0);
+    memcpy(head.data(), &header, sizeof(header));
+
+    for (int i = 0;i < ndim;i++)
+    {
+        const int64_t l = A.getLengths()[i], d = A.getLeadingDims()[i];
+        memcpy(head.data()+sizeof(header)+i*sizeof(int64_t), &l, sizeof(int64_t));
+        memcpy(head.data()+sizeof(header)+(ndim+i)*sizeof(int64_t), &d, sizeof(int64_t));
+    }
+
+    memcpy(head.data()+sizeof(header)+2*ndim*sizeof(int64_t), name.data(), name.size());
+
+    /*
+     * write a temporary file and rename it, so that the file is replaced only once complete
+     */
+    const std::string tmp = path + ".tmp";
+    const int fd = open(tmp.c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if (fd < 0) throw TensorFileError(tmp, strerror(errno));
+
+    try
+    {
+        write_all(fd, head.data(), head.size(), tmp);
+        write_all(fd, A.get_data(), header.data_size, tmp);
+    }
+    catch (...)
+    {
+        close(fd);
+        unlink(tmp.c_str());
+        throw;
+    }
+
+    if (close(fd) != 0 || rename(tmp.c_str(), path.c_str()) != 0)
+    {
+        const std::string problem = strerror(errno);
+        unlink(tmp.c_str());
+        throw TensorFileError(path, problem);
+    }
+}
+
+template <typename T>
+TensorFileMapping<T>::TensorFileMapping(const std::string& path, const bool verify, const bool writable)
+    : file_path(path), map_base(NULL), map_size(0), map_writable(writable)
+{
+    TensorFileHeader header = read_tensor_file_header(path, file_len, file_ld, file_name);
+
+    if (header.dtype != (uint32_t)TensorFileType<T>::value || header.elem_size != sizeof(T))
+        throw TensorFileError(path, "tensor file holds elements of a different type");
+
+    if (header.data_size != DenseTensor<T>::getSize(header.ndim, file_len, file_ld)*sizeof(T))
+        throw TensorFileError(path, "tensor file size does not match its lengths");
+
+    data_offset = header.data_offset;
+    data_size = header.data_size;
+    map_size = data_offset+data_size;
+
+    const int fd = open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+    if (fd < 0) throw TensorFileError(path, strerror(errno));
+
+    /*
+     * a private mapping may be written too, but the changes stay in memory
+     */
+    map_base = mmap(NULL, map_size, PROT_READ|PROT_WRITE, writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+    const int err = errno;
+    close(fd);
+
+    if (map_base == MAP_FAILED) throw TensorFileError(path, strerror(err));
+
+    if (verify && tensor_file_checksum(mapped_data(), data_size) != header.checksum)
+    {
+        munmap(map_base, map_size);
+        throw TensorFileError(path, "checksum mismatch");
+    }
+}
+
+template <typename T>
+TensorFileMapping<T>::~TensorFileMapping()
+{
+    munmap(map_base, map_size);
+}
+
+template <typename T>
+MappedDenseTensor<T>::MappedDenseTensor(const std::string& path, const bool verify, const bool writable)
+    : TensorFileMapping<T>(path, verify, writable),
+      DenseTensor<T>(TensorFileMapping<T>::file_name, TensorFileMapping<T>::file_len,
+                     TensorFileMapping<T>::file_ld, TensorFileMapping<T>::mapped_data(), false) {}
+
+template <typename T>
+void MappedDenseTensor<T>::sync()
+{
+    TensorFileMapping<T>& m = *this;
+
+    if (!m.map_writable) throw TensorFileError(m.file_path, "tensor file is not mapped writable");
+
+    ((TensorFileHeader*)m.map_base)->checksum = tensor_file_checksum(m.mapped_data(), m.data_size);
+
+    if (msync(m.map_base, m.map_size, MS_SYNC) != 0) throw TensorFileError(m.file_path, strerror(errno));
+}
+
+#define INSTANTIATE_SAVE_TENSOR(T) \
+template void save_tensor(const std::string& path, const DenseTensor<T>& A);
+
+INSTANTIATE_DENSE_KERNELS(INSTANTIATE_SAVE_TENSOR)
+
+INSTANTIATE_SPECIALIZATIONS(TensorFileMapping);
+INSTANTIATE_SPECIALIZATIONS(MappedDenseTensor);
+
+}
+}
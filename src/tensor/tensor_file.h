@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2013 Devin Matthews
+ *
+ * This is a slimmed down version of the tensor framework developed by
+ * Devin Matthews. The version by Devin was tied to Aquarius. This
+ * version is not.
+ *
+ * Copyright (C) 2013  Justin Turney
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined(AMBIT_LIB_TENSOR_TENSOR_FILE)
+#define AMBIT_LIB_TENSOR_TENSOR_FILE
+
+#include "dense_tensor.h"
+
+#include <complex>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace ambit {
+
+namespace tensor {
+
+/*
+ * Binary tensor files
+ *
+ * A file holds one dense tensor: a fixed header (TensorFileHeader), the lengths and leading dimensions as 64-bit
+ * integers, the name, and then, starting at the next multiple of kTensorFileAlignment bytes, the elements exactly as
+ * stored in memory (in native byte order). The checksum covers the elements; it is a 64-bit hash of the hashes of
+ * successive blocks of kTensorFileHashBlock bytes, so that it is computed in parallel and is the same for any number
+ * of threads.
+ */
+enum
+{
+    kTensorFileVersion = 1,
+    kTensorFileAlignment = 4096,
+    kTensorFileHashBlock = 1024*1024
+};
+
+enum kTensorFileTypes
+{
+    kTensorFileFloat = 1,
+    kTensorFileDouble = 2,
+    kTensorFileComplexFloat = 3,
+    kTensorFileComplexDouble = 4
+};
+
+/*
+ * The kTensorFileTypes value for elements of type T
+ */
+template <typename T> struct TensorFileType {};
+template <> struct TensorFileType<float>                  { enum { value = kTensorFileFloat }; };
+template <> struct TensorFileType<double>                 { enum { value = kTensorFileDouble }; };
+template <> struct TensorFileType< std::complex<float> >  { enum { value = kTensorFileComplexFloat }; };
+template <> struct TensorFileType< std::complex<double> > { enum { value = kTensorFileComplexDouble }; };
+
+struct TensorFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    uint32_t elem_size;
+    uint32_t ndim;
+    uint32_t name_size;
+    uint32_t reserved;
+    uint64_t data_offset;
+    uint64_t data_size;
+    uint64_t checksum;
+};
+
+/*
+ * Thrown when a tensor file cannot be written or read, or is not a valid tensor file of the expected type
+ */
+class TensorFileError : public TensorError
+{
+public:
+    TensorFileError(const std::string& path, const std::string& problem)
+        : what_(path + ": " + problem) {}
+
+    virtual const char* what() const throw() { return what_.c_str(); }
+
+private:
+    std::string what_;
+};
+
+/*
+ * The checksum of size bytes as stored in a tensor file
+ */
+uint64_t tensor_file_checksum(const void* data, const size_t size);
+
+/*
+ * Read and check the header of a tensor file, and its lengths, leading dimensions, and name
+ */
+TensorFileHeader read_tensor_file_header(const std::string& path, std::vector<int>& len, std::vector<int>& ld,
+                                         std::string& name);
+
+/*
+ * Write A to a tensor file, replacing any existing file; a view whose elements are not contiguous is written as a
+ * compact copy
+ */
+template <typename T>
+void save_tensor(const std::string& path, const DenseTensor<T>& A);
+
+/*
+ * A tensor file mapped into memory (see MappedDenseTensor)
+ */
+template <typename T>
+struct TensorFileMapping
+{
+    std::string file_path;
+    std::string file_name;
+    std::vector<int> file_len;
+    std::vector<int> file_ld;
+    void* map_base;
+    size_t map_size;
+    uint64_t data_offset;
+    uint64_t data_size;
+    bool map_writable;
+
+    TensorFileMapping(const std::string& path, const bool verify, const bool writable);
+    ~TensorFileMapping();
+
+    T* mapped_data() const { return (T*)((char*)map_base + data_offset); }
+
+private:
+    TensorFileMapping(const TensorFileMapping&);
+    TensorFileMapping& operator=(const TensorFileMapping&);
+};
+
+/*
+ * A DenseTensor whose data is a tensor file mapped into memory, so that loading it copies nothing and reads only
+ * the pages that are used
+ *
+ * By default the mapping is private: the tensor may be modified, but the changes are not written to the file. If
+ * writable, changes are written to the file, and sync() updates its checksum and flushes it. If verify, the checksum
+ * is checked when the file is opened, which reads all of it.
+ */
+template <typename T>
+class MappedDenseTensor : private TensorFileMapping<T>, public DenseTensor<T>
+{
+    public:
+        MappedDenseTensor(const std::string& path, const bool verify = true, const bool writable = false);
+
+        void sync();
+};
+
+}
+
+}
+
+#endif
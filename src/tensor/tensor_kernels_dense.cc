@@ -0,0 +1,171 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Contiguous vector kernels for the dense operations, with a generic version and, on x86-64 with GCC-compatible
+ * compilers, AVX2 and AVX-512 versions which are compiled regardless of the build flags and selected at runtime
+ * according to what the processor supports.
+ *
+ * All versions perform the same operations in the same order (no FMA), so the results do not depend on the
+ * instruction set.
+ */
+
+#include "tensor_kernels_dense.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define AMBIT_VECTOR_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace ambit {
+namespace tensor {
+
+namespace {
+
+#if defined(AMBIT_VECTOR_DISPATCH)
+
+/*
+ * Define the three kernels for one instruction set, given its vector type, width, and intrinsics
+ */
+#define DENSE_VECTOR_KERNELS(isa, flags,  vec, width, set1, setzero, loadu, storeu, add, mul)                   \
+__attribute__((target(flags)))                                                                                  \
+void isa##_scale(const size_t n, const double alpha, double* restrict A)                                        \
+{                                                                                                               \
+    const vec valpha = set1(alpha);                                                                             \
+    size_t i = 0;                                                                                               \
+                                                                                                                \
+    if (alpha == 0.0)                                                                                           \
+    {                                                                                                           \
+        for (;i+width <= n;i += width) storeu(A+i, setzero());                                                  \
+        for (;i < n;i++) A[i] = 0.0;                                                                            \
+    }                                                                                                           \
+    else                                                                                                        \
+    {                                                                                                           \
+        for (;i+width <= n;i += width) storeu(A+i, mul(valpha, loadu(A+i)));                                    \
+        for (;i < n;i++) A[i] *= alpha;                                                                         \
+    }                                                                                                           \
+}                                                                                                               \
+                                                                                                                \
+__attribute__((target(flags)))                                                                                  \
+void isa##_axpby(const size_t n, const double alpha, const double* restrict A,                                  \
+                 const double beta, double* restrict B)                                                         \
+{                                                                                                               \
+    const vec valpha = set1(alpha);                                                                             \
+    const vec vbeta = set1(beta);                                                                               \
+    size_t i = 0;                                                                                               \
+                                                                                                                \
+    if (beta == 0.0)                                                                                            \
+    {                                                                                                           \
+        for (;i+width <= n;i += width) storeu(B+i, mul(valpha, loadu(A+i)));                                    \
+        for (;i < n;i++) B[i] = alpha*A[i];                                                                     \
+    }                                                                                                           \
+    else if (beta == 1.0)                                                                                       \
+    {                                                                                                           \
+        for (;i+width <= n;i += width) storeu(B+i, add(loadu(B+i), mul(valpha, loadu(A+i))));                   \
+        for (;i < n;i++) B[i] += alpha*A[i];                                                                    \
+    }                                                                                                           \
+    else                                                                                                        \
+    {                                                                                                           \
+        for (;i+width <= n;i += width) storeu(B+i, add(mul(valpha, loadu(A+i)), mul(vbeta, loadu(B+i))));       \
+        for (;i < n;i++) B[i] = alpha*A[i] + beta*B[i];                                                         \
+    }                                                                                                           \
+}                                                                                                               \
+                                                                                                                \
+__attribute__((target(flags)))                                                                                  \
+void isa##_mul(const size_t n, const double alpha, const double* restrict A, const double* restrict B,          \
+               const double beta, double* restrict C)                                                           \
+{                                                                                                               \
+    const vec valpha = set1(alpha);                                                                             \
+    const vec vbeta = set1(beta);                                                                               \
+    size_t i = 0;                                                                                               \
+                                                                                                                \
+    if (beta == 0.0)                                                                                            \
+    {                                                                                                           \
+        for (;i+width <= n;i += width) storeu(C+i, mul(valpha, mul(loadu(A+i), loadu(B+i))));                   \
+        for (;i < n;i++) C[i] = alpha*(A[i]*B[i]);                                                              \
+    }                                                                                                           \
+    else if (beta == 1.0)                                                                                       \
+    {                                                                                                           \
+        for (;i+width <= n;i += width)                                                                          \
+            storeu(C+i, add(loadu(C+i), mul(valpha, mul(loadu(A+i), loadu(B+i)))));                             \
+        for (;i < n;i++) C[i] += alpha*(A[i]*B[i]);                                                             \
+    }                                                                                                           \
+    else                                                                                                        \
+    {                                                                                                           \
+        for (;i+width <= n;i += width)                                                                          \
+            storeu(C+i, add(mul(valpha, mul(loadu(A+i), loadu(B+i))), mul(vbeta, loadu(C+i))));                 \
+        for (;i < n;i++) C[i] = alpha*(A[i]*B[i]) + beta*C[i];                                                  \
+    }                                                                                                           \
+}
+
+DENSE_VECTOR_KERNELS(avx2, "avx2", __m256d, 4, _mm256_set1_pd, _mm256_setzero_pd,
+                     _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, _mm256_mul_pd)
+
+DENSE_VECTOR_KERNELS(avx512, "avx512f", __m512d, 8, _mm512_set1_pd, _mm512_setzero_pd,
+                     _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, _mm512_mul_pd)
+
+#undef DENSE_VECTOR_KERNELS
+
+#endif //AMBIT_VECTOR_DISPATCH
+
+const DenseVectorKernels kernels[] =
+{
+    {vector_scale_generic<double>, vector_axpby_generic<double>, vector_mul_generic<double>},
+#if defined(AMBIT_VECTOR_DISPATCH)
+    {avx2_scale, avx2_axpby, avx2_mul},
+    {avx512_scale, avx512_axpby, avx512_mul},
+#else
+    {vector_scale_generic<double>, vector_axpby_generic<double>, vector_mul_generic<double>},
+    {vector_scale_generic<double>, vector_axpby_generic<double>, vector_mul_generic<double>},
+#endif
+};
+
+int best_vector_isa()
+{
+#if defined(AMBIT_VECTOR_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return kTensorVectorAVX512;
+    if (__builtin_cpu_supports("avx2")) return kTensorVectorAVX2;
+#endif
+    return kTensorVectorGeneric;
+}
+
+const int max_vector_isa = best_vector_isa();
+int vector_isa = max_vector_isa;
+
+}
+
+void tensor_set_vector_isa(const int isa)
+{
+    vector_isa = std::max((int)kTensorVectorGeneric, std::min(isa, max_vector_isa));
+}
+
+int tensor_get_vector_isa()
+{
+    return vector_isa;
+}
+
+const DenseVectorKernels& tensor_vector_kernels()
+{
+    return kernels[vector_isa];
+}
+
+}
+}
@@ -0,0 +1,142 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined(AMBIT_LIB_TENSOR_TENSOR_KERNELS_DENSE)
+#define AMBIT_LIB_TENSOR_TENSOR_KERNELS_DENSE
+
+#include "tensor.h"
+
+namespace ambit {
+namespace tensor {
+
+/*
+ * Kernels over n contiguous elements, used for the unit-stride innermost loops of the dense operations
+ *
+ * Each kernel tests alpha and beta once and then runs a loop specialized for beta == 0 (B is not read),
+ * beta == 1, or general beta. The instruction set is chosen at runtime (see tensor_set_vector_isa).
+ */
+struct DenseVectorKernels
+{
+    /* A = alpha*A */
+    void (*scale)(const size_t n, const double alpha, double* A);
+
+    /* B = alpha*A + beta*B */
+    void (*axpby)(const size_t n, const double alpha, const double* A, const double beta, double* B);
+
+    /* C = alpha*A*B + beta*C */
+    void (*mul)(const size_t n, const double alpha, const double* A, const double* B, const double beta, double* C);
+};
+
+const DenseVectorKernels& tensor_vector_kernels();
+
+/*
+ * Portable versions of the kernels for any element type
+ */
+template <typename T>
+inline void vector_scale_generic(const size_t n, const T alpha, T* restrict A)
+{
+    if (alpha == T(0))
+    {
+        for (size_t i = 0;i < n;i++) A[i] = T(0);
+    }
+    else
+    {
+        for (size_t i = 0;i < n;i++) A[i] *= alpha;
+    }
+}
+
+template <typename T>
+inline void vector_axpby_generic(const size_t n, const T alpha, const T* restrict A, const T beta, T* restrict B)
+{
+    if (beta == T(0))
+    {
+        for (size_t i = 0;i < n;i++) B[i] = alpha*A[i];
+    }
+    else if (beta == T(1))
+    {
+        for (size_t i = 0;i < n;i++) B[i] += alpha*A[i];
+    }
+    else
+    {
+        for (size_t i = 0;i < n;i++) B[i] = alpha*A[i] + beta*B[i];
+    }
+}
+
+template <typename T>
+inline void vector_mul_generic(const size_t n, const T alpha, const T* restrict A, const T* restrict B,
+                               const T beta, T* restrict C)
+{
+    if (beta == T(0))
+    {
+        for (size_t i = 0;i < n;i++) C[i] = alpha*(A[i]*B[i]);
+    }
+    else if (beta == T(1))
+    {
+        for (size_t i = 0;i < n;i++) C[i] += alpha*(A[i]*B[i]);
+    }
+    else
+    {
+        for (size_t i = 0;i < n;i++) C[i] = alpha*(A[i]*B[i]) + beta*C[i];
+    }
+}
+
+/*
+ * The kernels for element type T: the runtime-dispatched ones for double, and the portable ones otherwise
+ */
+template <typename T>
+struct DenseVector
+{
+    static void scale(const size_t n, const T alpha, T* A)
+    {
+        vector_scale_generic(n, alpha, A);
+    }
+
+    static void axpby(const size_t n, const T alpha, const T* A, const T beta, T* B)
+    {
+        vector_axpby_generic(n, alpha, A, beta, B);
+    }
+
+    static void mul(const size_t n, const T alpha, const T* A, const T* B, const T beta, T* C)
+    {
+        vector_mul_generic(n, alpha, A, B, beta, C);
+    }
+};
+
+template <>
+struct DenseVector<double>
+{
+    static void scale(const size_t n, const double alpha, double* A)
+    {
+        tensor_vector_kernels().scale(n, alpha, A);
+    }
+
+    static void axpby(const size_t n, const double alpha, const double* A, const double beta, double* B)
+    {
+        tensor_vector_kernels().axpby(n, alpha, A, beta, B);
+    }
+
+    static void mul(const size_t n, const double alpha, const double* A, const double* B, const double beta, double* C)
+    {
+        tensor_vector_kernels().mul(n, alpha, A, B, beta, C);
+    }
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,102 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined(AMBIT_LIB_TENSOR_TENSOR_LOOPS_DENSE)
+#define AMBIT_LIB_TENSOR_TENSOR_LOOPS_DENSE
+
+#include <cstddef>
+
+namespace ambit {
+namespace tensor {
+
+/*
+ * The largest number of indices in a group for which the dense kernels have a specialized loop nest; groups
+ * with more indices use the generic odometer loops
+ */
+enum { kDenseMaxUnrolledRank = 6 };
+
+/*
+ * A loop nest of fixed depth N over a group of indices, tracking the offsets of up to three tensors
+ *
+ * body(off_A, off_B, off_C) is called for every element, with index 0 varying fastest. The depth is a template
+ * parameter so that the loops are fully expanded at compile time and the lengths and strides can be kept in
+ * registers.
+ */
+template <int N>
+struct DenseLoop
+{
+    template <class Body>
+    static inline void run(const int* len, const size_t* inc_A, const size_t* inc_B, const size_t* inc_C,
+                           const size_t off_A, const size_t off_B, const size_t off_C, Body& body)
+    {
+        const int n = len[N-1];
+        const size_t ia = inc_A[N-1];
+        const size_t ib = inc_B[N-1];
+        const size_t ic = inc_C[N-1];
+
+        for (int i = 0;i < n;i++)
+        {
+            DenseLoop<N-1>::run(len, inc_A, inc_B, inc_C, off_A+i*ia, off_B+i*ib, off_C+i*ic, body);
+        }
+    }
+};
+
+template <>
+struct DenseLoop<0>
+{
+    template <class Body>
+    static inline void run(const int*, const size_t*, const size_t*, const size_t*,
+                           const size_t off_A, const size_t off_B, const size_t off_C, Body& body)
+    {
+        body(off_A, off_B, off_C);
+    }
+};
+
+/*
+ * Copy the lengths and strides of a group into fixed-size arrays (with unused strides set to zero)
+ */
+template <int N>
+struct DenseGroup
+{
+    int len[N > 0 ? N : 1];
+    size_t inc_A[N > 0 ? N : 1];
+    size_t inc_B[N > 0 ? N : 1];
+    size_t inc_C[N > 0 ? N : 1];
+
+    DenseGroup(const int* len_, const size_t* inc_A_, const size_t* inc_B_, const size_t* inc_C_)
+    {
+        for (int i = 0;i < N;i++)
+        {
+            len[i] = len_[i];
+            inc_A[i] = (inc_A_ == NULL ? 0 : inc_A_[i]);
+            inc_B[i] = (inc_B_ == NULL ? 0 : inc_B_[i]);
+            inc_C[i] = (inc_C_ == NULL ? 0 : inc_C_[i]);
+        }
+    }
+
+    template <class Body>
+    void run(const size_t off_A, const size_t off_B, const size_t off_C, Body& body) const
+    {
+        DenseLoop<N>::run(len, inc_A, inc_B, inc_C, off_A, off_B, off_C, body);
+    }
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,347 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined(AMBIT_LIB_TENSOR_TENSOR_MAP_DENSE)
+#define AMBIT_LIB_TENSOR_TENSOR_MAP_DENSE
+
+#include "tensor.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace ambit {
+namespace tensor {
+
+/*
+ * Elementwise maps
+ *
+ * C[i] = alpha*f(A_0[i], ..., A_{N-1}[i]) + beta*C[i] for every element i, with one to four operands of the same
+ * lengths as C (any of which may be C itself). f is any functor or lambda taking N values of type T and returning a
+ * T. It is inlined into loops over contiguous runs, which the compiler vectorizes when f allows it, and the runs are
+ * divided among tensor_get_num_threads() threads. C is not read when beta is zero.
+ */
+enum { kDenseMapRun = 4096, kDenseMapParallelMinSize = 65536 };
+
+template <int N> struct DenseMapCall;
+
+template <>
+struct DenseMapCall<1>
+{
+    template <typename T, class F>
+    static auto apply(F& f, const T* const* A, const size_t i) -> decltype(f(A[0][i]))
+    {
+        return f(A[0][i]);
+    }
+
+    template <typename T, class F>
+    static auto apply(F& f, const T* const* A, const size_t* inc, const size_t i) -> decltype(f(A[0][i*inc[0]]))
+    {
+        return f(A[0][i*inc[0]]);
+    }
+};
+
+template <>
+struct DenseMapCall<2>
+{
+    template <typename T, class F>
+    static auto apply(F& f, const T* const* A, const size_t i) -> decltype(f(A[0][i], A[1][i]))
+    {
+        return f(A[0][i], A[1][i]);
+    }
+
+    template <typename T, class F>
+    static auto apply(F& f, const T* const* A, const size_t* inc, const size_t i) -> decltype(f(A[0][i*inc[0]], A[1][i*inc[1]]))
+    {
+        return f(A[0][i*inc[0]], A[1][i*inc[1]]);
+    }
+};
+
+template <>
+struct DenseMapCall<3>
+{
+    template <typename T, class F>
+    static auto apply(F& f, const T* const* A, const size_t i) -> decltype(f(A[0][i], A[1][i], A[2][i]))
+    {
+        return f(A[0][i], A[1][i], A[2][i]);
+    }
+
+    template <typename T, class F>
+    static auto apply(F& f, const T* const* A, const size_t* inc, const size_t i) -> decltype(f(A[0][i*inc[0]], A[1][i*inc[1]], A[2][i*inc[2]]))
+    {
+        return f(A[0][i*inc[0]], A[1][i*inc[1]], A[2][i*inc[2]]);
+    }
+};
+
+template <>
+struct DenseMapCall<4>
+{
+    template <typename T, class F>
+    static auto apply(F& f, const T* const* A, const size_t i) -> decltype(f(A[0][i], A[1][i], A[2][i], A[3][i]))
+    {
+        return f(A[0][i], A[1][i], A[2][i], A[3][i]);
+    }
+
+    template <typename T, class F>
+    static auto apply(F& f, const T* const* A, const size_t* inc, const size_t i) -> decltype(f(A[0][i*inc[0]], A[1][i*inc[1]], A[2][i*inc[2]], A[3][i*inc[3]]))
+    {
+        return f(A[0][i*inc[0]], A[1][i*inc[1]], A[2][i*inc[2]], A[3][i*inc[3]]);
+    }
+};
+
+/*
+ * The map over n contiguous elements, specialized for beta == 0, beta == 1, and general beta
+ *
+ * C may be the same as an operand, since element i of C is only written after element i of each operand is read.
+ */
+template <int N, typename T, class F>
+inline void tensor_map_run_(const size_t n, const T alpha, F& f, const T* const* A, const T beta, T* C)
+{
+    const T* p[N];
+    for (int k = 0;k < N;k++) p[k] = A[k];
+
+    if (beta == T(0))
+    {
+        #pragma omp simd
+        for (size_t i = 0;i < n;i++) C[i] = alpha*DenseMapCall<N>::apply(f, p, i);
+    }
+    else if (beta == T(1))
+    {
+        #pragma omp simd
+        for (size_t i = 0;i < n;i++) C[i] += alpha*DenseMapCall<N>::apply(f, p, i);
+    }
+    else
+    {
+        #pragma omp simd
+        for (size_t i = 0;i < n;i++) C[i] = alpha*DenseMapCall<N>::apply(f, p, i) + beta*C[i];
+    }
+}
+
+/*
+ * The map over n elements with strides inc (for the operands) and inc_C
+ */
+template <int N, typename T, class F>
+inline void tensor_map_run_(const size_t n, const T alpha, F& f, const T* const* A, const size_t* inc,
+                            const T beta, T* C, const size_t inc_C)
+{
+    for (size_t i = 0;i < n;i++)
+    {
+        const T val = alpha*DenseMapCall<N>::apply(f, A, inc, i);
+        C[i*inc_C] = (beta == T(0) ? val : val + beta*C[i*inc_C]);
+    }
+}
+
+/*
+ * The map over a tensor of ndim indices with lengths len, where inc[k] are the strides of operand k and inc[N]
+ * those of C
+ */
+template <int N, typename T, class F>
+void tensor_map_strided_(const T alpha, F& f, const T* const* A, const T beta, T* C,
+                         const int ndim, const size_t* len, const size_t* const* inc)
+{
+    std::vector<size_t> len_fused(ndim);
+    std::vector<size_t> inc_fused[N+1];
+    int ndim_fused = 0;
+
+    for (int k = 0;k <= N;k++) inc_fused[k].resize(ndim);
+
+    for (int i = 0;i < ndim;i++) if (len[i] == 0) return;
+
+    /*
+     * fuse indices which are contiguous with the previous one in every tensor, so that the innermost loop runs
+     * over as many contiguous elements as possible
+     */
+    for (int i = 0;i < ndim;i++)
+    {
+        bool fuse = (ndim_fused > 0);
+        for (int k = 0;k <= N && fuse;k++)
+            fuse = (inc[k][i] == inc_fused[k][ndim_fused-1]*len_fused[ndim_fused-1]);
+
+        if (fuse)
+        {
+            len_fused[ndim_fused-1] *= len[i];
+        }
+        else
+        {
+            len_fused[ndim_fused] = len[i];
+            for (int k = 0;k <= N;k++) inc_fused[k][ndim_fused] = inc[k][i];
+            ndim_fused++;
+        }
+    }
+
+    const size_t len_inner = (ndim_fused > 0 ? len_fused[0] : 1);
+    bool contiguous = true;
+    size_t inc_inner[N+1];
+    for (int k = 0;k <= N;k++)
+    {
+        inc_inner[k] = (ndim_fused > 0 ? inc_fused[k][0] : 1);
+        if (inc_inner[k] != 1) contiguous = false;
+    }
+
+    const size_t nrun = (len_inner+kDenseMapRun-1)/kDenseMapRun;
+    size_t nouter = 1;
+    for (int i = 1;i < ndim_fused;i++) nouter *= len_fused[i];
+    const size_t nwork = nouter*nrun;
+    const int nthread = (nouter*len_inner < kDenseMapParallelMinSize ? 1 : tensor_get_num_threads());
+
+    /*
+     * loop over runs of up to kDenseMapRun elements along the innermost index
+     */
+    #pragma omp parallel for num_threads(nthread) schedule(static) if (nthread > 1)
+    for (size_t w = 0;w < nwork;w++)
+    {
+        const size_t run = w%nrun;
+        const size_t n = std::min((size_t)kDenseMapRun, len_inner-run*kDenseMapRun);
+        size_t outer = w/nrun;
+        size_t off[N+1];
+
+        for (int k = 0;k <= N;k++) off[k] = run*kDenseMapRun*inc_inner[k];
+
+        for (int i = 1;i < ndim_fused;i++)
+        {
+            const size_t pos = outer%len_fused[i];
+            for (int k = 0;k <= N;k++) off[k] += pos*inc_fused[k][i];
+            outer /= len_fused[i];
+        }
+
+        const T* p[N];
+        for (int k = 0;k < N;k++) p[k] = A[k]+off[k];
+
+        if (contiguous)
+        {
+            tensor_map_run_<N>(n, alpha, f, p, beta, C+off[N]);
+        }
+        else
+        {
+            tensor_map_run_<N>(n, alpha, f, p, inc_inner, beta, C+off[N], inc_inner[N]);
+        }
+    }
+}
+
+/*
+ * The map over dense tensors with lengths len and leading dimensions lda[k] (for operand k) and ldc, as in the
+ * other dense kernels (NULL for a tensor without padding)
+ */
+template <int N, typename T, class F>
+int tensor_map_dense_(const T alpha, F f, const T* const* A, const int* const* lda,
+                      const T beta, T* C, const int ndim, const int* len, const int* ldc)
+{
+    std::vector<size_t> len_(len, len+ndim);
+    std::vector<size_t> stride[N+1];
+    const size_t* inc[N+1];
+
+    for (int k = 0;k <= N;k++)
+    {
+        const int* ld = (k < N ? lda[k] : ldc);
+
+        stride[k].resize(ndim);
+
+        for (int i = 0;i < ndim;i++)
+        {
+            const size_t step = (ld == NULL ? (i == 0 ? 1 : len[i-1]) : ld[i]);
+            stride[k][i] = (i == 0 ? 1 : stride[k][i-1])*step;
+        }
+
+        inc[k] = stride[k].data();
+    }
+
+    tensor_map_strided_<N>(alpha, f, A, beta, C, ndim, len_.data(), inc);
+
+    return kTensorReturnCodeSuccess;
+}
+
+/*
+ * The map over n contiguous elements (such as the local data of a distributed tensor)
+ */
+template <int N, typename T, class F>
+int tensor_map_dense_(const T alpha, F f, const T* const* A, const T beta, T* C, const size_t n)
+{
+    size_t one[N+1];
+    const size_t* inc[N+1];
+
+    for (int k = 0;k <= N;k++)
+    {
+        one[k] = 1;
+        inc[k] = &one[k];
+    }
+
+    tensor_map_strided_<N>(alpha, f, A, beta, C, 1, &n, inc);
+
+    return kTensorReturnCodeSuccess;
+}
+
+/*
+ * Reductions
+ *
+ * op(init, f(A_0[0], ...), f(A_0[1], ...), ...) over n contiguous elements, where op is an associative combining
+ * functor such as a sum or maximum. Each run of kDenseMapRun elements is reduced with four independent partial
+ * results, and the results of the runs are combined in order, so that the value does not depend on the number of
+ * threads. The partial results start from elements rather than from init, which is combined only once and so need
+ * not be an identity of op.
+ */
+template <int N, typename R, typename T, class F, class Op>
+R tensor_map_reduce_dense_(F f, Op op, const R init, const T* const* A, const size_t n)
+{
+    const size_t nrun = (n+kDenseMapRun-1)/kDenseMapRun;
+    const int nthread = (n < kDenseMapParallelMinSize ? 1 : tensor_get_num_threads());
+    std::vector<R> partial(nrun);
+
+    #pragma omp parallel for num_threads(nthread) schedule(static) if (nthread > 1)
+    for (size_t w = 0;w < nrun;w++)
+    {
+        const size_t first = w*kDenseMapRun;
+        const size_t m = std::min((size_t)kDenseMapRun, n-first);
+        const T* p[N];
+
+        for (int k = 0;k < N;k++) p[k] = A[k]+first;
+
+        if (m < 4)
+        {
+            R r = DenseMapCall<N>::apply(f, p, 0);
+            for (size_t i = 1;i < m;i++) r = op(r, DenseMapCall<N>::apply(f, p, i));
+            partial[w] = r;
+            continue;
+        }
+
+        R r[4] = {DenseMapCall<N>::apply(f, p, 0), DenseMapCall<N>::apply(f, p, 1),
+                  DenseMapCall<N>::apply(f, p, 2), DenseMapCall<N>::apply(f, p, 3)};
+        size_t i = 4;
+
+        for (;i+4 <= m;i += 4)
+        {
+            r[0] = op(r[0], DenseMapCall<N>::apply(f, p, i));
+            r[1] = op(r[1], DenseMapCall<N>::apply(f, p, i+1));
+            r[2] = op(r[2], DenseMapCall<N>::apply(f, p, i+2));
+            r[3] = op(r[3], DenseMapCall<N>::apply(f, p, i+3));
+        }
+
+        for (;i < m;i++) r[0] = op(r[0], DenseMapCall<N>::apply(f, p, i));
+
+        partial[w] = op(op(r[0], r[1]), op(r[2], r[3]));
+    }
+
+    R val = init;
+    for (size_t w = 0;w < nrun;w++) val = op(val, partial[w]);
+
+    return val;
+}
+
+}
+}
+
+#endif
@@ -35,621 +35,657 @@
  * \date Oct. 1 2011
  */
 
+
 #include "tensor.h"
+#include "tensor_kernels_dense.h"
+#include "tensor_loops_dense.h"
+#include "tensor_plan_dense.h"
 #include "util.h"
+#include <util/memory.h>
 #include <string.h>
+#include <algorithm>
 
 namespace ambit {
 namespace tensor {
 
-int tensor_mult_dense_(const double alpha, const double* restrict A, const int ndim_A, const int* restrict len_A, const int* restrict lda, const int* restrict idx_A,
-                                           const double* restrict B, const int ndim_B, const int* restrict len_B, const int* restrict ldb, const int* restrict idx_B,
-                       const double beta,        double* restrict C, const int ndim_C, const int* restrict len_C, const int* restrict ldc, const int* restrict idx_C)
-{
-    int i, j;
-    bool found, done_A, done_B, done_AB, done_C, done_ABC;
-    double temp, temp_A, temp_B;
-    int ndim_uniq_AB;
-    int ndim_uniq_A;
-    int ndim_uniq_B;
-    int ndim_uniq_C;
-    int ndim_uniq_ABC;
-    int len_uniq_AB[ndim_A+ndim_B];
-    int len_uniq_A[ndim_A];
-    int len_uniq_B[ndim_B];
-    int len_uniq_C[ndim_C];
-    int len_uniq_ABC[ndim_A+ndim_B+ndim_C];
-    size_t stride_A[ndim_A];
-    size_t stride_B[ndim_B];
-    size_t stride_C[ndim_C];
-    size_t off_A, off_B, off_C;
-    size_t inc_A_AB[ndim_A+ndim_B];
-    size_t inc_B_AB[ndim_A+ndim_B];
-    size_t inc_A_A[ndim_A];
-    size_t inc_B_B[ndim_B];
-    size_t inc_C_C[ndim_C];
-    size_t inc_A_ABC[ndim_A+ndim_B+ndim_C];
-    size_t inc_B_ABC[ndim_A+ndim_B+ndim_C];
-    size_t inc_C_ABC[ndim_A+ndim_B+ndim_C];
-    size_t size_A, size_B, size_C;
-    int pos_AB[ndim_A+ndim_B];
-    int pos_A[ndim_A];
-    int pos_B[ndim_B];
-    int pos_C[ndim_C];
-    int pos_ABC[ndim_A+ndim_B+ndim_C];
+namespace {
 
-#ifdef VALIDATE_INPUTS
-    VALIDATE_TENSOR(ndim_A, len_A, lda, NULL);
-    VALIDATE_TENSOR(ndim_B, len_B, ldb, NULL);
-    VALIDATE_TENSOR(ndim_C, len_C, ldc, NULL);
-#endif //VALIDATE_INPUTS
+/*
+ * Below this many multiply-adds an operation is not worth splitting across threads
+ */
+enum { kLoopParallelMinWork = 32768 };
 
-    if (lda == NULL)
-    {
-        if (ndim_A > 0) stride_A[0] = 1;
-        for (i = 1;i < ndim_A;i++) stride_A[i] = stride_A[i-1]*len_A[i-1];
-    }
-    else
-    {
-        if (ndim_A > 0) stride_A[0] = lda[0];
-        for (i = 1;i < ndim_A;i++) stride_A[i] = stride_A[i-1]*lda[i];
-    }
+int mixed_accumulation = kTensorAccumulateDouble;
 
-    if (ldb == NULL)
-    {
-        if (ndim_B > 0) stride_B[0] = 1;
-        for (i = 1;i < ndim_B;i++) stride_B[i] = stride_B[i-1]*len_B[i-1];
-    }
-    else
-    {
-        if (ndim_B > 0) stride_B[0] = ldb[0];
-        for (i = 1;i < ndim_B;i++) stride_B[i] = stride_B[i-1]*ldb[i];
-    }
+size_t loop_size(const std::vector<int>& len)
+{
+    size_t size = 1;
+    for (size_t i = 0;i < len.size();i++) size *= len[i];
+    return size;
+}
 
-    if (ldc == NULL)
-    {
-        if (ndim_C > 0) stride_C[0] = 1;
-        for (i = 1;i < ndim_C;i++) stride_C[i] = stride_C[i-1]*len_C[i-1];
-    }
-    else
+/*
+ * Position the odometer pos over a group of indices at linear element n, adding the corresponding
+ * offsets to off_0, off_1, and off_2 (inc_1 and inc_2 may be NULL)
+ */
+void loop_seek(const std::vector<int>& len, size_t n, int* pos,
+               const size_t* inc_0, size_t& off_0,
+               const size_t* inc_1, size_t& off_1,
+               const size_t* inc_2, size_t& off_2)
+{
+    for (size_t i = 0;i < len.size();i++)
     {
-        if (ndim_C > 0) stride_C[0] = ldc[0];
-        for (i = 1;i < ndim_C;i++) stride_C[i] = stride_C[i-1]*ldc[i];
-    }
+        pos[i] = n%len[i];
+        n /= len[i];
 
-    if (ndim_A > 0)
-    {
-        size_A = stride_A[ndim_A-1]*len_A[ndim_A-1];
-    }
-    else
-    {
-        size_A = 1;
+        off_0 += pos[i]*inc_0[i];
+        if (inc_1 != NULL) off_1 += pos[i]*inc_1[i];
+        if (inc_2 != NULL) off_2 += pos[i]*inc_2[i];
     }
+}
 
-    if (ndim_B > 0)
-    {
-        size_B = stride_B[ndim_B-1]*len_B[ndim_B-1];
-    }
-    else
-    {
-        size_B = 1;
-    }
+/*
+ * Sum the products of the elements of A and B over elements [begin,end) of the AB group, for fixed
+ * starting offsets in A and B, accumulating in type W
+ */
+template <typename T, typename W>
+int loop_sum_AB(const DenseLoopPlan& plan, const T* restrict A, const T* restrict B,
+                size_t off_A, size_t off_B, const size_t begin, const size_t end, W& temp)
+{
+    int i;
+    bool done_A, done_B;
+    W temp_A, temp_B;
+    const int ndim_uniq_AB = plan.len_AB.size();
+    const int ndim_uniq_A = plan.len_A.size();
+    const int ndim_uniq_B = plan.len_B.size();
+    const int* len_uniq_AB = plan.len_AB.data();
+    const int* len_uniq_A = plan.len_A.data();
+    const int* len_uniq_B = plan.len_B.data();
+    const size_t* inc_A_AB = plan.inc_A_AB.data();
+    const size_t* inc_B_AB = plan.inc_B_AB.data();
+    const size_t* inc_A_A = plan.inc_A_A.data();
+    const size_t* inc_B_B = plan.inc_B_B.data();
+    int pos_AB[ndim_uniq_AB];
+    int pos_A[ndim_uniq_A];
+    int pos_B[ndim_uniq_B];
+    size_t unused = 0;
 
-    if (ndim_C > 0)
-    {
-        size_C = stride_C[ndim_C-1]*len_C[ndim_C-1];
-    }
-    else
-    {
-        size_C = 1;
-    }
+    memset(pos_A, 0, ndim_uniq_A*sizeof(int));
+    memset(pos_B, 0, ndim_uniq_B*sizeof(int));
 
-    ndim_uniq_A = 0;
-    ndim_uniq_B = 0;
-    ndim_uniq_C = 0;
-    ndim_uniq_AB = 0;
-    ndim_uniq_ABC = 0;
-    memset(inc_A_A, 0, ndim_A*sizeof(size_t));
-    memset(inc_B_B, 0, ndim_B*sizeof(size_t));
-    memset(inc_C_C, 0, ndim_C*sizeof(size_t));
-    memset(inc_A_AB, 0, (ndim_A+ndim_B)*sizeof(size_t));
-    memset(inc_B_AB, 0, (ndim_A+ndim_B)*sizeof(size_t));
-    memset(inc_A_ABC, 0, (ndim_A+ndim_B+ndim_C)*sizeof(size_t));
-    memset(inc_B_ABC, 0, (ndim_A+ndim_B+ndim_C)*sizeof(size_t));
-    memset(inc_C_ABC, 0, (ndim_A+ndim_B+ndim_C)*sizeof(size_t));
+    loop_seek(plan.len_AB, begin, pos_AB, inc_A_AB, off_A, inc_B_AB, off_B, NULL, unused);
+
+    temp = W(0);
 
     /*
-     * sort the indices into five groups: A only, B only, C only, A, B and C, and A and B only
+     * with no traced indices, each run along the first AB index is a plain strided dot product
      */
-    for (i = 0;i < ndim_C;i++)
+    if (ndim_uniq_A == 0 && ndim_uniq_B == 0 && ndim_uniq_AB > 0)
     {
-        found = false;
+        const size_t inc_A0 = inc_A_AB[0];
+        const size_t inc_B0 = inc_B_AB[0];
 
-        for (j = i+1;j < ndim_C;j++)
+        for (size_t n = begin;n < end;)
         {
-            if (idx_C[i] == idx_C[j])
-            {
-#ifdef VALIDATE_INPUTS
-                if (len_C[i] != len_C[j]) return TENSOR_LENGTH_MISMATCH;
-#endif //VALIDATE_INPUTS
-                found = true;
-#ifndef VALIDATE_INPUTS
-                break;
-#endif //VALIDATE_INPUTS
-            }
-        }
+            const int run = (int)std::min((size_t)(len_uniq_AB[0]-pos_AB[0]), end-n);
 
-#ifndef VALIDATE_INPUTS
-        if (!found) {
-#endif //VALIDATE_INPUTS
-        for (j = 0;j < ndim_A;j++)
-        {
-            if (idx_C[i] == idx_A[j])
+#ifdef CHECK_BOUNDS
+            if (off_A+(run-1)*inc_A0 >= plan.size_A) return kTensorReturnCodeOutOfBounds;
+            if (off_B+(run-1)*inc_B0 >= plan.size_B) return kTensorReturnCodeOutOfBounds;
+#endif //CHECK_BOUNDS
+
+            if (inc_A0 == 1 && inc_B0 == 1)
             {
-#ifdef VALIDATE_INPUTS
-                if (len_C[i] != len_A[j]) return TENSOR_LENGTH_MISMATCH;
-#endif //VALIDATE_INPUTS
-                found = true;
-#ifndef VALIDATE_INPUTS
-                break;
-#endif //VALIDATE_INPUTS
+                for (int j = 0;j < run;j++) temp += W(A[off_A+j])*W(B[off_B+j]);
             }
-        }
-#ifndef VALIDATE_INPUTS
-        }
-#endif //VALIDATE_INPUTS
-
-#ifndef VALIDATE_INPUTS
-        if (!found) {
-#endif //VALIDATE_INPUTS
-        for (j = 0;j < ndim_B;j++)
-        {
-            if (idx_C[i] == idx_B[j])
+            else
             {
-#ifdef VALIDATE_INPUTS
-                if (len_C[i] != len_B[j]) return TENSOR_LENGTH_MISMATCH;
-#endif //VALIDATE_INPUTS
-                found = true;
-#ifndef VALIDATE_INPUTS
-                break;
-#endif //VALIDATE_INPUTS
+                for (int j = 0;j < run;j++) temp += W(A[off_A+j*inc_A0])*W(B[off_B+j*inc_B0]);
             }
-        }
-#ifndef VALIDATE_INPUTS
-        }
-#endif //VALIDATE_INPUTS
 
-        /*
-         * idx_C[i] is in C but not A or B
-         */
-        if (!found)
-        {
-            len_uniq_C[ndim_uniq_C] = len_C[i];
+            n += run;
+            off_A -= pos_AB[0]*inc_A0;
+            off_B -= pos_AB[0]*inc_B0;
+            pos_AB[0] = 0;
 
-            for (j = 0;j <= i;j++)
+            for (i = 1;i < ndim_uniq_AB;i++)
             {
-                if (idx_C[j] == idx_C[i]) inc_C_C[ndim_uniq_C] += stride_C[j];
+                if (pos_AB[i] < len_uniq_AB[i] - 1)
+                {
+                    pos_AB[i]++;
+                    off_A += inc_A_AB[i];
+                    off_B += inc_B_AB[i];
+                    break;
+                }
+                else
+                {
+                    pos_AB[i] = 0;
+                    off_A -= inc_A_AB[i]*(len_uniq_AB[i]-1);
+                    off_B -= inc_B_AB[i]*(len_uniq_AB[i]-1);
+                }
             }
-
-            ndim_uniq_C++;
         }
+
+        return kTensorReturnCodeSuccess;
     }
 
-    for (i = 0;i < ndim_A;i++)
+    /*
+     * loop over elements in A and B to be summed onto this element of C
+     */
+    for (size_t n = begin;n < end;n++)
     {
-        found = false;
-
-        for (j = i+1;j < ndim_A;j++)
-        {
-            if (idx_A[i] == idx_A[j])
-            {
-#ifdef VALIDATE_INPUTS
-                if (len_A[i] != len_A[j]) return TENSOR_LENGTH_MISMATCH;
-#endif //VALIDATE_INPUTS
-                found = true;
-#ifndef VALIDATE_INPUTS
-                break;
-#endif //VALIDATE_INPUTS
-            }
-        }
-
-#ifndef VALIDATE_INPUTS
-        if (!found) {
-#endif //VALIDATE_INPUTS
-        for (j = 0;j < ndim_B;j++)
-        {
-            if (idx_A[i] == idx_B[j])
-            {
-#ifdef VALIDATE_INPUTS
-                if (len_A[i] != len_B[j]) return TENSOR_LENGTH_MISMATCH;
-#endif //VALIDATE_INPUTS
-                found = true;
-#ifndef VALIDATE_INPUTS
-                break;
-#endif //VALIDATE_INPUTS
-            }
-        }
-#ifndef VALIDATE_INPUTS
-        }
-#endif //VALIDATE_INPUTS
+        temp_A = W(0);
 
         /*
-         * idx_A[i] is unique among A and B
+         * loop over elements in A to be summed onto this element of C
          */
-        if (!found)
+        for (done_A = false;!done_A;)
         {
-            found = false;
+#ifdef CHECK_BOUNDS
+            if (off_A < 0 || off_A >= plan.size_A) return kTensorReturnCodeOutOfBounds;
+#endif //CHECK_BOUNDS
 
-            for (j = 0;j < ndim_C;j++)
-            {
-                if (idx_C[j] == idx_A[i])
-                {
-                    found = true;
-                    break;
-                }
-            }
+            temp_A += W(A[off_A]);
 
-            /*
-             * idx_A[i] is in A, B, and C
-             */
-            if (found)
+            for (i = 0;i < ndim_uniq_A;i++)
             {
-                len_uniq_ABC[ndim_uniq_ABC] = len_A[i];
-
-                for (j = 0;j < ndim_A;j++)
+                if (pos_A[i] == len_uniq_A[i] - 1)
                 {
-                    if (idx_A[j] == idx_A[i]) inc_A_ABC[ndim_uniq_ABC] += stride_A[j];
-                }
-
-                for (j = 0;j < ndim_B;j++)
-                {
-                    if (idx_B[j] == idx_A[i]) inc_B_ABC[ndim_uniq_ABC] += stride_B[j];
-                }
-
-                for (j = 0;j < ndim_C;j++)
-                {
-                    if (idx_C[j] == idx_A[i]) inc_C_ABC[ndim_uniq_ABC] += stride_C[j];
-                }
-
-                ndim_uniq_ABC++;
-            }
-            else
-            {
-                found = false;
+                    pos_A[i] = 0;
+                    off_A -= inc_A_A[i]*(len_uniq_A[i]-1);
 
-                for (j = 0;j < ndim_B;j++)
-                {
-                    if (idx_B[j] == idx_A[i])
+                    if (i == ndim_uniq_A - 1)
                     {
-                        found = true;
+                        done_A = true;
                         break;
                     }
                 }
-
-                /*
-                 * idx_A[i] is in A and B but not C
-                 */
-                if (found)
-                {
-                    len_uniq_AB[ndim_uniq_AB] = len_A[i];
-
-                    for (j = 0;j < ndim_A;j++)
-                    {
-                        if (idx_A[j] == idx_A[i]) inc_A_AB[ndim_uniq_AB] += stride_A[j];
-                    }
-
-                    for (j = 0;j < ndim_B;j++)
-                    {
-                        if (idx_B[j] == idx_A[i]) inc_B_AB[ndim_uniq_AB] += stride_B[j];
-                    }
-
-                    ndim_uniq_AB++;
-                }
-                /*
-                 * idx_A[i] is in A, but not B or C
-                 */
                 else
                 {
-                    len_uniq_A[ndim_uniq_A] = len_A[i];
-
-                    for (j = 0;j < ndim_A;j++)
-                    {
-                        if (idx_A[j] == idx_A[i]) inc_A_A[ndim_uniq_A] += stride_A[j];
-                    }
-
-                    ndim_uniq_A++;
+                    pos_A[i]++;
+                    off_A += inc_A_A[i];
+                    break;
                 }
             }
-        }
-    }
-
-    for (i = 0;i < ndim_B;i++)
-    {
-        found = false;
 
-        for (j = i+1;j < ndim_B;j++)
-        {
-            if (idx_B[i] == idx_B[j])
-            {
-#ifdef VALIDATE_INPUTS
-                if (len_B[i] != len_B[j]) return TENSOR_LENGTH_MISMATCH;
-#endif //VALIDATE_INPUTS
-                found = true;
-#ifndef VALIDATE_INPUTS
-                break;
-#endif //VALIDATE_INPUTS
-            }
+            if (ndim_uniq_A == 0) done_A = true;
         }
+        /*
+         * end loop over A
+         */
+
+        temp_B = W(0);
 
         /*
-         * idx_B[i] is unique among A and B
+         * loop over elements in B to be summed onto this element of C
          */
-        if (!found)
+        for (done_B = false;!done_B;)
         {
-            found = false;
+#ifdef CHECK_BOUNDS
+            if (off_B < 0 || off_B >= plan.size_B) return kTensorReturnCodeOutOfBounds;
+#endif //CHECK_BOUNDS
 
-            for (j = 0;j < ndim_C;j++)
-            {
-                if (idx_C[j] == idx_B[i])
-                {
-                    found = true;
-                    break;
-                }
-            }
+            temp_B += W(B[off_B]);
 
-            /*
-             * idx_B[i] is in A, B, and C
-             */
-            if (found)
+            for (i = 0;i < ndim_uniq_B;i++)
             {
-                len_uniq_ABC[ndim_uniq_ABC] = len_B[i];
-
-                for (j = 0;j < ndim_A;j++)
-                {
-                    if (idx_A[j] == idx_B[i]) inc_A_ABC[ndim_uniq_ABC] += stride_A[j];
-                }
-
-                for (j = 0;j < ndim_B;j++)
-                {
-                    if (idx_B[j] == idx_B[i]) inc_B_ABC[ndim_uniq_ABC] += stride_B[j];
-                }
-
-                for (j = 0;j < ndim_C;j++)
+                if (pos_B[i] == len_uniq_B[i] - 1)
                 {
-                    if (idx_C[j] == idx_B[i]) inc_C_ABC[ndim_uniq_ABC] += stride_C[j];
-                }
-
-                ndim_uniq_ABC++;
-            }
-            else
-            {
-                found = false;
+                    pos_B[i] = 0;
+                    off_B -= inc_B_B[i]*(len_uniq_B[i]-1);
 
-                for (j = 0;j < ndim_A;j++)
-                {
-                    if (idx_A[j] == idx_B[i])
+                    if (i == ndim_uniq_B - 1)
                     {
-                        found = true;
+                        done_B = true;
                         break;
                     }
                 }
-
-                /*
-                 * idx_B[i] is in A and B but not C
-                 */
-                if (found)
-                {
-                    len_uniq_AB[ndim_uniq_AB] = len_B[i];
-
-                    for (j = 0;j < ndim_A;j++)
-                    {
-                        if (idx_A[j] == idx_B[i]) inc_A_AB[ndim_uniq_AB] += stride_A[j];
-                    }
-
-                    for (j = 0;j < ndim_B;j++)
-                    {
-                        if (idx_B[j] == idx_B[i]) inc_B_AB[ndim_uniq_AB] += stride_B[j];
-                    }
-
-                    ndim_uniq_AB++;
-                }
-                /*
-                 * idx_B[i] is in B but not A or C
-                 */
                 else
                 {
-                    len_uniq_B[ndim_uniq_B] = len_B[i];
-
-                    for (j = 0;j < ndim_B;j++)
-                    {
-                        if (idx_B[j] == idx_B[i]) inc_B_B[ndim_uniq_B] += stride_B[j];
-                    }
-
-                    ndim_uniq_B++;
+                    pos_B[i]++;
+                    off_B += inc_B_B[i];
+                    break;
                 }
             }
-        }
-    }
 
-    off_A = 0;
-    off_B = 0;
-    off_C = 0;
+            if (ndim_uniq_B == 0) done_B = true;
+        }
+        /*
+         * end loop over B
+         */
 
-    memset(pos_ABC, 0, ndim_uniq_ABC*sizeof(int));
-    memset(pos_AB, 0, ndim_uniq_AB*sizeof(int));
-    memset(pos_A, 0, ndim_uniq_A*sizeof(int));
-    memset(pos_B, 0, ndim_uniq_B*sizeof(int));
-    memset(pos_C, 0, ndim_uniq_C*sizeof(int));
+        temp += temp_A*temp_B;
 
+        for (i = 0;i < ndim_uniq_AB;i++)
+        {
+            if (pos_AB[i] < len_uniq_AB[i] - 1)
+            {
+                pos_AB[i]++;
+                off_A += inc_A_AB[i];
+                off_B += inc_B_AB[i];
+                break;
+            }
+            else
+            {
+                pos_AB[i] = 0;
+                off_A -= inc_A_AB[i]*(len_uniq_AB[i]-1);
+                off_B -= inc_B_AB[i]*(len_uniq_AB[i]-1);
+            }
+        }
+    }
     /*
-     * loop over elements in the first replicate of C (will also change off_A and off_B)
+     * end loop over AB
      */
-    for (done_ABC = false;!done_ABC;)
-    {
-        temp = 0.0;
 
-        /*
-         * loop over elements in A an B to be summed onto this element of C
-         */
-        for (done_AB = false;!done_AB;)
-        {
-            temp_A = 0.0;
+    return kTensorReturnCodeSuccess;
+}
 
-            /*
-             * loop over elements in A to be summed onto this element of C
-             */
-            for (done_A = false;!done_A;)
-            {
+/*
+ * Store temp into every replicate of one element of C
+ */
+template <typename T>
+int loop_store_C(const DenseLoopPlan& plan, const T temp, const T beta, T* restrict C, size_t off_C)
+{
+    int i;
+    bool done_C;
+    const int ndim_uniq_C = plan.len_C.size();
+    const int* len_uniq_C = plan.len_C.data();
+    const size_t* inc_C_C = plan.inc_C_C.data();
+    int pos_C[ndim_uniq_C];
+
+    if (ndim_uniq_C == 0)
+    {
 #ifdef CHECK_BOUNDS
-                if (off_A < 0 || off_A >= size_A) return TENSOR_OUT_OF_BOUNDS;
+        if (off_C >= plan.size_C) return kTensorReturnCodeOutOfBounds;
 #endif //CHECK_BOUNDS
 
-                temp_A += A[off_A];
+        C[off_C] = (beta == T(0) ? temp : temp + beta*C[off_C]);
+        return kTensorReturnCodeSuccess;
+    }
 
-                for (i = 0;i < ndim_uniq_A;i++)
-                {
-                    if (pos_A[i] == len_uniq_A[i] - 1)
-                    {
-                        pos_A[i] = 0;
-                        off_A -= inc_A_A[i]*(len_uniq_A[i]-1);
-
-                        if (i == ndim_uniq_A - 1)
-                        {
-                            done_A = true;
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        pos_A[i]++;
-                        off_A += inc_A_A[i];
-                        break;
-                    }
-                }
+    const int len_C0 = len_uniq_C[0];
+    const size_t inc_C0 = inc_C_C[0];
 
-                if (ndim_uniq_A == 0) done_A = true;
-            }
-            /*
-             * end loop over A
-             */
+    memset(pos_C, 0, ndim_uniq_C*sizeof(int));
 
-            temp_B = 0.0;
+    /*
+     * loop over replicates of C, a whole run along the first replicated index at a time
+     */
+    for (done_C = false;!done_C;)
+    {
+#ifdef CHECK_BOUNDS
+        if (off_C+(len_C0-1)*inc_C0 >= plan.size_C) return kTensorReturnCodeOutOfBounds;
+#endif //CHECK_BOUNDS
 
-            /*
-             * loop over elements in B to be summed onto this element of C
-             */
-            for (done_B = false;!done_B;)
+        if (beta == T(0))
+        {
+            for (int k = 0;k < len_C0;k++) C[off_C+k*inc_C0] = temp;
+        }
+        else
+        {
+            for (int k = 0;k < len_C0;k++) C[off_C+k*inc_C0] = temp + beta*C[off_C+k*inc_C0];
+        }
+
+        done_C = true;
+        for (i = 1;i < ndim_uniq_C;i++)
+        {
+            if (pos_C[i] == len_uniq_C[i] - 1)
             {
-#ifdef CHECK_BOUNDS
-                if (off_B < 0 || off_B >= size_B) return TENSOR_OUT_OF_BOUNDS;
-#endif //CHECK_BOUNDS
+                pos_C[i] = 0;
+                off_C -= inc_C_C[i]*(len_uniq_C[i]-1);
+            }
+            else
+            {
+                pos_C[i]++;
+                off_C += inc_C_C[i];
+                done_C = false;
+                break;
+            }
+        }
+    }
+    /*
+     * end loop over C
+     */
 
-                temp_B += B[off_B];
+    return kTensorReturnCodeSuccess;
+}
 
-                for (i = 0;i < ndim_uniq_B;i++)
-                {
-                    if (pos_B[i] == len_uniq_B[i] - 1)
-                    {
-                        pos_B[i] = 0;
-                        off_B -= inc_B_B[i]*(len_uniq_B[i]-1);
-
-                        if (i == ndim_uniq_B - 1)
-                        {
-                            done_B = true;
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        pos_B[i]++;
-                        off_B += inc_B_B[i];
-                        break;
-                    }
-                }
+/*
+ * The contiguous kernels for operands of type T and a result of type U, with products formed in type W: the
+ * dense vector kernels when all three types are the same, and plain loops otherwise
+ */
+template <typename T, typename U, typename W>
+struct LoopVector
+{
+    static void axpby(const size_t n, const U alpha, const T* restrict A, const U beta, U* restrict C)
+    {
+        if (beta == U(0))
+        {
+            for (size_t i = 0;i < n;i++) C[i] = alpha*U(A[i]);
+        }
+        else
+        {
+            for (size_t i = 0;i < n;i++) C[i] = alpha*U(A[i]) + beta*C[i];
+        }
+    }
 
-                if (ndim_uniq_B == 0) done_B = true;
-            }
-            /*
-             * end loop over B
-             */
+    static void mul(const size_t n, const U alpha, const T* restrict A, const T* restrict B,
+                    const U beta, U* restrict C)
+    {
+        if (beta == U(0))
+        {
+            for (size_t i = 0;i < n;i++) C[i] = alpha*U(W(A[i])*W(B[i]));
+        }
+        else
+        {
+            for (size_t i = 0;i < n;i++) C[i] = alpha*U(W(A[i])*W(B[i])) + beta*C[i];
+        }
+    }
+};
 
-            temp += temp_A*temp_B;
+template <typename T>
+struct LoopVector<T,T,T>
+{
+    static void axpby(const size_t n, const T alpha, const T* A, const T beta, T* C)
+    {
+        DenseVector<T>::axpby(n, alpha, A, beta, C);
+    }
 
-            for (i = 0;i < ndim_uniq_AB;i++)
-            {
-                if (pos_AB[i] < len_uniq_AB[i] - 1)
-                {
-                    pos_AB[i]++;
-                    off_A += inc_A_AB[i];
-                    off_B += inc_B_AB[i];
-                    break;
-                }
-                else
-                {
-                    pos_AB[i] = 0;
-                    off_A -= inc_A_AB[i]*(len_uniq_AB[i]-1);
-                    off_B -= inc_B_AB[i]*(len_uniq_AB[i]-1);
+    static void mul(const size_t n, const T alpha, const T* A, const T* B, const T beta, T* C)
+    {
+        DenseVector<T>::mul(n, alpha, A, B, beta, C);
+    }
+};
 
-                    if (i == ndim_uniq_AB - 1)
-                    {
-                        done_AB = true;
-                        break;
-                    }
-                }
-            }
+/*
+ * Compute elements [begin,end) of the ABC group of C when there are no other indices and the first ABC index
+ * is contiguous in C, so that each run along it is an elementwise product (or, when it does not appear in one of
+ * A and B, a scaled copy) which can be vectorized
+ */
+template <typename T, typename U, typename W>
+int loop_range_vector(const DenseLoopPlan& plan,
+                      const U alpha, const T* restrict A, const T* restrict B,
+                      const U beta,        U* restrict C,
+                      const size_t begin, const size_t end)
+{
+    int i;
+    const int ndim_uniq_ABC = plan.len_ABC.size();
+    const int* len_uniq_ABC = plan.len_ABC.data();
+    const size_t* inc_A_ABC = plan.inc_A_ABC.data();
+    const size_t* inc_B_ABC = plan.inc_B_ABC.data();
+    const size_t* inc_C_ABC = plan.inc_C_ABC.data();
+    const size_t inc_A0 = inc_A_ABC[0];
+    const size_t inc_B0 = inc_B_ABC[0];
+    size_t off_A, off_B, off_C;
+    int pos_ABC[ndim_uniq_ABC];
 
-            if (ndim_uniq_AB == 0) done_AB = true;
-        }
-        /*
-         * end loop over AB
-         */
+    off_A = 0;
+    off_B = 0;
+    off_C = 0;
 
-        temp *= alpha;
+    loop_seek(plan.len_ABC, begin, pos_ABC, inc_A_ABC, off_A, inc_B_ABC, off_B, inc_C_ABC, off_C);
+
+    for (size_t n = begin;n < end;)
+    {
+        const size_t run = std::min((size_t)(len_uniq_ABC[0]-pos_ABC[0]), end-n);
 
-        /*
-         * loop over replicates of C
-         */
-        for (done_C = false;!done_C;)
-        {
 #ifdef CHECK_BOUNDS
-            if (off_C < 0 || off_C >= size_C) return TENSOR_OUT_OF_BOUNDS;
+        if (off_C+run-1 >= plan.size_C) return kTensorReturnCodeOutOfBounds;
 #endif //CHECK_BOUNDS
 
-            if (beta == 0.0)
+        if (inc_A0 == 1 && inc_B0 == 1)
+        {
+            LoopVector<T,U,W>::mul(run, alpha, A+off_A, B+off_B, beta, C+off_C);
+        }
+        else if (inc_A0 == 1)
+        {
+            LoopVector<T,U,W>::axpby(run, alpha*U(B[off_B]), A+off_A, beta, C+off_C);
+        }
+        else
+        {
+            LoopVector<T,U,W>::axpby(run, alpha*U(A[off_A]), B+off_B, beta, C+off_C);
+        }
+
+        n += run;
+        off_A -= pos_ABC[0]*inc_A0;
+        off_B -= pos_ABC[0]*inc_B0;
+        off_C -= pos_ABC[0];
+        pos_ABC[0] = 0;
+
+        for (i = 1;i < ndim_uniq_ABC;i++)
+        {
+            if (pos_ABC[i] == len_uniq_ABC[i] - 1)
             {
-                C[off_C] = temp;
+                pos_ABC[i] = 0;
+                off_A -= inc_A_ABC[i]*(len_uniq_ABC[i]-1);
+                off_B -= inc_B_ABC[i]*(len_uniq_ABC[i]-1);
+                off_C -= inc_C_ABC[i]*(len_uniq_ABC[i]-1);
             }
             else
             {
-                C[off_C] = temp + beta*C[off_C];
+                pos_ABC[i]++;
+                off_A += inc_A_ABC[i];
+                off_B += inc_B_ABC[i];
+                off_C += inc_C_ABC[i];
+                break;
             }
+        }
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+/*
+ * Whether the operation is a weighting (or outer product) whose first ABC index is contiguous in C and in A
+ * or B, so that loop_range_vector applies
+ */
+bool loop_is_vector(const DenseLoopPlan& plan)
+{
+    return plan.len_A.empty() && plan.len_B.empty() && plan.len_AB.empty() && plan.len_C.empty() &&
+           !plan.len_ABC.empty() && plan.inc_C_ABC[0] == 1 &&
+           (plan.inc_A_ABC[0] == 1 || plan.inc_B_ABC[0] == 1) &&
+           plan.inc_A_ABC[0] <= 1 && plan.inc_B_ABC[0] <= 1;
+}
+
+/*
+ * Whether the operation has only ABC and AB indices, each group of at most kDenseMaxUnrolledRank, so that
+ * one of the rank-specialized kernels below applies
+ */
+bool loop_is_unrolled(const DenseLoopPlan& plan)
+{
+    return plan.len_A.empty() && plan.len_B.empty() && plan.len_C.empty() &&
+           plan.len_ABC.size() <= kDenseMaxUnrolledRank && plan.len_AB.size() <= kDenseMaxUnrolledRank;
+}
+
+/*
+ * Sum A*B over the AB group
+ */
+template <typename T, typename W>
+struct LoopDotBody
+{
+    const T* restrict A;
+    const T* restrict B;
+    W sum;
+
+    inline void operator()(const size_t off_A, const size_t off_B, const size_t off_C)
+    {
+        sum += W(A[off_A])*W(B[off_B]);
+    }
+};
+
+/*
+ * For one element of the ABC group, sum over the AB group and store to C
+ */
+template <int NAB, bool BETA_ZERO, typename T, typename U, typename W>
+struct LoopStoreBody
+{
+    const DenseGroup<NAB>& AB;
+    const T* restrict A;
+    const T* restrict B;
+    U* restrict C;
+    U alpha, beta;
+
+    inline void operator()(const size_t off_A, const size_t off_B, const size_t off_C)
+    {
+        LoopDotBody<T,W> dot = {A, B, W(0)};
+        AB.run(off_A, off_B, 0, dot);
+
+        if (BETA_ZERO)
+        {
+            C[off_C] = alpha*U(dot.sum);
+        }
+        else
+        {
+            C[off_C] = alpha*U(dot.sum) + beta*C[off_C];
+        }
+    }
+};
+
+/*
+ * Rank-specialized kernel for NABC ABC indices and NAB AB indices, restricted to [lo,hi) of the last
+ * (slowest) ABC index
+ */
+template <int NABC, int NAB, bool BETA_ZERO, typename T, typename U, typename W>
+void loop_unrolled_kernel(const DenseLoopPlan& plan,
+                          const U alpha, const T* restrict A, const T* restrict B,
+                          const U beta,        U* restrict C, const int lo, const int hi)
+{
+    DenseGroup<NABC> ABC(plan.len_ABC.data(), plan.inc_A_ABC.data(), plan.inc_B_ABC.data(), plan.inc_C_ABC.data());
+    DenseGroup<NAB> AB(plan.len_AB.data(), plan.inc_A_AB.data(), plan.inc_B_AB.data(), NULL);
+    LoopStoreBody<NAB,BETA_ZERO,T,U,W> body = {AB, A, B, C, alpha, beta};
+    size_t off_A = 0, off_B = 0, off_C = 0;
+
+    if (NABC > 0)
+    {
+        const int last = (NABC > 0 ? NABC-1 : 0);
+        ABC.len[last] = hi-lo;
+        off_A = lo*ABC.inc_A[last];
+        off_B = lo*ABC.inc_B[last];
+        off_C = lo*ABC.inc_C[last];
+    }
+
+    ABC.run(off_A, off_B, off_C, body);
+}
+
+template <int NABC, bool BETA_ZERO, typename T, typename U, typename W>
+void loop_unrolled_AB(const DenseLoopPlan& plan,
+                      const U alpha, const T* restrict A, const T* restrict B,
+                      const U beta,        U* restrict C, const int lo, const int hi)
+{
+    switch (plan.len_AB.size())
+    {
+        case 0: loop_unrolled_kernel<NABC,0,BETA_ZERO,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+        case 1: loop_unrolled_kernel<NABC,1,BETA_ZERO,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+        case 2: loop_unrolled_kernel<NABC,2,BETA_ZERO,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+        case 3: loop_unrolled_kernel<NABC,3,BETA_ZERO,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+        case 4: loop_unrolled_kernel<NABC,4,BETA_ZERO,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+        case 5: loop_unrolled_kernel<NABC,5,BETA_ZERO,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+        case 6: loop_unrolled_kernel<NABC,6,BETA_ZERO,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+    }
+}
+
+template <int NABC, typename T, typename U, typename W>
+void loop_unrolled_beta(const DenseLoopPlan& plan,
+                        const U alpha, const T* restrict A, const T* restrict B,
+                        const U beta,        U* restrict C, const int lo, const int hi)
+{
+    if (beta == U(0))
+    {
+        loop_unrolled_AB<NABC,true,T,U,W>(plan, alpha, A, B, beta, C, lo, hi);
+    }
+    else
+    {
+        loop_unrolled_AB<NABC,false,T,U,W>(plan, alpha, A, B, beta, C, lo, hi);
+    }
+}
+
+/*
+ * Dispatch to the kernel specialized on the ranks of the ABC and AB groups (loop_is_unrolled must hold)
+ */
+template <typename T, typename U, typename W>
+void loop_unrolled(const DenseLoopPlan& plan,
+                   const U alpha, const T* restrict A, const T* restrict B,
+                   const U beta,        U* restrict C, const int lo, const int hi)
+{
+    switch (plan.len_ABC.size())
+    {
+        case 0: loop_unrolled_beta<0,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+        case 1: loop_unrolled_beta<1,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+        case 2: loop_unrolled_beta<2,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+        case 3: loop_unrolled_beta<3,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+        case 4: loop_unrolled_beta<4,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+        case 5: loop_unrolled_beta<5,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+        case 6: loop_unrolled_beta<6,T,U,W>(plan, alpha, A, B, beta, C, lo, hi); break;
+    }
+}
+
+/*
+ * Compute elements [begin,end) of the ABC group of C, optionally splitting the sum over the AB group
+ * of each element across nthread threads
+ */
+template <typename T, typename U, typename W>
+int loop_range(const DenseLoopPlan& plan,
+               const U alpha, const T* restrict A, const T* restrict B,
+               const U beta,        U* restrict C,
+               const size_t begin, const size_t end, const int nthread)
+{
+    int i, ret;
+    W temp;
+    const int ndim_uniq_ABC = plan.len_ABC.size();
+    const int* len_uniq_ABC = plan.len_ABC.data();
+    const size_t* inc_A_ABC = plan.inc_A_ABC.data();
+    const size_t* inc_B_ABC = plan.inc_B_ABC.data();
+    const size_t* inc_C_ABC = plan.inc_C_ABC.data();
+    const size_t size_AB = loop_size(plan.len_AB);
+    size_t off_A, off_B, off_C;
+    int pos_ABC[ndim_uniq_ABC];
+    std::vector<W> partial(nthread > 1 ? nthread : 0);
+
+    if (loop_is_vector(plan))
+    {
+        return loop_range_vector<T,U,W>(plan, alpha, A, B, beta, C, begin, end);
+    }
+
+    off_A = 0;
+    off_B = 0;
+    off_C = 0;
 
-            for (i = 0;i < ndim_uniq_C;i++)
+    loop_seek(plan.len_ABC, begin, pos_ABC, inc_A_ABC, off_A, inc_B_ABC, off_B, inc_C_ABC, off_C);
+
+    /*
+     * loop over elements in the first replicate of C (will also change off_A and off_B)
+     */
+    for (size_t n = begin;n < end;n++)
+    {
+        if (nthread > 1)
+        {
+            /*
+             * reduction mode: each thread sums over a contiguous part of the AB group, and the partial
+             * sums are added in thread order (OpenMP has no built-in reduction for complex types)
+             */
+            ret = kTensorReturnCodeSuccess;
+
+            #pragma omp parallel num_threads(nthread) reduction(min:ret)
             {
-                if (pos_C[i] == len_uniq_C[i] - 1)
-                {
-                    pos_C[i] = 0;
-                    off_C -= inc_C_C[i]*(len_uniq_C[i]-1);
+                const int tid = tensor_thread_num();
+                const int nt = tensor_thread_count();
 
-                    if (i == ndim_uniq_C - 1)
-                    {
-                        done_C = true;
-                        break;
-                    }
-                }
-                else
-                {
-                    pos_C[i]++;
-                    off_C += inc_C_C[i];
-                    break;
-                }
+                partial[tid] = W(0);
+                ret = loop_sum_AB(plan, A, B, off_A, off_B,
+                                  size_AB*tid/nt, size_AB*(tid+1)/nt, partial[tid]);
             }
 
-            if (ndim_uniq_C == 0) done_C = true;
+            temp = W(0);
+            for (i = 0;i < nthread;i++) temp += partial[i];
         }
-        /*
-         * end loop over C
-         */
+        else
+        {
+            ret = loop_sum_AB(plan, A, B, off_A, off_B, 0, size_AB, temp);
+        }
+        if (ret != kTensorReturnCodeSuccess) return ret;
+
+        ret = loop_store_C(plan, alpha*U(temp), beta, C, off_C);
+        if (ret != kTensorReturnCodeSuccess) return ret;
 
         for (i = 0;i < ndim_uniq_ABC;i++)
         {
@@ -659,12 +695,6 @@ int tensor_mult_dense_(const double alpha, const double* restrict A, const int n
                 off_A -= inc_A_ABC[i]*(len_uniq_ABC[i]-1);
                 off_B -= inc_B_ABC[i]*(len_uniq_ABC[i]-1);
                 off_C -= inc_C_ABC[i]*(len_uniq_ABC[i]-1);
-
-                if (i == ndim_uniq_ABC - 1)
-                {
-                    done_ABC = true;
-                    break;
-                }
             }
             else
             {
@@ -675,8 +705,6 @@ int tensor_mult_dense_(const double alpha, const double* restrict A, const int n
                 break;
             }
         }
-
-        if (ndim_uniq_ABC == 0) done_ABC = true;
     }
     /*
      * end loop over ABC
@@ -685,5 +713,275 @@ int tensor_mult_dense_(const double alpha, const double* restrict A, const int n
     return kTensorReturnCodeSuccess;
 }
 
+}
+
+template <typename T>
+int tensor_mult_dense_(const T alpha, const T* restrict A, const int ndim_A, const int* restrict len_A, const int* restrict lda, const int* restrict idx_A,
+                                      const T* restrict B, const int ndim_B, const int* restrict len_B, const int* restrict ldb, const int* restrict idx_B,
+                       const T beta,        T* restrict C, const int ndim_C, const int* restrict len_C, const int* restrict ldc, const int* restrict idx_C)
+{
+    return tensor_mult_dense_(alpha, A, ndim_A, len_A, lda, idx_A,
+                                     B, ndim_B, len_B, ldb, idx_B,
+                              beta,  C, ndim_C, len_C, ldc, idx_C, kTensorContractAuto);
+}
+
+template <typename T>
+int tensor_mult_dense_(const T alpha, const T* restrict A, const int ndim_A, const int* restrict len_A, const int* restrict lda, const int* restrict idx_A,
+                                      const T* restrict B, const int ndim_B, const int* restrict len_B, const int* restrict ldb, const int* restrict idx_B,
+                       const T beta,        T* restrict C, const int ndim_C, const int* restrict len_C, const int* restrict ldc, const int* restrict idx_C,
+                       const int algorithm)
+{
+    DenseMultPlanPtr plan;
+    int ret;
+
+#ifdef VALIDATE_INPUTS
+    VALIDATE_TENSOR(ndim_A, len_A, lda, NULL);
+    VALIDATE_TENSOR(ndim_B, len_B, ldb, NULL);
+    VALIDATE_TENSOR(ndim_C, len_C, ldc, NULL);
+#endif //VALIDATE_INPUTS
+
+    ret = tensor_plan_mult_dense(ndim_A, len_A, lda, idx_A,
+                                 ndim_B, len_B, ldb, idx_B,
+                                 ndim_C, len_C, ldc, idx_C, sizeof(T), algorithm, plan);
+    if (ret != kTensorReturnCodeSuccess) return ret;
+
+    /*
+     * an automatically chosen TTGT whose scratch would not fit in what is left of the memory budget falls back to
+     * GETT (the plan is cached, so this is checked on every call)
+     */
+    if (algorithm == kTensorContractAuto && plan->algorithm == kTensorContractTTGT &&
+        plan->contract.scratch*sizeof(T) > util::ambit_memory_available())
+    {
+        ret = tensor_plan_mult_dense(ndim_A, len_A, lda, idx_A,
+                                     ndim_B, len_B, ldb, idx_B,
+                                     ndim_C, len_C, ldc, idx_C, sizeof(T), kTensorContractGETT, plan);
+        if (ret != kTensorReturnCodeSuccess) return ret;
+    }
+
+    /*
+     * pure contractions (including batched ones) are handed off to TTGT or GETT
+     */
+    switch (plan->algorithm)
+    {
+        case kTensorContractTTGT:
+            return tensor_contract_dense_ttgt(plan->contract,
+                                              alpha, A, ndim_A, len_A, lda, idx_A,
+                                                     B, ndim_B, len_B, ldb, idx_B,
+                                              beta,  C, ndim_C, len_C, ldc, idx_C);
+
+        case kTensorContractGETT:
+            return tensor_contract_dense_gett<T,T,T>(plan->contract, alpha, A, B, beta, C);
+
+        default:
+            return tensor_mult_dense_loop<T,T,T>(plan->loop, alpha, A, B, beta, C);
+    }
+}
+
+template <typename T, typename U, typename W>
+int tensor_mult_dense_loop(const DenseLoopPlan& plan,
+                           const U alpha, const T* restrict A, const T* restrict B,
+                           const U beta,        U* restrict C)
+{
+    const size_t size_ABC = loop_size(plan.len_ABC);
+    const size_t size_AB = loop_size(plan.len_AB);
+    const size_t work = size_ABC*(size_AB*(loop_size(plan.len_A)+loop_size(plan.len_B)) + loop_size(plan.len_C));
+    int nthread = tensor_get_num_threads();
+    int ret;
+
+    if (work < kLoopParallelMinWork) nthread = 1;
+
+    /*
+     * low-rank operations without traced or replicated indices use the rank-specialized kernels, with
+     * threads splitting the slowest ABC index when it is long enough
+     */
+    if (loop_is_unrolled(plan) && !loop_is_vector(plan))
+    {
+        const int len_last = (plan.len_ABC.empty() ? 1 : plan.len_ABC.back());
+
+        if (nthread == 1)
+        {
+            loop_unrolled<T,U,W>(plan, alpha, A, B, beta, C, 0, len_last);
+            return kTensorReturnCodeSuccess;
+        }
+        else if (len_last >= nthread)
+        {
+            #pragma omp parallel num_threads(nthread)
+            {
+                const int tid = tensor_thread_num();
+                const int nt = tensor_thread_count();
+
+                loop_unrolled<T,U,W>(plan, alpha, A, B, beta, C, len_last*tid/nt, len_last*(tid+1)/nt);
+            }
+
+            return kTensorReturnCodeSuccess;
+        }
+    }
+
+    if (nthread == 1)
+    {
+        return loop_range<T,U,W>(plan, alpha, A, B, beta, C, 0, size_ABC, 1);
+    }
+    else if (size_ABC >= (size_t)nthread)
+    {
+        /*
+         * each thread writes a contiguous part of the ABC group, and so a disjoint set of elements of C
+         */
+        ret = kTensorReturnCodeSuccess;
+
+        #pragma omp parallel num_threads(nthread) reduction(min:ret)
+        {
+            const int tid = tensor_thread_num();
+            const int nt = tensor_thread_count();
+
+            ret = loop_range<T,U,W>(plan, alpha, A, B, beta, C,
+                             size_ABC*tid/nt, size_ABC*(tid+1)/nt, 1);
+        }
+
+        return ret;
+    }
+    else
+    {
+        /*
+         * too few elements of C to go around (e.g. a dot product), so parallelize the sum for each one instead
+         */
+        return loop_range<T,U,W>(plan, alpha, A, B, beta, C, 0, size_ABC, nthread);
+    }
+}
+
+namespace {
+
+/*
+ * The type in which products of elements of type T are accumulated with kTensorAccumulateDouble
+ */
+template <typename T>
+struct double_type
+{
+    typedef T type;
+};
+
+template <>
+struct double_type<float>
+{
+    typedef double type;
+};
+
+template <>
+struct double_type< std::complex<float> >
+{
+    typedef std::complex<double> type;
+};
+
+/*
+ * Multiply operands of type T onto a result of type U, accumulating in type W
+ *
+ * There is no mixed-type gemm, so pure contractions are always done by GETT, which converts the operands to W
+ * as it packs them; when all three types are the same the ordinary kernel (and so TTGT) is used instead.
+ */
+template <typename T, typename U, typename W>
+struct MixedMult
+{
+    static int run(const U alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                                  const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                   const U beta,        U* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+                   const int algorithm)
+    {
+        DenseMultPlanPtr plan;
+        int ret;
+
+        ret = tensor_plan_mult_dense(ndim_A, len_A, lda, idx_A,
+                                     ndim_B, len_B, ldb, idx_B,
+                                     ndim_C, len_C, ldc, idx_C, sizeof(W), algorithm, plan);
+        if (ret != kTensorReturnCodeSuccess) return ret;
+
+        if (plan->algorithm == kTensorContractTTGT)
+        {
+            ret = tensor_plan_mult_dense(ndim_A, len_A, lda, idx_A,
+                                         ndim_B, len_B, ldb, idx_B,
+                                         ndim_C, len_C, ldc, idx_C, sizeof(W), kTensorContractGETT, plan);
+            if (ret != kTensorReturnCodeSuccess) return ret;
+        }
+
+        if (plan->algorithm == kTensorContractGETT)
+        {
+            return tensor_contract_dense_gett<T,U,W>(plan->contract, alpha, A, B, beta, C);
+        }
+        else
+        {
+            return tensor_mult_dense_loop<T,U,W>(plan->loop, alpha, A, B, beta, C);
+        }
+    }
+};
+
+template <typename T>
+struct MixedMult<T,T,T>
+{
+    static int run(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                                  const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                   const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+                   const int algorithm)
+    {
+        return tensor_mult_dense_(alpha, A, ndim_A, len_A, lda, idx_A,
+                                         B, ndim_B, len_B, ldb, idx_B,
+                                  beta,  C, ndim_C, len_C, ldc, idx_C, algorithm);
+    }
+};
+
+}
+
+template <typename T, typename U>
+int tensor_mult_dense_(const U alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                                      const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                       const U beta,        U* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+                       const int algorithm, const int accumulation)
+{
+#ifdef VALIDATE_INPUTS
+    VALIDATE_TENSOR(ndim_A, len_A, lda, NULL);
+    VALIDATE_TENSOR(ndim_B, len_B, ldb, NULL);
+    VALIDATE_TENSOR(ndim_C, len_C, ldc, NULL);
+#endif //VALIDATE_INPUTS
+
+    if (accumulation == kTensorAccumulateDouble)
+    {
+        return MixedMult<T,U,typename double_type<T>::type>::run(alpha, A, ndim_A, len_A, lda, idx_A,
+                                                                        B, ndim_B, len_B, ldb, idx_B,
+                                                                 beta,  C, ndim_C, len_C, ldc, idx_C, algorithm);
+    }
+    else
+    {
+        return MixedMult<T,U,T>::run(alpha, A, ndim_A, len_A, lda, idx_A,
+                                            B, ndim_B, len_B, ldb, idx_B,
+                                     beta,  C, ndim_C, len_C, ldc, idx_C, algorithm);
+    }
+}
+
+void tensor_set_mixed_accumulation(const int accumulation)
+{
+    mixed_accumulation = (accumulation == kTensorAccumulateSingle ? kTensorAccumulateSingle : kTensorAccumulateDouble);
+}
+
+int tensor_get_mixed_accumulation()
+{
+    return mixed_accumulation;
+}
+
+#define INSTANTIATE_MULT_DENSE(T) \
+template int tensor_mult_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A, \
+                                               const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B, \
+                                const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C); \
+template int tensor_mult_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A, \
+                                               const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B, \
+                                const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C, \
+                                const int algorithm);
+
+INSTANTIATE_DENSE_KERNELS(INSTANTIATE_MULT_DENSE)
+
+#define INSTANTIATE_MULT_MIXED_DENSE(T,U) \
+template int tensor_mult_dense_(const U alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A, \
+                                               const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B, \
+                                const U beta,        U* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C, \
+                                const int algorithm, const int accumulation);
+
+INSTANTIATE_MIXED_DENSE_KERNELS(INSTANTIATE_MULT_MIXED_DENSE)
+
 }
 }
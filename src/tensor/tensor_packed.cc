@@ -0,0 +1,707 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Kernels for tensors in packed (anti)symmetric storage.
+ *
+ * sym[i] gives the relation between indices i and i+1, and a run of indices related by SY, AS, or SH forms a
+ * group, within which only the elements with i_0 <= i_1 <= ... (SY) or i_0 < i_1 < ... (AS and SH) are stored.
+ * The stored elements are contiguous, in the order of first_packed_indices/next_packed_indices (index 0 varying
+ * fastest), so a group of n indices of length l takes binomial(l+n-1,n) (SY) or binomial(l,n) (AS, SH) elements
+ * rather than l^n.
+ *
+ * A sum which only permutes the indices (a copy, transpose, pack, unpack, or resym) works directly on the packed
+ * storage, without dense scratch. The other operations unpack the packed operands into dense scratch, call the dense
+ * kernels, and (when the result is packed) project the dense result back onto the symmetry of the output; the whole
+ * of each packed operand and of a packed result is then held in dense form for the duration of the operation, so
+ * the packed storage reduces the memory used between these operations but not their peak memory.
+ */
+
+#include "tensor.h"
+#include "util.h"
+#include <util/memory.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+namespace ambit {
+namespace tensor {
+
+namespace {
+
+/*
+ * A group of n consecutive indices starting at start, related by sym (NS for a lone index)
+ */
+struct SymGroup
+{
+    int start, n, sym;
+};
+
+int symmetry_groups(const int ndim, const int* len, const int* sym, std::vector<SymGroup>& groups)
+{
+    groups.clear();
+
+    for (int i = 0;i < ndim;)
+    {
+        SymGroup g = {i, 1, NS};
+
+        if (sym[i] < NS || sym[i] > SH) return kTensorReturnCodeInvalidSymmetry;
+
+        while (sym[i] != NS)
+        {
+            if (i == ndim-1) return kTensorReturnCodeInvalidSymmetry;
+            if (g.sym != NS && sym[i] != g.sym) return kTensorReturnCodeInvalidSymmetry;
+            if (len[i] != len[i+1]) return kTensorReturnCodeLengthMismatch;
+            g.sym = sym[i];
+            g.n++;
+            i++;
+        }
+
+        groups.push_back(g);
+        i++;
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+bool is_packed(const std::vector<SymGroup>& groups)
+{
+    for (size_t g = 0;g < groups.size();g++)
+        if (groups[g].sym != NS) return true;
+    return false;
+}
+
+/*
+ * The ld arguments describe a dense layout, so they are only allowed for tensors with no packed groups
+ */
+int check_ld(const std::vector<SymGroup>& groups, const int* ld)
+{
+    return (ld != NULL && is_packed(groups) ? kTensorReturnCodeInvalidLD : kTensorReturnCodeSuccess);
+}
+
+int64_t binomial(const int n, const int k)
+{
+    if (k < 0 || k > n) return 0;
+
+    int64_t c = 1;
+    for (int i = 0;i < k;i++) c = c*(n-i)/(i+1);
+    return c;
+}
+
+int64_t packed_size(const int* len, const std::vector<SymGroup>& groups)
+{
+    int64_t size = 1;
+
+    for (size_t g = 0;g < groups.size();g++)
+    {
+        const int l = len[groups[g].start];
+        const int n = groups[g].n;
+
+        switch (groups[g].sym)
+        {
+            case NS: size *= l; break;
+            case SY: size *= binomial(l+n-1, n); break;
+            default: size *= binomial(l, n); break;
+        }
+    }
+
+    return size;
+}
+
+int64_t dense_size(const int ndim, const int* len)
+{
+    int64_t size = 1;
+    for (int i = 0;i < ndim;i++) size *= len[i];
+    return size;
+}
+
+/*
+ * Call f(k, off, sign, nperm) for each stored element k of a packed tensor, where off and sign hold, for each of
+ * the nperm permutations of the indices within every group, the offset of the corresponding element of the dense
+ * (contiguous) tensor and the sign relating it to the packed element (-1 only for odd permutations of AS groups).
+ * If permute is false, only the element itself (the identity permutation) is given.
+ */
+template <class F>
+void for_each_packed(const int ndim, const int* len, const int* sym, const std::vector<SymGroup>& groups,
+                     const bool permute, F f)
+{
+    if (packed_size(len, groups) == 0) return;
+
+    std::vector<size_t> stride(ndim);
+    for (int i = 0;i < ndim;i++) stride[i] = (i == 0 ? 1 : stride[i-1]*len[i-1]);
+
+    std::vector< std::vector<int> > perm(groups.size());
+    size_t nperm = 1;
+    for (size_t g = 0;g < groups.size();g++)
+    {
+        perm[g].resize(groups[g].n);
+        for (int j = 0;j < groups[g].n;j++) perm[g][j] = j;
+        if (permute) for (int j = 2;j <= groups[g].n;j++) nperm *= j;
+    }
+
+    std::vector<int> idx(ndim);
+    std::vector<size_t> off(nperm);
+    std::vector<int> sign(nperm);
+
+    first_packed_indices(ndim, len, sym, idx.data());
+
+    int64_t k = 0;
+    do
+    {
+        for (size_t p = 0;p < nperm;p++)
+        {
+            off[p] = 0;
+            sign[p] = 1;
+
+            for (size_t g = 0;g < groups.size();g++)
+            {
+                const SymGroup& grp = groups[g];
+
+                for (int j = 0;j < grp.n;j++)
+                {
+                    off[p] += stride[grp.start+j]*idx[grp.start+perm[g][j]];
+                    if (grp.sym == AS)
+                        for (int m = j+1;m < grp.n;m++)
+                            if (perm[g][m] < perm[g][j]) sign[p] = -sign[p];
+                }
+            }
+
+            if (permute)
+                for (size_t g = 0;g < groups.size();g++)
+                    if (std::next_permutation(perm[g].begin(), perm[g].end())) break;
+        }
+
+        f(k, off.data(), sign.data(), nperm);
+        k++;
+    }
+    while (next_packed_indices(ndim, len, sym, idx.data()));
+}
+
+bool has_zero_elements(const std::vector<SymGroup>& groups)
+{
+    for (size_t g = 0;g < groups.size();g++)
+        if (groups[g].sym == AS || groups[g].sym == SH) return true;
+    return false;
+}
+
+template <typename T>
+void unpack(const T* A, T* B, const int ndim, const int* len, const int* sym, const std::vector<SymGroup>& groups)
+{
+    if (has_zero_elements(groups)) std::fill(B, B+dense_size(ndim, len), T(0));
+
+    for_each_packed(ndim, len, sym, groups, true,
+    [&](const int64_t k, const size_t* off, const int* sign, const size_t nperm)
+    {
+        for (size_t p = 0;p < nperm;p++) B[off[p]] = (sign[p] < 0 ? -A[k] : A[k]);
+    });
+}
+
+/*
+ * B = alpha*S(A) + beta*B, where A is dense and S is the (anti)symmetrizer of B, which averages the elements of A
+ * over the permutations of the indices in each group
+ */
+template <typename T>
+void pack_projected(const T alpha, const T* A, const T beta, T* B,
+                    const int ndim, const int* len, const int* sym, const std::vector<SymGroup>& groups)
+{
+    for_each_packed(ndim, len, sym, groups, true,
+    [&](const int64_t k, const size_t* off, const int* sign, const size_t nperm)
+    {
+        T s = T(0);
+        for (size_t p = 0;p < nperm;p++) s += (sign[p] < 0 ? -A[off[p]] : A[off[p]]);
+        s = alpha*s/T(nperm);
+        B[k] = (beta == T(0) ? s : s + beta*B[k]);
+    });
+}
+
+/*
+ * Unpack A into scratch if it is packed, otherwise return A itself
+ */
+template <typename T>
+const T* dense_operand(const T* A, const int ndim, const int* len, const int* sym,
+                       const std::vector<SymGroup>& groups, T*& scratch)
+{
+    scratch = NULL;
+    if (!is_packed(groups)) return A;
+
+    scratch = SAFE_MALLOC(T, std::max(dense_size(ndim, len), (int64_t)1));
+    unpack(A, scratch, ndim, len, sym, groups);
+    return scratch;
+}
+
+/*
+ * The location of the elements of a tensor given all of their indices
+ *
+ * A packed tensor stores each group in colexicographic order of its sorted indices, so a group of AS or SH indices
+ * v_0 < v_1 < ... is at sum_j binomial(v_j, j+1) within the group, and one of SY indices v_0 <= v_1 <= ... is at
+ * sum_j binomial(v_j+j, j+1); the groups follow each other with group 0 varying fastest. A tensor without packed
+ * groups is located through its leading dimensions.
+ */
+class PackedIndexer
+{
+    public:
+        PackedIndexer(const int ndim, const int* len, const int* ld, const std::vector<SymGroup>& groups)
+        : groups(groups), packed(is_packed(groups)), stride(ndim), scale(groups.size()), sorted(ndim)
+        {
+            int maxn = 0, maxlen = 0;
+            for (int i = 0;i < ndim;i++)
+            {
+                const int step = (ld != NULL ? ld[i] : i == 0 ? 1 : len[i-1]);
+                stride[i] = (i == 0 ? 1 : stride[i-1])*step;
+                maxlen = std::max(maxlen, len[i]);
+            }
+            for (size_t g = 0;g < groups.size();g++)
+            {
+                maxn = std::max(maxn, groups[g].n);
+                scale[g] = (g == 0 ? 1 : scale[g-1]*packed_size(len, std::vector<SymGroup>(1, groups[g-1])));
+            }
+
+            nbinom = maxn+1;
+            binom.resize((maxlen+maxn)*nbinom);
+            for (int m = 0;m < maxlen+maxn;m++)
+                for (int k = 0;k <= maxn;k++) binom[m*nbinom+k] = binomial(m, k);
+        }
+
+        /*
+         * The offset of the element with indices idx and the sign relating it to the stored element, or false if it
+         * is zero because two indices of an AS or SH group are equal
+         */
+        bool locate(const int* idx, int64_t& off, int& sign)
+        {
+            off = 0;
+            sign = 1;
+
+            if (!packed)
+            {
+                for (size_t i = 0;i < stride.size();i++) off += idx[i]*stride[i];
+                return true;
+            }
+
+            for (size_t g = 0;g < groups.size();g++)
+            {
+                const SymGroup& grp = groups[g];
+                int* v = sorted.data();
+
+                /*
+                 * sort the indices of the group, counting the transpositions for the sign of an AS group
+                 */
+                int swaps = 0;
+                for (int j = 0;j < grp.n;j++)
+                {
+                    int m = j;
+                    v[j] = idx[grp.start+j];
+                    for (;m > 0 && v[m-1] > v[m];m--)
+                    {
+                        std::swap(v[m-1], v[m]);
+                        swaps++;
+                    }
+                }
+
+                int64_t rank = 0;
+                for (int j = 0;j < grp.n;j++)
+                {
+                    if (grp.sym != NS && grp.sym != SY && j > 0 && v[j-1] == v[j]) return false;
+                    if (grp.sym == NS) rank = v[j];
+                    else rank += binom[(v[j] + (grp.sym == SY ? j : 0))*nbinom+j+1];
+                }
+
+                if (grp.sym == AS && swaps%2 == 1) sign = -sign;
+                off += rank*scale[g];
+            }
+
+            return true;
+        }
+
+    private:
+        const std::vector<SymGroup>& groups;
+        bool packed;
+        std::vector<int64_t> stride, scale, binom;
+        std::vector<int> sorted;
+        int nbinom;
+};
+
+/*
+ * B = alpha*S(P(A)) + beta*B, where P permutes the indices of A to those of B (index i of A becomes index pos[i]
+ * of B) and S is the (anti)symmetrizer of B, without forming A or B densely: each stored element of B is the
+ * average over the permutations of its indices within the groups of B of the elements of A found by PackedIndexer
+ */
+template <typename T>
+void sum_permuted(const T alpha, const T* A, const int ndim, const int* len_A, const int* lda,
+                  const std::vector<SymGroup>& groups_A, const int* pos,
+                  const T beta, T* B, const int* len_B, const int* ldb, const int* sym_B,
+                  const std::vector<SymGroup>& groups_B)
+{
+    if (packed_size(len_B, groups_B) == 0) return;
+
+    PackedIndexer index_A(ndim, len_A, lda, groups_A), index_B(ndim, len_B, ldb, groups_B);
+
+    /*
+     * the permutations of the indices within the groups of B, as the index of the stored element which each index
+     * of the permuted element takes, and their signs
+     */
+    std::vector< std::vector<int> > perm;
+    std::vector<int> perm_sign;
+    {
+        std::vector< std::vector<int> > within(groups_B.size());
+        for (size_t g = 0;g < groups_B.size();g++)
+            for (int j = 0;j < groups_B[g].n;j++) within[g].push_back(j);
+
+        do
+        {
+            std::vector<int> p(ndim);
+            int sign = 1;
+
+            for (size_t g = 0;g < groups_B.size();g++)
+            {
+                const SymGroup& grp = groups_B[g];
+                for (int j = 0;j < grp.n;j++)
+                {
+                    p[grp.start+j] = grp.start+within[g][j];
+                    if (grp.sym == AS)
+                        for (int m = j+1;m < grp.n;m++)
+                            if (within[g][m] < within[g][j]) sign = -sign;
+                }
+            }
+
+            perm.push_back(p);
+            perm_sign.push_back(sign);
+
+            size_t g = 0;
+            for (;g < groups_B.size();g++)
+                if (std::next_permutation(within[g].begin(), within[g].end())) break;
+            if (g == groups_B.size()) break;
+        }
+        while (true);
+    }
+
+    const size_t nperm = perm.size();
+    const bool packed_B = is_packed(groups_B);
+    std::vector<int> idx(ndim), idx_A(ndim);
+
+    first_packed_indices(ndim, len_B, sym_B, idx.data());
+
+    int64_t k = 0;
+    do
+    {
+        T s = T(0);
+
+        for (size_t p = 0;p < nperm;p++)
+        {
+            int64_t off;
+            int sign;
+
+            for (int i = 0;i < ndim;i++) idx_A[i] = idx[perm[p][pos[i]]];
+            if (!index_A.locate(idx_A.data(), off, sign)) continue;
+
+            s += (sign*perm_sign[p] < 0 ? -A[off] : A[off]);
+        }
+
+        s = alpha*s/T(nperm);
+
+        int64_t off_B = k;
+        int sign_B;
+        if (!packed_B) index_B.locate(idx.data(), off_B, sign_B);
+
+        B[off_B] = (beta == T(0) ? s : s + beta*B[off_B]);
+        k++;
+    }
+    while (next_packed_indices(ndim, len_B, sym_B, idx.data()));
+}
+
+void print_value(const double val)
+{
+    printf("%.15e\n", val);
+}
+
+void print_value(const std::complex<double> val)
+{
+    printf("(%.15e, %.15e)\n", val.real(), val.imag());
+}
+
+}
+
+int64_t tensor_size(const int ndim, const int* len, const int* ld, const int* sym)
+{
+    std::vector<SymGroup> groups;
+    int ret;
+
+    if (ndim < 0) return kTensorReturnCodeInvalidNDim;
+    if (sym == NULL) return tensor_size_dense(ndim, len, ld);
+
+    if ((ret = symmetry_groups(ndim, len, sym, groups)) != kTensorReturnCodeSuccess) return ret;
+    if ((ret = check_ld(groups, ld)) != kTensorReturnCodeSuccess) return ret;
+
+    if (!is_packed(groups)) return tensor_size_dense(ndim, len, ld);
+    return packed_size(len, groups);
+}
+
+template <typename T>
+int tensor_unpack(const T* A, T* B, const int ndim_A, const int* len_A, const int* sym_A)
+{
+    std::vector<SymGroup> groups;
+    int ret;
+
+    if ((ret = symmetry_groups(ndim_A, len_A, sym_A, groups)) != kTensorReturnCodeSuccess) return ret;
+
+    unpack(A, B, ndim_A, len_A, sym_A, groups);
+
+    return kTensorReturnCodeSuccess;
+}
+
+template <typename T>
+int tensor_pack(const T* A, T* B, const int ndim_A, const int* len_A, const int* sym_A)
+{
+    std::vector<SymGroup> groups;
+    int ret;
+
+    if ((ret = symmetry_groups(ndim_A, len_A, sym_A, groups)) != kTensorReturnCodeSuccess) return ret;
+
+    for_each_packed(ndim_A, len_A, sym_A, groups, false,
+    [&](const int64_t k, const size_t* off, const int* sign, const size_t nperm)
+    {
+        B[k] = A[off[0]];
+    });
+
+    return kTensorReturnCodeSuccess;
+}
+
+template <typename T>
+int tensor_symmetrize(const T* A, T* B, const int ndim_A, const int* len_A, const int* sym_A)
+{
+    std::vector<SymGroup> groups;
+    int ret;
+
+    if ((ret = symmetry_groups(ndim_A, len_A, sym_A, groups)) != kTensorReturnCodeSuccess) return ret;
+
+    T* packed = SAFE_MALLOC(T, std::max(packed_size(len_A, groups), (int64_t)1));
+    pack_projected(T(1), A, T(0), packed, ndim_A, len_A, sym_A, groups);
+    unpack(packed, B, ndim_A, len_A, sym_A, groups);
+    FREE(packed);
+
+    return kTensorReturnCodeSuccess;
+}
+
+template <typename T>
+int tensor_mult_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A,
+                                const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* sym_B, const int* idx_B,
+                 const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* sym_C, const int* idx_C)
+{
+    std::vector<SymGroup> groups_A, groups_B, groups_C;
+    T *scratch_A, *scratch_B, *scratch_C;
+    int ret;
+
+    if ((ret = symmetry_groups(ndim_A, len_A, sym_A, groups_A)) != kTensorReturnCodeSuccess) return ret;
+    if ((ret = symmetry_groups(ndim_B, len_B, sym_B, groups_B)) != kTensorReturnCodeSuccess) return ret;
+    if ((ret = symmetry_groups(ndim_C, len_C, sym_C, groups_C)) != kTensorReturnCodeSuccess) return ret;
+    if ((ret = check_ld(groups_A, lda)) != kTensorReturnCodeSuccess) return ret;
+    if ((ret = check_ld(groups_B, ldb)) != kTensorReturnCodeSuccess) return ret;
+    if ((ret = check_ld(groups_C, ldc)) != kTensorReturnCodeSuccess) return ret;
+
+    const T* dense_A = dense_operand(A, ndim_A, len_A, sym_A, groups_A, scratch_A);
+    const T* dense_B = dense_operand(B, ndim_B, len_B, sym_B, groups_B, scratch_B);
+
+    if (!is_packed(groups_C))
+    {
+        ret = tensor_mult_dense_(alpha, dense_A, ndim_A, len_A, lda, idx_A,
+                                        dense_B, ndim_B, len_B, ldb, idx_B,
+                                 beta,        C, ndim_C, len_C, ldc, idx_C);
+    }
+    else
+    {
+        scratch_C = SAFE_MALLOC(T, std::max(dense_size(ndim_C, len_C), (int64_t)1));
+
+        ret = tensor_mult_dense_(T(1), dense_A, ndim_A, len_A, (const int*)NULL, idx_A,
+                                       dense_B, ndim_B, len_B, (const int*)NULL, idx_B,
+                                 T(0), scratch_C, ndim_C, len_C, (const int*)NULL, idx_C);
+
+        if (ret == kTensorReturnCodeSuccess)
+            pack_projected(alpha, (const T*)scratch_C, beta, C, ndim_C, len_C, sym_C, groups_C);
+
+        FREE(scratch_C);
+    }
+
+    if (scratch_A != NULL) FREE(scratch_A);
+    if (scratch_B != NULL) FREE(scratch_B);
+
+    return ret;
+}
+
+template <typename T>
+int tensor_sum_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A,
+                const T beta,        T* B, const int ndim_B, const int* len_B, const int* ldb, const int* sym_B, const int* idx_B)
+{
+    std::vector<SymGroup> groups_A, groups_B;
+    T *scratch_A, *scratch_B;
+    int ret;
+
+    if ((ret = symmetry_groups(ndim_A, len_A, sym_A, groups_A)) != kTensorReturnCodeSuccess) return ret;
+    if ((ret = symmetry_groups(ndim_B, len_B, sym_B, groups_B)) != kTensorReturnCodeSuccess) return ret;
+    if ((ret = check_ld(groups_A, lda)) != kTensorReturnCodeSuccess) return ret;
+    if ((ret = check_ld(groups_B, ldb)) != kTensorReturnCodeSuccess) return ret;
+
+    /*
+     * a sum which only permutes the indices (a copy, transpose, pack, unpack, or resym) works directly on the
+     * packed storage
+     */
+    if ((is_packed(groups_A) || is_packed(groups_B)) && A != B &&
+        tensor_is_permutation_dense(ndim_A, idx_A, ndim_B, idx_B))
+    {
+        std::vector<int> pos(ndim_A);
+
+        for (int i = 0;i < ndim_A;i++)
+        {
+            for (int j = 0;j < ndim_B;j++)
+                if (idx_B[j] == idx_A[i]) pos[i] = j;
+            if (len_A[i] != len_B[pos[i]]) return kTensorReturnCodeLengthMismatch;
+        }
+
+        sum_permuted(alpha, A, ndim_A, len_A, lda, groups_A, pos.data(),
+                     beta,  B,         len_B, ldb, sym_B, groups_B);
+
+        return kTensorReturnCodeSuccess;
+    }
+
+    const T* dense_A = dense_operand(A, ndim_A, len_A, sym_A, groups_A, scratch_A);
+
+    if (!is_packed(groups_B))
+    {
+        ret = tensor_sum_dense_(alpha, dense_A, ndim_A, len_A, lda, idx_A,
+                                beta,        B, ndim_B, len_B, ldb, idx_B);
+    }
+    else
+    {
+        scratch_B = SAFE_MALLOC(T, std::max(dense_size(ndim_B, len_B), (int64_t)1));
+
+        ret = tensor_sum_dense_(T(1), dense_A, ndim_A, len_A, (const int*)NULL, idx_A,
+                                T(0), scratch_B, ndim_B, len_B, (const int*)NULL, idx_B);
+
+        if (ret == kTensorReturnCodeSuccess)
+            pack_projected(alpha, (const T*)scratch_B, beta, B, ndim_B, len_B, sym_B, groups_B);
+
+        FREE(scratch_B);
+    }
+
+    if (scratch_A != NULL) FREE(scratch_A);
+
+    return ret;
+}
+
+template <typename T>
+int tensor_resym_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A,
+                  const T beta,        T* B, const int ndim_B, const int* len_B, const int* ldb, const int* sym_B, const int* idx_B)
+{
+    if (ndim_A != ndim_B) return kTensorReturnCodeInvalidNDim;
+
+    /*
+     * resym only changes the symmetry (and perhaps the order) of the indices, so each index must appear exactly
+     * once in both A and B
+     */
+    std::vector<int> sorted_A(idx_A, idx_A+ndim_A);
+    std::vector<int> sorted_B(idx_B, idx_B+ndim_B);
+    std::sort(sorted_A.begin(), sorted_A.end());
+    std::sort(sorted_B.begin(), sorted_B.end());
+    if (sorted_A != sorted_B ||
+        std::adjacent_find(sorted_A.begin(), sorted_A.end()) != sorted_A.end()) return kTensorReturnCodeIndexMismatch;
+
+    return tensor_sum_(alpha, A, ndim_A, len_A, lda, sym_A, idx_A,
+                       beta,  B, ndim_B, len_B, ldb, sym_B, idx_B);
+}
+
+template <typename T>
+int tensor_scale_(const T alpha, T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A)
+{
+    std::vector<SymGroup> groups;
+    int ret;
+
+    if ((ret = symmetry_groups(ndim_A, len_A, sym_A, groups)) != kTensorReturnCodeSuccess) return ret;
+    if ((ret = check_ld(groups, lda)) != kTensorReturnCodeSuccess) return ret;
+
+    if (!is_packed(groups)) return tensor_scale_dense_(alpha, A, ndim_A, len_A, lda, idx_A);
+
+    /*
+     * a repeated index selects the (semi)diagonal elements, which are the only ones scaled
+     */
+    std::vector< std::pair<int,int> > repeated;
+    for (int i = 0;i < ndim_A;i++)
+        for (int j = i+1;j < ndim_A;j++)
+            if (idx_A[i] == idx_A[j]) repeated.push_back(std::make_pair(i, j));
+
+    std::vector<int> idx(ndim_A);
+    first_packed_indices(ndim_A, len_A, sym_A, idx.data());
+
+    const int64_t size = packed_size(len_A, groups);
+    for (int64_t k = 0;k < size;k++)
+    {
+        bool diagonal = true;
+        for (size_t r = 0;r < repeated.size();r++)
+            if (idx[repeated[r].first] != idx[repeated[r].second]) diagonal = false;
+
+        if (diagonal) A[k] = (alpha == T(0) ? T(0) : alpha*A[k]);
+
+        next_packed_indices(ndim_A, len_A, sym_A, idx.data());
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+template <typename T>
+int tensor_print(const T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A)
+{
+    std::vector<SymGroup> groups;
+    int ret;
+
+    if ((ret = symmetry_groups(ndim_A, len_A, sym_A, groups)) != kTensorReturnCodeSuccess) return ret;
+    if ((ret = check_ld(groups, lda)) != kTensorReturnCodeSuccess) return ret;
+
+    if (!is_packed(groups)) return tensor_print_dense(A, ndim_A, len_A, lda);
+
+    std::vector<int> idx(ndim_A);
+    first_packed_indices(ndim_A, len_A, sym_A, idx.data());
+
+    const int64_t size = packed_size(len_A, groups);
+    for (int64_t k = 0;k < size;k++)
+    {
+        for (int i = 0;i < ndim_A;i++) printf("%d ", idx[i]);
+        print_value(A[k]);
+
+        next_packed_indices(ndim_A, len_A, sym_A, idx.data());
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+#define INSTANTIATE_PACKED(T) \
+template int tensor_unpack(const T* A, T* B, const int ndim_A, const int* len_A, const int* sym_A); \
+template int tensor_pack(const T* A, T* B, const int ndim_A, const int* len_A, const int* sym_A); \
+template int tensor_symmetrize(const T* A, T* B, const int ndim_A, const int* len_A, const int* sym_A); \
+template int tensor_mult_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A, \
+                                         const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* sym_B, const int* idx_B, \
+                          const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* sym_C, const int* idx_C); \
+template int tensor_sum_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A, \
+                         const T beta,        T* B, const int ndim_B, const int* len_B, const int* ldb, const int* sym_B, const int* idx_B); \
+template int tensor_resym_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A, \
+                           const T beta,        T* B, const int ndim_B, const int* len_B, const int* ldb, const int* sym_B, const int* idx_B); \
+template int tensor_scale_(const T alpha, T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A, const int* idx_A); \
+template int tensor_print(const T* A, const int ndim_A, const int* len_A, const int* lda, const int* sym_A);
+
+INSTANTIATE_DENSE_KERNELS(INSTANTIATE_PACKED)
+
+}
+}
@@ -0,0 +1,758 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Planning of binary dense tensor operations.
+ *
+ * A plan holds the classification of the indices, the loop order, the strides, and the choice of
+ * algorithm for one combination of shapes, leading dimensions, and index labels. Plans are kept in a
+ * bounded least-recently-used cache so that an operation which is repeated many times (e.g. inside an
+ * iterative solver) is only set up once.
+ */
+
+#include "tensor_plan_dense.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+
+namespace ambit {
+namespace tensor {
+
+namespace {
+
+enum { OP_A = kDenseOperandA, OP_B = kDenseOperandB, OP_C = kDenseOperandC };
+
+/*
+ * Plan cache state
+ */
+typedef std::vector<int> plan_key;
+typedef std::list<std::pair<plan_key, DenseMultPlanPtr> > plan_list;
+
+std::mutex plan_mutex;
+plan_list plan_lru;
+std::map<plan_key, plan_list::iterator> plan_map;
+size_t plan_capacity = 256;
+uint64_t plan_hits = 0;
+uint64_t plan_misses = 0;
+
+/*
+ * Batched contractions with fewer multiply-adds than this per batch use the loop kernel
+ */
+enum { kDenseBatchMinWork = 256 };
+
+/*
+ * Read when planning, outside of plan_mutex, so it is atomic (it is only changed under plan_mutex, which also clears
+ * the plan cache)
+ */
+std::atomic<size_t> contract_scratch_limit(512*1024*1024);
+
+/*
+ * Read by every kernel, so it is atomic rather than guarded by plan_mutex (which is only taken to change it, since
+ * that also clears the plan cache)
+ */
+std::atomic<int> num_threads(0);
+
+struct stride_less
+{
+    int op;
+    stride_less(int op) : op(op) {}
+    bool operator()(const DenseIndex& a, const DenseIndex& b) const { return a.stride[op] < b.stride[op]; }
+};
+
+void dense_strides(const int ndim, const int* len, const int* ld, size_t* stride)
+{
+    if (ld == NULL)
+    {
+        if (ndim > 0) stride[0] = 1;
+        for (int i = 1;i < ndim;i++) stride[i] = stride[i-1]*len[i-1];
+    }
+    else
+    {
+        if (ndim > 0) stride[0] = ld[0];
+        for (int i = 1;i < ndim;i++) stride[i] = stride[i-1]*ld[i];
+    }
+}
+
+size_t group_size(const std::vector<DenseIndex>& group)
+{
+    size_t size = 1;
+    for (size_t i = 0;i < group.size();i++) size *= group[i].len;
+    return size;
+}
+
+size_t dense_size(const int ndim, const int* len, const size_t* stride)
+{
+    return (ndim > 0 ? stride[ndim-1]*len[ndim-1] : 1);
+}
+
+void append_key(plan_key& key, const int ndim, const int* len, const int* ld, const int* idx)
+{
+    key.push_back(ndim);
+    for (int i = 0;i < ndim;i++) key.push_back(len[i]);
+    key.push_back(ld == NULL ? 0 : 1);
+    if (ld != NULL) for (int i = 0;i < ndim;i++) key.push_back(ld[i]);
+    for (int i = 0;i < ndim;i++) key.push_back(idx[i]);
+}
+
+/*
+ * Gather the distinct index labels of A, B, and C, summing the strides of repeated labels
+ *
+ * Unlike in a contraction, indices of length one are kept here, since the loop kernel must
+ * still visit every element of C.
+ */
+int gather_indices(const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                   const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                   const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+                   const bool drop_unit, std::vector<DenseIndex>& indices, std::vector<int>& where,
+                   size_t* size = NULL)
+{
+    size_t stride_A[ndim_A];
+    size_t stride_B[ndim_B];
+    size_t stride_C[ndim_C];
+
+    dense_strides(ndim_A, len_A, lda, stride_A);
+    dense_strides(ndim_B, len_B, ldb, stride_B);
+    dense_strides(ndim_C, len_C, ldc, stride_C);
+
+    if (size != NULL)
+    {
+        size[OP_A] = dense_size(ndim_A, len_A, stride_A);
+        size[OP_B] = dense_size(ndim_B, len_B, stride_B);
+        size[OP_C] = dense_size(ndim_C, len_C, stride_C);
+    }
+
+    const int ndim[3] = {ndim_A, ndim_B, ndim_C};
+    const int* len[3] = {len_A, len_B, len_C};
+    const int* idx[3] = {idx_A, idx_B, idx_C};
+    const size_t* stride[3] = {stride_A, stride_B, stride_C};
+
+    for (int op = 0;op < 3;op++)
+    {
+        for (int i = 0;i < ndim[op];i++)
+        {
+            bool seen = false;
+            for (size_t j = 0;j < indices.size();j++)
+            {
+                if (indices[j].idx == idx[op][i]) seen = true;
+            }
+            if (seen) continue;
+
+            DenseIndex di;
+            di.idx = idx[op][i];
+            di.len = len[op][i];
+            int in = 0;
+
+            for (int other = 0;other < 3;other++)
+            {
+                di.stride[other] = 0;
+                for (int j = 0;j < ndim[other];j++)
+                {
+                    if (idx[other][j] == di.idx)
+                    {
+#ifdef VALIDATE_INPUTS
+                        if (len[other][j] != di.len) return kTensorReturnCodeLengthMismatch;
+#endif //VALIDATE_INPUTS
+                        in |= (1 << other);
+                        di.stride[other] += stride[other][j];
+                    }
+                }
+            }
+
+            if (drop_unit && di.len == 1) continue;
+
+            indices.push_back(di);
+            where.push_back(in);
+        }
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+int plan_loop(const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+              const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+              const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+              DenseLoopPlan& plan)
+{
+    std::vector<DenseIndex> indices;
+    std::vector<int> where;
+    std::vector<DenseIndex> g_A, g_B, g_C, g_AB, g_ABC;
+    size_t size[3];
+    int ret;
+
+    ret = gather_indices(ndim_A, len_A, lda, idx_A,
+                         ndim_B, len_B, ldb, idx_B,
+                         ndim_C, len_C, ldc, idx_C, false, indices, where, size);
+    if (ret != kTensorReturnCodeSuccess) return ret;
+
+    plan.size_A = size[OP_A];
+    plan.size_B = size[OP_B];
+    plan.size_C = size[OP_C];
+
+    /*
+     * sort the indices into five groups: A only, B only, C only, A and B only, and C and at least one of A and B
+     */
+    for (size_t i = 0;i < indices.size();i++)
+    {
+        const bool in_A = where[i] & (1 << OP_A);
+        const bool in_B = where[i] & (1 << OP_B);
+        const bool in_C = where[i] & (1 << OP_C);
+
+        if (in_C && (in_A || in_B))
+            g_ABC.push_back(indices[i]);
+        else if (in_C)
+            g_C.push_back(indices[i]);
+        else if (in_A && in_B)
+            g_AB.push_back(indices[i]);
+        else if (in_A)
+            g_A.push_back(indices[i]);
+        else
+            g_B.push_back(indices[i]);
+    }
+
+    /*
+     * loop over the index with the smallest stride fastest
+     */
+    std::stable_sort(g_A.begin(), g_A.end(), stride_less(OP_A));
+    std::stable_sort(g_B.begin(), g_B.end(), stride_less(OP_B));
+    std::stable_sort(g_C.begin(), g_C.end(), stride_less(OP_C));
+    std::stable_sort(g_AB.begin(), g_AB.end(), stride_less(OP_A));
+    std::stable_sort(g_ABC.begin(), g_ABC.end(), stride_less(OP_C));
+
+    for (size_t i = 0;i < g_A.size();i++)
+    {
+        plan.len_A.push_back(g_A[i].len);
+        plan.inc_A_A.push_back(g_A[i].stride[OP_A]);
+    }
+
+    for (size_t i = 0;i < g_B.size();i++)
+    {
+        plan.len_B.push_back(g_B[i].len);
+        plan.inc_B_B.push_back(g_B[i].stride[OP_B]);
+    }
+
+    for (size_t i = 0;i < g_C.size();i++)
+    {
+        plan.len_C.push_back(g_C[i].len);
+        plan.inc_C_C.push_back(g_C[i].stride[OP_C]);
+    }
+
+    for (size_t i = 0;i < g_AB.size();i++)
+    {
+        plan.len_AB.push_back(g_AB[i].len);
+        plan.inc_A_AB.push_back(g_AB[i].stride[OP_A]);
+        plan.inc_B_AB.push_back(g_AB[i].stride[OP_B]);
+    }
+
+    for (size_t i = 0;i < g_ABC.size();i++)
+    {
+        plan.len_ABC.push_back(g_ABC[i].len);
+        plan.inc_A_ABC.push_back(g_ABC[i].stride[OP_A]);
+        plan.inc_B_ABC.push_back(g_ABC[i].stride[OP_B]);
+        plan.inc_C_ABC.push_back(g_ABC[i].stride[OP_C]);
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+/*
+ * Compute the offset in operand op of every element of a group of indices, in column-major order
+ */
+void group_offsets(const std::vector<DenseIndex>& group, const int op, std::vector<size_t>& off)
+{
+    const int ndim = group.size();
+    int pos[ndim];
+    size_t cur = 0;
+    bool done;
+
+    off.clear();
+    off.reserve(group_size(group));
+
+    for (int i = 0;i < ndim;i++) pos[i] = 0;
+
+    for (done = false;!done;)
+    {
+        off.push_back(cur);
+
+        done = true;
+        for (int i = 0;i < ndim;i++)
+        {
+            if (pos[i] == group[i].len - 1)
+            {
+                pos[i] = 0;
+                cur -= group[i].stride[op]*(group[i].len-1);
+            }
+            else
+            {
+                pos[i]++;
+                cur += group[i].stride[op];
+                done = false;
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * Determine whether the indices in fast followed by those in slow are laid out in operand op as a
+ * column-major matrix, and if so return the leading dimension in ld.
+ */
+bool is_matrix(const std::vector<DenseIndex>& fast, const std::vector<DenseIndex>& slow, const int op, int& ld)
+{
+    size_t expect = 1;
+    for (size_t i = 0;i < fast.size();i++)
+    {
+        if (fast[i].stride[op] != expect) return false;
+        expect *= fast[i].len;
+    }
+
+    if (slow.empty())
+    {
+        ld = std::max(expect, (size_t)1);
+        return true;
+    }
+
+    if (slow[0].stride[op] < expect) return false;
+    ld = slow[0].stride[op];
+
+    expect = slow[0].stride[op];
+    for (size_t i = 0;i < slow.size();i++)
+    {
+        if (slow[i].stride[op] != expect) return false;
+        expect *= slow[i].len;
+    }
+
+    return true;
+}
+
+/*
+ * Lay out the groups of indices consecutively in a dense scratch tensor, returning the lengths and
+ * labels of the scratch tensor and the strides of the batch indices (the last group) within it.
+ */
+void pack_layout(const std::vector<DenseIndex>& g0, const std::vector<DenseIndex>& g1, const std::vector<DenseIndex>& g2,
+                 std::vector<int>& len, std::vector<int>& idx, std::vector<size_t>& stride_L)
+{
+    const std::vector<DenseIndex>* groups[3] = {&g0, &g1, &g2};
+    size_t stride = 1;
+
+    len.clear();
+    idx.clear();
+    stride_L.clear();
+
+    for (int g = 0;g < 3;g++)
+    {
+        for (size_t i = 0;i < groups[g]->size();i++)
+        {
+            const DenseIndex& di = (*groups[g])[i];
+            if (g == 2) stride_L.push_back(stride);
+            stride *= di.len;
+            len.push_back(di.len);
+            idx.push_back(di.idx);
+        }
+    }
+}
+
+/*
+ * Sort the indices of a pure contraction into the groups A and C (I), B and C (J), A and B (K), and
+ * A, B, and C (L), and choose the order within each group and the operands which TTGT must permute.
+ *
+ * Indices of length one never change any offset and are dropped.
+ */
+int plan_contract(const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                  const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                  const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+                  DenseContractPlan& plan)
+{
+    std::vector<DenseIndex> indices;
+    std::vector<int> where;
+    int ret;
+
+    ret = gather_indices(ndim_A, len_A, lda, idx_A,
+                         ndim_B, len_B, ldb, idx_B,
+                         ndim_C, len_C, ldc, idx_C, true, indices, where);
+    if (ret != kTensorReturnCodeSuccess) return ret;
+
+    for (size_t i = 0;i < indices.size();i++)
+    {
+        const bool in_A = where[i] & (1 << OP_A);
+        const bool in_B = where[i] & (1 << OP_B);
+        const bool in_C = where[i] & (1 << OP_C);
+
+        if (in_A && in_B && in_C)
+            plan.L.push_back(indices[i]);
+        else if (in_A && in_B)
+            plan.K.push_back(indices[i]);
+        else if (in_A)
+            plan.I.push_back(indices[i]);
+        else
+            plan.J.push_back(indices[i]);
+    }
+
+    plan.m = group_size(plan.I);
+    plan.n = group_size(plan.J);
+    plan.k = group_size(plan.K);
+
+    /*
+     * choose the storage order of C; C^T = B^T*A^T is used when C is stored with the J indices first, in
+     * which case the roles of A and B (X and Y) and of I and J (rows and columns) are swapped
+     */
+    plan.swap = false;
+    plan.pack_C = false;
+
+    std::sort(plan.L.begin(), plan.L.end(), stride_less(OP_C));
+    std::sort(plan.I.begin(), plan.I.end(), stride_less(OP_C));
+    std::sort(plan.J.begin(), plan.J.end(), stride_less(OP_C));
+
+    if (is_matrix(plan.I, plan.J, OP_C, plan.ldc))
+    {
+        plan.swap = false;
+    }
+    else if (is_matrix(plan.J, plan.I, OP_C, plan.ldc))
+    {
+        plan.swap = true;
+    }
+    else
+    {
+        plan.pack_C = true;
+        std::sort(plan.I.begin(), plan.I.end(), stride_less(OP_A));
+        std::sort(plan.J.begin(), plan.J.end(), stride_less(OP_B));
+    }
+
+    const std::vector<DenseIndex>& R = (plan.swap ? plan.J : plan.I);
+    const std::vector<DenseIndex>& S = (plan.swap ? plan.I : plan.J);
+    const int op_X = (plan.swap ? OP_B : OP_A);
+    const int op_Y = (plan.swap ? OP_A : OP_B);
+    const size_t m = group_size(R);
+    const size_t n = group_size(S);
+    const size_t k = plan.k;
+    const size_t nbatch = group_size(plan.L);
+
+    /*
+     * choose the order of the contracted indices to match X if possible, otherwise Y
+     */
+    plan.pack_X = false;
+    plan.pack_Y = false;
+
+    std::sort(plan.K.begin(), plan.K.end(), stride_less(op_X));
+
+    if (is_matrix(R, plan.K, op_X, plan.ldx))
+    {
+        plan.trans_X = 'N';
+    }
+    else if (is_matrix(plan.K, R, op_X, plan.ldx))
+    {
+        plan.trans_X = 'T';
+    }
+    else
+    {
+        plan.pack_X = true;
+        std::sort(plan.K.begin(), plan.K.end(), stride_less(op_Y));
+    }
+
+    if (is_matrix(plan.K, S, op_Y, plan.ldy))
+    {
+        plan.trans_Y = 'N';
+    }
+    else if (is_matrix(S, plan.K, op_Y, plan.ldy))
+    {
+        plan.trans_Y = 'T';
+    }
+    else
+    {
+        plan.pack_Y = true;
+    }
+
+    /*
+     * lay out the scratch tensors and the strides of the batch indices in each matrix operand
+     */
+    plan.scratch = 0;
+
+    if (plan.pack_X)
+    {
+        pack_layout(R, plan.K, plan.L, plan.len_X_P, plan.idx_X_P, plan.stride_X_L);
+        plan.trans_X = 'N';
+        plan.ldx = std::max(m, (size_t)1);
+        plan.scratch += m*k*nbatch;
+    }
+    else
+    {
+        for (size_t i = 0;i < plan.L.size();i++) plan.stride_X_L.push_back(plan.L[i].stride[op_X]);
+    }
+
+    if (plan.pack_Y)
+    {
+        pack_layout(plan.K, S, plan.L, plan.len_Y_P, plan.idx_Y_P, plan.stride_Y_L);
+        plan.trans_Y = 'N';
+        plan.ldy = std::max(k, (size_t)1);
+        plan.scratch += k*n*nbatch;
+    }
+    else
+    {
+        for (size_t i = 0;i < plan.L.size();i++) plan.stride_Y_L.push_back(plan.L[i].stride[op_Y]);
+    }
+
+    if (plan.pack_C)
+    {
+        pack_layout(R, S, plan.L, plan.len_C_P, plan.idx_C_P, plan.stride_Z_L);
+        plan.ldc = std::max(m, (size_t)1);
+        plan.scratch += m*n*nbatch;
+    }
+    else
+    {
+        for (size_t i = 0;i < plan.L.size();i++) plan.stride_Z_L.push_back(plan.L[i].stride[OP_C]);
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+int plan_mult(const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+              const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+              const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+              const size_t elem_size, const int algorithm, const int nthread, DenseMultPlan& plan)
+{
+    int ret;
+
+    if (algorithm == kTensorContractLoop ||
+        !tensor_is_contraction_dense(ndim_A, idx_A, ndim_B, idx_B, ndim_C, idx_C))
+    {
+        plan.algorithm = kTensorContractLoop;
+        return plan_loop(ndim_A, len_A, lda, idx_A,
+                         ndim_B, len_B, ldb, idx_B,
+                         ndim_C, len_C, ldc, idx_C, plan.loop);
+    }
+
+    ret = plan_contract(ndim_A, len_A, lda, idx_A,
+                        ndim_B, len_B, ldb, idx_B,
+                        ndim_C, len_C, ldc, idx_C, plan.contract);
+    if (ret != kTensorReturnCodeSuccess) return ret;
+
+    switch (algorithm)
+    {
+        case kTensorContractTTGT:
+        case kTensorContractGETT:
+            plan.algorithm = algorithm;
+            break;
+
+        default:
+            /*
+             * TTGT wins whenever its scratch copies fit, since the bulk of the work is then done by
+             * an optimized dgemm; otherwise GETT avoids the copies entirely
+             */
+            if (plan.contract.scratch*elem_size > contract_scratch_limit.load(std::memory_order_relaxed))
+                plan.algorithm = kTensorContractGETT;
+            else
+                plan.algorithm = kTensorContractTTGT;
+
+            /*
+             * when C has fewer elements than there are threads (e.g. a dot product) neither can use
+             * more than a few threads, but the loop kernel can split the contracted indices instead;
+             * likewise, a batch of tiny matrix products (e.g. an elementwise product) is dominated by
+             * the overhead of calling dgemm
+             */
+            const size_t mnk = (size_t)plan.contract.m*plan.contract.n*plan.contract.k;
+            if ((nthread > 1 && (size_t)plan.contract.m*plan.contract.n*group_size(plan.contract.L) < (size_t)nthread) ||
+                (!plan.contract.L.empty() && mnk < kDenseBatchMinWork))
+            {
+                plan.algorithm = kTensorContractLoop;
+                return plan_loop(ndim_A, len_A, lda, idx_A,
+                                 ndim_B, len_B, ldb, idx_B,
+                                 ndim_C, len_C, ldc, idx_C, plan.loop);
+            }
+            break;
+    }
+
+    if (plan.algorithm == kTensorContractGETT)
+    {
+        group_offsets(plan.contract.I, OP_A, plan.contract.off_A_I);
+        group_offsets(plan.contract.I, OP_C, plan.contract.off_C_I);
+        group_offsets(plan.contract.J, OP_B, plan.contract.off_B_J);
+        group_offsets(plan.contract.J, OP_C, plan.contract.off_C_J);
+        group_offsets(plan.contract.K, OP_A, plan.contract.off_A_K);
+        group_offsets(plan.contract.K, OP_B, plan.contract.off_B_K);
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+void clear_plan_cache_locked()
+{
+    plan_lru.clear();
+    plan_map.clear();
+}
+
+}
+
+int tensor_plan_mult_dense(const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                           const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                           const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+                           const size_t elem_size, const int algorithm, DenseMultPlanPtr& plan)
+{
+    plan_key key;
+    int ret;
+
+    /*
+     * an automatic choice depends on the number of threads, which is one inside a parallel region and may otherwise
+     * follow omp_get_max_threads(), so it is part of the key
+     */
+    const int nthread = (algorithm == kTensorContractAuto ? tensor_get_num_threads() : 0);
+
+    key.push_back(elem_size);
+    key.push_back(algorithm);
+    key.push_back(nthread);
+    append_key(key, ndim_A, len_A, lda, idx_A);
+    append_key(key, ndim_B, len_B, ldb, idx_B);
+    append_key(key, ndim_C, len_C, ldc, idx_C);
+
+    {
+        std::lock_guard<std::mutex> lock(plan_mutex);
+
+        std::map<plan_key, plan_list::iterator>::iterator it = plan_map.find(key);
+        if (it != plan_map.end())
+        {
+            plan_hits++;
+            plan_lru.splice(plan_lru.begin(), plan_lru, it->second);
+            plan = it->second->second;
+            return kTensorReturnCodeSuccess;
+        }
+
+        plan_misses++;
+    }
+
+    DenseMultPlan* new_plan = new DenseMultPlan;
+    ret = plan_mult(ndim_A, len_A, lda, idx_A,
+                    ndim_B, len_B, ldb, idx_B,
+                    ndim_C, len_C, ldc, idx_C, elem_size, algorithm, nthread, *new_plan);
+    if (ret != kTensorReturnCodeSuccess)
+    {
+        delete new_plan;
+        return ret;
+    }
+    plan.reset(new_plan);
+
+    if (plan_capacity > 0)
+    {
+        std::lock_guard<std::mutex> lock(plan_mutex);
+
+        if (plan_map.find(key) == plan_map.end())
+        {
+            plan_lru.push_front(std::make_pair(key, plan));
+            plan_map[key] = plan_lru.begin();
+
+            while (plan_lru.size() > plan_capacity)
+            {
+                plan_map.erase(plan_lru.back().first);
+                plan_lru.pop_back();
+            }
+        }
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+void tensor_set_plan_cache_capacity(const size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(plan_mutex);
+
+    plan_capacity = capacity;
+    while (plan_lru.size() > plan_capacity)
+    {
+        plan_map.erase(plan_lru.back().first);
+        plan_lru.pop_back();
+    }
+}
+
+size_t tensor_get_plan_cache_capacity()
+{
+    std::lock_guard<std::mutex> lock(plan_mutex);
+    return plan_capacity;
+}
+
+void tensor_clear_plan_cache()
+{
+    std::lock_guard<std::mutex> lock(plan_mutex);
+    clear_plan_cache_locked();
+}
+
+uint64_t tensor_plan_cache_hits()
+{
+    std::lock_guard<std::mutex> lock(plan_mutex);
+    return plan_hits;
+}
+
+uint64_t tensor_plan_cache_misses()
+{
+    std::lock_guard<std::mutex> lock(plan_mutex);
+    return plan_misses;
+}
+
+void tensor_reset_plan_cache_stats()
+{
+    std::lock_guard<std::mutex> lock(plan_mutex);
+    plan_hits = 0;
+    plan_misses = 0;
+}
+
+void tensor_set_contract_scratch_limit(const size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(plan_mutex);
+
+    /*
+     * cached plans may have chosen their algorithm based on the old limit
+     */
+    contract_scratch_limit = bytes;
+    clear_plan_cache_locked();
+}
+
+size_t tensor_get_contract_scratch_limit()
+{
+    return contract_scratch_limit.load(std::memory_order_relaxed);
+}
+
+void tensor_set_num_threads(const int nthread)
+{
+    std::lock_guard<std::mutex> lock(plan_mutex);
+
+    /*
+     * cached plans may have chosen their algorithm based on the old thread count
+     */
+    num_threads = std::max(nthread, 0);
+    clear_plan_cache_locked();
+}
+
+int tensor_get_num_threads()
+{
+    int nthread = num_threads.load(std::memory_order_relaxed);
+
+#if defined(OPENMP_FOUND)
+    /*
+     * the dense kernels are not themselves nested, so never start threads from inside a parallel region
+     */
+    if (omp_in_parallel()) return 1;
+    if (nthread == 0) nthread = omp_get_max_threads();
+#else
+    nthread = 1;
+#endif
+
+    return nthread;
+}
+
+}
+}
@@ -0,0 +1,165 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined(AMBIT_LIB_TENSOR_TENSOR_PLAN_DENSE)
+#define AMBIT_LIB_TENSOR_TENSOR_PLAN_DENSE
+
+#include "tensor.h"
+
+#include <boost/shared_ptr.hpp>
+#include <vector>
+
+#if defined(OPENMP_FOUND)
+#include <omp.h>
+#endif
+
+namespace ambit {
+namespace tensor {
+
+/*
+ * Operand numbers used to index DenseIndex::stride
+ */
+enum { kDenseOperandA = 0, kDenseOperandB = 1, kDenseOperandC = 2 };
+
+/*
+ * An index label of a binary operation and its stride in each of the tensors in which it appears
+ * (zero in the others)
+ */
+struct DenseIndex
+{
+    int idx;
+    int len;
+    size_t stride[3];
+};
+
+/*
+ * Index groups for the generic loop kernel of tensor_mult_dense_
+ *
+ * The groups are A only (traced), B only (traced), C only (replicated), A and B only (summed), and
+ * those appearing in C and at least one of A and B. Each group is ordered so that the index with
+ * the smallest stride varies fastest.
+ */
+struct DenseLoopPlan
+{
+    std::vector<int> len_A, len_B, len_C, len_AB, len_ABC;
+    std::vector<size_t> inc_A_A, inc_B_B, inc_C_C;
+    std::vector<size_t> inc_A_AB, inc_B_AB;
+    std::vector<size_t> inc_A_ABC, inc_B_ABC, inc_C_ABC;
+    size_t size_A, size_B, size_C;
+};
+
+/*
+ * A pure contraction C[I,J,L] = A[I,K,L]*B[K,J,L], evaluated as a batch (over L) of matrix products
+ *
+ * For TTGT, X and Y are the left and right operands of the matrix product, which are A and B respectively
+ * unless C is stored with the J indices first, in which case C^T = B^T*A^T is computed instead (swap). Operands
+ * which must be permuted are copied into scratch tensors with the lengths and labels given by len_P and idx_P.
+ *
+ * For GETT, the offsets of every element of each group in each operand are tabulated.
+ */
+struct DenseContractPlan
+{
+    std::vector<DenseIndex> I, J, K, L;
+    int m, n, k;
+
+    bool swap;
+    bool pack_X, pack_Y, pack_C;
+    char trans_X, trans_Y;
+    int ldx, ldy, ldc;
+    size_t scratch;
+    std::vector<int> len_X_P, idx_X_P;
+    std::vector<int> len_Y_P, idx_Y_P;
+    std::vector<int> len_C_P, idx_C_P;
+    std::vector<size_t> stride_X_L, stride_Y_L, stride_Z_L;
+
+    std::vector<size_t> off_A_I, off_C_I;
+    std::vector<size_t> off_B_J, off_C_J;
+    std::vector<size_t> off_A_K, off_B_K;
+};
+
+/*
+ * Everything about a call to tensor_mult_dense_ which depends only on the shapes, leading dimensions,
+ * and index labels of the operands (and on the requested algorithm), but not on the data
+ */
+struct DenseMultPlan
+{
+    int algorithm;
+    DenseLoopPlan loop;
+    DenseContractPlan contract;
+};
+
+typedef boost::shared_ptr<const DenseMultPlan> DenseMultPlanPtr;
+
+/*
+ * The number of the calling thread and the number of threads in the innermost parallel region
+ */
+inline int tensor_thread_num()
+{
+#if defined(OPENMP_FOUND)
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+inline int tensor_thread_count()
+{
+#if defined(OPENMP_FOUND)
+    return omp_get_num_threads();
+#else
+    return 1;
+#endif
+}
+
+/**
+ * Return a plan for the given binary operation, from the plan cache if possible
+ *
+ * The algorithm of the returned plan is kTensorContractLoop, kTensorContractTTGT, or kTensorContractGETT,
+ * with kTensorContractAuto resolved and kTensorContractTTGT or kTensorContractGETT replaced by
+ * kTensorContractLoop if the operation is not a pure contraction. elem_size is the size of one element in
+ * bytes, which determines the size of the TTGT scratch tensors.
+ */
+int tensor_plan_mult_dense(const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                           const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                           const int ndim_C, const int* len_C, const int* ldc, const int* idx_C,
+                           const size_t elem_size, const int algorithm, DenseMultPlanPtr& plan);
+
+/*
+ * The loop and GETT kernels take operands of type T and a result of type U, and form and sum the products of
+ * the operands in type W (all three are the same except for mixed-precision multiplication)
+ */
+template <typename T, typename U, typename W>
+int tensor_mult_dense_loop(const DenseLoopPlan& plan,
+                           const U alpha, const T* A, const T* B,
+                           const U beta,        U* C);
+
+template <typename T>
+int tensor_contract_dense_ttgt(const DenseContractPlan& plan,
+                               const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                                              const T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B,
+                               const T beta,        T* C, const int ndim_C, const int* len_C, const int* ldc, const int* idx_C);
+
+template <typename T, typename U, typename W>
+int tensor_contract_dense_gett(const DenseContractPlan& plan,
+                               const U alpha, const T* A, const T* B,
+                               const U beta,        U* C);
+
+}
+}
+
+#endif
@@ -0,0 +1,345 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Contraction order planning for products of three or more tensors.
+ *
+ * Sets of operands and of index labels are represented as bit masks. For each set of operands S, the cheapest
+ * way to form its intermediate is found by dynamic programming over the ways of splitting S in two, ascending in
+ * S, so that the best plans for both halves are already known.
+ */
+
+#include "tensor_plan_product.h"
+
+#include <util/memory.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <stdint.h>
+
+namespace ambit {
+namespace tensor {
+
+namespace {
+
+typedef uint64_t label_set;
+
+std::atomic<size_t> product_memory_limit(0);
+
+/*
+ * The best way found so far to form the intermediate of a set of operands: by forming the intermediate of the
+ * operands in first, then that of the rest, and multiplying the two
+ */
+struct ProductNode
+{
+    double flops, peak, size;
+    bool fits;
+    uint32_t first;
+};
+
+bool better(const ProductNode& a, const ProductNode& b)
+{
+    if (a.fits != b.fits) return a.fits;
+    if (a.flops != b.flops) return a.flops < b.flops;
+    return a.peak < b.peak;
+}
+
+struct ProductLabels
+{
+    std::vector<label_set> occ;
+    label_set out;
+    std::vector<char> label;
+    std::vector<int> len;
+
+    label_set labels(const uint32_t S) const
+    {
+        label_set l = 0;
+        for (size_t i = 0;i < occ.size();i++)
+            if (S & (1u << i)) l |= occ[i];
+        return l;
+    }
+
+    /*
+     * The labels of the intermediate of S, which are those needed by the result or by an operand outside of S
+     */
+    label_set kept(const uint32_t S, const uint32_t all) const
+    {
+        return labels(S) & (out | labels(all & ~S));
+    }
+
+    double size(const label_set l) const
+    {
+        double s = 1;
+        for (size_t i = 0;i < label.size();i++)
+            if (l & (label_set(1) << i)) s *= len[i];
+        return s;
+    }
+
+    std::string indices(const label_set l) const
+    {
+        std::string idx;
+        for (size_t i = 0;i < label.size();i++)
+            if (l & (label_set(1) << i)) idx += label[i];
+        return idx;
+    }
+
+    std::vector<int> lengths(const label_set l) const
+    {
+        std::vector<int> lens;
+        for (size_t i = 0;i < label.size();i++)
+            if (l & (label_set(1) << i)) lens.push_back(len[i]);
+        return lens;
+    }
+};
+
+/*
+ * Number the labels, those of C first so that intermediates list their indices in the same order as C
+ */
+int number_labels(const std::vector<std::string>& idx, const std::vector< std::vector<int> >& len,
+                  const std::string& idx_C, const std::vector<int>& len_C, ProductLabels& labels)
+{
+    std::map<char,int> number;
+
+    for (size_t op = 0;op <= idx.size();op++)
+    {
+        const std::string& idx_X = (op == 0 ? idx_C : idx[op-1]);
+        const std::vector<int>& len_X = (op == 0 ? len_C : len[op-1]);
+
+        if (idx_X.size() != len_X.size()) return kTensorReturnCodeInvalidNDim;
+
+        label_set l = 0;
+        for (size_t i = 0;i < idx_X.size();i++)
+        {
+            std::map<char,int>::iterator it = number.find(idx_X[i]);
+            if (it == number.end())
+            {
+                if (labels.label.size() == 64) return kTensorReturnCodeInvalidNDim;
+                it = number.insert(std::make_pair(idx_X[i], (int)labels.label.size())).first;
+                labels.label.push_back(idx_X[i]);
+                labels.len.push_back(len_X[i]);
+            }
+            else if (labels.len[it->second] != len_X[i])
+            {
+                return kTensorReturnCodeLengthMismatch;
+            }
+            l |= label_set(1) << it->second;
+        }
+
+        if (op == 0) labels.out = l;
+        else labels.occ.push_back(l);
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+/*
+ * Append the steps forming the intermediate of S (and those of its parts) and return its number
+ */
+int emit_steps(const ProductLabels& labels, const std::vector<ProductNode>& node, const uint32_t S, const uint32_t all,
+               const std::string& idx_C, const std::vector<int>& len_C, ProductPlan& plan)
+{
+    if ((S & (S-1)) == 0)
+    {
+        int i = 0;
+        while (!(S & (1u << i))) i++;
+        return i;
+    }
+
+    const int A = emit_steps(labels, node, node[S].first, all, idx_C, len_C, plan);
+    const int B = emit_steps(labels, node, S & ~node[S].first, all, idx_C, len_C, plan);
+
+    ProductStep step;
+    step.A = A;
+    step.B = B;
+    step.C = (int)(labels.occ.size() + plan.steps.size());
+    step.idx_C = (S == all ? idx_C : labels.indices(labels.kept(S, all)));
+    step.len_C = (S == all ? len_C : labels.lengths(labels.kept(S, all)));
+    plan.steps.push_back(step);
+
+    return step.C;
+}
+
+void plan_exhaustive(const ProductLabels& labels, const double limit, const std::string& idx_C,
+                     const std::vector<int>& len_C, ProductPlan& plan)
+{
+    const int n = labels.occ.size();
+    const uint32_t all = (1u << n) - 1;
+    std::vector<ProductNode> node(all+1);
+
+    for (uint32_t S = 1;S <= all;S++)
+    {
+        if ((S & (S-1)) == 0)
+        {
+            ProductNode leaf = {0, 0, 0, true, 0};
+            node[S] = leaf;
+            continue;
+        }
+
+        const double size = (S == all ? 0 : labels.size(labels.kept(S, all)));
+        const label_set root = (S == all ? labels.out : 0);
+        bool found = false;
+
+        for (uint32_t X = (S-1) & S;X > 0;X = (X-1) & S)
+        {
+            const uint32_t Y = S & ~X;
+            if (X < Y) continue;
+
+            const ProductNode& a = node[X];
+            const ProductNode& b = node[Y];
+
+            ProductNode c;
+            c.size = size;
+            c.flops = a.flops + b.flops + labels.size(labels.kept(X, all) | labels.kept(Y, all) | root);
+
+            /*
+             * the intermediate of the part formed first is held while the other is formed
+             */
+            const double peak_X = std::max(std::max(a.peak, a.size+b.peak), a.size+b.size+size);
+            const double peak_Y = std::max(std::max(b.peak, b.size+a.peak), a.size+b.size+size);
+            c.peak = std::min(peak_X, peak_Y);
+            c.first = (peak_X <= peak_Y ? X : Y);
+            c.fits = a.fits && b.fits && (limit == 0 || c.peak <= limit);
+
+            if (!found || better(c, node[S]))
+            {
+                node[S] = c;
+                found = true;
+            }
+        }
+    }
+
+    plan.flops = node[all].flops;
+    plan.peak = node[all].peak;
+    emit_steps(labels, node, all, all, idx_C, len_C, plan);
+}
+
+void plan_greedy(const ProductLabels& labels, const std::string& idx_C, const std::vector<int>& len_C,
+                 ProductPlan& plan)
+{
+    const int n = labels.occ.size();
+    const uint32_t all = (n == 32 ? ~0u : (1u << n) - 1);
+
+    /*
+     * the operand sets not yet consumed, with the number of the operand or intermediate holding each
+     */
+    std::vector<uint32_t> set;
+    std::vector<int> id;
+    std::vector<double> size;
+    for (int i = 0;i < n;i++)
+    {
+        set.push_back(1u << i);
+        id.push_back(i);
+        size.push_back(0);
+    }
+
+    double live = 0;
+    plan.flops = 0;
+    plan.peak = 0;
+
+    while (set.size() > 1)
+    {
+        size_t best_i = 0, best_j = 1;
+        double best_flops = -1, best_size = 0;
+
+        for (size_t i = 0;i < set.size();i++)
+        {
+            for (size_t j = i+1;j < set.size();j++)
+            {
+                const uint32_t S = set[i] | set[j];
+                const label_set root = (S == all ? labels.out : 0);
+                const double flops = labels.size(labels.kept(set[i], all) | labels.kept(set[j], all) | root);
+                const double res = (S == all ? 0 : labels.size(labels.kept(S, all)));
+
+                if (best_flops < 0 || flops < best_flops || (flops == best_flops && res < best_size))
+                {
+                    best_i = i;
+                    best_j = j;
+                    best_flops = flops;
+                    best_size = res;
+                }
+            }
+        }
+
+        const uint32_t S = set[best_i] | set[best_j];
+
+        ProductStep step;
+        step.A = id[best_i];
+        step.B = id[best_j];
+        step.C = n + plan.steps.size();
+        step.idx_C = (S == all ? idx_C : labels.indices(labels.kept(S, all)));
+        step.len_C = (S == all ? len_C : labels.lengths(labels.kept(S, all)));
+        plan.steps.push_back(step);
+
+        plan.flops += best_flops;
+        plan.peak = std::max(plan.peak, live + best_size);
+        live += best_size - size[best_i] - size[best_j];
+
+        set[best_i] = S;
+        id[best_i] = step.C;
+        size[best_i] = best_size;
+        set.erase(set.begin()+best_j);
+        id.erase(id.begin()+best_j);
+        size.erase(size.begin()+best_j);
+    }
+}
+
+}
+
+int tensor_plan_product(const std::vector<std::string>& idx, const std::vector< std::vector<int> >& len,
+                        const std::string& idx_C, const std::vector<int>& len_C,
+                        const size_t elem_size, ProductPlan& plan)
+{
+    ProductLabels labels;
+    int ret;
+
+    if (idx.size() < 2 || idx.size() > 32 || idx.size() != len.size()) return kTensorReturnCodeInvalidNDim;
+
+    if ((ret = number_labels(idx, len, idx_C, len_C, labels)) != kTensorReturnCodeSuccess) return ret;
+
+    plan.steps.clear();
+
+    if (idx.size() <= kProductMaxExhaustive)
+    {
+        /*
+         * the intermediates must also fit in what is left of the memory budget
+         */
+        size_t limit = std::min(product_memory_limit == 0 ? SIZE_MAX : (size_t)product_memory_limit,
+                                util::ambit_memory_available());
+        plan_exhaustive(labels, limit == SIZE_MAX ? 0.0 : std::max((double)limit/elem_size, 1.0), idx_C, len_C, plan);
+    }
+    else
+    {
+        plan_greedy(labels, idx_C, len_C, plan);
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+void tensor_set_product_memory_limit(const size_t bytes)
+{
+    product_memory_limit = bytes;
+}
+
+size_t tensor_get_product_memory_limit()
+{
+    return product_memory_limit;
+}
+
+}
+}
@@ -0,0 +1,78 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined(AMBIT_LIB_TENSOR_TENSOR_PLAN_PRODUCT)
+#define AMBIT_LIB_TENSOR_TENSOR_PLAN_PRODUCT
+
+#include "tensor.h"
+
+#include <string>
+#include <vector>
+
+namespace ambit {
+namespace tensor {
+
+/*
+ * One binary multiplication in the evaluation of an N-ary product: operands (or intermediates) A and B are
+ * multiplied into C, which has the indices idx_C and lengths len_C
+ *
+ * The n operands of the product are numbered 0...n-1 and the intermediates n, n+1, ... in the order of the steps
+ * which produce them. The last step produces the result of the product rather than an intermediate.
+ */
+struct ProductStep
+{
+    int A, B, C;
+    std::string idx_C;
+    std::vector<int> len_C;
+};
+
+/*
+ * An order of evaluation for an N-ary product, with its cost
+ *
+ * Each intermediate is consumed by exactly one later step, after which it may be freed. flops counts the
+ * multiply-adds of all of the steps, and peak the largest number of elements of intermediates alive at once.
+ */
+struct ProductPlan
+{
+    std::vector<ProductStep> steps;
+    double flops;
+    double peak;
+};
+
+/**
+ * Choose the order in which to multiply the operands of the product
+ *
+ *   C[idx_C] = A_0[idx[0]]*A_1[idx[1]]*...*A_{n-1}[idx[n-1]]
+ *
+ * Each intermediate keeps the indices of its operands which appear in C or in an operand outside of it, and an
+ * index which appears only within it is summed over as early as possible. With up to kProductMaxExhaustive
+ * operands every contraction tree is considered, and the one with the fewest multiply-adds whose intermediates
+ * fit within tensor_get_product_memory_limit() (with elements of elem_size bytes) is chosen, with ties broken
+ * by peak intermediate memory; if no tree fits, the limit is ignored. With more operands, the pair whose
+ * multiplication is cheapest is multiplied at each step.
+ */
+int tensor_plan_product(const std::vector<std::string>& idx, const std::vector< std::vector<int> >& len,
+                        const std::string& idx_C, const std::vector<int>& len_C,
+                        const size_t elem_size, ProductPlan& plan);
+
+enum { kProductMaxExhaustive = 12 };
+
+}
+}
+
+#endif
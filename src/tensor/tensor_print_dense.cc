@@ -29,7 +29,22 @@
 namespace ambit {
 namespace tensor {
 
-int tensor_print_dense(const double* A, const int ndim_A, const int* len_A, const int* lda)
+namespace {
+
+void print_value(const double val)
+{
+    printf("%.15e\n", val);
+}
+
+void print_value(const std::complex<double> val)
+{
+    printf("(%.15e, %.15e)\n", val.real(), val.imag());
+}
+
+}
+
+template <typename T>
+int tensor_print_dense(const T* A, const int ndim_A, const int* len_A, const int* lda)
 {
     size_t off, size;
     int i;
@@ -70,7 +85,7 @@ int tensor_print_dense(const double* A, const int ndim_A, const int* len_A, cons
 #endif //CHECK_BOUNDS
 
         for (i = 0;i < ndim_A;i++) printf("%d ", pos[i]);
-        printf("%.15e\n", A[off]);
+        print_value(A[off]);
 
         for (i = 0;i < ndim_A;i++)
         {
@@ -102,5 +117,10 @@ int tensor_print_dense(const double* A, const int ndim_A, const int* len_A, cons
     return kTensorReturnCodeSuccess;
 }
 
+#define INSTANTIATE_PRINT_DENSE(T) \
+template int tensor_print_dense(const T* A, const int ndim_A, const int* len_A, const int* lda);
+
+INSTANTIATE_DENSE_KERNELS(INSTANTIATE_PRINT_DENSE)
+
 }
 }
@@ -23,23 +23,33 @@
  * SUCH DAMAGE. */
 
 #include "tensor.h"
+#include "tensor_kernels_dense.h"
+#include "tensor_plan_dense.h"
 #include "util.h"
 #include <string.h>
+#include <algorithm>
 
 namespace ambit {
 namespace tensor {
 
-int tensor_scale_dense_(const double alpha, double* restrict A, const int ndim_A, const int* restrict len_A, const int* restrict lda, const int* restrict idx_A)
+namespace {
+
+/*
+ * The number of contiguous elements in one unit of work, and the size below which scaling runs on a single thread
+ */
+enum { SCALE_RUN = 8192, SCALE_PARALLEL_MIN_SIZE = 65536 };
+
+}
+
+template <typename T>
+int tensor_scale_dense_(const T alpha, T* restrict A, const int ndim_A, const int* restrict len_A, const int* restrict lda, const int* restrict idx_A)
 {
     int i, j;
-    bool found, done;
+    bool found;
     int ndim_uniq;
-    int len_uniq[ndim_A];
+    size_t len_uniq[ndim_A];
     size_t stride[ndim_A];
-    size_t off;
     size_t inc[ndim_A];
-    size_t size;
-    int pos[ndim_A];
 
 #ifdef VALIDATE_INPUTS
     VALIDATE_TENSOR(ndim_A, len_A, lda, NULL);
@@ -56,15 +66,6 @@ int tensor_scale_dense_(const double alpha, double* restrict A, const int ndim_A
         for (i = 1;i < ndim_A;i++) stride[i] = stride[i-1]*lda[i];
     }
 
-    if (ndim_A > 0)
-    {
-        size = stride[ndim_A-1]*len_A[ndim_A-1];
-    }
-    else
-    {
-        size = 1;
-    }
-
     ndim_uniq = 0;
     memset(inc, 0, ndim_A*sizeof(size_t));
 
@@ -77,7 +78,7 @@ int tensor_scale_dense_(const double alpha, double* restrict A, const int ndim_A
             if (idx_A[i] == idx_A[j])
             {
 #ifdef VALIDATE_INPUTS
-                if (len_A[i] != len_A[j]) return TENSOR_LENGTH_MISMATCH;
+                if (len_A[i] != len_A[j]) return kTensorReturnCodeLengthMismatch;
 #endif //VALIDATE_INPUTS
                 found = true;
 #ifndef VALIDATE_INPUTS
@@ -99,56 +100,88 @@ int tensor_scale_dense_(const double alpha, double* restrict A, const int ndim_A
         }
     }
 
-    off = 0;
+    /*
+     * scaling by one changes nothing
+     */
+    if (alpha == T(1)) return kTensorReturnCodeSuccess;
 
     /*
-     * loop over elements in A
+     * order the indices by stride and fuse those which are contiguous, so that the innermost loop runs over
+     * as many contiguous elements as possible
      */
-    memset(pos, 0, ndim_uniq*sizeof(int));
-    for (done = false;!done;)
+    for (i = 1;i < ndim_uniq;i++)
     {
-#ifdef CHECK_BOUNDS
-        if (off < 0 || off >= size) return TENSOR_OUT_OF_BOUNDS;
-#endif //CHECK_BOUNDS
+        for (j = i;j > 0 && inc[j] < inc[j-1];j--)
+        {
+            std::swap(inc[j], inc[j-1]);
+            std::swap(len_uniq[j], len_uniq[j-1]);
+        }
+    }
 
-        if (alpha == 0.0)
+    for (i = 1;i < ndim_uniq;)
+    {
+        if (inc[i] == inc[i-1]*len_uniq[i-1])
         {
-            A[off] = 0.0;
+            len_uniq[i-1] *= len_uniq[i];
+            for (j = i+1;j < ndim_uniq;j++)
+            {
+                inc[j-1] = inc[j];
+                len_uniq[j-1] = len_uniq[j];
+            }
+            ndim_uniq--;
         }
         else
         {
-            A[off] *= alpha;
+            i++;
         }
+    }
+
+    const size_t len_inner = (ndim_uniq > 0 ? len_uniq[0] : 1);
+    const size_t inc_inner = (ndim_uniq > 0 ? inc[0] : 1);
+    const size_t nrun = (len_inner+SCALE_RUN-1)/SCALE_RUN;
+    size_t nouter = 1;
+    for (i = 1;i < ndim_uniq;i++) nouter *= len_uniq[i];
+    const size_t nwork = nouter*nrun;
+    const int nthread = (nouter*len_inner < SCALE_PARALLEL_MIN_SIZE ? 1 : tensor_get_num_threads());
 
-        for (i = 0;i < ndim_uniq;i++)
+    /*
+     * loop over runs of up to SCALE_RUN elements along the innermost index
+     */
+    #pragma omp parallel for num_threads(nthread) schedule(static) if (nthread > 1)
+    for (size_t w = 0;w < nwork;w++)
+    {
+        const size_t run = w%nrun;
+        const size_t n = std::min((size_t)SCALE_RUN, len_inner-run*SCALE_RUN);
+        size_t outer = w/nrun;
+        size_t off = run*SCALE_RUN*inc_inner;
+
+        for (int k = 1;k < ndim_uniq;k++)
         {
-            if (pos[i] == len_uniq[i] - 1)
-            {
-                pos[i] = 0;
-                off -= inc[i]*(len_uniq[i]-1);
-
-                if (i == ndim_uniq - 1)
-                {
-                    done = true;
-                    break;
-                }
-            }
-            else
-            {
-                pos[i]++;
-                off += inc[i];
-                break;
-            }
+            off += (outer%len_uniq[k])*inc[k];
+            outer /= len_uniq[k];
         }
 
-        if (ndim_uniq == 0) done = true;
+        if (inc_inner == 1)
+        {
+            DenseVector<T>::scale(n, alpha, A+off);
+        }
+        else if (alpha == T(0))
+        {
+            for (size_t k = 0;k < n;k++) A[off+k*inc_inner] = T(0);
+        }
+        else
+        {
+            for (size_t k = 0;k < n;k++) A[off+k*inc_inner] *= alpha;
+        }
     }
-    /*
-     * end loop over A
-     */
 
     return kTensorReturnCodeSuccess;
 }
 
+#define INSTANTIATE_SCALE_DENSE(T) \
+template int tensor_scale_dense_(const T alpha, T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A);
+
+INSTANTIATE_DENSE_KERNELS(INSTANTIATE_SCALE_DENSE)
+
 }
 }
@@ -28,8 +28,9 @@
 namespace ambit {
 namespace tensor {
 
-int tensor_slice_dense(const double*  A, const int  ndim_A, const int* len_A, const int* lda,
-                             double** B,       int* ndim_B,       int* len_B,       int* ldb,
+template <typename T>
+int tensor_slice_dense(const T*  A, const int  ndim_A, const int* len_A, const int* lda,
+                             T** B,       int* ndim_B,       int* len_B,       int* ldb,
                        const int* start, const int* len)
 {
     int i;
@@ -39,7 +40,7 @@ int tensor_slice_dense(const double*  A, const int  ndim_A, const int* len_A, co
     VALIDATE_TENSOR(ndim_A, len_A, lda, NULL);
 #endif //VALIDATE_INPUTS
 
-    *B = (double*)A;
+    *B = (T*)A;
     *ndim_B = 0;
 
     if (ndim_A > 0 && lda != NULL)
@@ -103,5 +104,12 @@ int tensor_slice_dense(const double*  A, const int  ndim_A, const int* len_A, co
     return kTensorReturnCodeSuccess;
 }
 
+#define INSTANTIATE_SLICE_DENSE(T) \
+template int tensor_slice_dense(const T*  A, const int  ndim_A, const int* len_A, const int* lda, \
+                                      T** B,       int* ndim_B,       int* len_B,       int* ldb, \
+                                const int* start, const int* len);
+
+INSTANTIATE_DENSE_KERNELS(INSTANTIATE_SLICE_DENSE)
+
 }
 }
@@ -34,18 +34,131 @@
  */
 
 #include "tensor.h"
+#include "tensor_loops_dense.h"
 #include "util.h"
 #include <string.h>
 
 namespace ambit {
 namespace tensor {
 
-int tensor_sum_dense_(const double alpha, const double* restrict A, const int ndim_A, const int* restrict len_A, const int* restrict lda, const int* restrict idx_A,
-                      const double beta,        double* restrict B, const int ndim_B, const int* restrict len_B, const int* restrict ldb, const int* restrict idx_B)
+namespace {
+
+/*
+ * Sum A over the A-only group
+ */
+template <typename T>
+struct SumTraceBody
+{
+    const T* restrict A;
+    T sum;
+
+    inline void operator()(const size_t off_A, const size_t off_B, const size_t off_C)
+    {
+        sum += A[off_A];
+    }
+};
+
+/*
+ * For one element of the AB group, trace over the A-only group and store to B
+ */
+template <int NA, bool BETA_ZERO, typename T>
+struct SumStoreBody
+{
+    const DenseGroup<NA>& uniq_A;
+    const T* restrict A;
+    T* restrict B;
+    T alpha, beta;
+
+    inline void operator()(const size_t off_A, const size_t off_B, const size_t off_C)
+    {
+        SumTraceBody<T> trace = {A, T(0)};
+        uniq_A.run(off_A, 0, 0, trace);
+
+        if (BETA_ZERO)
+        {
+            B[off_B] = alpha*trace.sum;
+        }
+        else
+        {
+            B[off_B] = alpha*trace.sum + beta*B[off_B];
+        }
+    }
+};
+
+template <int NAB, int NA, bool BETA_ZERO, typename T>
+void sum_unrolled_kernel(const T alpha, const T* restrict A, const T beta, T* restrict B,
+                         const int* len_AB, const size_t* inc_A_AB, const size_t* inc_B_AB,
+                         const int* len_A, const size_t* inc_A_A)
+{
+    DenseGroup<NAB> AB(len_AB, inc_A_AB, inc_B_AB, NULL);
+    DenseGroup<NA> uniq_A(len_A, inc_A_A, NULL, NULL);
+    SumStoreBody<NA,BETA_ZERO,T> body = {uniq_A, A, B, alpha, beta};
+
+    AB.run(0, 0, 0, body);
+}
+
+template <int NAB, bool BETA_ZERO, typename T>
+void sum_unrolled_A(const T alpha, const T* restrict A, const T beta, T* restrict B,
+                    const int* len_AB, const size_t* inc_A_AB, const size_t* inc_B_AB,
+                    const int ndim_A, const int* len_A, const size_t* inc_A_A)
+{
+    switch (ndim_A)
+    {
+        case 0: sum_unrolled_kernel<NAB,0,BETA_ZERO>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, len_A, inc_A_A); break;
+        case 1: sum_unrolled_kernel<NAB,1,BETA_ZERO>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, len_A, inc_A_A); break;
+        case 2: sum_unrolled_kernel<NAB,2,BETA_ZERO>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, len_A, inc_A_A); break;
+        case 3: sum_unrolled_kernel<NAB,3,BETA_ZERO>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, len_A, inc_A_A); break;
+        case 4: sum_unrolled_kernel<NAB,4,BETA_ZERO>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, len_A, inc_A_A); break;
+        case 5: sum_unrolled_kernel<NAB,5,BETA_ZERO>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, len_A, inc_A_A); break;
+        case 6: sum_unrolled_kernel<NAB,6,BETA_ZERO>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, len_A, inc_A_A); break;
+    }
+}
+
+template <int NAB, typename T>
+void sum_unrolled_beta(const T alpha, const T* restrict A, const T beta, T* restrict B,
+                       const int* len_AB, const size_t* inc_A_AB, const size_t* inc_B_AB,
+                       const int ndim_A, const int* len_A, const size_t* inc_A_A)
+{
+    if (beta == T(0))
+    {
+        sum_unrolled_A<NAB,true>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, ndim_A, len_A, inc_A_A);
+    }
+    else
+    {
+        sum_unrolled_A<NAB,false>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, ndim_A, len_A, inc_A_A);
+    }
+}
+
+/*
+ * Dispatch to the kernel specialized on the ranks of the AB and A-only groups (both at most
+ * kDenseMaxUnrolledRank, with no B-only indices)
+ */
+template <typename T>
+void sum_unrolled(const T alpha, const T* restrict A, const T beta, T* restrict B,
+                  const int ndim_AB, const int* len_AB, const size_t* inc_A_AB, const size_t* inc_B_AB,
+                  const int ndim_A, const int* len_A, const size_t* inc_A_A)
+{
+    switch (ndim_AB)
+    {
+        case 0: sum_unrolled_beta<0>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, ndim_A, len_A, inc_A_A); break;
+        case 1: sum_unrolled_beta<1>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, ndim_A, len_A, inc_A_A); break;
+        case 2: sum_unrolled_beta<2>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, ndim_A, len_A, inc_A_A); break;
+        case 3: sum_unrolled_beta<3>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, ndim_A, len_A, inc_A_A); break;
+        case 4: sum_unrolled_beta<4>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, ndim_A, len_A, inc_A_A); break;
+        case 5: sum_unrolled_beta<5>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, ndim_A, len_A, inc_A_A); break;
+        case 6: sum_unrolled_beta<6>(alpha, A, beta, B, len_AB, inc_A_AB, inc_B_AB, ndim_A, len_A, inc_A_A); break;
+    }
+}
+
+}
+
+template <typename T>
+int tensor_sum_dense_(const T alpha, const T* restrict A, const int ndim_A, const int* restrict len_A, const int* restrict lda, const int* restrict idx_A,
+                      const T beta,        T* restrict B, const int ndim_B, const int* restrict len_B, const int* restrict ldb, const int* restrict idx_B)
 {
     int i, j;
     bool found, done_A, done_B, done_AB;
-    double temp;
+    T temp;
     int ndim_uniq_A;
     int ndim_uniq_B;
     int ndim_uniq_AB;
@@ -69,6 +182,15 @@ int tensor_sum_dense_(const double alpha, const double* restrict A, const int nd
     VALIDATE_TENSOR(ndim_B, len_B, ldb, NULL);
 #endif //VALIDATE_INPUTS
 
+    /*
+     * pure permutations (including plain copies) are handed off to the transpose engine
+     */
+    if (tensor_is_permutation_dense(ndim_A, idx_A, ndim_B, idx_B))
+    {
+        return tensor_transpose_dense_(alpha, A, ndim_A, len_A, lda, idx_A,
+                                       beta,  B, ndim_B, len_B, ldb, idx_B);
+    }
+
     if (lda == NULL)
     {
         if (ndim_A > 0) stride_A[0] = 1;
@@ -239,6 +361,16 @@ int tensor_sum_dense_(const double alpha, const double* restrict A, const int nd
         }
     }
 
+    /*
+     * traces and diagonals of low rank (no replicated indices) use the rank-specialized kernels
+     */
+    if (ndim_uniq_B == 0 && ndim_uniq_AB <= kDenseMaxUnrolledRank && ndim_uniq_A <= kDenseMaxUnrolledRank)
+    {
+        sum_unrolled(alpha, A, beta, B, ndim_uniq_AB, len_uniq_AB, inc_A_AB, inc_B_AB,
+                                        ndim_uniq_A, len_uniq_A, inc_A_A);
+        return kTensorReturnCodeSuccess;
+    }
+
     off_A = 0;
     off_B = 0;
 
@@ -248,7 +380,7 @@ int tensor_sum_dense_(const double alpha, const double* restrict A, const int nd
     memset(pos_AB, 0, ndim_uniq_AB*sizeof(int));
     for (done_AB = false;!done_AB;)
     {
-        temp = 0.0;
+        temp = T(0);
 
         /*
          * loop over elements in A to be summed onto this element of B
@@ -301,7 +433,7 @@ int tensor_sum_dense_(const double alpha, const double* restrict A, const int nd
             if (off_B < 0 || off_B >= size_B) return TENSOR_OUT_OF_BOUNDS;
 #endif //CHECK_BOUNDS
 
-            if (beta == 0.0)
+            if (beta == T(0))
             {
                 B[off_B] = temp;
             }
@@ -369,5 +501,11 @@ int tensor_sum_dense_(const double alpha, const double* restrict A, const int nd
     return kTensorReturnCodeSuccess;
 }
 
+#define INSTANTIATE_SUM_DENSE(T) \
+template int tensor_sum_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A, \
+                               const T beta,        T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B);
+
+INSTANTIATE_DENSE_KERNELS(INSTANTIATE_SUM_DENSE)
+
 }
 }
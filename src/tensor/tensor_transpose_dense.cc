@@ -0,0 +1,439 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * Permute the indices of a tensor and sum onto a second, B = alpha*P(A) + beta*B.
+ *
+ * Indices of length one are dropped and indices which are adjacent in both A and B are fused. If the
+ * fastest-varying index is then the same in A and B, the permutation is a set of strided copies along it.
+ * Otherwise, the indices which vary fastest in A (a) and in B (b) are tiled so that each TILE x TILE block
+ * of both A and B stays in cache while it is transposed, 4 x 4 at a time in SIMD registers where the
+ * strides allow. The copies or tiles are divided among threads; each element of B is written by one thread.
+ */
+
+#include "tensor.h"
+#include "tensor_kernels_dense.h"
+#include "tensor_plan_dense.h"
+#include "util.h"
+
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace ambit {
+namespace tensor {
+
+namespace {
+
+/*
+ * Blocking parameters: the cache tile, the number of elements in one unit of work for copies, and the
+ * size below which a permutation runs on a single thread
+ */
+enum { TRANSPOSE_TILE = 32, TRANSPOSE_RUN = 4096, TRANSPOSE_PARALLEL_MIN_SIZE = 32768 };
+
+struct transpose_index
+{
+    size_t len;
+    size_t stride_A;
+    size_t stride_B;
+};
+
+bool stride_B_less(const transpose_index& a, const transpose_index& b) { return a.stride_B < b.stride_B; }
+
+/*
+ * Position an odometer over the indices in outer at linear element n, returning the offsets in A and B
+ */
+void transpose_seek(const std::vector<transpose_index>& outer, size_t n, size_t& off_A, size_t& off_B)
+{
+    off_A = 0;
+    off_B = 0;
+
+    for (size_t i = 0;i < outer.size();i++)
+    {
+        const size_t pos = n%outer[i].len;
+        n /= outer[i].len;
+
+        off_A += pos*outer[i].stride_A;
+        off_B += pos*outer[i].stride_B;
+    }
+}
+
+/*
+ * B[0:n:inc_B] = alpha*A[0:n:inc_A] + beta*B[0:n:inc_B]
+ */
+template <typename T>
+void transpose_copy(const int n, const T alpha, const T* restrict A, const size_t inc_A,
+                                 const T beta,        T* restrict B, const size_t inc_B)
+{
+    if (inc_A == 1 && inc_B == 1)
+    {
+        DenseVector<T>::axpby(n, alpha, A, beta, B);
+    }
+    else
+    {
+        if (beta == T(0))
+        {
+            for (int i = 0;i < n;i++) B[i*inc_B] = alpha*A[i*inc_A];
+        }
+        else
+        {
+            for (int i = 0;i < n;i++) B[i*inc_B] = alpha*A[i*inc_A] + beta*B[i*inc_B];
+        }
+    }
+}
+
+/*
+ * Transpose a 4 x 4 block in which A is contiguous along a and B is contiguous along b
+ */
+template <typename T>
+inline void transpose_micro_4x4(const T alpha, const T* restrict A, const size_t ld_A,
+                                const T beta,        T* restrict B, const size_t ld_B)
+{
+    for (int i = 0;i < 4;i++)
+    {
+        for (int j = 0;j < 4;j++)
+        {
+            if (beta == T(0))
+                B[i*ld_B+j] = alpha*A[j*ld_A+i];
+            else
+                B[i*ld_B+j] = alpha*A[j*ld_A+i] + beta*B[i*ld_B+j];
+        }
+    }
+}
+
+#if defined(__SSE2__)
+
+/*
+ * Transpose a 2 x 2 block held in two registers and store it into B
+ */
+inline void transpose_store_2x2(const __m128d a0, const __m128d a1, const __m128d alpha, const double beta,
+                                double* restrict B0, double* restrict B1)
+{
+    __m128d b0 = _mm_mul_pd(alpha, _mm_unpacklo_pd(a0, a1));
+    __m128d b1 = _mm_mul_pd(alpha, _mm_unpackhi_pd(a0, a1));
+
+    if (beta != 0.0)
+    {
+        const __m128d vbeta = _mm_set1_pd(beta);
+        b0 = _mm_add_pd(b0, _mm_mul_pd(vbeta, _mm_loadu_pd(B0)));
+        b1 = _mm_add_pd(b1, _mm_mul_pd(vbeta, _mm_loadu_pd(B1)));
+    }
+
+    _mm_storeu_pd(B0, b0);
+    _mm_storeu_pd(B1, b1);
+}
+
+#endif
+
+/*
+ * As above, in SIMD registers for double
+ */
+inline void transpose_micro_4x4(const double alpha, const double* restrict A, const size_t ld_A,
+                                const double beta,        double* restrict B, const size_t ld_B)
+{
+#if defined(__AVX__)
+    const __m256d valpha = _mm256_set1_pd(alpha);
+
+    __m256d r0 = _mm256_loadu_pd(A       );
+    __m256d r1 = _mm256_loadu_pd(A+  ld_A);
+    __m256d r2 = _mm256_loadu_pd(A+2*ld_A);
+    __m256d r3 = _mm256_loadu_pd(A+3*ld_A);
+
+    __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+    __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+    __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+    __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+
+    __m256d c0 = _mm256_mul_pd(valpha, _mm256_permute2f128_pd(t0, t2, 0x20));
+    __m256d c1 = _mm256_mul_pd(valpha, _mm256_permute2f128_pd(t1, t3, 0x20));
+    __m256d c2 = _mm256_mul_pd(valpha, _mm256_permute2f128_pd(t0, t2, 0x31));
+    __m256d c3 = _mm256_mul_pd(valpha, _mm256_permute2f128_pd(t1, t3, 0x31));
+
+    if (beta != 0.0)
+    {
+        const __m256d vbeta = _mm256_set1_pd(beta);
+        c0 = _mm256_add_pd(c0, _mm256_mul_pd(vbeta, _mm256_loadu_pd(B       )));
+        c1 = _mm256_add_pd(c1, _mm256_mul_pd(vbeta, _mm256_loadu_pd(B+  ld_B)));
+        c2 = _mm256_add_pd(c2, _mm256_mul_pd(vbeta, _mm256_loadu_pd(B+2*ld_B)));
+        c3 = _mm256_add_pd(c3, _mm256_mul_pd(vbeta, _mm256_loadu_pd(B+3*ld_B)));
+    }
+
+    _mm256_storeu_pd(B       , c0);
+    _mm256_storeu_pd(B+  ld_B, c1);
+    _mm256_storeu_pd(B+2*ld_B, c2);
+    _mm256_storeu_pd(B+3*ld_B, c3);
+#elif defined(__SSE2__)
+    const __m128d valpha = _mm_set1_pd(alpha);
+
+    for (int j = 0;j < 4;j += 2)
+    {
+        for (int i = 0;i < 4;i += 2)
+        {
+            const __m128d a0 = _mm_loadu_pd(A+ j   *ld_A+i);
+            const __m128d a1 = _mm_loadu_pd(A+(j+1)*ld_A+i);
+            transpose_store_2x2(a0, a1, valpha, beta, B+i*ld_B+j, B+(i+1)*ld_B+j);
+        }
+    }
+#else
+    transpose_micro_4x4<double>(alpha, A, ld_A, beta, B, ld_B);
+#endif
+}
+
+/*
+ * Transpose an n_a x n_b tile, where element (i,j) is A[i*inc_A_a+j*inc_A_b] and B[i*inc_B_a+j*inc_B_b]
+ */
+template <typename T>
+void transpose_tile(const int n_a, const int n_b,
+                    const T alpha, const T* restrict A, const size_t inc_A_a, const size_t inc_A_b,
+                    const T beta,        T* restrict B, const size_t inc_B_a, const size_t inc_B_b)
+{
+    int i0 = 0;
+
+    if (inc_A_a == 1 && inc_B_b == 1)
+    {
+        const int n_a4 = n_a - n_a%4;
+        const int n_b4 = n_b - n_b%4;
+
+        for (int i = 0;i < n_a4;i += 4)
+        {
+            for (int j = 0;j < n_b4;j += 4)
+            {
+                transpose_micro_4x4(alpha, A+i+j*inc_A_b, inc_A_b,
+                                    beta,  B+i*inc_B_a+j, inc_B_a);
+            }
+        }
+
+        /*
+         * the remaining columns here, and the remaining rows below
+         */
+        for (int i = 0;i < n_a4;i++)
+        {
+            transpose_copy(n_b-n_b4, alpha, A+i+n_b4*inc_A_b, inc_A_b,
+                                     beta,  B+i*inc_B_a+n_b4, 1);
+        }
+
+        i0 = n_a4;
+    }
+
+    for (int i = i0;i < n_a;i++)
+    {
+        transpose_copy(n_b, alpha, A+i*inc_A_a, inc_A_b,
+                            beta,  B+i*inc_B_a, inc_B_b);
+    }
+}
+
+}
+
+bool tensor_is_permutation_dense(const int ndim_A, const int* idx_A,
+                                 const int ndim_B, const int* idx_B)
+{
+    if (ndim_A != ndim_B) return false;
+
+    for (int i = 0;i < ndim_A;i++)
+    {
+        int count_A = 0, count_B = 0;
+
+        for (int j = 0;j < ndim_A;j++)
+        {
+            if (idx_A[j] == idx_A[i]) count_A++;
+            if (idx_B[j] == idx_A[i]) count_B++;
+        }
+
+        if (count_A != 1 || count_B != 1) return false;
+    }
+
+    return true;
+}
+
+template <typename T>
+int tensor_transpose_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A,
+                            const T beta,        T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B)
+{
+    std::vector<transpose_index> indices;
+    size_t stride_A[ndim_A];
+    size_t stride_B[ndim_B];
+    size_t size = 1;
+
+#ifdef VALIDATE_INPUTS
+    VALIDATE_TENSOR(ndim_A, len_A, lda, NULL);
+    VALIDATE_TENSOR(ndim_B, len_B, ldb, NULL);
+#endif //VALIDATE_INPUTS
+
+    if (!tensor_is_permutation_dense(ndim_A, idx_A, ndim_B, idx_B)) return kTensorReturnCodeIndexMismatch;
+
+    if (lda == NULL)
+    {
+        if (ndim_A > 0) stride_A[0] = 1;
+        for (int i = 1;i < ndim_A;i++) stride_A[i] = stride_A[i-1]*len_A[i-1];
+    }
+    else
+    {
+        if (ndim_A > 0) stride_A[0] = lda[0];
+        for (int i = 1;i < ndim_A;i++) stride_A[i] = stride_A[i-1]*lda[i];
+    }
+
+    if (ldb == NULL)
+    {
+        if (ndim_B > 0) stride_B[0] = 1;
+        for (int i = 1;i < ndim_B;i++) stride_B[i] = stride_B[i-1]*len_B[i-1];
+    }
+    else
+    {
+        if (ndim_B > 0) stride_B[0] = ldb[0];
+        for (int i = 1;i < ndim_B;i++) stride_B[i] = stride_B[i-1]*ldb[i];
+    }
+
+    /*
+     * pair up the indices of A and B, dropping those of length one
+     */
+    for (int i = 0;i < ndim_B;i++)
+    {
+        for (int j = 0;j < ndim_A;j++)
+        {
+            if (idx_A[j] != idx_B[i]) continue;
+
+#ifdef VALIDATE_INPUTS
+            if (len_A[j] != len_B[i]) return kTensorReturnCodeLengthMismatch;
+#endif //VALIDATE_INPUTS
+
+            if (len_B[i] == 0) return kTensorReturnCodeSuccess;
+            if (len_B[i] == 1) continue;
+
+            transpose_index ti;
+            ti.len = len_B[i];
+            ti.stride_A = stride_A[j];
+            ti.stride_B = stride_B[i];
+            indices.push_back(ti);
+            size *= ti.len;
+        }
+    }
+
+    /*
+     * fuse indices which are adjacent in both A and B
+     */
+    std::sort(indices.begin(), indices.end(), stride_B_less);
+
+    for (size_t i = 1;i < indices.size();)
+    {
+        transpose_index& prev = indices[i-1];
+
+        if (indices[i].stride_A == prev.stride_A*prev.len &&
+            indices[i].stride_B == prev.stride_B*prev.len)
+        {
+            prev.len *= indices[i].len;
+            indices.erase(indices.begin()+i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    const int nthread = (size < TRANSPOSE_PARALLEL_MIN_SIZE ? 1 : tensor_get_num_threads());
+
+    if (indices.empty())
+    {
+        transpose_copy(1, alpha, A, 1, beta, B, 1);
+        return kTensorReturnCodeSuccess;
+    }
+
+    size_t a = 0;
+    for (size_t i = 1;i < indices.size();i++)
+    {
+        if (indices[i].stride_A < indices[a].stride_A) a = i;
+    }
+
+    if (a == 0)
+    {
+        /*
+         * the same index varies fastest in A and B, so copy along it
+         */
+        const transpose_index fast = indices[0];
+        std::vector<transpose_index> outer(indices.begin()+1, indices.end());
+        const size_t nrun = (fast.len+TRANSPOSE_RUN-1)/TRANSPOSE_RUN;
+        size_t nouter = 1;
+        for (size_t i = 0;i < outer.size();i++) nouter *= outer[i].len;
+        const size_t nwork = nouter*nrun;
+
+        #pragma omp parallel for num_threads(nthread) schedule(static) if (nthread > 1)
+        for (size_t w = 0;w < nwork;w++)
+        {
+            const size_t run = w%nrun;
+            const int n = std::min((size_t)TRANSPOSE_RUN, fast.len-run*TRANSPOSE_RUN);
+            size_t off_A, off_B;
+
+            transpose_seek(outer, w/nrun, off_A, off_B);
+            off_A += run*TRANSPOSE_RUN*fast.stride_A;
+            off_B += run*TRANSPOSE_RUN*fast.stride_B;
+
+            transpose_copy(n, alpha, A+off_A, fast.stride_A, beta, B+off_B, fast.stride_B);
+        }
+    }
+    else
+    {
+        /*
+         * tile the fastest indices of A (a) and B (b)
+         */
+        const transpose_index fast_a = indices[a];
+        const transpose_index fast_b = indices[0];
+        std::vector<transpose_index> outer;
+        for (size_t i = 1;i < indices.size();i++)
+        {
+            if (i != a) outer.push_back(indices[i]);
+        }
+
+        const size_t ntile_a = (fast_a.len+TRANSPOSE_TILE-1)/TRANSPOSE_TILE;
+        const size_t ntile_b = (fast_b.len+TRANSPOSE_TILE-1)/TRANSPOSE_TILE;
+        size_t nouter = 1;
+        for (size_t i = 0;i < outer.size();i++) nouter *= outer[i].len;
+        const size_t nwork = nouter*ntile_a*ntile_b;
+
+        #pragma omp parallel for num_threads(nthread) schedule(static) if (nthread > 1)
+        for (size_t w = 0;w < nwork;w++)
+        {
+            const size_t tile_b = w%ntile_b;
+            const size_t tile_a = (w/ntile_b)%ntile_a;
+            const size_t i0 = tile_a*TRANSPOSE_TILE;
+            const size_t j0 = tile_b*TRANSPOSE_TILE;
+            const int n_a = std::min((size_t)TRANSPOSE_TILE, fast_a.len-i0);
+            const int n_b = std::min((size_t)TRANSPOSE_TILE, fast_b.len-j0);
+            size_t off_A, off_B;
+
+            transpose_seek(outer, w/(ntile_a*ntile_b), off_A, off_B);
+            off_A += i0*fast_a.stride_A + j0*fast_b.stride_A;
+            off_B += i0*fast_a.stride_B + j0*fast_b.stride_B;
+
+            transpose_tile(n_a, n_b, alpha, A+off_A, fast_a.stride_A, fast_b.stride_A,
+                                     beta,  B+off_B, fast_a.stride_B, fast_b.stride_B);
+        }
+    }
+
+    return kTensorReturnCodeSuccess;
+}
+
+#define INSTANTIATE_TRANSPOSE_DENSE(T) \
+template int tensor_transpose_dense_(const T alpha, const T* A, const int ndim_A, const int* len_A, const int* lda, const int* idx_A, \
+                                     const T beta,        T* B, const int ndim_B, const int* len_B, const int* ldb, const int* idx_B);
+
+INSTANTIATE_DENSE_KERNELS(INSTANTIATE_TRANSPOSE_DENSE)
+
+}
+}
@@ -0,0 +1,92 @@
+/*
+ *  Copyright (C) 2013  Justin Turney
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#if !defined(AMBIT_LIB_UTIL_BLAS)
+#define AMBIT_LIB_UTIL_BLAS
+
+#include <complex>
+
+/*
+ * Fortran BLAS entry points from the LAPACK/BLAS libraries found by the top-level CMakeLists.txt.
+ */
+extern "C" {
+
+void dgemm_(const char* transa, const char* transb, const int* m, const int* n, const int* k,
+            const double* alpha, const double* a, const int* lda,
+                                 const double* b, const int* ldb,
+            const double* beta,        double* c, const int* ldc);
+
+void sgemm_(const char* transa, const char* transb, const int* m, const int* n, const int* k,
+            const float* alpha, const float* a, const int* lda,
+                                const float* b, const int* ldb,
+            const float* beta,        float* c, const int* ldc);
+
+void cgemm_(const char* transa, const char* transb, const int* m, const int* n, const int* k,
+            const std::complex<float>* alpha, const std::complex<float>* a, const int* lda,
+                                              const std::complex<float>* b, const int* ldb,
+            const std::complex<float>* beta,        std::complex<float>* c, const int* ldc);
+
+void zgemm_(const char* transa, const char* transb, const int* m, const int* n, const int* k,
+            const std::complex<double>* alpha, const std::complex<double>* a, const int* lda,
+                                               const std::complex<double>* b, const int* ldb,
+            const std::complex<double>* beta,        std::complex<double>* c, const int* ldc);
+
+}
+
+namespace ambit {
+namespace util {
+
+/**
+ * C = alpha*op(A)*op(B) + beta*C, with all matrices in column-major order.
+ */
+inline void gemm(const char transa, const char transb, const int m, const int n, const int k,
+                 const double alpha, const double* a, const int lda,
+                                     const double* b, const int ldb,
+                 const double beta,        double* c, const int ldc)
+{
+    dgemm_(&transa, &transb, &m, &n, &k, &alpha, a, &lda, b, &ldb, &beta, c, &ldc);
+}
+
+inline void gemm(const char transa, const char transb, const int m, const int n, const int k,
+                 const float alpha, const float* a, const int lda,
+                                    const float* b, const int ldb,
+                 const float beta,        float* c, const int ldc)
+{
+    sgemm_(&transa, &transb, &m, &n, &k, &alpha, a, &lda, b, &ldb, &beta, c, &ldc);
+}
+
+inline void gemm(const char transa, const char transb, const int m, const int n, const int k,
+                 const std::complex<float> alpha, const std::complex<float>* a, const int lda,
+                                                  const std::complex<float>* b, const int ldb,
+                 const std::complex<float> beta,        std::complex<float>* c, const int ldc)
+{
+    cgemm_(&transa, &transb, &m, &n, &k, &alpha, a, &lda, b, &ldb, &beta, c, &ldc);
+}
+
+inline void gemm(const char transa, const char transb, const int m, const int n, const int k,
+                 const std::complex<double> alpha, const std::complex<double>* a, const int lda,
+                                                   const std::complex<double>* b, const int ldb,
+                 const std::complex<double> beta,        std::complex<double>* c, const int ldc)
+{
+    zgemm_(&transa, &transb, &m, &n, &k, &alpha, a, &lda, b, &ldb, &beta, c, &ldc);
+}
+
+}
+}
+
+#endif
@@ -19,22 +19,381 @@
 #include "memory.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
 
 #include <iostream>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace ambit {
 namespace util {
 
-void* ambit_malloc(const size_t size_, const char* file, const int line, const int bailout)
+size_t mem_used = 0;
+
+namespace {
+
+enum { kBlockSystem, kBlockPool, kBlockArena };
+
+/*
+ * Stored in the ALIGNMENT bytes before each block
+ */
+struct block_header
+{
+    size_t size;
+    int kind;
+    int policy;
+    int line;
+    const char* file;
+    memory_arena* owner;
+};
+
+static_assert(sizeof(block_header) <= ALIGNMENT, "block header does not fit in the alignment");
+
+const size_t min_pooled = 4096;
+
+/*
+ * Pooled blocks are not counted as in use, so the pool is bounded by default to keep memory freed by workloads of
+ * varying sizes from accumulating out of sight
+ */
+const size_t default_pool_limit = size_t(1) << 30;
+
+/*
+ * The size class of a block of size bytes: size rounded up to a multiple of a quarter of the next smaller power of
+ * two, or zero for blocks too small to pool
+ */
+size_t size_class(const size_t size)
+{
+    if (size <= min_pooled) return 0;
+
+    size_t p = 1;
+    while ((p << 1) < size) p <<= 1;
+
+    const size_t q = p/4;
+    return (size+q-1)/q*q;
+}
+
+/*
+ * Blocks are pooled by size class and placement policy
+ */
+typedef std::map< std::pair<size_t,int>, std::vector<char*> > pooled_blocks;
+
+struct block_pool
+{
+    std::mutex lock;
+    pooled_blocks blocks;
+    size_t cached;
+    size_t limit;
+
+    block_pool() : cached(0), limit(default_pool_limit) {}
+};
+
+/*
+ * Never destroyed, so that blocks may be freed during static destruction
+ */
+block_pool& pool()
+{
+    static block_pool* p = new block_pool();
+    return *p;
+}
+
+/*
+ * Release pooled blocks, largest first, until at most bytes remain; the caller holds the lock
+ */
+void trim_locked(block_pool& p, const size_t bytes)
+{
+    while (p.cached > bytes && !p.blocks.empty())
+    {
+        pooled_blocks::iterator it = --p.blocks.end();
+
+        while (!it->second.empty() && p.cached > bytes)
+        {
+            free(it->second.back());
+            it->second.pop_back();
+            p.cached -= it->first.first;
+        }
+
+        if (it->second.empty()) p.blocks.erase(it);
+    }
+}
+
+/*
+ * Placement policies only apply to blocks of at least one huge page, which are aligned to one
+ */
+const size_t huge_page = size_t(2) << 20;
+
+std::atomic<int> global_policy(kMemoryFirstTouch);
+
+int& scoped_policy()
+{
+    static thread_local int policy = -1;
+    return policy;
+}
+
+/*
+ * The policy for a new block of size bytes
+ */
+int block_policy(const size_t size)
+{
+    if (size < huge_page) return kMemoryFirstTouch;
+    return (scoped_policy() >= 0 ? scoped_policy() : global_policy.load());
+}
+
+int num_nodes()
+{
+    static const int n = []
+    {
+        int n = 0;
+#if defined(__linux__)
+        while (n < 64)
+        {
+            std::ostringstream os;
+            os << "/sys/devices/system/node/node" << n;
+            if (access(os.str().c_str(), F_OK) != 0) break;
+            n++;
+        }
+#endif
+        return std::max(n, 1);
+    }();
+    return n;
+}
+
+/*
+ * Apply a placement policy to the pages wholly inside [ptr, ptr+size); return 0 on success (or if there is nothing to
+ * do) and -1 on failure
+ */
+int apply_policy(void* ptr, const size_t size, const int policy, const bool move)
+{
+#if defined(__linux__)
+    const size_t page = sysconf(_SC_PAGESIZE);
+    char* begin = (char*)(((uintptr_t)ptr+page-1)/page*page);
+    char* end = (char*)(((uintptr_t)ptr+size)/page*page);
+    if (end <= begin) return 0;
+
+    int ret = 0;
+
+#if defined(MADV_HUGEPAGE)
+    if ((policy & kMemoryHugePages) && madvise(begin, end-begin, MADV_HUGEPAGE) != 0) ret = -1;
+#endif
+
+#if defined(SYS_mbind)
+    /*
+     * called directly to avoid depending on libnuma; the constants are those of linux/mempolicy.h
+     */
+    const int mpol_bind = 2, mpol_interleave = 3;
+    const unsigned mpol_mf_move = 1u << 1;
+    const int placement = policy & 3;
+    const int nnode = num_nodes();
+
+    if (placement != kMemoryFirstTouch && nnode > 1)
+    {
+        unsigned long mask;
+        int mode;
+
+        if (placement == kMemoryInterleave)
+        {
+            mask = (nnode >= 64 ? ~0ul : (1ul << nnode)-1);
+            mode = mpol_interleave;
+        }
+        else
+        {
+            mask = 1ul << (memory_policy_node(policy) % nnode);
+            mode = mpol_bind;
+        }
+
+        if (syscall(SYS_mbind, begin, end-begin, mode, &mask, 64, move ? mpol_mf_move : 0) != 0) ret = -1;
+    }
+#endif
+
+    return ret;
+#else
+    return (policy == kMemoryFirstTouch ? 0 : -1);
+#endif
+}
+
+/*
+ * Allocate a block with room for size bytes after its header, from the pool if possible; return the start of the
+ * header (and the usable size in size), or NULL
+ */
+char* acquire(size_t& size, const int policy)
+{
+    const size_t cls = size_class(size);
+    block_pool& p = pool();
+
+    if (cls != 0)
+    {
+        std::lock_guard<std::mutex> guard(p.lock);
+        pooled_blocks::iterator it = p.blocks.find(std::make_pair(cls, policy));
+
+        if (it != p.blocks.end() && !it->second.empty())
+        {
+            char* base = it->second.back();
+            it->second.pop_back();
+            p.cached -= cls;
+            size = cls;
+            return base;
+        }
+    }
+
+    if (cls != 0) size = cls;
+
+    const size_t alignment = (policy == kMemoryFirstTouch ? (size_t)ALIGNMENT : huge_page);
+
+    void* mem;
+    if (posix_memalign(&mem, alignment, ALIGNMENT + size) != 0)
+    {
+        /*
+         * Try again after returning the pool to the system
+         */
+        {
+            std::lock_guard<std::mutex> guard(p.lock);
+            if (p.cached == 0) return NULL;
+            trim_locked(p, 0);
+        }
+
+        if (posix_memalign(&mem, alignment, ALIGNMENT + size) != 0) return NULL;
+    }
+
+    /*
+     * the pages are untouched, so they are placed by the policy when first written
+     */
+    if (policy != kMemoryFirstTouch) apply_policy(mem, ALIGNMENT + size, policy, false);
+
+    return (char*)mem;
+}
+
+/*
+ * Return a block acquired with the given usable size to the pool, or to the system
+ */
+void release(char* base, const size_t size, const int policy)
+{
+    const size_t cls = size_class(size);
+    block_pool& p = pool();
+
+    if (cls == size)
+    {
+        std::lock_guard<std::mutex> guard(p.lock);
+
+        if (p.cached + cls <= p.limit && p.limit >= cls)
+        {
+            p.blocks[std::make_pair(cls, policy)].push_back(base);
+            p.cached += cls;
+            return;
+        }
+    }
+
+    free(base);
+}
+
+/*
+ * Accounting of the bytes allocated, in total and by call site
+ */
+struct site_usage
+{
+    size_t used;
+    size_t peak;
+    size_t count;
+};
+
+struct memory_accounts
+{
+    std::mutex lock;
+    std::map< std::pair<const char*,int>, site_usage > sites;
+    size_t peak;
+    size_t budget;
+
+    memory_accounts() : peak(0), budget(0) {}
+};
+
+memory_accounts& accounts()
+{
+    static memory_accounts* a = new memory_accounts();
+    return *a;
+}
+
+const char* arena_site = "memory_arena";
+
+/*
+ * Record the allocation of size bytes by file:line, if it fits in the budget (after trimming the pool if needed);
+ * otherwise throw a memory_budget_error if bailout, or return false
+ */
+bool reserve(const size_t size, const char* file, const int line, const int bailout)
+{
+    memory_accounts& a = accounts();
+    std::unique_lock<std::mutex> guard(a.lock);
+
+    if (a.budget != 0)
+    {
+        if (size > a.budget || mem_used > a.budget-size)
+        {
+            const size_t used = mem_used, budget = a.budget;
+            guard.unlock();
+            if (bailout) throw memory_budget_error(size, used, budget, file, line);
+            return false;
+        }
+
+        if (ambit_pool_get_cached() > a.budget-size-mem_used)
+            ambit_pool_trim(a.budget-size-mem_used);
+    }
+
+    mem_used += size;
+    a.peak = std::max(a.peak, mem_used);
+
+    site_usage& s = a.sites[std::make_pair(file, line)];
+    s.used += size;
+    s.peak = std::max(s.peak, s.used);
+    s.count++;
+
+    return true;
+}
+
+void unreserve(const size_t size, const char* file, const int line)
+{
+    memory_accounts& a = accounts();
+    std::lock_guard<std::mutex> guard(a.lock);
+
+    mem_used -= size;
+    a.sites[std::make_pair(file, line)].used -= size;
+}
+
+memory_arena*& current_arena()
 {
-    assert(ALIGNMENT >= sizeof(size_t));
+    static thread_local memory_arena* active = NULL;
+    return active;
+}
 
+}
+
+void* ambit_malloc(const size_t size_, const char* file, const int line, const int bailout)
+{
     size_t size = std::max(size_, size_t(1));
 
-    void *mem;
-    if (posix_memalign(&mem, ALIGNMENT, size) != 0) {
+    memory_arena* arena = current_arena();
+    if (arena != NULL)
+    {
+        void* mem = arena->allocate(size);
+        if (mem != NULL) return mem;
+    }
+
+    size_t usable = std::max(size_class(size), size);
+    if (!reserve(usable, file, line, bailout)) return NULL;
+
+    const int policy = block_policy(usable);
+    char* base = acquire(usable, policy);
+
+    if (base == NULL) {
+        unreserve(usable, file, line);
         std::cerr
             << " => MEMORY ALLOCATION FAILURE <=\n"
             << "ambit_malloc: Aligned memory allocation failed.\n"
@@ -47,13 +406,271 @@ void* ambit_malloc(const size_t size_, const char* file, const int line, const i
         return NULL;
     }
 
-    return (void*)((intptr_t)mem);
+    block_header* header = (block_header*)base;
+    header->size = usable;
+    header->kind = (size_class(usable) == 0 ? kBlockSystem : kBlockPool);
+    header->policy = policy;
+    header->line = line;
+    header->file = file;
+    header->owner = NULL;
+
+    return base + ALIGNMENT;
 }
 
 void ambit_free(void* ptr, const char* file, const int line)
 {
     if (ptr == NULL) return;
-    free(ptr);
+
+    char* base = (char*)ptr - ALIGNMENT;
+    block_header* header = (block_header*)base;
+
+    switch (header->kind)
+    {
+        case kBlockArena:
+            if (header->owner == current_arena()) header->owner->deallocate(ptr);
+            break;
+        case kBlockPool:
+            unreserve(header->size, header->file, header->line);
+            release(base, header->size, header->policy);
+            break;
+        default:
+            unreserve(header->size, header->file, header->line);
+            free(base);
+            break;
+    }
+}
+
+void ambit_pool_set_limit(const size_t bytes)
+{
+    block_pool& p = pool();
+    std::lock_guard<std::mutex> guard(p.lock);
+    p.limit = bytes;
+    trim_locked(p, bytes);
+}
+
+size_t ambit_pool_get_limit()
+{
+    block_pool& p = pool();
+    std::lock_guard<std::mutex> guard(p.lock);
+    return p.limit;
+}
+
+size_t ambit_pool_get_cached()
+{
+    block_pool& p = pool();
+    std::lock_guard<std::mutex> guard(p.lock);
+    return p.cached;
+}
+
+void ambit_pool_trim(const size_t bytes)
+{
+    block_pool& p = pool();
+    std::lock_guard<std::mutex> guard(p.lock);
+    trim_locked(p, bytes);
+}
+
+void ambit_set_memory_policy(const int policy)
+{
+    global_policy = policy;
+}
+
+int ambit_get_memory_policy()
+{
+    return (scoped_policy() >= 0 ? scoped_policy() : global_policy.load());
+}
+
+int ambit_apply_memory_policy(void* ptr, const size_t size, const int policy)
+{
+    return apply_policy(ptr, size, policy, true);
+}
+
+memory_policy_scope::memory_policy_scope(const int policy)
+    : parent_(scoped_policy())
+{
+    scoped_policy() = policy;
+}
+
+memory_policy_scope::~memory_policy_scope()
+{
+    scoped_policy() = parent_;
+}
+
+memory_budget_error::memory_budget_error(const size_t requested, const size_t used, const size_t budget,
+                                         const char* file, const int line)
+    : requested_(requested), used_(used), budget_(budget)
+{
+    std::ostringstream os;
+    os << "memory budget exceeded: " << requested << " bytes requested at " << file << ":" << line
+       << " with " << used << " of " << budget << " bytes in use";
+    what_ = os.str();
+}
+
+void ambit_memory_set_budget(const size_t bytes)
+{
+    memory_accounts& a = accounts();
+    std::lock_guard<std::mutex> guard(a.lock);
+    a.budget = bytes;
+}
+
+size_t ambit_memory_get_budget()
+{
+    memory_accounts& a = accounts();
+    std::lock_guard<std::mutex> guard(a.lock);
+    return a.budget;
+}
+
+size_t ambit_memory_used()
+{
+    memory_accounts& a = accounts();
+    std::lock_guard<std::mutex> guard(a.lock);
+    return mem_used;
+}
+
+size_t ambit_memory_peak()
+{
+    memory_accounts& a = accounts();
+    std::lock_guard<std::mutex> guard(a.lock);
+    return a.peak;
+}
+
+void ambit_memory_reset_peak()
+{
+    memory_accounts& a = accounts();
+    std::lock_guard<std::mutex> guard(a.lock);
+    a.peak = mem_used;
+    for (std::map< std::pair<const char*,int>, site_usage >::iterator it = a.sites.begin();it != a.sites.end();++it)
+        it->second.peak = it->second.used;
+}
+
+size_t ambit_memory_available()
+{
+    memory_accounts& a = accounts();
+    std::lock_guard<std::mutex> guard(a.lock);
+    if (a.budget == 0) return std::numeric_limits<size_t>::max();
+    return (mem_used < a.budget ? a.budget-mem_used : 0);
+}
+
+std::vector<memory_site> ambit_memory_sites()
+{
+    std::map< std::pair<std::string,int>, memory_site > merged;
+
+    {
+        memory_accounts& a = accounts();
+        std::lock_guard<std::mutex> guard(a.lock);
+
+        /*
+         * the same file may be named by different string literals
+         */
+        for (std::map< std::pair<const char*,int>, site_usage >::iterator it = a.sites.begin();it != a.sites.end();++it)
+        {
+            memory_site& s = merged[std::make_pair(std::string(it->first.first), it->first.second)];
+            s.file = it->first.first;
+            s.line = it->first.second;
+            s.used += it->second.used;
+            s.peak += it->second.peak;
+            s.count += it->second.count;
+        }
+    }
+
+    std::vector<memory_site> sites;
+    for (std::map< std::pair<std::string,int>, memory_site >::iterator it = merged.begin();it != merged.end();++it)
+        sites.push_back(it->second);
+
+    std::stable_sort(sites.begin(), sites.end(),
+                     [](const memory_site& a, const memory_site& b) { return a.peak > b.peak; });
+
+    return sites;
+}
+
+void ambit_memory_report(const size_t nsite)
+{
+    std::vector<memory_site> sites = ambit_memory_sites();
+    const size_t budget = ambit_memory_get_budget();
+
+    printf("Memory: %zu bytes in use, %zu peak, %zu pooled", ambit_memory_used(), ambit_memory_peak(),
+           ambit_pool_get_cached());
+    if (budget != 0) printf(", %zu budget", budget);
+    printf("\n");
+
+    for (size_t i = 0;i < std::min(nsite, sites.size());i++)
+        printf("    %s:%d: %zu bytes in use, %zu peak, %zu allocations\n", sites[i].file.c_str(), sites[i].line,
+               sites[i].used, sites[i].peak, sites[i].count);
+}
+
+memory_arena::memory_arena(const size_t chunk)
+    : chunk_(std::max(chunk, min_pooled+1)), used_(0), reserved_(0), parent_(current_arena())
+{
+    current_arena() = this;
+}
+
+memory_arena::~memory_arena()
+{
+    for (size_t i = 0;i < chunks_.size();i++)
+    {
+        unreserve(chunks_[i].size, arena_site, 0);
+        release(chunks_[i].base, chunks_[i].size, chunks_[i].policy);
+    }
+    current_arena() = parent_;
+}
+
+memory_arena* memory_arena::active()
+{
+    return current_arena();
+}
+
+void* memory_arena::allocate(const size_t size_)
+{
+    /*
+     * Each block is preceded by its header and padded to a multiple of ALIGNMENT
+     */
+    const size_t size = (std::max(size_, size_t(1)) + ALIGNMENT-1)/ALIGNMENT*ALIGNMENT;
+
+    if (chunks_.empty() || chunks_.back().top + size > chunks_.back().size)
+    {
+        /*
+         * A chunk has ALIGNMENT bytes in front of its usable size (where ambit_malloc would put the header), so
+         * it holds blocks with headers totalling size + ALIGNMENT bytes
+         */
+        chunk c;
+        c.size = std::max(size_class(std::max(chunk_, size)), size);
+        if (!reserve(c.size, arena_site, 0, 0)) return NULL;
+
+        c.policy = block_policy(c.size);
+        c.base = acquire(c.size, c.policy);
+        if (c.base == NULL)
+        {
+            unreserve(c.size, arena_site, 0);
+            return NULL;
+        }
+
+        c.top = 0;
+        chunks_.push_back(c);
+        reserved_ += c.size;
+    }
+
+    chunk& c = chunks_.back();
+    block_header* header = (block_header*)(c.base + c.top);
+    header->size = size;
+    header->kind = kBlockArena;
+    header->owner = this;
+
+    c.top += ALIGNMENT + size;
+    used_ += size;
+
+    return (char*)header + ALIGNMENT;
+}
+
+void memory_arena::deallocate(void* ptr)
+{
+    char* base = (char*)ptr - ALIGNMENT;
+    block_header* header = (block_header*)base;
+    chunk& c = chunks_.back();
+
+    if (base + ALIGNMENT + header->size == c.base + c.top)
+    {
+        c.top -= ALIGNMENT + header->size;
+        used_ -= header->size;
+    }
 }
 
 }
@@ -20,6 +20,9 @@
 #define MINTS_LIB_UTIL_TIMER
 
 #include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
 
 #define SAFE_MALLOC(type, size) (type*)ambit::util::ambit_malloc(sizeof(type)*(size), __FILE__, __LINE__, 1)
 #define FREE(ptr) ambit::util::ambit_free(ptr, __FILE__, __LINE__)
@@ -52,11 +55,201 @@ for (x)
 
 #endif
 
+/**
+ * Placement policies for large blocks (see ambit_set_memory_policy): one of kMemoryFirstTouch (pages are placed on
+ * the NUMA node of the thread which first writes them, the system default), kMemoryInterleave (pages are spread over
+ * all nodes), or kMemoryBind (pages are placed on the node given by memory_policy_bind), optionally combined with
+ * kMemoryHugePages (transparent huge pages are requested with madvise)
+ */
+enum
+{
+    kMemoryFirstTouch = 0,
+    kMemoryInterleave = 1,
+    kMemoryBind = 2,
+    kMemoryHugePages = 4
+};
+
+inline int memory_policy_bind(const int node) { return kMemoryBind | (node << 8); }
+inline int memory_policy_node(const int policy) { return policy >> 8; }
+
+/**
+ * Set or get the policy for blocks of at least 2 MiB allocated by ambit_malloc (smaller blocks always use
+ * kMemoryFirstTouch); blocks with a policy are aligned to 2 MiB. Where the system does not support a policy (e.g. on
+ * a single node) it has no effect.
+ */
+void ambit_set_memory_policy(const int policy);
+int ambit_get_memory_policy();
+
+/**
+ * Apply a policy to the pages inside an existing block, moving those already placed; return 0 on success
+ */
+int ambit_apply_memory_policy(void* ptr, const size_t size, const int policy);
+
+/**
+ * Override the policy for the blocks allocated on this thread while the scope exists, e.g. for one tensor
+ */
+class memory_policy_scope
+{
+public:
+    explicit memory_policy_scope(const int policy);
+    ~memory_policy_scope();
+
+private:
+    memory_policy_scope(const memory_policy_scope&);
+    memory_policy_scope& operator=(const memory_policy_scope&);
+
+    int parent_;
+};
+
+/**
+ * The number of bytes currently allocated by ambit_malloc (the same as ambit_memory_used())
+ */
 extern size_t mem_used;
 
+/**
+ * Thrown by ambit_malloc when an allocation would exceed the budget set by ambit_memory_set_budget
+ */
+class memory_budget_error : public std::bad_alloc
+{
+public:
+    memory_budget_error(const size_t requested, const size_t used, const size_t budget,
+                        const char* file, const int line);
+
+    virtual const char* what() const throw() { return what_.c_str(); }
+
+    size_t requested() const { return requested_; }
+    size_t used() const { return used_; }
+    size_t budget() const { return budget_; }
+
+private:
+    std::string what_;
+    size_t requested_;
+    size_t used_;
+    size_t budget_;
+};
+
+/**
+ * Allocate and free memory aligned to ALIGNMENT
+ *
+ * Blocks are allocated with a small header recording their size. Blocks of more than 4 KiB are rounded up to one of
+ * four size classes per power of two, and when freed are kept in a pool for reuse by later allocations of the same
+ * class instead of being returned to the system (see ambit_pool_set_limit). While a memory_arena is active on the
+ * calling thread, blocks are instead carved out of the arena.
+ *
+ * The memory in use is accounted for in total and by call site (who and where, normally __FILE__ and __LINE__), with
+ * the chunks of arenas counted as a single site. If an allocation would exceed the memory budget it fails, with a
+ * memory_budget_error thrown if bailout is nonzero and NULL returned otherwise (the system running out of memory
+ * still aborts if bailout is nonzero).
+ */
 void* ambit_malloc(const size_t size, const char* who, const int where, const int bailout=1);
 void ambit_free(void* ptr, const char* who, const int where);
 
+/**
+ * Set or get the largest number of bytes which may be allocated at once by ambit_malloc (excluding the blocks kept
+ * in the pool, which are returned to the system as needed to stay within it); zero, the default, means no limit
+ */
+void ambit_memory_set_budget(const size_t bytes);
+size_t ambit_memory_get_budget();
+
+/**
+ * The number of bytes currently allocated, the largest number allocated at once since the start or the last call to
+ * ambit_memory_reset_peak, and the number which may still be allocated within the budget
+ */
+size_t ambit_memory_used();
+size_t ambit_memory_peak();
+void ambit_memory_reset_peak();
+size_t ambit_memory_available();
+
+/**
+ * Allocations by call site
+ */
+struct memory_site
+{
+    std::string file;
+    int line;
+    size_t used;
+    size_t peak;
+    size_t count;
+};
+
+/**
+ * The call sites which have allocated memory, in decreasing order of peak usage
+ */
+std::vector<memory_site> ambit_memory_sites();
+
+/**
+ * Print the totals and the call sites with the largest peak usage
+ */
+void ambit_memory_report(const size_t nsite = 10);
+
+/**
+ * Set or get the largest number of bytes which the pool keeps for reuse; freed blocks which would exceed it are
+ * returned to the system. The default is 1 GiB, and a limit of zero disables the pool.
+ */
+void ambit_pool_set_limit(const size_t bytes);
+size_t ambit_pool_get_limit();
+
+/**
+ * The number of bytes currently kept in the pool
+ */
+size_t ambit_pool_get_cached();
+
+/**
+ * Return pooled blocks to the system until at most bytes remain in the pool
+ */
+void ambit_pool_trim(const size_t bytes = 0);
+
+/**
+ * A scoped arena for the temporaries of e.g. one iteration of a solver
+ *
+ * While a memory_arena exists, ambit_malloc on the same thread allocates from it by advancing a pointer through large
+ * chunks (taken from the pool), and ambit_free of its blocks does nothing, except that freeing the most recent block
+ * makes its memory available again (so scratch freed in the reverse order of allocation is reused). The destructor
+ * releases everything allocated from the arena at once, so nothing allocated while it is active may be used after
+ * it is destroyed. Arenas may be nested, in which case the innermost one is used.
+ */
+class memory_arena
+{
+public:
+    explicit memory_arena(const size_t chunk = size_t(64) << 20);
+    ~memory_arena();
+
+    /*
+     * Allocate size bytes from the arena, or free the block at ptr
+     */
+    void* allocate(const size_t size);
+    void deallocate(void* ptr);
+
+    /*
+     * The number of bytes currently allocated from the arena, and the total size of its chunks
+     */
+    size_t used() const { return used_; }
+    size_t reserved() const { return reserved_; }
+
+    /*
+     * The innermost arena active on this thread, or NULL
+     */
+    static memory_arena* active();
+
+private:
+    memory_arena(const memory_arena&);
+    memory_arena& operator=(const memory_arena&);
+
+    struct chunk
+    {
+        char* base;
+        size_t size;
+        size_t top;
+        int policy;
+    };
+
+    std::vector<chunk> chunks_;
+    size_t chunk_;
+    size_t used_;
+    size_t reserved_;
+    memory_arena* parent_;
+};
+
 }
 }
 
@@ -35,6 +35,8 @@
 #endif // defined(MPI)
 
 #include <boost/shared_ptr.hpp>
+#include <cassert>
+#include <complex>
 #include <vector>
 
 namespace ambit {
@@ -142,6 +144,11 @@ public:
         comm.Free();
     }
 
+    const MPI::Intracomm& get_comm() const
+    {
+        return comm;
+    }
+
     template <typename T>
     tCTF_World<T>& ctf();
 
@@ -180,6 +187,167 @@ public:
         buffer.resize(len);
         comm.Bcast((void*)&(buffer[0]), len, MPI_TYPE_<char>::value(), root);
     }
+
+    /*
+     * Reductions, with op one of the MPI reduction operations (MPI::SUM, MPI::MAX, ...)
+     *
+     * The forms taking a single buffer reduce in place; for reduce, the result is only defined on root.
+     */
+    template<typename T>
+    void allreduce(const T* sendbuf, T* recvbuf, int count, const MPI::Op& op = MPI::SUM) const
+    {
+        comm.Allreduce(sendbuf, recvbuf, count, MPI_TYPE_<T>::value(), op);
+    }
+
+    template<typename T>
+    void allreduce(T* buffer, int count, const MPI::Op& op = MPI::SUM) const
+    {
+        comm.Allreduce(MPI::IN_PLACE, buffer, count, MPI_TYPE_<T>::value(), op);
+    }
+
+    template<typename T>
+    void allreduce(std::vector<T>& buffer, const MPI::Op& op = MPI::SUM) const
+    {
+        allreduce(buffer.data(), buffer.size(), op);
+    }
+
+    template<typename T>
+    T allreduce(T val, const MPI::Op& op = MPI::SUM) const
+    {
+        T result;
+        allreduce(&val, &result, 1, op);
+        return result;
+    }
+
+    template<typename T>
+    void reduce(const T* sendbuf, T* recvbuf, int count, int root, const MPI::Op& op = MPI::SUM) const
+    {
+        comm.Reduce(sendbuf, recvbuf, count, MPI_TYPE_<T>::value(), op, root);
+    }
+
+    template<typename T>
+    void reduce(T* buffer, int count, int root, const MPI::Op& op = MPI::SUM) const
+    {
+        comm.Reduce(rank == root ? MPI::IN_PLACE : buffer, buffer, count, MPI_TYPE_<T>::value(), op, root);
+    }
+
+    template<typename T>
+    void reduce(std::vector<T>& buffer, int root, const MPI::Op& op = MPI::SUM) const
+    {
+        reduce(buffer.data(), buffer.size(), root, op);
+    }
+
+    /*
+     * Gathers onto every process, in rank order: count elements from each process, or for allgatherv, any number
+     * (with the number from each process returned in counts if it is given)
+     */
+    template<typename T>
+    void allgather(const T* sendbuf, int count, T* recvbuf) const
+    {
+        const MPI::Datatype& type = MPI_TYPE_<T>::value();
+        comm.Allgather(sendbuf, count, type, recvbuf, count, type);
+    }
+
+    template<typename T>
+    std::vector<T> allgather(T val) const
+    {
+        std::vector<T> result(nproc);
+        allgather(&val, 1, result.data());
+        return result;
+    }
+
+    template<typename T>
+    void allgather(const std::vector<T>& sendbuf, std::vector<T>& recvbuf) const
+    {
+        recvbuf.resize(sendbuf.size()*nproc);
+        allgather(sendbuf.data(), sendbuf.size(), recvbuf.data());
+    }
+
+    template<typename T>
+    void allgatherv(const std::vector<T>& sendbuf, std::vector<T>& recvbuf, std::vector<int>* counts = NULL) const
+    {
+        const MPI::Datatype& type = MPI_TYPE_<T>::value();
+        std::vector<int> recvcounts = allgather((int)sendbuf.size());
+        std::vector<int> displs(nproc, 0);
+
+        for (int i = 1;i < nproc;i++) displs[i] = displs[i-1]+recvcounts[i-1];
+        recvbuf.resize(displs[nproc-1]+recvcounts[nproc-1]);
+
+        comm.Allgatherv(sendbuf.data(), sendbuf.size(), type, recvbuf.data(), recvcounts.data(), displs.data(), type);
+
+        if (counts) counts->swap(recvcounts);
+    }
+
+    /*
+     * All-to-all exchanges: count elements to and from each process, or for alltoallv, sendcounts[i] elements to
+     * process i (taken from sendbuf in rank order), with the numbers received returned in recvcounts
+     */
+    template<typename T>
+    void alltoall(const T* sendbuf, int count, T* recvbuf) const
+    {
+        const MPI::Datatype& type = MPI_TYPE_<T>::value();
+        comm.Alltoall(sendbuf, count, type, recvbuf, count, type);
+    }
+
+    template<typename T>
+    void alltoall(const std::vector<T>& sendbuf, std::vector<T>& recvbuf) const
+    {
+        assert(sendbuf.size()%nproc == 0);
+        recvbuf.resize(sendbuf.size());
+        alltoall(sendbuf.data(), sendbuf.size()/nproc, recvbuf.data());
+    }
+
+    template<typename T>
+    void alltoallv(const std::vector<T>& sendbuf, const std::vector<int>& sendcounts,
+                   std::vector<T>& recvbuf, std::vector<int>& recvcounts) const
+    {
+        const MPI::Datatype& type = MPI_TYPE_<T>::value();
+        std::vector<int> sdispls(nproc, 0), rdispls(nproc, 0);
+
+        assert((int)sendcounts.size() == nproc);
+        recvcounts.resize(nproc);
+        alltoall(sendcounts.data(), 1, recvcounts.data());
+
+        for (int i = 1;i < nproc;i++)
+        {
+            sdispls[i] = sdispls[i-1]+sendcounts[i-1];
+            rdispls[i] = rdispls[i-1]+recvcounts[i-1];
+        }
+        recvbuf.resize(rdispls[nproc-1]+recvcounts[nproc-1]);
+
+        comm.Alltoallv(sendbuf.data(), sendcounts.data(), sdispls.data(), type,
+                       recvbuf.data(), recvcounts.data(), rdispls.data(), type);
+    }
+
+    /*
+     * Nonblocking collectives, which complete when the returned request is waited on (request.Wait()) or tested
+     * successfully; the buffers must not be touched until then
+     *
+     * These are MPI-3 operations, which the MPI C++ bindings do not have, so they call the C interface.
+     */
+    template<typename T>
+    MPI::Request ibcast(T* buffer, int count, int root) const
+    {
+        MPI_Request request;
+        MPI_Ibcast(buffer, count, MPI_TYPE_<T>::value(), root, comm, &request);
+        return request;
+    }
+
+    template<typename T>
+    MPI::Request iallreduce(const T* sendbuf, T* recvbuf, int count, const MPI::Op& op = MPI::SUM) const
+    {
+        MPI_Request request;
+        MPI_Iallreduce(sendbuf, recvbuf, count, MPI_TYPE_<T>::value(), op, comm, &request);
+        return request;
+    }
+
+    template<typename T>
+    MPI::Request iallreduce(T* buffer, int count, const MPI::Op& op = MPI::SUM) const
+    {
+        MPI_Request request;
+        MPI_Iallreduce(MPI_IN_PLACE, buffer, count, MPI_TYPE_<T>::value(), op, comm, &request);
+        return request;
+    }
 };
 
 template <>